@@ -6,6 +6,7 @@
  * - 1-factor full bandwidth test
  * - fcc Broadcast
  * - fcc PrefixSum
+ * - random block transmissions, optionally comparing TCP dispatchers
  *
  * Part of Project Thrill - http://project-thrill.org
  *
@@ -23,6 +24,12 @@
 #include <thrill/common/string.hpp>
 #include <thrill/net/dispatcher.hpp>
 #include <tlx/cmdline_parser.hpp>
+#include <tlx/die.hpp>
+#include <tlx/string/split.hpp>
+
+#if THRILL_HAVE_NET_TCP
+#include <thrill/net/tcp/group.hpp>
+#endif
 
 #include <iostream>
 #include <string>
@@ -646,6 +653,10 @@ public:
         clp.add_unsigned('R', "outer_repeats", outer_repeats_,
                          "Repeat whole experiment a number of times.");
 
+        clp.add_string('D', "dispatcher", dispatcher_name_,
+                       "TCP dispatcher: select, epoll, or uring, "
+                       "default: backend's");
+
         if (!clp.process(argc, argv)) return -1;
 
         return api::Run(
@@ -667,7 +678,7 @@ public:
 
             group_ = &ctx.net.group();
             std::unique_ptr<net::Dispatcher> dispatcher =
-                group_->ConstructDispatcher();
+                ConstructDispatcher();
             dispatcher_ = dispatcher.get();
 
             t.Start();
@@ -706,6 +717,8 @@ public:
                 << " requests=" << num_requests_
                 << " block_size=" << block_size_
                 << " limit_active=" << limit_active_
+                << " dispatcher="
+                << (dispatcher_name_.empty() ? "default" : dispatcher_name_)
                 << " time[us]=" << time
                 << " time_per_op[us]="
                 << static_cast<double>(time) / num_requests_
@@ -716,6 +729,23 @@ public:
         }
     }
 
+    //! construct the selected dispatcher for the group's connections
+    std::unique_ptr<net::Dispatcher> ConstructDispatcher() {
+        if (dispatcher_name_.empty())
+            return group_->ConstructDispatcher();
+#if THRILL_HAVE_NET_TCP
+        die_unless(dynamic_cast<net::tcp::Group*>(group_) &&
+                   "explicit dispatchers require a tcp network backend");
+        std::unique_ptr<net::Dispatcher> dispatcher =
+            net::tcp::Group::ConstructDispatcher(dispatcher_name_);
+        die_unless(dispatcher && "unknown or unsupported dispatcher");
+        return dispatcher;
+#else
+        die("explicit dispatchers require a tcp network backend");
+        return nullptr;
+#endif
+    }
+
     void OnComplete() {
         --active_;
 
@@ -793,6 +823,9 @@ protected:
     //! limit on the number of simultaneous active requests
     unsigned int limit_active_ = 16;
 
+    //! name of TCP dispatcher to construct, empty for the group's default
+    std::string dispatcher_name_;
+
     //! communication group
     net::Group* group_;
 
@@ -837,6 +870,10 @@ public:
         clp.add_bytes('L', "max_limit_active", max_limit_active_,
                       "maximum number of simultaneous active requests, default: 512");
 
+        clp.add_string('D', "dispatchers", dispatcher_list_,
+                       "Comma-separated TCP dispatchers to compare, "
+                       "e.g. select,epoll,uring, default: backend's");
+
         if (!clp.process(argc, argv)) return -1;
 
         return api::Run(
@@ -849,16 +886,22 @@ public:
 
     void Test(api::Context& ctx) {
 
+        std::vector<std::string> dispatchers =
+            tlx::split(',', dispatcher_list_);
+
         for (size_t block_size = min_block_size_;
              block_size <= max_block_size_; block_size *= 2) {
 
             for (size_t limit_active = min_limit_active_;
                  limit_active <= max_limit_active_; limit_active *= 2) {
 
-                Super::num_requests_ = total_bytes_ / block_size;
-                Super::block_size_ = block_size;
-                Super::limit_active_ = limit_active;
-                Super::Test(ctx);
+                for (const std::string& dispatcher : dispatchers) {
+                    Super::num_requests_ = total_bytes_ / block_size;
+                    Super::block_size_ = block_size;
+                    Super::limit_active_ = limit_active;
+                    Super::dispatcher_name_ = dispatcher;
+                    Super::Test(ctx);
+                }
             }
         }
     }
@@ -878,6 +921,9 @@ protected:
 
     //! max limit on the number of simultaneous active requests
     unsigned int max_limit_active_ = 512;
+
+    //! comma-separated list of dispatchers to run experiments with
+    std::string dispatcher_list_;
 };
 
 /******************************************************************************/
@@ -893,6 +939,9 @@ void Usage(const char* argv0) {
         << "    allreduce  - FCC PrefixSum operation" << std::endl
         << "    rblocks    - random block transmissions" << std::endl
         << "    rblocks_series - series of rblocks experiments" << std::endl
+        << std::endl
+        << "The TCP dispatcher of the backend is selected with"
+        << " THRILL_NET=tcp-select, tcp-epoll, or tcp-uring." << std::endl
         << std::endl;
 }
 
@@ -14,6 +14,7 @@
 #include <thrill/api/sort.hpp>
 #include <thrill/api/write_binary.hpp>
 #include <thrill/common/logger.hpp>
+#include <thrill/common/radix_sort.hpp>
 #include <thrill/common/string.hpp>
 #include <tlx/cmdline_parser.hpp>
 
@@ -35,6 +36,8 @@ struct Record {
     bool operator < (const Record& b) const {
         return std::lexicographical_compare(key, key + 10, b.key, b.key + 10);
     }
+    // method used by radix sort to access 8-bit key at given depth
+    const uint8_t& at_radix(size_t depth) const { return key[depth]; }
     friend std::ostream& operator << (std::ostream& os, const Record& c) {
         return os << tlx::hexdump(c.key, 10);
     }
@@ -51,6 +54,11 @@ struct RecordSigned {
     bool operator < (const RecordSigned& b) const {
         return std::lexicographical_compare(key, key + 10, b.key, b.key + 10);
     }
+    // method used by radix sort to access 8-bit key at given depth, shifted
+    // such that negative characters come first
+    uint8_t at_radix(size_t depth) const {
+        return static_cast<uint8_t>(key[depth]) ^ 0x80;
+    }
     friend std::ostream& operator << (std::ostream& os, const RecordSigned& c) {
         return os << tlx::hexdump(c.key, 10);
     }
@@ -174,7 +182,8 @@ int main(int argc, char* argv[]) {
 
                 auto r =
                     Generate(ctx, size / sizeof(Record), GenerateRecord())
-                    .Sort();
+                    .Sort(std::less<Record>(),
+                          common::RadixSort<Record, 10>(256));
 
                 if (output.size())
                     r.WriteBinary(output);
@@ -183,7 +192,9 @@ int main(int argc, char* argv[]) {
             }
             else {
                 if (use_signed_char) {
-                    auto r = ReadBinary<RecordSigned>(ctx, input).Sort();
+                    auto r = ReadBinary<RecordSigned>(ctx, input).Sort(
+                        std::less<RecordSigned>(),
+                        common::RadixSort<RecordSigned, 10>(256));
 
                     if (output.size())
                         r.WriteBinary(output);
@@ -191,7 +202,8 @@ int main(int argc, char* argv[]) {
                         r.Size();
                 }
                 else {
-                    auto r = ReadBinary<Record>(ctx, input).Sort();
+                    auto r = ReadBinary<Record>(ctx, input).Sort(
+                        std::less<Record>(), common::RadixSort<Record, 10>(256));
 
                     if (output.size())
                         r.WriteBinary(output);
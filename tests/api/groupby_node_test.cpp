@@ -196,4 +196,51 @@ TEST(GroupByNode, GroupToIndexCorrectSize) {
     api::RunLocalTests(start_func);
 }
 
+TEST(GroupByNode, HashGroupingSmallGroups) {
+
+    auto start_func =
+        [](Context& ctx) {
+            size_t n = 99999;
+            static constexpr size_t m = 3;
+
+            auto sizets = Generate(ctx, n);
+
+            // many groups of m items each
+            auto div_keyfn = [](size_t in) { return in / m; };
+
+            auto sum_fn =
+                [](auto& r, size_t key) {
+                    size_t res = 0, count = 0;
+                    while (r.HasNext()) {
+                        res += r.Next();
+                        ++count;
+                    }
+                    die_unequal(m, count);
+                    die_unequal(m * key * m + m * (m - 1) / 2, res);
+                    return res;
+                };
+
+            // compute vector with expected results
+            std::vector<size_t> res_vec(n / m, 0);
+            for (size_t t = 0; t < n; ++t) {
+                res_vec[t / m] += t;
+            }
+
+            std::vector<size_t> out_vec =
+                sizets.GroupByKey<size_t>(HashGroupingTag, div_keyfn, sum_fn)
+                .AllGather();
+            std::sort(out_vec.begin(), out_vec.end());
+            ASSERT_EQ(res_vec, out_vec);
+
+            out_vec =
+                sizets.GroupByKey<size_t>(
+                    LocationDetectionTag, HashGroupingTag, div_keyfn, sum_fn)
+                .AllGather();
+            std::sort(out_vec.begin(), out_vec.end());
+            ASSERT_EQ(res_vec, out_vec);
+        };
+
+    api::RunLocalTests(start_func);
+}
+
 /******************************************************************************/
@@ -11,6 +11,7 @@
 #include <thrill/api/all_gather.hpp>
 #include <thrill/api/generate.hpp>
 #include <thrill/api/inner_join.hpp>
+#include <thrill/api/size.hpp>
 #include <thrill/api/sum.hpp>
 #include <thrill/common/logger.hpp>
 
@@ -220,4 +221,224 @@ TEST(Join, DifferentTypes) {
     api::RunLocalTests(start_func);
 }
 
+TEST(Join, BroadcastSmallSide) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            using IntPair = std::pair<size_t, size_t>;
+            using IntTuple = std::tuple<size_t, size_t, size_t>;
+
+            // small dimension table and large fact table, the dimension table
+            // is broadcast to all workers.
+            size_t m = 100;
+            size_t n = 100000;
+
+            auto dim = Generate(ctx, m, [](const size_t& e) {
+                                    return std::make_pair(e, e * e);
+                                });
+
+            auto fact = Generate(ctx, n, [](const size_t& e) {
+                                     return std::make_pair(e % 100, e);
+                                 });
+
+            auto key_ex = [](const IntPair& input) {
+                              return input.first;
+                          };
+
+            auto check =
+                [n](std::vector<IntTuple> out_vec) {
+                    std::sort(out_vec.begin(), out_vec.end(),
+                              [](const IntTuple& a, const IntTuple& b) {
+                                  return std::get<2>(a) < std::get<2>(b);
+                              });
+
+                    ASSERT_EQ(n, out_vec.size());
+                    for (size_t i = 0; i < out_vec.size(); i++) {
+                        size_t k = i % 100;
+                        ASSERT_EQ(std::make_tuple(k, k * k, i), out_vec[i]);
+                    }
+                };
+
+            // small input first
+            auto joined1 = InnerJoin(
+                dim, fact, key_ex, key_ex,
+                [](const IntPair& d, const IntPair& f) {
+                    return std::make_tuple(d.first, d.second, f.second);
+                });
+            check(joined1.AllGather());
+
+            // small input second
+            auto joined2 = InnerJoin(
+                fact, dim, key_ex, key_ex,
+                [](const IntPair& f, const IntPair& d) {
+                    return std::make_tuple(d.first, d.second, f.second);
+                });
+            check(joined2.AllGather());
+        };
+
+    api::RunLocalTests(start_func);
+}
+
+TEST(Join, LowMatchRateNoLocationDetection) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            using IntPair = std::pair<size_t, size_t>;
+
+            // only every 20th key of the second input occurs in the first
+            size_t n = 100000;
+
+            auto dia1 = Generate(ctx, n, [](const size_t& e) {
+                                     return std::make_pair(e, e + 1);
+                                 });
+
+            auto dia2 = Generate(ctx, n, [](const size_t& e) {
+                                     return std::make_pair(e * 20, e);
+                                 });
+
+            auto key_ex = [](const IntPair& input) {
+                              return input.first;
+                          };
+
+            auto join_fn = [](const IntPair& input1, const IntPair& input2) {
+                               return std::make_pair(input1.second,
+                                                     input2.second);
+                           };
+
+            auto joined = InnerJoin(NoLocationDetectionTag,
+                                    dia1, dia2, key_ex, key_ex, join_fn);
+            std::vector<IntPair> out_vec = joined.AllGather();
+
+            std::sort(out_vec.begin(), out_vec.end());
+
+            ASSERT_EQ(n / 20, out_vec.size());
+            for (size_t i = 0; i < out_vec.size(); i++) {
+                ASSERT_EQ(std::make_pair(i * 20 + 1, i), out_vec[i]);
+            }
+        };
+
+    api::RunLocalTests(start_func);
+}
+
+TEST(Join, SkewedKey) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            using IntPair = std::pair<size_t, size_t>;
+
+            // three quarters of the first input and four items of the second
+            // have key zero.
+            size_t n = 100000;
+
+            auto dia1 = Generate(ctx, n, [](const size_t& e) {
+                                     return std::make_pair(
+                                         e % 4 == 3 ? e : 0, e);
+                                 });
+
+            auto dia2 = Generate(ctx, n, [](const size_t& e) {
+                                     return std::make_pair(e < 4 ? 0 : e, e);
+                                 });
+
+            auto key_ex = [](const IntPair& input) {
+                              return input.first;
+                          };
+
+            auto join_fn = [](const IntPair& input1, const IntPair& input2) {
+                               return std::make_pair(input1.second,
+                                                     input2.second);
+                           };
+
+            std::vector<IntPair> check;
+            for (size_t i = 0; i < n; ++i) {
+                if (i % 4 != 3) {
+                    for (size_t j = 0; j < 4; ++j)
+                        check.emplace_back(i, j);
+                }
+                else if (i >= 4) {
+                    check.emplace_back(i, i);
+                }
+            }
+
+            for (bool location_detection : { true, false }) {
+                std::vector<IntPair> out_vec =
+                    location_detection
+                    ? InnerJoin(LocationDetectionTag,
+                                dia1, dia2, key_ex, key_ex, join_fn)
+                    .AllGather()
+                    : InnerJoin(NoLocationDetectionTag,
+                                dia1, dia2, key_ex, key_ex, join_fn)
+                    .AllGather();
+
+                std::sort(out_vec.begin(), out_vec.end());
+                ASSERT_EQ(check, out_vec);
+            }
+        };
+
+    api::RunLocalTests(start_func);
+}
+
+//! large item, such that few of them fill the memory limit of the join
+struct LargeItem {
+    size_t key;
+    size_t index;
+    char   payload[16 * 1024];
+};
+
+TEST(Join, ManyEqualKeysLowMemory) {
+
+    // number of items with key zero, and with distinct keys in each input
+    static constexpr size_t equal = 2000;
+    static constexpr size_t distinct = 1000;
+    static constexpr size_t n = equal + distinct;
+
+    auto start_func =
+        [](Context& ctx) {
+
+            auto make_item = [](const size_t& e) {
+                                 LargeItem item;
+                                 item.key = e < equal ? 0 : e;
+                                 item.index = e;
+                                 std::fill(item.payload,
+                                           item.payload + sizeof(item.payload),
+                                           static_cast<char>(e));
+                                 return item;
+                             };
+
+            auto dia1 = Generate(ctx, n, make_item);
+            auto dia2 = Generate(ctx, n, make_item);
+
+            auto key_ex = [](const LargeItem& item) { return item.key; };
+
+            // the hash tables of the partitions exceed the memory limit, hence
+            // they are grace partitioned, and the equal keys are joined
+            // block-wise.
+            auto joined = InnerJoin(
+                dia1, dia2, key_ex, key_ex,
+                [](const LargeItem& a, const LargeItem& b) {
+                    die_unless(a.payload[0] == static_cast<char>(a.index));
+                    return a.index * n + b.index;
+                });
+
+            size_t check = 0;
+            for (size_t i = 0; i < equal; ++i) {
+                for (size_t j = 0; j < equal; ++j)
+                    check += i * n + j;
+            }
+            for (size_t i = equal; i < n; ++i)
+                check += i * n + i;
+
+            ASSERT_EQ(equal * equal + distinct, joined.Keep().Size());
+            ASSERT_EQ(check, joined.Sum());
+        };
+
+    // set small amount of RAM for testing
+    api::MemoryConfig mem_config;
+    mem_config.setup(128 * 1024 * 1024llu);
+
+    api::RunLocalMock(mem_config, 2, 1, start_func);
+}
+
 /******************************************************************************/
@@ -87,6 +87,10 @@ TEST(ReduceNode, ReduceModulo2CorrectResults) {
         TestReduceModulo2CorrectResults<ReduceTableImpl::BUCKET>());
     api::RunLocalTests(
         TestReduceModulo2CorrectResults<ReduceTableImpl::OLD_PROBING>());
+    api::RunLocalTests(
+        TestReduceModulo2CorrectResults<ReduceTableImpl::CONCURRENT>());
+    api::RunLocalTests(
+        TestReduceModulo2CorrectResults<ReduceTableImpl::SWISS>());
 }
 
 //! Test sums of integers 0..n-1 for n=100 in 1000 buckets in the reduce table
@@ -136,6 +140,176 @@ TEST(ReduceNode, ReduceModuloPairsCorrectResults) {
         TestReduceModuloPairsCorrectResults<ReduceTableImpl::BUCKET>());
     api::RunLocalTests(
         TestReduceModuloPairsCorrectResults<ReduceTableImpl::OLD_PROBING>());
+    api::RunLocalTests(
+        TestReduceModuloPairsCorrectResults<ReduceTableImpl::CONCURRENT>());
+    api::RunLocalTests(
+        TestReduceModuloPairsCorrectResults<ReduceTableImpl::SWISS>());
+}
+
+//! reduce among the workers of each host first
+template <ReduceTableImpl table_impl>
+class HierarchicalReduceConfig
+    : public core::DefaultReduceConfigSelect<table_impl>
+{
+public:
+    static constexpr bool use_hierarchical_ = true;
+};
+
+template <ReduceTableImpl table_impl>
+class TestReduceHierarchicalCorrectResults
+{
+public:
+    void operator () (Context& ctx) {
+        static constexpr size_t test_size = 100000u;
+        static constexpr size_t mod_size = 100u;
+        static constexpr size_t div_size = test_size / mod_size;
+
+        using IntPair = std::pair<size_t, size_t>;
+
+        auto integers = Generate(
+            ctx, test_size,
+            [](const size_t& index) {
+                return IntPair(index % mod_size, index / mod_size);
+            });
+
+        auto add_function = [](const size_t& in1, const size_t& in2) {
+                                return in1 + in2;
+                            };
+
+        // ReducePair keeps the key, ReduceByKey with VolatileKey sends it
+        std::vector<IntPair> out_vec =
+            integers.ReducePair(
+                add_function, HierarchicalReduceConfig<table_impl>())
+            .AllGather();
+
+        std::vector<IntPair> out_vec_volatile =
+            integers.ReduceByKey(
+                VolatileKeyTag,
+                [](const IntPair& p) { return p.first; },
+                [](const IntPair& a, const IntPair& b) {
+                    return IntPair(a.first, a.second + b.second);
+                },
+                HierarchicalReduceConfig<table_impl>())
+            .AllGather();
+
+        for (std::vector<IntPair>* v : { &out_vec, &out_vec_volatile }) {
+            std::sort(v->begin(), v->end());
+
+            ASSERT_EQ(mod_size, v->size());
+            for (size_t i = 0; i < mod_size; ++i) {
+                ASSERT_EQ(i, (*v)[i].first);
+                ASSERT_EQ((div_size * (div_size - 1)) / 2u, (*v)[i].second);
+            }
+        }
+    }
+};
+
+TEST(ReduceNode, ReduceHierarchicalCorrectResults) {
+    api::RunLocalTests(
+        TestReduceHierarchicalCorrectResults<ReduceTableImpl::PROBING>());
+    api::RunLocalTests(
+        TestReduceHierarchicalCorrectResults<ReduceTableImpl::CONCURRENT>());
+}
+
+//! Test sums with one key carrying half of the items, which is detected as a
+//! heavy hitter.
+template <ReduceTableImpl table_impl>
+class TestReduceHeavyHittersCorrectResults
+{
+public:
+    void operator () (Context& ctx) {
+        static constexpr size_t test_size = 200000u;
+        static constexpr size_t mod_size = 1000u;
+
+        using IntPair = std::pair<size_t, size_t>;
+
+        auto integers = Generate(
+            ctx, test_size,
+            [](const size_t& index) {
+                return IntPair(index % 2 ? 0 : index % mod_size, 1);
+            });
+
+        core::DefaultReduceConfigSelect<table_impl> config;
+        config.heavy_hitter_fraction_ = 0.05;
+
+        std::vector<IntPair> out_vec =
+            integers.ReducePair(
+                [](const size_t& a, const size_t& b) { return a + b; },
+                config)
+            .AllGather();
+
+        std::sort(out_vec.begin(), out_vec.end());
+
+        // even indexes cover the even keys, odd ones all go to key 0
+        ASSERT_EQ(mod_size / 2, out_vec.size());
+        ASSERT_EQ(0u, out_vec[0].first);
+        ASSERT_EQ(test_size / 2 + test_size / mod_size, out_vec[0].second);
+        for (size_t i = 1; i < out_vec.size(); ++i) {
+            ASSERT_EQ(2 * i, out_vec[i].first);
+            ASSERT_EQ(test_size / mod_size, out_vec[i].second);
+        }
+    }
+};
+
+TEST(ReduceNode, ReduceHeavyHittersCorrectResults) {
+    api::RunLocalTests(
+        TestReduceHeavyHittersCorrectResults<ReduceTableImpl::PROBING>());
+    api::RunLocalTests(
+        TestReduceHeavyHittersCorrectResults<ReduceTableImpl::BUCKET>());
+    api::RunLocalTests(
+        TestReduceHeavyHittersCorrectResults<ReduceTableImpl::CONCURRENT>());
+}
+
+//! Test sums with one key in the odd items of the first quarter only, which is
+//! heavy globally but not seen at all by the workers holding the rest.
+template <typename ReduceConfig>
+class TestReduceGlobalHeavyHittersCorrectResults
+{
+public:
+    void operator () (Context& ctx) {
+        static constexpr size_t test_size = 200000u;
+        static constexpr size_t mod_size = 1000u;
+
+        using IntPair = std::pair<size_t, size_t>;
+
+        auto integers = Generate(
+            ctx, test_size,
+            [](const size_t& index) {
+                return IntPair(
+                    index < test_size / 4 && index % 2 ? 0 : index % mod_size,
+                    1);
+            });
+
+        ReduceConfig config;
+        config.heavy_hitter_fraction_ = 0.05;
+
+        std::vector<IntPair> out_vec =
+            integers.ReducePair(
+                [](const size_t& a, const size_t& b) { return a + b; },
+                config)
+            .AllGather();
+
+        std::sort(out_vec.begin(), out_vec.end());
+
+        // odd keys lose the items of the first quarter to key 0
+        ASSERT_EQ(mod_size, out_vec.size());
+        ASSERT_EQ(0u, out_vec[0].first);
+        ASSERT_EQ(test_size / 8 + test_size / mod_size, out_vec[0].second);
+        for (size_t i = 1; i < out_vec.size(); ++i) {
+            ASSERT_EQ(i, out_vec[i].first);
+            ASSERT_EQ(i % 2 ? test_size / mod_size * 3 / 4
+                      : test_size / mod_size, out_vec[i].second);
+        }
+    }
+};
+
+TEST(ReduceNode, ReduceGlobalHeavyHittersCorrectResults) {
+    api::RunLocalTests(
+        TestReduceGlobalHeavyHittersCorrectResults<
+            core::DefaultReduceConfigSelect<ReduceTableImpl::PROBING> >());
+    api::RunLocalTests(
+        TestReduceGlobalHeavyHittersCorrectResults<
+            HierarchicalReduceConfig<ReduceTableImpl::PROBING> >());
 }
 
 template <ReduceTableImpl table_impl>
@@ -212,6 +386,10 @@ TEST(ReduceNode, ReduceToIndexCorrectResults) {
         TestReduceToIndexCorrectResults<ReduceTableImpl::BUCKET>());
     api::RunLocalTests(
         TestReduceToIndexCorrectResults<ReduceTableImpl::OLD_PROBING>());
+    api::RunLocalTests(
+        TestReduceToIndexCorrectResults<ReduceTableImpl::CONCURRENT>());
+    api::RunLocalTests(
+        TestReduceToIndexCorrectResults<ReduceTableImpl::SWISS>());
 }
 
 TEST(ReduceToIndexNode, OutputSizeCheck) {
@@ -52,6 +52,53 @@ TEST(Sort, SortKnownIntegers) {
     api::RunLocalMock(mem_config, 2, 1, start_func);
 }
 
+struct LargeItem {
+    size_t key;
+    char   payload[248];
+};
+
+TEST(Sort, SortLargeItemsBackgroundSort) {
+
+    // about 100 MiB of items with 128 MiB RAM: the sort node receives many
+    // runs, which are sorted and written in the background.
+    static constexpr size_t test_size = 400000u;
+
+    auto start_func =
+        [](Context& ctx) {
+
+            auto items = Generate(
+                ctx, test_size,
+                [](const size_t& index) {
+                    LargeItem item;
+                    item.key = test_size - index - 1;
+                    std::fill(item.payload, item.payload + sizeof(item.payload),
+                              static_cast<char>(index));
+                    return item;
+                });
+
+            auto sorted = items.Sort(
+                [](const LargeItem& a, const LargeItem& b) {
+                    return a.key < b.key;
+                });
+
+            std::vector<size_t> out_vec =
+                sorted.Map([](const LargeItem& item) {
+                               return item.key;
+                           }).AllGather();
+
+            ASSERT_EQ(test_size, out_vec.size());
+            for (size_t i = 0; i < out_vec.size(); i++) {
+                ASSERT_EQ(i, out_vec[i]);
+            }
+        };
+
+    // set fixed amount of RAM for testing
+    api::MemoryConfig mem_config;
+    mem_config.setup(128 * 1024 * 1024llu);
+
+    api::RunLocalMock(mem_config, 2, 1, start_func);
+}
+
 TEST(Sort, SortRandomIntegers) {
 
     auto start_func =
@@ -159,6 +206,71 @@ TEST(Sort, SortRandomIntIntStructs) {
     api::RunLocalTests(start_func);
 }
 
+TEST(Sort, SortRandomIntegersParallelSortAlgorithm) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            std::default_random_engine generator(std::random_device { } ());
+            std::uniform_int_distribution<int> distribution(0, 10000);
+
+            auto integers = Generate(
+                ctx, 1000000,
+                [&distribution, &generator](const size_t&) -> int {
+                    return distribution(generator);
+                });
+
+            auto sorted = integers.Sort(
+                std::less<int>(), api::ParallelSortAlgorithm(ctx));
+
+            std::vector<int> out_vec = sorted.AllGather();
+
+            for (size_t i = 0; i < out_vec.size() - 1; i++) {
+                ASSERT_FALSE(out_vec[i + 1] < out_vec[i]);
+            }
+
+            ASSERT_EQ(1000000u, out_vec.size());
+        };
+
+    api::RunLocalTests(start_func);
+}
+
+TEST(Sort, SortRandomIntegersMultiLevelExchange) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            std::default_random_engine generator(std::random_device { } ());
+            std::uniform_int_distribution<int> distribution(0, 10000);
+
+            auto integers = Generate(
+                ctx, 100000,
+                [&distribution, &generator](const size_t&) -> int {
+                    return distribution(generator);
+                });
+
+            // lower both thresholds such that the local tests with 2-8
+            // workers exchange in multiple levels and select splitters
+            // distributedly.
+            api::DefaultSortConfig config;
+            config.max_single_level_workers_ = 2;
+            config.max_root_splitter_workers_ = 2;
+
+            auto sorted = integers.Sort(
+                std::less<int>(), api::DefaultSortAlgorithm(), config);
+
+            std::vector<int> out_vec = sorted.AllGather();
+
+            for (size_t i = 0; i + 1 < out_vec.size(); i++) {
+                ASSERT_FALSE(out_vec[i + 1] < out_vec[i]);
+            }
+
+            ASSERT_EQ(100000u, out_vec.size());
+        };
+
+    api::RunLocalTests(start_func);
+}
+
 TEST(Sort, SortZeros) {
 
     auto start_func =
@@ -364,6 +476,77 @@ TEST(SortStable, SortRandomIndexedIntegers) {
     api::RunLocalTests(start_func);
 }
 
+TEST(SortStable, SortRandomIndexedIntegersParallelSortAlgorithm) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            std::default_random_engine generator(std::random_device { } ());
+            std::uniform_int_distribution<size_t> distribution(0, 10);
+
+            auto pairs = Generate(
+                ctx, 1000000,
+                [&distribution, &generator](const size_t& index) -> auto {
+                    return IVPair{ distribution(generator), index };
+                });
+
+            auto sorted = pairs.SortStable(
+                std::less<IVPair>(), api::ParallelStableSortAlgorithm(ctx));
+
+            std::vector<IVPair> out_vec = sorted.AllGather();
+
+            ASSERT_EQ(1000000u, out_vec.size());
+            for (size_t i = 1; i < out_vec.size(); i++) {
+                ASSERT_LE(out_vec[i - 1].value, out_vec[i].value);
+
+                if (out_vec[i - 1].value == out_vec[i].value) {
+                    ASSERT_LT(out_vec[i - 1].index, out_vec[i].index);
+                }
+            }
+        };
+
+    api::RunLocalTests(start_func);
+}
+
+TEST(SortStable, SortRandomIndexedIntegersDistributedSplitters) {
+
+    auto start_func =
+        [](Context& ctx) {
+
+            std::default_random_engine generator(std::random_device { } ());
+            std::uniform_int_distribution<size_t> distribution(0, 10);
+
+            auto pairs = Generate(
+                ctx, 100000,
+                [&distribution, &generator](const size_t& index) -> auto {
+                    return IVPair{ distribution(generator), index };
+                });
+
+            // stable sorts never use the multi-level exchange, but do select
+            // splitters distributedly above the threshold.
+            api::DefaultSortConfig config;
+            config.max_single_level_workers_ = 2;
+            config.max_root_splitter_workers_ = 2;
+
+            auto sorted = pairs.SortStable(
+                std::less<IVPair>(), api::DefaultStableSortAlgorithm(),
+                config);
+
+            std::vector<IVPair> out_vec = sorted.AllGather();
+
+            ASSERT_EQ(100000u, out_vec.size());
+            for (size_t i = 1; i < out_vec.size(); i++) {
+                ASSERT_LE(out_vec[i - 1].value, out_vec[i].value);
+
+                if (out_vec[i - 1].value == out_vec[i].value) {
+                    ASSERT_LT(out_vec[i - 1].index, out_vec[i].index);
+                }
+            }
+        };
+
+    api::RunLocalTests(start_func);
+}
+
 TEST(SortStable, SortRandomIndexedIntegersCustomCompareFunction) {
 
     auto start_func =
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * tests/common/parallel_sort_test.cpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/common/parallel_sort.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace thrill;
+
+TEST(ParallelSort, RandomIntegers) {
+
+    std::default_random_engine rng(std::random_device { } ());
+    tlx::ThreadPool pool(3);
+
+    for (size_t num_threads : { 1, 2, 3, 4, 7 }) {
+        size_t test_size = 1024000 + rng() % 20480;
+        std::vector<size_t> vec(test_size);
+        for (size_t i = 0; i < test_size; ++i)
+            vec[i] = rng();
+
+        common::parallel_sort(vec.begin(), vec.end(), std::less<size_t>(),
+                              &pool, num_threads);
+
+        ASSERT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+    }
+}
+
+struct IVPair {
+    size_t value; // sort "key"
+    size_t index; // used to verify stability of sort
+};
+
+TEST(ParallelSort, StableRandomIndexedIntegers) {
+
+    std::default_random_engine rng(std::random_device { } ());
+    tlx::ThreadPool pool(3);
+
+    for (size_t num_threads : { 1, 2, 3, 4, 7 }) {
+        size_t test_size = 1024000 + rng() % 20480;
+        std::vector<IVPair> vec(test_size);
+        for (size_t i = 0; i < test_size; ++i)
+            vec[i] = IVPair { rng() % 100, i };
+
+        common::parallel_stable_sort(
+            vec.begin(), vec.end(),
+            [](const IVPair& a, const IVPair& b) { return a.value < b.value; },
+            &pool, num_threads);
+
+        for (size_t i = 1; i < vec.size(); ++i) {
+            ASSERT_LE(vec[i - 1].value, vec[i].value);
+            if (vec[i - 1].value == vec[i].value)
+                ASSERT_LT(vec[i - 1].index, vec[i].index);
+        }
+    }
+}
+
+//! item without default constructor, which owns heap memory
+class NamedItem
+{
+public:
+    explicit NamedItem(size_t value)
+        : value_(value), name_(std::to_string(value)) { }
+
+    size_t value() const { return value_; }
+    const std::string& name() const { return name_; }
+
+private:
+    size_t value_;
+    std::string name_;
+};
+
+TEST(ParallelSort, NoDefaultConstructor) {
+
+    std::default_random_engine rng(std::random_device { } ());
+    tlx::ThreadPool pool(3);
+
+    size_t test_size = 512000 + rng() % 20480;
+    std::vector<NamedItem> vec;
+    for (size_t i = 0; i < test_size; ++i)
+        vec.emplace_back(rng());
+
+    common::parallel_sort(
+        vec.begin(), vec.end(),
+        [](const NamedItem& a, const NamedItem& b) {
+            return a.value() < b.value();
+        },
+        &pool, 4);
+
+    for (size_t i = 1; i < vec.size(); ++i) {
+        ASSERT_LE(vec[i - 1].value(), vec[i].value());
+        ASSERT_EQ(std::to_string(vec[i].value()), vec[i].name());
+    }
+}
+
+TEST(ParallelSort, ThrowingComparator) {
+
+    std::default_random_engine rng(std::random_device { } ());
+    tlx::ThreadPool pool(3);
+
+    size_t test_size = 512000;
+    auto cmp = [](const size_t& a, const size_t& b) {
+                   if (a == 0 || b == 0) throw std::runtime_error("zero");
+                   return a < b;
+               };
+
+    // a zero in the first part throws on the calling thread, in the last part
+    // on a thread of the pool.
+    for (size_t pos : { size_t(0), test_size - 1 }) {
+        std::vector<size_t> vec(test_size);
+        for (size_t i = 0; i < test_size; ++i)
+            vec[i] = rng() | 1;
+        vec[pos] = 0;
+
+        ASSERT_THROW(
+            common::parallel_sort(vec.begin(), vec.end(), cmp, &pool, 4),
+            std::runtime_error);
+    }
+
+    // the pool is still usable
+    std::vector<size_t> vec(test_size);
+    for (size_t i = 0; i < test_size; ++i)
+        vec[i] = rng() | 1;
+    common::parallel_sort(vec.begin(), vec.end(), cmp, &pool, 4);
+    ASSERT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+}
+
+/******************************************************************************/
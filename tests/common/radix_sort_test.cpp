@@ -14,6 +14,9 @@
 
 #include <algorithm>
 #include <random>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 using namespace thrill;
@@ -51,4 +54,80 @@ TEST(RadixSort, RandomStrings) {
     ASSERT_TRUE(std::is_sorted(vec.begin(), vec.end()));
 }
 
+template <typename Type, typename Generator>
+static void TestRadixSortAuto(Generator gen) {
+
+    std::default_random_engine rng(std::random_device { } ());
+
+    size_t test_size = 1024000 + rng() % 20480;
+    std::vector<Type> vec;
+    vec.reserve(test_size);
+    for (size_t i = 0; i < test_size; ++i)
+        vec.emplace_back(gen(rng));
+
+    std::vector<Type> vec_correct = vec;
+    std::sort(vec_correct.begin(), vec_correct.end());
+
+    bool fallback_called = false;
+    common::radix_sort_auto(
+        vec.begin(), vec.end(), std::less<Type>(),
+        [&](auto begin, auto end, const std::less<Type>& cmp) {
+            fallback_called = true;
+            std::sort(begin, end, cmp);
+        });
+
+    ASSERT_FALSE(fallback_called);
+    ASSERT_TRUE(vec == vec_correct);
+}
+
+TEST(RadixSort, AutoSignedIntegers) {
+    TestRadixSortAuto<int64_t>(
+        [](auto& rng) { return static_cast<int64_t>(rng()) - (1 << 30); });
+}
+
+TEST(RadixSort, AutoUnsignedIntegers) {
+    TestRadixSortAuto<uint32_t>(
+        [](auto& rng) { return static_cast<uint32_t>(rng()); });
+}
+
+TEST(RadixSort, AutoPairs) {
+    TestRadixSortAuto<std::pair<int, uint64_t> >(
+        [](auto& rng) {
+            return std::make_pair(static_cast<int>(rng() % 16) - 8,
+                                  static_cast<uint64_t>(rng()));
+        });
+}
+
+TEST(RadixSort, AutoTuples) {
+    TestRadixSortAuto<std::tuple<char, int16_t, uint32_t> >(
+        [](auto& rng) {
+            return std::make_tuple(static_cast<char>(rng() % 256),
+                                   static_cast<int16_t>(rng() % 64 - 32),
+                                   static_cast<uint32_t>(rng()));
+        });
+}
+
+TEST(RadixSort, AutoStrings) {
+    TestRadixSortAuto<std::string>(
+        [](auto& rng) {
+            std::string s(rng() % 12, 0);
+            for (char& c : s)
+                c = static_cast<char>(rng() % 4 + (rng() % 8 == 0 ? 200 : 0));
+            return s;
+        });
+}
+
+TEST(RadixSort, AutoFallback) {
+    std::vector<double> vec = { 3.0, 1.0, 2.0 };
+    bool fallback_called = false;
+    common::radix_sort_auto(
+        vec.begin(), vec.end(), std::less<double>(),
+        [&](auto begin, auto end, const std::less<double>& cmp) {
+            fallback_called = true;
+            std::sort(begin, end, cmp);
+        });
+    ASSERT_TRUE(fallback_called);
+    ASSERT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+}
+
 /******************************************************************************/
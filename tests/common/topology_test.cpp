@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * tests/common/topology_test.cpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/common/topology.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace thrill;
+
+//! two sockets with four cores and two hyperthreads each, numbered like Linux
+//! does: first the cores of all sockets, then their siblings.
+static common::Topology MakeTwoSocketTopology() {
+    std::vector<common::CpuInfo> cpus;
+    for (size_t smt = 0; smt < 2; ++smt) {
+        for (size_t socket = 0; socket < 2; ++socket) {
+            for (size_t core = 0; core < 4; ++core) {
+                size_t id = smt * 8 + socket * 4 + core;
+                cpus.push_back(common::CpuInfo {
+                                   id, socket, socket, socket * 4, core, smt
+                               });
+            }
+        }
+    }
+    return common::Topology(cpus);
+}
+
+TEST(Topology, Counts) {
+    common::Topology t = MakeTwoSocketTopology();
+    ASSERT_EQ(16u, t.num_cpus());
+    ASSERT_EQ(2u, t.num_sockets());
+    ASSERT_EQ(2u, t.num_nodes());
+    ASSERT_EQ(2u, t.num_l3());
+    ASSERT_EQ(1u, t.cpu(13).socket);
+    ASSERT_EQ(1u, t.cpu(13).smt);
+}
+
+TEST(Topology, PlaceWorkersSpread) {
+    common::Topology t = MakeTwoSocketTopology();
+
+    // four workers: two per socket, on separate cores
+    std::vector<size_t> cpus = t.PlaceWorkers(4);
+    ASSERT_EQ(std::vector<size_t>({ 0, 1, 4, 5 }), cpus);
+    ASSERT_EQ(std::vector<size_t>({ 0, 0, 1, 1 }), t.SocketGroups(cpus));
+
+    // eight workers: all physical cores, no hyperthreads
+    cpus = t.PlaceWorkers(8);
+    ASSERT_EQ(std::vector<size_t>({ 0, 1, 2, 3, 4, 5, 6, 7 }), cpus);
+
+    // ten workers: five per socket, one hyperthread each
+    cpus = t.PlaceWorkers(10);
+    ASSERT_EQ(10u, std::set<size_t>(cpus.begin(), cpus.end()).size());
+    std::vector<size_t> groups = t.SocketGroups(cpus);
+    ASSERT_EQ(5, std::count(groups.begin(), groups.end(), 0u));
+    ASSERT_EQ(5, std::count(groups.begin(), groups.end(), 1u));
+    ASSERT_TRUE(std::is_sorted(groups.begin(), groups.end()));
+}
+
+TEST(Topology, PlaceWorkersOversubscribed) {
+    common::Topology t = MakeTwoSocketTopology();
+
+    // more workers than cpus: round-robin in hierarchy order
+    std::vector<size_t> cpus = t.PlaceWorkers(20);
+    ASSERT_EQ(20u, cpus.size());
+    ASSERT_EQ(16u, std::set<size_t>(cpus.begin(), cpus.end()).size());
+    ASSERT_EQ(cpus[0], cpus[16]);
+}
+
+TEST(Topology, PlaceWorkersCoreOffset) {
+    common::Topology t = MakeTwoSocketTopology();
+
+    // skip the first socket's physical cores
+    std::vector<size_t> cpus = t.PlaceWorkers(6, 4);
+    ASSERT_EQ(6u, std::set<size_t>(cpus.begin(), cpus.end()).size());
+    for (size_t c : cpus) ASSERT_GE(c, 4u);
+}
+
+TEST(Topology, DetectHost) {
+    const common::Topology& t = common::Topology::Host();
+    ASSERT_GE(t.num_cpus(), 1u);
+    ASSERT_GE(t.num_sockets(), 1u);
+
+    std::vector<size_t> cpus = t.PlaceWorkers(t.num_cpus());
+    ASSERT_EQ(t.num_cpus(), std::set<size_t>(cpus.begin(), cpus.end()).size());
+}
+
+/******************************************************************************/
@@ -0,0 +1,46 @@
+/*******************************************************************************
+ * tests/core/bloom_filter_test.cpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/core/bloom_filter.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+using namespace thrill;
+
+TEST(BloomFilter, InsertAndMerge) {
+    size_t n = 100000;
+
+    // build two filters of halves of the items and combine them
+    core::BloomFilter f1(n), f2(n);
+    for (uint64_t i = 0; i < n / 2; ++i) f1.Insert(i);
+    for (uint64_t i = n / 2; i < n; ++i) f2.Insert(i);
+    f1 |= f2;
+
+    ASSERT_EQ(core::BloomFilter::SizeBytes(n), f1.size_bytes());
+
+    // no false negatives
+    for (uint64_t i = 0; i < n; ++i)
+        ASSERT_TRUE(f1.Contains(i));
+
+    // few false positives, less than 5% of the queries
+    size_t false_positives = 0;
+    for (uint64_t i = n; i < 11 * n; ++i)
+        false_positives += f1.Contains(i);
+    ASSERT_LT(false_positives, 10 * n / 20);
+}
+
+TEST(BloomFilter, Empty) {
+    core::BloomFilter f;
+    ASSERT_FALSE(f.Contains(42));
+    ASSERT_EQ(0u, f.size_bytes());
+}
+
+/******************************************************************************/
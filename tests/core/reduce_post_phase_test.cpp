@@ -111,6 +111,106 @@ TEST(ReduceHashPhase, ProbingAddMyStructByHash) {
         });
 }
 
+TEST(ReduceHashPhase, SwissAddMyStructByHash) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            TestAddMyStructByHash<core::ReduceTableImpl::SWISS>(ctx);
+        });
+}
+
+/******************************************************************************/
+
+template <typename ReduceConfig>
+static void TestSpillMyStructByHash(Context& ctx) {
+    // many more keys than fit into the table, hence partitions are spilled
+    // and re-reduced with a larger fan-out.
+    static constexpr size_t mod_size = 100003;
+    static constexpr size_t test_size = mod_size * 4;
+
+    auto key_ex = [](const MyStruct& in) {
+                      return in.key % mod_size;
+                  };
+
+    auto red_fn = [](const MyStruct& in1, const MyStruct& in2) {
+                      return MyStruct {
+                          in1.key, in1.value + in2.value
+                      };
+                  };
+
+    // collect all items
+    std::vector<MyStruct> result;
+
+    auto emit_fn = [&result](const MyStruct& in) {
+                       result.emplace_back(in);
+                   };
+
+    using Phase = core::ReduceByHashPostPhase<
+        MyStruct, size_t, MyStruct,
+        decltype(key_ex), decltype(red_fn), decltype(emit_fn),
+        /* VolatileKey */ false, ReduceConfig>;
+
+    Phase phase(ctx, 0, key_ex, red_fn, emit_fn);
+    phase.Initialize(/* limit_memory_bytes */ 64 * 1024);
+
+    for (size_t i = 0; i < test_size; ++i) {
+        phase.Insert(MyStruct { i % mod_size, 1 });
+    }
+
+    phase.PushData(/* consume */ true);
+
+    // check result
+    std::sort(result.begin(), result.end());
+
+    ASSERT_EQ(mod_size, result.size());
+
+    for (size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQ(i, result[i].key);
+        ASSERT_EQ(test_size / mod_size, result[i].value);
+    }
+}
+
+TEST(ReduceHashPhase, BucketSpillMyStructByHash) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            using Config =
+                core::DefaultReduceConfigSelect<core::ReduceTableImpl::BUCKET>;
+            TestSpillMyStructByHash<Config>(ctx);
+        });
+}
+
+TEST(ReduceHashPhase, ProbingSpillMyStructByHash) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            using Config =
+                core::DefaultReduceConfigSelect<core::ReduceTableImpl::PROBING>;
+            TestSpillMyStructByHash<Config>(ctx);
+        });
+}
+
+TEST(ReduceHashPhase, SwissSpillMyStructByHash) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            using Config =
+                core::DefaultReduceConfigSelect<core::ReduceTableImpl::SWISS>;
+            TestSpillMyStructByHash<Config>(ctx);
+        });
+}
+
+//! config which re-reduces spilled partitions by sorting
+class SortReduceConfig
+    : public core::DefaultReduceConfigSelect<core::ReduceTableImpl::PROBING>
+{
+public:
+    static constexpr size_t max_spill_fanout_ = 1;
+};
+
+TEST(ReduceHashPhase, SortSpillMyStructByHash) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            TestSpillMyStructByHash<SortReduceConfig>(ctx);
+        });
+}
+
 /******************************************************************************/
 
 TEST(ReduceHashPhase, PostReduceByIndex) {
@@ -223,6 +323,13 @@ TEST(ReduceHashPhase, ProbingAddMyStructByIndex) {
         });
 }
 
+TEST(ReduceHashPhase, SwissAddMyStructByIndex) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            TestAddMyStructByIndex<core::ReduceTableImpl::SWISS>(ctx);
+        });
+}
+
 /******************************************************************************/
 
 template <core::ReduceTableImpl table_impl>
@@ -306,4 +413,11 @@ TEST(ReduceHashPhase, ProbingAddMyStructByIndexWithHoles) {
         });
 }
 
+TEST(ReduceHashPhase, SwissAddMyStructByIndexWithHoles) {
+    api::RunLocalSameThread(
+        [](Context& ctx) {
+            TestAddMyStructByIndexWithHoles<core::ReduceTableImpl::SWISS>(ctx);
+        });
+}
+
 /******************************************************************************/
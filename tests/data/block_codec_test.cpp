@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * tests/data/block_codec_test.cpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <thrill/data/block_codec.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace thrill;
+
+static const data::BlockCodec codecs[] = {
+    data::BlockCodec::LZ4, data::BlockCodec::Zstd
+};
+
+TEST(BlockCodec, RoundTrip) {
+    std::string text;
+    for (size_t i = 0; i < 100000; ++i)
+        text += "item " + std::to_string(i % 1000) + " with some text; ";
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(text.data());
+
+    for (data::BlockCodec codec : codecs) {
+        if (!data::BlockCodecAvailable(codec)) continue;
+
+        std::vector<uint8_t> compressed(
+            data::BlockCompressBound(codec, text.size()));
+        size_t csize = data::BlockCompress(
+            codec, src, text.size(), compressed.data(), compressed.size());
+        ASSERT_GT(csize, 0u);
+        ASSERT_LT(csize, text.size());
+
+        std::vector<uint8_t> output(text.size());
+        ASSERT_TRUE(data::BlockDecompress(
+                        codec, compressed.data(), csize,
+                        output.data(), output.size()));
+        ASSERT_EQ(text, std::string(output.begin(), output.end()));
+
+        // truncated data must be detected
+        ASSERT_FALSE(data::BlockDecompress(
+                         codec, compressed.data(), csize / 2,
+                         output.data(), output.size()));
+    }
+}
+
+TEST(BlockCodec, IncompressibleDoesNotFit) {
+    std::vector<uint8_t> random(1024 * 1024);
+    std::default_random_engine rng(42);
+    for (uint8_t& c : random) c = static_cast<uint8_t>(rng());
+
+    for (data::BlockCodec codec : codecs) {
+        if (!data::BlockCodecAvailable(codec)) continue;
+
+        std::vector<uint8_t> compressed(random.size() - 4096);
+        ASSERT_EQ(0u, data::BlockCompress(
+                      codec, random.data(), random.size(),
+                      compressed.data(), compressed.size()));
+    }
+}
+
+TEST(BlockCodec, ParseNames) {
+    data::BlockCodec codec;
+    ASSERT_TRUE(data::ParseBlockCodec("zstd", &codec));
+    ASSERT_EQ(data::BlockCodec::Zstd, codec);
+    ASSERT_TRUE(data::ParseBlockCodec("none", &codec));
+    ASSERT_EQ(data::BlockCodec::None, codec);
+    ASSERT_FALSE(data::ParseBlockCodec("rar", &codec));
+
+    data::CompressMode mode;
+    ASSERT_TRUE(data::ParseCompressMode("adaptive", &mode));
+    ASSERT_EQ(data::CompressMode::Adaptive, mode);
+    ASSERT_FALSE(data::ParseCompressMode("sometimes", &mode));
+}
+
+TEST(CompressionPolicy, Modes) {
+    data::CompressionPolicy none(1, data::BlockCodec::None);
+    ASSERT_FALSE(none.ShouldCompress(data::CompressMode::On));
+
+    for (data::BlockCodec codec : codecs) {
+        if (!data::BlockCodecAvailable(codec)) continue;
+
+        data::CompressionPolicy policy(1, codec, data::CompressMode::Off);
+        ASSERT_FALSE(policy.ShouldCompress(data::CompressMode::Default));
+        ASSERT_TRUE(policy.ShouldCompress(data::CompressMode::On));
+        ASSERT_FALSE(policy.ShouldCompress(data::CompressMode::Off));
+    }
+}
+
+TEST(CompressionPolicy, AdaptiveSkipsIncompressibleOnFastNetwork) {
+    std::vector<uint8_t> random(1024 * 1024);
+    std::default_random_engine rng(42);
+    for (uint8_t& c : random) c = static_cast<uint8_t>(rng());
+
+    for (data::BlockCodec codec : codecs) {
+        if (!data::BlockCodecAvailable(codec)) continue;
+
+        data::CompressionPolicy policy(1, codec, data::CompressMode::Adaptive);
+        // nothing measured yet: compress to learn the ratio
+        ASSERT_TRUE(policy.ShouldCompress(data::CompressMode::Default));
+
+        std::vector<uint8_t> compressed(random.size() - 4096);
+        for (size_t i = 0; i < 8; ++i) {
+            ASSERT_EQ(0u, policy.Compress(random.data(), random.size(),
+                                          compressed.data(),
+                                          compressed.size()));
+        }
+
+        // a window of sends completing immediately is a very fast network
+        policy.OnSendQueued(data::CompressionPolicy::bandwidth_window);
+        policy.OnSendDone(data::CompressionPolicy::bandwidth_window);
+        ASSERT_GT(policy.bandwidth(), 0.0);
+
+        // only the periodic probes compress
+        size_t compressed_blocks = 0;
+        for (size_t i = 0; i < 2 * data::CompressionPolicy::probe_interval; ++i)
+            compressed_blocks +=
+                policy.ShouldCompress(data::CompressMode::Default);
+        ASSERT_EQ(2u, compressed_blocks);
+    }
+}
+
+/******************************************************************************/
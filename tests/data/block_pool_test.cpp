@@ -11,8 +11,13 @@
 #include <gtest/gtest.h>
 #include <thrill/data/block.hpp>
 #include <thrill/data/block_pool.hpp>
+#include <thrill/mem/numa_arena.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace thrill;
 
@@ -109,4 +114,168 @@ TEST_F(BlockPoolTest, EvictBlock) {
     ASSERT_EQ(0u, block_pool_.writing_blocks() + block_pool_.swapped_blocks());
 }
 
+TEST_F(BlockPoolTest, EvictCompressedBlock) {
+    data::BlockCodec codec =
+        data::BlockCodecAvailable(data::BlockCodec::LZ4) ? data::BlockCodec::LZ4
+        : data::BlockCodecAvailable(data::BlockCodec::Zstd)
+        ? data::BlockCodec::Zstd : data::BlockCodec::None;
+    block_pool_.set_swap_codec(codec);
+
+    static constexpr size_t size = 64 * 1024;
+    data::Block unpinned_block;
+    {
+        data::PinnedByteBlockPtr block = block_pool_.AllocateByteBlock(size, 0);
+        for (size_t i = 0; i < size; ++i)
+            block->data()[i] = static_cast<data::Byte>(i % 7);
+        data::PinnedBlock pinned_block(std::move(block), 0, size, 0, 0, false);
+        unpinned_block = pinned_block.ToBlock();
+    }
+    // evict block, which is compressed if a codec is available
+    block_pool_.EvictBlock(unpinned_block.byte_block().get());
+    ASSERT_EQ(1u, block_pool_.writing_blocks() + block_pool_.swapped_blocks());
+
+    // swap block back in and check contents
+    data::PinnedBlock pinned = unpinned_block.PinWait(0);
+    ASSERT_EQ(0u, block_pool_.writing_blocks() + block_pool_.swapped_blocks());
+    for (size_t i = 0; i < size; ++i)
+        ASSERT_EQ(static_cast<data::Byte>(i % 7), pinned.data_begin()[i]);
+}
+
+TEST(BlockPool, HugePageArena) {
+    data::default_hugepage_size = 2 * 1024 * 1024;
+    {
+        data::BlockPool block_pool(2);
+        block_pool.SetWorkerCpus({ 0, 1 });
+
+        static constexpr size_t size = 64 * 1024;
+        data::Block unpinned_block;
+        {
+            data::PinnedByteBlockPtr block =
+                block_pool.AllocateByteBlock(size, 0);
+            for (size_t i = 0; i < size; ++i)
+                block->data()[i] = static_cast<data::Byte>(i % 7);
+            data::PinnedBlock pinned_block(
+                std::move(block), 0, size, 0, 0, false);
+            unpinned_block = pinned_block.ToBlock();
+        }
+
+        // evict block and swap it back in on the other worker
+        block_pool.EvictBlock(unpinned_block.byte_block().get());
+        data::PinnedBlock pinned = unpinned_block.PinWait(1);
+        for (size_t i = 0; i < size; ++i)
+            ASSERT_EQ(static_cast<data::Byte>(i % 7), pinned.data_begin()[i]);
+
+        // a block swapped in by a worker is local to it.
+        data::PinnedBlock pinned0 = unpinned_block.PinWait(0);
+        size_t remote = mem::NumaNodeOfCpu(0) != mem::NumaNodeOfCpu(1);
+        ASSERT_EQ(remote, block_pool.remote_pins());
+    }
+    data::default_hugepage_size = 0;
+}
+
+TEST(BlockPool, ConcurrentPinUnpin) {
+    static constexpr size_t workers = 4;
+    data::BlockPool block_pool(workers);
+
+    data::Block block;
+    {
+        data::PinnedByteBlockPtr byte_block =
+            block_pool.AllocateByteBlock(4096, 0);
+        block = data::PinnedBlock(
+            std::move(byte_block), 0, 4096, 0, 0, false).ToBlock();
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back(
+            [&block, w]() {
+                data::PinnedBlock pinned = block.PinWait(w);
+                for (size_t i = 0; i < 100000; ++i) {
+                    // copies take the lock-free path, since pinned holds a pin
+                    data::PinnedBlock copy = pinned;
+                    data::PinnedBlock pin = block.PinWait(w);
+                }
+            });
+    }
+    for (std::thread& t : threads) t.join();
+
+    ASSERT_EQ(0u, block_pool.pinned_blocks());
+    ASSERT_EQ(1u, block_pool.unpinned_blocks());
+    for (size_t w = 0; w < workers; ++w)
+        ASSERT_EQ(0u, block.byte_block()->pin_count(w));
+}
+
+TEST(BlockPool, ConcurrentPinUnpinLastPin) {
+    static constexpr size_t workers = 4;
+    static constexpr size_t num_blocks = 16;
+    data::BlockPool block_pool(workers);
+
+    std::vector<data::Block> blocks;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        data::PinnedByteBlockPtr byte_block =
+            block_pool.AllocateByteBlock(4096, 0);
+        blocks.emplace_back(
+            data::PinnedBlock(std::move(byte_block), 0, 4096, 0, 0, false)
+            .ToBlock());
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back(
+            [&blocks, w]() {
+                for (size_t i = 0; i < 100000; ++i) {
+                    // each pin is the worker's first and last one, which races
+                    // with the other workers' lock-free copies.
+                    data::PinnedBlock pin =
+                        blocks[(i + w) % num_blocks].PinWait(w);
+                    data::PinnedBlock copy = pin;
+                }
+            });
+    }
+    for (std::thread& t : threads) t.join();
+
+    ASSERT_EQ(0u, block_pool.pinned_blocks());
+    ASSERT_EQ(num_blocks, block_pool.unpinned_blocks());
+    ASSERT_EQ(num_blocks, block_pool.total_blocks());
+}
+
+TEST(BlockPool, BackgroundEviction) {
+    static constexpr size_t block_size = 4096;
+    static constexpr size_t num_blocks = 32;
+
+    // soft limit of 32 blocks: the low watermark is 2 blocks, the high one 4.
+    data::BlockPool block_pool(
+        num_blocks * block_size, 2 * num_blocks * block_size,
+        nullptr, nullptr, 1);
+    {
+        std::vector<data::Block> blocks;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            data::PinnedByteBlockPtr byte_block =
+                block_pool.AllocateByteBlock(block_size, 0);
+            std::fill(byte_block->begin(), byte_block->end(),
+                      static_cast<data::Byte>(i));
+            blocks.emplace_back(
+                data::PinnedBlock(std::move(byte_block), 0, block_size, 0, 0,
+                                  false).ToBlock());
+        }
+
+        // the eviction thread must write out blocks without any request
+        for (size_t r = 0; r < 100 && block_pool.swapped_blocks() < 4; ++r)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        ASSERT_LE(4u, block_pool.swapped_blocks() + block_pool.writing_blocks());
+        ASSERT_LE(4u, block_pool.evicted_background_blocks());
+        ASSERT_EQ(num_blocks, block_pool.total_blocks());
+
+        // check contents of evicted blocks
+        for (size_t i = 0; i < num_blocks; ++i) {
+            data::PinnedBlock pinned = blocks[i].PinWait(0);
+            for (const data::Byte* b = pinned.data_begin();
+                 b != pinned.data_end(); ++b)
+                ASSERT_EQ(static_cast<data::Byte>(i), *b);
+        }
+    }
+    ASSERT_EQ(0u, block_pool.total_blocks());
+}
+
 /******************************************************************************/
@@ -36,6 +36,8 @@ struct MultiplexerHeaderTest : public ::testing::Test {
         candidate.size = 4;
         candidate.num_items = 5;
         candidate.sender_worker = 6;
+        candidate.codec = data::BlockCodec::Zstd;
+        candidate.wire_size = 3;
     }
 
     data::StreamMultiplexerHeader candidate;
@@ -45,6 +47,8 @@ TEST_F(MultiplexerHeaderTest, ParsesAndSerializesHeader) {
     net::BufferBuilder bb;
     candidate.Serialize(bb);
     net::Buffer b = bb.ToBuffer();
+    ASSERT_EQ(static_cast<size_t>(data::MultiplexerHeader::total_size),
+              b.size());
 
     net::BufferReader br(b);
     data::StreamMultiplexerHeader result =
@@ -54,6 +58,8 @@ TEST_F(MultiplexerHeaderTest, ParsesAndSerializesHeader) {
     ASSERT_EQ(candidate.size, result.size);
     ASSERT_EQ(candidate.num_items, result.num_items);
     ASSERT_EQ(candidate.sender_worker, result.sender_worker);
+    ASSERT_EQ(candidate.codec, result.codec);
+    ASSERT_EQ(candidate.wire_size, result.wire_size);
 }
 
 TEST_F(MultiplexerHeaderTest, HeaderIsEnd) {
@@ -112,6 +118,9 @@ TEST(StreamSet, TestLoopbacks) {
     consumer(stream0, 0);
     consumer(stream1, 1);
     consumer(stream2, 2);
+    // all Blocks were handed over locally
+    ASSERT_GT(multiplexer.tx_int_bytes(), 0u);
+    ASSERT_EQ(0u, multiplexer.tx_net_bytes());
     stream0->Close();
     stream1->Close();
     stream2->Close();
@@ -635,6 +644,45 @@ TEST_F(Multiplexer, TalkAllToAllViaMixStreamForManyNetSizes) {
     net::RunLoopbackGroupTest(9, TalkAllToAllViaMixStream);
 }
 
+TEST_F(Multiplexer, CompressedCatStream) {
+    data::default_block_size = test_block_size;
+    // use any compiled in codec, otherwise the Blocks are sent raw.
+    data::BlockCodec codec =
+        data::BlockCodecAvailable(data::BlockCodec::LZ4) ? data::BlockCodec::LZ4
+        : data::BlockCodecAvailable(data::BlockCodec::Zstd)
+        ? data::BlockCodec::Zstd : data::BlockCodec::None;
+    data::default_block_codec = codec;
+
+    static constexpr size_t items = 10000;
+
+    auto sender =
+        [](data::Multiplexer& multiplexer) {
+            auto c = multiplexer.GetNewCatStream(0, /* dia_id */ 0);
+            c->set_compress(data::CompressMode::On);
+            auto writers = c->GetWriters();
+            for (size_t i = 0; i < items; ++i)
+                writers[1].Put("compressible item " + std::to_string(i % 10));
+            for (auto& w : writers) w.Close();
+        };
+    auto receiver =
+        [](data::Multiplexer& multiplexer) {
+            auto c = multiplexer.GetNewCatStream(0, /* dia_id */ 0);
+            auto writers = c->GetWriters();
+            for (auto& w : writers) w.Close();
+
+            auto reader = c->GetCatReader(true);
+            for (size_t i = 0; i < items; ++i) {
+                ASSERT_TRUE(reader.HasNext());
+                ASSERT_EQ("compressible item " + std::to_string(i % 10),
+                          reader.Next<std::string>());
+            }
+            ASSERT_FALSE(reader.HasNext());
+        };
+    Execute(sender, receiver);
+
+    data::default_block_codec = data::BlockCodec::None;
+}
+
 /******************************************************************************/
 // Scatter Tests
 
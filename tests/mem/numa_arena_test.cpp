@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * tests/mem/numa_arena_test.cpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/mem/numa_arena.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace thrill;
+
+TEST(NumaArena, AllocateDeallocate) {
+    if (!mem::NumaArena::IsSupported()) return;
+
+    mem::Manager manager(nullptr, "NumaArena");
+    // small page size, such that blocks are carved and also mapped directly.
+    size_t page_size = 64 * 1024;
+    size_t num_nodes = mem::NumaNumNodes();
+
+    std::vector<std::pair<void*, size_t> > blocks;
+    {
+        mem::NumaArena arena(&manager, page_size);
+        ASSERT_EQ(num_nodes, arena.num_nodes());
+
+        std::set<void*> addrs;
+        for (size_t i = 0; i < 64; ++i) {
+            size_t size = size_t(4096) << (i % 6);
+            void* p = arena.allocate(size, i % num_nodes);
+            ASSERT_TRUE(p != nullptr);
+            ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p) % 4096);
+            ASSERT_TRUE(addrs.insert(p).second);
+            memset(p, static_cast<int>(i), size);
+            blocks.emplace_back(p, size);
+        }
+
+        ASSERT_GT(manager.total(), 0u);
+        ASSERT_GE(arena.mapped_bytes(), manager.total());
+
+        // check that blocks do not overlap
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            const uint8_t* p = static_cast<const uint8_t*>(blocks[i].first);
+            ASSERT_EQ(static_cast<uint8_t>(i), p[0]);
+            ASSERT_EQ(static_cast<uint8_t>(i), p[blocks[i].second - 1]);
+        }
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+            arena.deallocate(blocks[i].first, blocks[i].second, i % num_nodes);
+        ASSERT_EQ(0u, manager.total());
+
+        // freed small blocks are reused
+        void* p = arena.allocate(4096, 0);
+        ASSERT_TRUE(addrs.count(p));
+        arena.deallocate(p, 4096, 0);
+    }
+}
+
+TEST(NumaArena, UnmapFreeChunks) {
+    if (!mem::NumaArena::IsSupported()) return;
+
+    mem::Manager manager(nullptr, "NumaArena");
+    size_t page_size = 64 * 1024;
+    mem::NumaArena arena(&manager, page_size);
+
+    // fill four chunks with small blocks
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 4 * page_size / 4096; ++i)
+        blocks.push_back(arena.allocate(4096, 0));
+    ASSERT_EQ(4 * page_size, arena.mapped_bytes());
+
+    // all but one of the free chunks are returned to the system
+    for (void* p : blocks)
+        arena.deallocate(p, 4096, 0);
+    ASSERT_EQ(page_size, arena.mapped_bytes());
+
+    // the kept chunk is reused
+    void* p = arena.allocate(4096, 0);
+    ASSERT_EQ(page_size, arena.mapped_bytes());
+    arena.deallocate(p, 4096, 0);
+}
+
+TEST(NumaArena, NodeOfCpu) {
+    size_t num_nodes = mem::NumaNumNodes();
+    ASSERT_GE(num_nodes, 1u);
+    ASSERT_LT(mem::NumaNodeOfCpu(0), num_nodes);
+}
+
+/******************************************************************************/
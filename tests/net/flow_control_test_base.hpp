@@ -101,10 +101,13 @@ static void TestSingleThreadBroadcast(net::Group* net) {
 
 static void ExecuteMultiThreads(
     net::Group* net, size_t count,
-    const std::function<void(net::FlowControlChannel&)>& function) {
+    const std::function<void(net::FlowControlChannel&)>& function,
+    const std::vector<size_t>& socket_groups = std::vector<size_t>()) {
 
     std::vector<std::thread> threads(count);
     net::FlowControlChannelManager manager(*net, count);
+    if (!socket_groups.empty())
+        manager.SetSocketGroups(socket_groups);
 
     for (size_t i = 0; i < count; i++) {
         threads[i] = std::thread(
@@ -379,6 +382,67 @@ static void TestHardcoreRaceConditionTest(net::Group* net) {
         });
 }
 
+/*!
+ * Runs the collectives with the workers split into uneven socket groups, which
+ * synchronize hierarchically.
+ */
+static void TestMultiThreadSocketGroups(net::Group* net) {
+
+    const std::vector<size_t> socket_groups = { 0, 0, 1, 1, 1, 2 };
+    const size_t count = socket_groups.size();
+
+    ExecuteMultiThreads(
+        net, count, [=](net::FlowControlChannel& channel) {
+            size_t my_rank = channel.my_rank();
+            size_t num_workers = net->num_hosts() * count;
+            const size_t initial = 42;
+            std::plus<size_t> plus;
+
+            for (size_t r = 0; r < 10; ++r) {
+                size_t value = my_rank + r;
+
+                size_t expected_prefix = 42;
+                for (size_t i = 0; i < my_rank; i++)
+                    expected_prefix += i + r;
+
+                ASSERT_EQ(expected_prefix + value,
+                          channel.PrefixSum(value, plus, initial));
+                ASSERT_EQ(expected_prefix,
+                          channel.ExPrefixSum(value, plus, initial));
+
+                size_t expected_total = 0;
+                for (size_t i = 0; i < num_workers; i++)
+                    expected_total += i + r;
+
+                size_t ex_value = value;
+                ASSERT_EQ(expected_total, channel.ExPrefixSumTotal(ex_value));
+                ASSERT_EQ(expected_prefix - 42, ex_value);
+
+                ASSERT_EQ(expected_total, channel.AllReduce(value));
+
+                size_t root = (r * 7) % num_workers;
+                size_t res = channel.Reduce(value, root);
+                if (my_rank == root)
+                    ASSERT_EQ(expected_total, res);
+
+                ASSERT_EQ(root + r, channel.Broadcast(value, root));
+
+                std::vector<size_t> pre =
+                    channel.Predecessor(1, std::vector<size_t>(1, value));
+                if (my_rank == 0) {
+                    ASSERT_EQ(0u, pre.size());
+                }
+                else {
+                    ASSERT_EQ(1u, pre.size());
+                    ASSERT_EQ(value - 1, pre[0]);
+                }
+
+                channel.Barrier();
+            }
+        },
+        socket_groups);
+}
+
 /*!
  * single threaded test for allgather collective
  */
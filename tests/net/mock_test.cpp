@@ -136,6 +136,9 @@ TEST(MockGroup, PredecessorOneItem) {
 TEST(MockGroup, HardcoreRaceConditionTest) {
     MockTestLess(TestHardcoreRaceConditionTest);
 }
+TEST(MockGroup, MultiThreadSocketGroups) {
+    MockTestLess(TestMultiThreadSocketGroups);
+}
 TEST(MockGroup, AllGather) {
     MockTestLess(TestAllGather);
 }
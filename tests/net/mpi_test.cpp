@@ -126,6 +126,9 @@ TEST(MpiGroup, PredecessorOneItem) {
 TEST(MpiGroup, HardcoreRaceConditionTest) {
     MpiTest(TestHardcoreRaceConditionTest);
 }
+TEST(MpiGroup, MultiThreadSocketGroups) {
+    MpiTest(TestMultiThreadSocketGroups);
+}
 TEST(MpiGroup, AllGather) {
     MpiTest(TestAllGather);
 }
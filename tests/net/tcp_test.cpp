@@ -12,11 +12,14 @@
 #include <thrill/mem/manager.hpp>
 #include <thrill/net/dispatcher_thread.hpp>
 #include <thrill/net/tcp/group.hpp>
+#include <thrill/net/tcp/io_uring_dispatcher.hpp>
 #include <thrill/net/tcp/select_dispatcher.hpp>
 
+#include <chrono>
 #include <random>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "flow_control_test_base.hpp"
@@ -173,6 +176,9 @@ TEST(LocalTcpGroup, PredecessorOneItem) {
 TEST(LocalTcpGroup, HardcoreRaceConditionTest) {
     LocalGroupTest(TestHardcoreRaceConditionTest);
 }
+TEST(LocalTcpGroup, MultiThreadSocketGroups) {
+    LocalGroupTest(TestMultiThreadSocketGroups);
+}
 TEST(LocalTcpGroup, AllGather) {
     LocalGroupTest(TestAllGather);
 }
@@ -185,3 +191,109 @@ TEST(LocalTcpGroup, AllGatherString) {
 // [[[end]]]
 
 /******************************************************************************/
+// Explicit Dispatcher Tests
+
+//! exchange a series of large messages between all hosts using asynchronous
+//! reads and writes on the dispatcher with the given name.
+static void TestDispatcherAsyncExchange(
+    net::Group* net, const std::string& dispatcher_name) {
+    mem::Manager mem_manager(nullptr, "DispatcherTest");
+
+    std::unique_ptr<net::Dispatcher> dispatcher =
+        net::tcp::Group::ConstructDispatcher(dispatcher_name);
+    ASSERT_TRUE(dispatcher);
+
+    static constexpr size_t kRounds = 4;
+    static constexpr size_t kSize = 1024 * 1024;
+
+    size_t received = 0;
+
+    for (size_t i = 0; i != net->num_hosts(); ++i)
+    {
+        if (i == net->my_host_rank()) continue;
+
+        for (size_t r = 0; r < kRounds; ++r) {
+            // large messages, such that writes and reads run into EAGAIN.
+            std::vector<size_t> data(kSize, net->my_host_rank() * kRounds + r);
+            dispatcher->AsyncWriteCopy(
+                net->connection(i), /* seq */ 0,
+                data.data(), data.size() * sizeof(size_t));
+
+            dispatcher->AsyncRead(
+                net->connection(i), /* seq */ 0, kSize * sizeof(size_t),
+                [i, r, &received](net::Connection&, net::Buffer&& buffer) {
+                    const size_t* data =
+                        reinterpret_cast<const size_t*>(buffer.data());
+                    for (size_t j = 0; j < kSize; ++j)
+                        ASSERT_EQ(i * kRounds + r, data[j]);
+                    received++;
+                });
+        }
+    }
+
+    while (received < (net->num_hosts() - 1) * kRounds ||
+           dispatcher->HasAsyncWrites()) {
+        dispatcher->Dispatch();
+    }
+}
+
+TEST(LocalTcpGroup, SelectDispatcherAsyncExchange) {
+    LocalGroupTest(
+        [](net::Group* net) { TestDispatcherAsyncExchange(net, "select"); });
+}
+
+#if THRILL_HAVE_EPOLL
+TEST(LocalTcpGroup, EPollDispatcherAsyncExchange) {
+    LocalGroupTest(
+        [](net::Group* net) { TestDispatcherAsyncExchange(net, "epoll"); });
+}
+
+TEST(RealTcpGroup, EPollDispatcherAsyncExchange) {
+    RealGroupTest(
+        [](net::Group* net) { TestDispatcherAsyncExchange(net, "epoll"); });
+}
+#endif
+
+#if THRILL_HAVE_IO_URING
+TEST(LocalTcpGroup, IoUringDispatcherAsyncExchange) {
+    if (!net::tcp::IoUringDispatcher::IsSupported())
+        GTEST_SKIP() << "the kernel does not support io_uring";
+    LocalGroupTest(
+        [](net::Group* net) { TestDispatcherAsyncExchange(net, "uring"); });
+}
+
+TEST(IoUringDispatcher, AsyncReadEndOfFile) {
+    if (!net::tcp::IoUringDispatcher::IsSupported())
+        GTEST_SKIP() << "the kernel does not support io_uring";
+
+    std::pair<net::tcp::Socket, net::tcp::Socket> pair =
+        net::tcp::Socket::CreatePair();
+    net::tcp::Connection conn(std::move(pair.first));
+    net::tcp::IoUringDispatcher dispatcher;
+
+    // a read of a closed connection delivers an invalid Buffer, like the other
+    // dispatchers do.
+    bool done = false;
+    dispatcher.AsyncRead(
+        conn, /* seq */ 0, 1024,
+        [&done](net::Connection&, net::Buffer&& buffer) {
+            ASSERT_FALSE(buffer.IsValid());
+            done = true;
+        });
+
+    // close the other end while the recv is in flight.
+    std::thread closer(
+        [&pair]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            pair.second.close();
+        });
+
+    while (!done)
+        dispatcher.Dispatch();
+
+    closer.join();
+    ASSERT_FALSE(dispatcher.HasAsyncWrites());
+}
+#endif
+
+/******************************************************************************/
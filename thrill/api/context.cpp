@@ -19,6 +19,9 @@
 #include <thrill/common/profile_thread.hpp>
 #include <thrill/common/string.hpp>
 #include <thrill/common/system_exception.hpp>
+#include <thrill/common/topology.hpp>
+#include <thrill/data/block_codec.hpp>
+#include <thrill/mem/numa_arena.hpp>
 #include <thrill/vfs/file_io.hpp>
 
 #include <foxxll/io/iostats.hpp>
@@ -28,12 +31,14 @@
 #include <tlx/string/format_si_iec_units.hpp>
 #include <tlx/string/parse_si_iec_units.hpp>
 #include <tlx/string/split.hpp>
+#include <tlx/string/to_lower.hpp>
 
 // mock net backend is always available -tb :)
 #include <thrill/net/mock/group.hpp>
 
 #if THRILL_HAVE_NET_TCP
 #include <thrill/net/tcp/construct.hpp>
+#include <thrill/net/tcp/epoll_dispatcher.hpp>
 #include <thrill/net/tcp/select_dispatcher.hpp>
 #endif
 
@@ -130,6 +135,10 @@ ConstructLoopbackHostContexts(
     return host_context;
 }
 
+static inline void PlaceHosts(
+    const std::vector<HostContext*>& hosts, size_t workers_per_host,
+    size_t core_offset);
+
 //! Generic runner for backends supporting loopback tests.
 template <typename NetGroup>
 static inline void
@@ -148,6 +157,13 @@ RunLoopbackThreads(
         ConstructLoopbackHostContexts<NetGroup>(
             host_mem_config, num_hosts, workers_per_host);
 
+    // pin workers to cpus, each host gets a contiguous range of them, and
+    // divide the remaining cores among the hosts' idle thread pools.
+    std::vector<HostContext*> hosts;
+    for (size_t host = 0; host < num_hosts; ++host)
+        hosts.push_back(host_contexts[host].get());
+    PlaceHosts(hosts, workers_per_host, core_offset);
+
     // launch thread for each of the workers on this host.
     std::vector<std::thread> threads(num_hosts * workers_per_host);
 
@@ -163,7 +179,7 @@ RunLoopbackThreads(
 
                     ctx.Launch(job_startpoint);
                 });
-            common::SetCpuAffinity(threads[id], core_offset + id);
+            host_contexts[host]->PinWorker(threads[id], worker);
         }
     }
 
@@ -201,6 +217,175 @@ static inline bool SetupBlockSize() {
     return true;
 }
 
+static inline bool SetupBlockCodec() {
+
+    const char* env_codec = getenv("THRILL_BLOCK_CODEC");
+    if (env_codec != nullptr && *env_codec != 0) {
+        if (!data::ParseBlockCodec(env_codec, &data::default_block_codec)) {
+            std::cerr << "Thrill: environment variable"
+                      << " THRILL_BLOCK_CODEC=" << env_codec
+                      << " is not a valid codec (none, lz4, zstd)."
+                      << std::endl;
+            return false;
+        }
+        if (!data::BlockCodecAvailable(data::default_block_codec)) {
+            std::cerr << "Thrill: block codec " << env_codec
+                      << " was not compiled in."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    const char* env_net_compress = getenv("THRILL_NET_COMPRESS");
+    if (env_net_compress != nullptr && *env_net_compress != 0) {
+        if (!data::ParseCompressMode(
+                env_net_compress, &data::default_net_compress)) {
+            std::cerr << "Thrill: environment variable"
+                      << " THRILL_NET_COMPRESS=" << env_net_compress
+                      << " is not valid (off, on, adaptive)."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    const char* env_swap_compress = getenv("THRILL_SWAP_COMPRESS");
+    if (env_swap_compress != nullptr && *env_swap_compress != 0) {
+        if (!data::ParseCompressMode(
+                env_swap_compress, &data::default_swap_compress)) {
+            std::cerr << "Thrill: environment variable"
+                      << " THRILL_SWAP_COMPRESS=" << env_swap_compress
+                      << " is not valid (off, on)."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline bool SetupHugePages() {
+
+    const char* env_hugepages = getenv("THRILL_HUGEPAGES");
+    if (env_hugepages == nullptr || *env_hugepages == 0) return true;
+
+    std::string hugepages = tlx::to_lower(env_hugepages);
+    if (hugepages == "off" || hugepages == "0")
+        data::default_hugepage_size = 0;
+    else if (hugepages == "on" || hugepages == "1" || hugepages == "2m")
+        data::default_hugepage_size = 2 * 1024 * 1024;
+    else if (hugepages == "1g")
+        data::default_hugepage_size = 1024 * 1024 * 1024;
+    else {
+        std::cerr << "Thrill: environment variable"
+                  << " THRILL_HUGEPAGES=" << env_hugepages
+                  << " is not valid (off, 2m, 1g)."
+                  << std::endl;
+        return false;
+    }
+
+    if (data::default_hugepage_size != 0 && !mem::NumaArena::IsSupported()) {
+        std::cerr << "Thrill: hugepage arenas are not supported"
+                  << " on this system, ignoring THRILL_HUGEPAGES."
+                  << std::endl;
+        data::default_hugepage_size = 0;
+    }
+
+    return true;
+}
+
+//! how worker threads are pinned to cpus, set by THRILL_PIN
+enum class PinMode { Topology, Linear, Off };
+
+static PinMode s_pin_mode = PinMode::Topology;
+
+static inline bool SetupWorkerPinning() {
+
+    const char* env_pin = getenv("THRILL_PIN");
+    if (env_pin == nullptr || *env_pin == 0) return true;
+
+    std::string pin = tlx::to_lower(env_pin);
+    if (pin == "topology" || pin == "on" || pin == "1")
+        s_pin_mode = PinMode::Topology;
+    else if (pin == "linear")
+        s_pin_mode = PinMode::Linear;
+    else if (pin == "off" || pin == "0")
+        s_pin_mode = PinMode::Off;
+    else {
+        std::cerr << "Thrill: environment variable"
+                  << " THRILL_PIN=" << env_pin
+                  << " is not valid (topology, linear, off)."
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+//! Returns the cpus of num_workers workers, skipping the first core_offset
+//! cpus, or an empty vector if workers are not pinned.
+static inline std::vector<size_t> WorkerCpus(
+    size_t num_workers, size_t core_offset) {
+
+    std::vector<size_t> cpus;
+    if (s_pin_mode == PinMode::Topology) {
+        cpus = common::Topology::Host().PlaceWorkers(num_workers, core_offset);
+    }
+    else if (s_pin_mode == PinMode::Linear) {
+        for (size_t i = 0; i < num_workers; ++i)
+            cpus.push_back(core_offset + i);
+    }
+    return cpus;
+}
+
+/*!
+ * Place the workers and idle threads of the num_hosts hosts running in this
+ * process. Workers are pinned as by WorkerCpus(), skipping the first
+ * core_offset cpus. The remaining cores are divided equally among the hosts,
+ * and their cpus are handed out in contiguous ranges.
+ */
+static inline void PlaceHosts(
+    const std::vector<HostContext*>& hosts, size_t workers_per_host,
+    size_t core_offset) {
+
+    size_t num_hosts = hosts.size();
+    size_t num_workers = num_hosts * workers_per_host;
+    size_t num_cores = std::thread::hardware_concurrency();
+
+    std::vector<size_t> cpus = WorkerCpus(num_workers, core_offset);
+
+    // this host's share of the cores not occupied by workers
+    size_t num_idle = num_cores > core_offset + num_workers
+                      ? (num_cores - core_offset - num_workers) / num_hosts : 0;
+
+    // cpus not occupied by workers, if they are pinned
+    std::vector<size_t> idle_cpus;
+    if (!cpus.empty()) {
+        std::vector<bool> used(num_cores);
+        for (const size_t& c : cpus) {
+            if (c < num_cores) used[c] = true;
+        }
+        for (size_t c = core_offset; c < num_cores; ++c) {
+            if (!used[c]) idle_cpus.push_back(c);
+        }
+        num_idle = std::min(num_idle, idle_cpus.size() / num_hosts);
+    }
+
+    for (size_t h = 0; h < num_hosts; ++h) {
+        if (cpus.empty()) {
+            hosts[h]->PlaceWorkers(cpus);
+            hosts[h]->PlaceIdleThreads(num_idle, cpus);
+            continue;
+        }
+        hosts[h]->PlaceWorkers(
+            std::vector<size_t>(cpus.begin() + h * workers_per_host,
+                                cpus.begin() + (h + 1) * workers_per_host));
+        hosts[h]->PlaceIdleThreads(
+            num_idle,
+            std::vector<size_t>(idle_cpus.begin() + h * num_idle,
+                                idle_cpus.begin() + (h + 1) * num_idle));
+    }
+}
+
 static inline size_t FindWorkersPerHost(
     const char*& str_workers_per_host, const char*& env_workers_per_host) {
 
@@ -274,6 +459,9 @@ static inline size_t FindWorkersPerHost(
 static inline bool Initialize() {
 
     if (!SetupBlockSize()) return false;
+    if (!SetupBlockCodec()) return false;
+    if (!SetupHugePages()) return false;
+    if (!SetupWorkerPinning()) return false;
 
     vfs::Initialize();
 
@@ -493,7 +681,8 @@ int RunBackendLoopback(
 
 #if THRILL_HAVE_NET_TCP
 static inline
-int RunBackendTcp(const std::function<void(Context&)>& job_startpoint) {
+int RunBackendTcp(const std::function<void(Context&)>& job_startpoint,
+                  const std::string& dispatcher_name) {
 
     char* endptr;
 
@@ -597,16 +786,22 @@ int RunBackendTcp(const std::function<void(Context&)>& job_startpoint) {
         std::cerr << ' ' << ep;
     std::cerr << std::endl;
 
+    std::unique_ptr<net::Dispatcher> tcp_dispatcher =
+        net::tcp::Group::ConstructDispatcher(dispatcher_name);
+    if (!tcp_dispatcher) {
+        std::cerr << "Thrill: tcp dispatcher " << dispatcher_name
+                  << " is not supported by this binary." << std::endl;
+        return -1;
+    }
+
     if (!Initialize()) return -1;
 
     static constexpr size_t kGroupCount = net::Manager::kGroupCount;
 
     // construct three TCP network groups
-    auto select_dispatcher = std::make_unique<net::tcp::SelectDispatcher>();
-
     std::array<std::unique_ptr<net::tcp::Group>, kGroupCount> groups;
     net::tcp::Construct(
-        *select_dispatcher, my_host_rank, hostlist,
+        *tcp_dispatcher, my_host_rank, hostlist,
         groups.data(), net::Manager::kGroupCount);
 
     std::array<net::GroupPtr, kGroupCount> host_groups = {
@@ -616,12 +811,15 @@ int RunBackendTcp(const std::function<void(Context&)>& job_startpoint) {
     // construct HostContext
 
     auto dispatcher = std::make_unique<net::DispatcherThread>(
-        std::move(select_dispatcher), my_host_rank);
+        std::move(tcp_dispatcher), my_host_rank);
 
     HostContext host_context(
         0, mem_config,
         std::move(dispatcher), std::move(host_groups), workers_per_host);
 
+    // pin workers to cpus and place their ByteBlocks on the cpus' nodes
+    PlaceHosts({ &host_context }, workers_per_host, 0);
+
     std::vector<std::thread> threads(workers_per_host);
 
     for (size_t worker = 0; worker < workers_per_host; worker++) {
@@ -632,7 +830,7 @@ int RunBackendTcp(const std::function<void(Context&)>& job_startpoint) {
 
                 ctx.Launch(job_startpoint);
             });
-        common::SetCpuAffinity(threads[worker], worker);
+        host_context.PinWorker(threads[worker], worker);
     }
 
     // join worker threads
@@ -712,6 +910,9 @@ int RunBackendMpi(const std::function<void(Context&)>& job_startpoint) {
         0, mem_config,
         std::move(dispatcher), std::move(host_groups), workers_per_host);
 
+    // pin workers to cpus and place their ByteBlocks on the cpus' nodes
+    PlaceHosts({ &host_context }, workers_per_host, 0);
+
     // launch worker threads
     std::vector<std::thread> threads(workers_per_host);
 
@@ -724,7 +925,7 @@ int RunBackendMpi(const std::function<void(Context&)>& job_startpoint) {
 
                 ctx.Launch(job_startpoint);
             });
-        common::SetCpuAffinity(threads[worker], worker);
+        host_context.PinWorker(threads[worker], worker);
     }
 
     // join worker threads
@@ -786,6 +987,9 @@ int RunBackendIb(const std::function<void(Context&)>& job_startpoint) {
     HostContext host_context(
         0, mem_config, std::move(host_groups), workers_per_host);
 
+    // pin workers to cpus and place their ByteBlocks on the cpus' nodes
+    PlaceHosts({ &host_context }, workers_per_host, 0);
+
     // launch worker threads
     std::vector<std::thread> threads(workers_per_host);
 
@@ -798,7 +1002,7 @@ int RunBackendIb(const std::function<void(Context&)>& job_startpoint) {
 
                 ctx.Launch(job_startpoint);
             });
-        common::SetCpuAffinity(threads[worker], worker);
+        host_context.PinWorker(threads[worker], worker);
     }
 
     // join worker threads
@@ -982,8 +1186,19 @@ int Run(const std::function<void(Context&)>& job_startpoint) {
 
     if (strcmp(env_net, "tcp") == 0) {
 #if THRILL_HAVE_NET_TCP
-        // real tcp network backend
-        return RunBackendTcp(job_startpoint);
+        // real tcp network backend with default dispatcher
+        return RunBackendTcp(job_startpoint, "");
+#else
+        return RunNotSupported(env_net);
+#endif
+    }
+
+    if (strcmp(env_net, "tcp-select") == 0 ||
+        strcmp(env_net, "tcp-epoll") == 0 ||
+        strcmp(env_net, "tcp-uring") == 0) {
+#if THRILL_HAVE_NET_TCP
+        // real tcp network backend with a specific dispatcher
+        return RunBackendTcp(job_startpoint, env_net + 4);
 #else
         return RunNotSupported(env_net);
 #endif
@@ -1173,11 +1388,59 @@ std::string HostContext::MakeHostLogPath(size_t host_rank) {
     return output + "-host-" + std::to_string(host_rank) + ".json";
 }
 
+void HostContext::PlaceWorkers(const std::vector<size_t>& cpus) {
+    assert(cpus.empty() || cpus.size() == workers_per_host_);
+    worker_cpus_ = cpus;
+
+    const common::Topology& topology = common::Topology::Host();
+    worker_socket_.assign(workers_per_host_, 0);
+    if (!cpus.empty()) {
+        for (size_t i = 0; i < workers_per_host_; ++i)
+            worker_socket_[i] = topology.cpu(cpus[i]).socket;
+        flow_manager_.SetSocketGroups(topology.SocketGroups(cpus));
+    }
+    block_pool_.SetWorkerCpus(cpus);
+
+    if (local_host_id_ == 0 && mem_config_.verbose_) {
+        std::cerr << "Thrill: host topology: " << topology
+                  << ", workers use " << flow_manager_.num_socket_groups()
+                  << " socket groups." << std::endl;
+    }
+}
+
+void HostContext::PinWorker(std::thread& thread, size_t local_worker_id) {
+    if (worker_cpus_.empty()) return;
+    common::SetCpuAffinity(thread, worker_cpus_[local_worker_id]);
+}
+
+void HostContext::PlaceIdleThreads(
+    size_t num_threads, const std::vector<size_t>& cpus) {
+    assert(cpus.empty() || cpus.size() == num_threads);
+    num_idle_threads_ = num_threads;
+    idle_cpus_ = cpus;
+}
+
+tlx::ThreadPool* HostContext::idle_thread_pool() {
+    std::unique_lock<std::mutex> lock(idle_thread_pool_mutex_);
+    if (idle_thread_pool_) return idle_thread_pool_.get();
+
+    if (num_idle_threads_ == 0) return nullptr;
+
+    idle_thread_pool_ = std::make_unique<tlx::ThreadPool>(
+        num_idle_threads_,
+        [this](size_t i) {
+            if (!idle_cpus_.empty())
+                common::SetCpuAffinity(idle_cpus_[i]);
+        });
+    return idle_thread_pool_.get();
+}
+
 /******************************************************************************/
 // Context methods
 
 Context::Context(HostContext& host_context, size_t local_worker_id)
-    : local_host_id_(host_context.local_host_id()),
+    : host_context_(host_context),
+      local_host_id_(host_context.local_host_id()),
       local_worker_id_(local_worker_id),
       workers_per_host_(host_context.workers_per_host()),
       mem_limit_(host_context.worker_mem_limit()),
@@ -1243,6 +1506,9 @@ struct OverallStats {
     //! network traffic performed by net layer
     size_t net_traffic_tx, net_traffic_rx;
 
+    //! Stream bytes sent to workers on the same host and on other hosts
+    size_t stream_int_bytes, stream_net_bytes;
+
     //! I/O volume performed by io layer
     size_t io_volume;
 
@@ -1255,6 +1521,8 @@ struct OverallStats {
                   << " max_block_bytes=" << c.max_block_bytes
                   << " net_traffic_tx=" << c.net_traffic_tx
                   << " net_traffic_rx=" << c.net_traffic_rx
+                  << " stream_int_bytes=" << c.stream_int_bytes
+                  << " stream_net_bytes=" << c.stream_net_bytes
                   << " io_volume=" << c.io_volume
                   << " io_max_allocation=" << c.io_max_allocation
                   << "]";
@@ -1266,6 +1534,8 @@ struct OverallStats {
         r.max_block_bytes = max_block_bytes + b.max_block_bytes;
         r.net_traffic_tx = net_traffic_tx + b.net_traffic_tx;
         r.net_traffic_rx = net_traffic_rx + b.net_traffic_rx;
+        r.stream_int_bytes = stream_int_bytes + b.stream_int_bytes;
+        r.stream_net_bytes = stream_net_bytes + b.stream_net_bytes;
         r.io_volume = io_volume + b.io_volume;
         r.io_max_allocation = std::max(io_max_allocation, b.io_max_allocation);
         return r;
@@ -1308,6 +1578,11 @@ void Context::Launch(const std::function<void(Context&)>& job_startpoint) {
     stats.net_traffic_tx = local_worker_id_ == 0 ? net_manager_.Traffic().tx : 0;
     stats.net_traffic_rx = local_worker_id_ == 0 ? net_manager_.Traffic().rx : 0;
 
+    stats.stream_int_bytes =
+        local_worker_id_ == 0 ? multiplexer_.tx_int_bytes() : 0;
+    stats.stream_net_bytes =
+        local_worker_id_ == 0 ? multiplexer_.tx_net_bytes() : 0;
+
     if (local_host_id_ == 0 && local_worker_id_ == 0) {
         foxxll::stats_data io_stats(*foxxll::stats::get_instance());
         stats.io_volume = io_stats.get_read_bytes() + io_stats.get_write_bytes();
@@ -1336,6 +1611,9 @@ void Context::Launch(const std::function<void(Context&)>& job_startpoint) {
                 << " ran " << stats.runtime << "s with max "
                 << format_iec_units(stats.max_block_bytes) << "B in DIA Blocks, "
                 << format_iec_units(stats.net_traffic_tx) << "B network traffic, "
+                << format_iec_units(stats.stream_int_bytes) << "B intra-host and "
+                << format_iec_units(stats.stream_net_bytes) << "B inter-host "
+                << "stream data, "
                 << format_iec_units(stats.io_volume) << "B disk I/O, and "
                 << format_iec_units(stats.io_max_allocation) << "B max disk use."
                 << std::endl;
@@ -1345,6 +1623,8 @@ void Context::Launch(const std::function<void(Context&)>& job_startpoint) {
                 << "event" << "summary"
                 << "runtime" << stats.runtime
                 << "net_traffic" << stats.net_traffic_tx
+                << "stream_int_bytes" << stats.stream_int_bytes
+                << "stream_net_bytes" << stats.stream_net_bytes
                 << "io_volume" << stats.io_volume
                 << "io_max_allocation" << stats.io_max_allocation;
     }
@@ -27,12 +27,16 @@
 #include <thrill/net/flow_control_manager.hpp>
 #include <thrill/net/manager.hpp>
 
+#include <tlx/thread_pool.hpp>
+
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <mutex>
 #include <numeric>
 #include <random>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -141,6 +145,51 @@ public:
     //! data multiplexer transmits large amounts of data asynchronously.
     data::Multiplexer& data_multiplexer() { return data_multiplexer_; }
 
+    //! host-global pool of helper threads for the cores not occupied by
+    //! workers, or nullptr if there are no idle cores. Created on first use.
+    tlx::ThreadPool * idle_thread_pool();
+
+    //! \name Worker Placement
+    //! \{
+
+    /*!
+     * Set the cpus of the local workers, or none if they are not pinned. This
+     * splits the workers into socket groups for the hierarchical collectives
+     * of the FlowControlChannel and places their ByteBlocks on the cpus' NUMA
+     * nodes. Must be called before the workers start.
+     */
+    void PlaceWorkers(const std::vector<size_t>& cpus);
+
+    //! pin a worker's thread to its cpu selected by PlaceWorkers().
+    void PinWorker(std::thread& thread, size_t local_worker_id);
+
+    /*!
+     * Set the number of helper threads of idle_thread_pool(), which is this
+     * host's share of the cores not occupied by workers, and their cpus, or
+     * none if they are not pinned. Must be called before the workers start.
+     */
+    void PlaceIdleThreads(size_t num_threads, const std::vector<size_t>& cpus);
+
+    //! whether workers are pinned to cpus
+    bool workers_pinned() const { return !worker_cpus_.empty(); }
+
+    //! cpu of a local worker, only valid if workers_pinned().
+    size_t worker_cpu(size_t local_worker_id) const {
+        return worker_cpus_[local_worker_id];
+    }
+
+    //! socket of a local worker, zero if workers are not pinned.
+    size_t worker_socket(size_t local_worker_id) const {
+        return worker_socket_[local_worker_id];
+    }
+
+    //! number of socket groups the local workers are split into.
+    size_t num_socket_groups() const {
+        return flow_manager_.num_socket_groups();
+    }
+
+    //! \}
+
 private:
     //! memory configuration
     MemoryConfig mem_config_;
@@ -208,6 +257,25 @@ private:
         mem_manager_, block_pool_,
         *dispatcher_, net_manager_.GetDataGroup(), workers_per_host_
     };
+
+    //! mutex protecting creation of idle_thread_pool_
+    std::mutex idle_thread_pool_mutex_;
+
+    //! helper threads on idle cores, e.g. for parallel local sorting
+    std::unique_ptr<tlx::ThreadPool> idle_thread_pool_;
+
+    //! number of threads of idle_thread_pool_
+    size_t num_idle_threads_ = 0;
+
+    //! cpu of each thread of idle_thread_pool_, empty if they are not pinned
+    std::vector<size_t> idle_cpus_;
+
+    //! cpu of each local worker, empty if they are not pinned
+    std::vector<size_t> worker_cpus_;
+
+    //! socket of each local worker
+    std::vector<size_t> worker_socket_ =
+        std::vector<size_t>(workers_per_host_, 0);
 };
 
 /*!
@@ -267,6 +335,16 @@ public:
     //! id among all _local_ hosts (in test program runs)
     size_t local_host_id() const { return local_host_id_; }
 
+    //! socket of the cpu this worker is pinned to, zero if not pinned.
+    size_t local_socket() const {
+        return host_context_.worker_socket(local_worker_id_);
+    }
+
+    //! number of sockets the workers of this host are spread over.
+    size_t num_local_sockets() const {
+        return host_context_.num_socket_groups();
+    }
+
 #ifndef SWIG
     //! Outputs the context as [host id]:[local worker id] to an std::ostream
     friend std::ostream& operator << (std::ostream& os, const Context& ctx) {
@@ -333,6 +411,12 @@ public:
 
     net::Manager& net_manager() { return net_manager_; }
 
+    //! host-global pool of helper threads on idle cores, shared by all workers
+    //! on this host, or nullptr if all cores are occupied by workers.
+    tlx::ThreadPool * idle_thread_pool() {
+        return host_context_.idle_thread_pool();
+    }
+
     //! given a global range [0,global_size) and p PEs to split the range, calculate
     //! the [local_begin,local_end) index range assigned to the PE i. Takes the
     //! information from the Context.
@@ -391,6 +475,9 @@ public:
     size_t next_dia_id() { return ++last_dia_id_; }
 
 private:
+    //! host context shared by all workers on this host
+    HostContext& host_context_;
+
     //! id among all _local_ hosts (in test program runs)
     size_t local_host_id_;
 
@@ -124,6 +124,22 @@ const struct LocationDetectionFlag<true> LocationDetectionTag;
 //! global const LocationDetectionFlag instance
 const struct LocationDetectionFlag<false> NoLocationDetectionTag;
 
+//! tag structure for GroupByKey()
+template <bool Value>
+struct HashGroupingFlag {
+    HashGroupingFlag() { }
+    static const bool value = Value;
+};
+
+//! global const HashGroupingFlag instance
+const struct HashGroupingFlag<true> HashGroupingTag;
+
+//! global const HashGroupingFlag instance
+const struct HashGroupingFlag<false> NoHashGroupingTag;
+
+//! default configuration of Sort(), defined in sort.hpp
+class DefaultSortConfig;
+
 /*!
  * DIA is the interface between the user and the Thrill framework. A DIA can be
  * imagined as an immutable array, even though the data does not need to be
@@ -1570,6 +1586,106 @@ public:
                     const GroupByFunction& groupby_function,
                     const HashFunction& hash_function = HashFunction()) const;
 
+    /*!
+     * GroupByKey is a DOp, which groups elements of the DIA by its key.
+     * After having grouped all elements of one key, all elements of one key
+     * will be processed according to the GroupByFunction and returns an output
+     * Contrary to Reduce, GroupBy allows usage of functions that require all
+     * elements of one key at once as GroupByFunction will be applied _after_
+     * all elements with the same key have been grouped. However because of this
+     * reason, the communication overhead is also higher. If possible, usage of
+     * Reduce is therefore recommended.
+     *
+     * \image html dia_ops/GroupByKey.svg
+     *
+     * As GroupBy is a DOp, it creates a new DIANode. The DIA returned by
+     * Reduce links to this newly created DIANode. The stack_ of the returned
+     * DIA consists of the PostOp of Reduce, as a reduced element can
+     * directly be chained to the following LOps.
+     *
+     * \tparam KeyExtractor Type of the key_extractor function.
+     * The key_extractor function is equal to a map function.
+     *
+     * \param key_extractor Key extractor function, which maps each element to a
+     * key of possibly different type.
+     *
+     * \tparam GroupByFunction Type of the groupby_function. This is a function
+     * taking an iterator for all elements of the same key as input.
+     *
+     * \param groupby_function Reduce function, which defines how the key
+     * buckets are grouped and processed.
+     *      input param: api::GroupByReader with functions HasNext() and Next()
+     *
+     * \param hash_function Hash method for Keys
+     *
+     * With HashGroupingTag, the items of each key are collected in a hash table
+     * instead of being sorted, hence the groups are delivered in no particular
+     * order. If the items do not fit into RAM, they are split into partitions
+     * by hash, and partitions with too many equal keys are grouped by sorting.
+     *
+     * \ingroup dia_dops
+     */
+    template <typename ValueOut, bool LocationDetectionTagValue,
+              bool HashGroupingTagValue,
+              typename KeyExtractor, typename GroupByFunction,
+              typename HashFunction =
+                  std::hash<typename FunctionTraits<KeyExtractor>::result_type>
+              >
+    auto GroupByKey(const LocationDetectionFlag<LocationDetectionTagValue>&,
+                    const HashGroupingFlag<HashGroupingTagValue>&,
+                    const KeyExtractor& key_extractor,
+                    const GroupByFunction& groupby_function,
+                    const HashFunction& hash_function = HashFunction()) const;
+
+    /*!
+     * GroupByKey is a DOp, which groups elements of the DIA by its key.
+     * After having grouped all elements of one key, all elements of one key
+     * will be processed according to the GroupByFunction and returns an output
+     * Contrary to Reduce, GroupBy allows usage of functions that require all
+     * elements of one key at once as GroupByFunction will be applied _after_
+     * all elements with the same key have been grouped. However because of this
+     * reason, the communication overhead is also higher. If possible, usage of
+     * Reduce is therefore recommended.
+     *
+     * \image html dia_ops/GroupByKey.svg
+     *
+     * As GroupBy is a DOp, it creates a new DIANode. The DIA returned by
+     * Reduce links to this newly created DIANode. The stack_ of the returned
+     * DIA consists of the PostOp of Reduce, as a reduced element can
+     * directly be chained to the following LOps.
+     *
+     * \tparam KeyExtractor Type of the key_extractor function.
+     * The key_extractor function is equal to a map function.
+     *
+     * \param key_extractor Key extractor function, which maps each element to a
+     * key of possibly different type.
+     *
+     * \tparam GroupByFunction Type of the groupby_function. This is a function
+     * taking an iterator for all elements of the same key as input.
+     *
+     * \param groupby_function Reduce function, which defines how the key
+     * buckets are grouped and processed.
+     *      input param: api::GroupByReader with functions HasNext() and Next()
+     *
+     * \param hash_function Hash method for Keys
+     *
+     * With HashGroupingTag, the items of each key are collected in a hash table
+     * instead of being sorted, hence the groups are delivered in no particular
+     * order. If the items do not fit into RAM, they are split into partitions
+     * by hash, and partitions with too many equal keys are grouped by sorting.
+     *
+     * \ingroup dia_dops
+     */
+    template <typename ValueOut, bool HashGroupingTagValue,
+              typename KeyExtractor, typename GroupByFunction,
+              typename HashFunction =
+                  std::hash<typename FunctionTraits<KeyExtractor>::result_type>
+              >
+    auto GroupByKey(const HashGroupingFlag<HashGroupingTagValue>&,
+                    const KeyExtractor& key_extractor,
+                    const GroupByFunction& groupby_function,
+                    const HashFunction& hash_function = HashFunction()) const;
+
     /*!
      * GroupBy is a DOp, which groups elements of the DIA by its key.
      * After having grouped all elements of one key, all elements of one key
@@ -1768,11 +1884,16 @@ public:
      * \param sort_algorithm Algorithm class used to sort items. Merging is
      * always done using a tournament tree with compare_function.
      *
+     * \param sort_config Operational parameters of the sort, see
+     * DefaultSortConfig.
+     *
      * \ingroup dia_dops
      */
-    template <typename CompareFunction, typename SortAlgorithm>
+    template <typename CompareFunction, typename SortAlgorithm,
+              typename SortConfig = DefaultSortConfig>
     auto Sort(const CompareFunction& compare_function,
-              const SortAlgorithm& sort_algorithm) const;
+              const SortAlgorithm& sort_algorithm,
+              const SortConfig& sort_config = SortConfig()) const;
 
     /*!
      * SortStable is a DOp, which sorts a given DIA stably according to the
@@ -1807,11 +1928,16 @@ public:
      * is always done using a tournament tree with compare_function. In order
      * for the sorting to be stable, this must be a stable sorting algorithm.
      *
+     * \param sort_config Operational parameters of the sort, see
+     * DefaultSortConfig. Stable sorts always exchange items in a single level.
+     *
      * \ingroup dia_dops
      */
-    template <typename CompareFunction, typename SortAlgorithm>
+    template <typename CompareFunction, typename SortAlgorithm,
+              typename SortConfig = DefaultSortConfig>
     auto SortStable(const CompareFunction& compare_function,
-                    const SortAlgorithm& sort_algorithm) const;
+                    const SortAlgorithm& sort_algorithm,
+                    const SortConfig& sort_config = SortConfig()) const;
 
     /*!
      * Merge is a DOp, which merges two sorted DIAs to a single sorted DIA.
@@ -2090,6 +2216,15 @@ using api::LocationDetectionTag;
 //! imported from api namespace
 using api::NoLocationDetectionTag;
 
+//! imported from api namespace
+using api::HashGroupingFlag;
+
+//! imported from api namespace
+using api::HashGroupingTag;
+
+//! imported from api namespace
+using api::NoHashGroupingTag;
+
 } // namespace thrill
 
 #endif // !THRILL_API_DIA_HEADER
@@ -35,7 +35,7 @@ namespace api {
 // forward declarations for friend classes
 template <typename ValueType,
           typename KeyExtractor, typename GroupFunction, typename HashFunction,
-          bool UseLocationDetection>
+          bool UseLocationDetection, bool UseHashGrouping>
 class GroupByNode;
 
 template <typename ValueType,
@@ -51,7 +51,8 @@ class GroupByIterator
               typename T2,
               typename T3,
               typename T4,
-              bool T5>
+              bool T5,
+              bool T6>
     friend class GroupByNode;
 
     template <typename T1,
@@ -135,7 +136,8 @@ class GroupByMultiwayMergeIterator
               typename T2,
               typename T3,
               typename T4,
-              bool T5>
+              bool T5,
+              bool T6>
     friend class GroupByNode;
 
     template <typename T1,
@@ -211,6 +213,47 @@ private:
     }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Iterator over the items of one group in hash grouping mode. The items are
+ * stored in a vector, and next holds the index of the following item of the
+ * same key, or the vector's size for the last one.
+ */
+template <typename ValueType>
+class GroupByChainIterator
+{
+public:
+    using ValueIn = ValueType;
+
+    GroupByChainIterator(const std::vector<ValueIn>& items,
+                         const std::vector<size_t>& next, size_t first)
+        : items_(items), next_(next), index_(first) { }
+
+    //! non-copyable: delete copy-constructor
+    GroupByChainIterator(const GroupByChainIterator&) = delete;
+    //! non-copyable: delete assignment operator
+    GroupByChainIterator& operator = (const GroupByChainIterator&) = delete;
+    //! move-constructor: default
+    GroupByChainIterator(GroupByChainIterator&&) = default;
+
+    bool HasNext() {
+        return index_ < items_.size();
+    }
+
+    ValueIn Next() {
+        assert(HasNext());
+        size_t index = index_;
+        index_ = next_[index];
+        return items_[index];
+    }
+
+private:
+    const std::vector<ValueIn>& items_;
+    const std::vector<size_t>& next_;
+    size_t index_;
+};
+
 //! \}
 
 } // namespace api
@@ -19,6 +19,7 @@
 #include <thrill/api/dop_node.hpp>
 #include <thrill/api/group_by_iterator.hpp>
 #include <thrill/common/functional.hpp>
+#include <thrill/common/hash.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/core/location_detection.hpp>
 #include <thrill/core/reduce_functional.hpp>
@@ -27,6 +28,7 @@
 #include <tlx/vector_free.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <deque>
 #include <functional>
 #include <type_traits>
@@ -39,11 +41,21 @@ namespace thrill {
 namespace api {
 
 /*!
+ * DIANode for GroupByKey. The items are sent to workers by the hash of their
+ * key. By default, each worker sorts the received items in runs and merges
+ * them to bring equal keys together.
+ *
+ * With UseHashGrouping, the received items are instead chained by key in a
+ * hash table, which avoids sorting if there are many small groups. Items
+ * which do not fit into RAM are split into partitions by a salted hash, and
+ * partitions which are still too large after max_partition_levels_ are
+ * grouped by sorting.
+ *
  * \ingroup api_layer
  */
 template <typename ValueType,
           typename KeyExtractor, typename GroupFunction, typename HashFunction,
-          bool UseLocationDetection>
+          bool UseLocationDetection, bool UseHashGrouping>
 class GroupByNode final : public DOpNode<ValueType>
 {
 private:
@@ -171,7 +183,11 @@ public:
     }
 
     DIAMemUse PushDataMemUse() final {
-        if (files_.size() <= 1) {
+        if (!partitions_.empty()) {
+            // hash tables of the partitions
+            return DIAMemUse::Max();
+        }
+        else if (files_.size() <= 1) {
             // direct push, no merge necessary
             return 0;
         }
@@ -202,6 +218,9 @@ public:
     }
 
     void PushData(bool consume) final {
+        for (data::File& file : partitions_)
+            HashGroupFile(file, consume);
+
         LOG << "sort data";
         common::StatsTimerStart timer;
         const size_t num_runs = files_.size();
@@ -291,7 +310,10 @@ public:
             << " multiwaymerge=" << (num_runs > 1);
     }
 
-    void Dispose() override { }
+    void Dispose() override {
+        partitions_.clear();
+        files_.clear();
+    }
 
 private:
     KeyExtractor key_extractor_;
@@ -311,6 +333,138 @@ private:
     data::File pre_file_;
     data::File::Writer pre_writer_;
 
+    //! \name Hash Grouping
+    //! \{
+
+    //! maximum number of hash partitioning levels, after which a partition
+    //! is grouped by sorting, as it must contain many equal keys.
+    static constexpr size_t max_partition_levels_ = 3;
+
+    //! maximum number of partitions created per partitioning level
+    static constexpr size_t max_partition_fanout_ = 64;
+
+    //! partitions of the received items whose hash tables fit into RAM
+    std::vector<data::File> partitions_;
+
+    //! estimated RAM used to group num_items items in a hash table: the item,
+    //! its successor index, and, if all keys are distinct, a group of two
+    //! indexes and a node with the key, the group index, a next pointer, and
+    //! the cached hash, plus a bucket pointer.
+    static size_t HashGroupBytes(size_t num_items) {
+        return num_items
+               * (sizeof(ValueIn) + sizeof(Key) + 7 * sizeof(size_t));
+    }
+
+    //! RAM available for the hash table of a partition
+    size_t HashGroupLimit() const {
+        return std::max<size_t>(DIABase::mem_limit_ / 2, 1);
+    }
+
+    /*!
+     * Store the file as partition if its hash table fits into RAM. Otherwise
+     * split it by a hash salted with the level and store the parts, or, after
+     * max_partition_levels_, sort it into runs in files_.
+     */
+    void PartitionFile(data::File& file, size_t level) {
+        if (file.num_items() == 0) return;
+
+        if (HashGroupBytes(file.num_items()) <= HashGroupLimit()) {
+            partitions_.emplace_back(std::move(file));
+            return;
+        }
+
+        if (level >= max_partition_levels_) {
+            LOG1 << "Thrill: Warning: Too many equal keys for main memory "
+                 << "in GroupByKey. Falling back to sorting.";
+
+            size_t capacity = std::max<size_t>(
+                1, HashGroupLimit() / sizeof(ValueIn));
+            std::vector<ValueIn> run;
+            auto reader = file.GetConsumeReader();
+            while (reader.HasNext()) {
+                run.emplace_back(reader.template Next<ValueIn>());
+                if (run.size() >= capacity) {
+                    FlushVectorToFile(run);
+                    run.clear();
+                }
+            }
+            if (!run.empty()) FlushVectorToFile(run);
+            return;
+        }
+
+        size_t max_fanout = max_partition_fanout_;
+        size_t fanout = static_cast<size_t>(
+            std::ceil(1.25 * static_cast<double>(
+                          HashGroupBytes(file.num_items()))
+                      / static_cast<double>(HashGroupLimit())));
+        fanout = std::max<size_t>(2, std::min(max_fanout, fanout));
+
+        sLOG << "GroupByKey: hash partitioning" << file.num_items()
+             << "items into" << fanout << "partitions on level" << level;
+
+        std::vector<data::File> parts;
+        std::vector<data::File::Writer> writers;
+        for (size_t i = 0; i < fanout; ++i) {
+            parts.emplace_back(context_.GetFile(this));
+            writers.emplace_back(parts.back().GetWriter());
+        }
+
+        auto reader = file.GetConsumeReader();
+        while (reader.HasNext()) {
+            ValueIn item = reader.template Next<ValueIn>();
+            uint64_t hash = common::Hash128to64(
+                level + 1, hash_function_(key_extractor_(item)));
+            writers[hash % fanout].Put(item);
+        }
+        for (data::File::Writer& writer : writers)
+            writer.Close();
+
+        for (data::File& part : parts)
+            PartitionFile(part, level + 1);
+    }
+
+    //! group the items of a partition in a hash table, which chains the items
+    //! of each key in their order, and call the user function per group.
+    void HashGroupFile(data::File& file, bool consume) {
+        std::vector<ValueIn> items;
+        items.reserve(file.num_items());
+        {
+            auto reader = file.GetReader(consume);
+            while (reader.HasNext())
+                items.emplace_back(reader.template Next<ValueIn>());
+        }
+
+        // first and last item of each group, and successor of each item
+        std::vector<std::pair<size_t, size_t> > groups;
+        std::vector<size_t> next(items.size(), items.size());
+        {
+            std::unordered_map<Key, size_t, HashFunction> index(
+                items.size(), hash_function_);
+            for (size_t i = 0; i < items.size(); ++i) {
+                auto it = index.emplace(
+                    key_extractor_(items[i]), groups.size());
+                if (it.second) {
+                    groups.emplace_back(i, i);
+                }
+                else {
+                    std::pair<size_t, size_t>& group = groups[it.first->second];
+                    next[group.second] = i;
+                    group.second = i;
+                }
+            }
+        }
+
+        for (const std::pair<size_t, size_t>& group : groups) {
+            GroupByChainIterator<ValueIn> user_iterator(
+                items, next, group.first);
+            const ValueOut res = groupby_function_(
+                user_iterator, key_extractor_(items[group.first]));
+            this->PushItem(res);
+        }
+    }
+
+    //! \}
+
     void RunUserFunc(data::File& f, bool consume) {
         auto r = f.GetReader(consume);
         if (r.HasNext()) {
@@ -348,6 +502,24 @@ private:
     void MainOp() {
         LOG << "running group by main op";
 
+        if (UseHashGrouping) {
+            data::File file = context_.GetFile(this);
+            data::File::Writer writer = file.GetWriter();
+            auto reader = stream_->GetCatReader(/* consume */ true);
+            while (reader.HasNext())
+                writer.Put(reader.template Next<ValueIn>());
+            writer.Close();
+            stream_.reset();
+
+            PartitionFile(file, /* level */ 0);
+
+            LOG << "RESULT"
+                << " name=mainop"
+                << " partitions=" << partitions_.size()
+                << " number_files=" << files_.size();
+            return;
+        }
+
         std::vector<ValueIn> incoming;
 
         common::StatsTimerStart timer;
@@ -380,9 +552,11 @@ private:
 
 template <typename ValueType, typename Stack>
 template <typename ValueOut, bool LocationDetectionValue,
+          bool HashGroupingValue,
           typename KeyExtractor, typename GroupFunction, typename HashFunction>
 auto DIA<ValueType, Stack>::GroupByKey(
     const LocationDetectionFlag<LocationDetectionValue>&,
+    const HashGroupingFlag<HashGroupingValue>&,
     const KeyExtractor& key_extractor,
     const GroupFunction& groupby_function,
     const HashFunction& hash_function) const {
@@ -396,7 +570,7 @@ auto DIA<ValueType, Stack>::GroupByKey(
 
     using GroupByNode = api::GroupByNode<
         ValueOut, KeyExtractor, GroupFunction, HashFunction,
-        LocationDetectionValue>;
+        LocationDetectionValue, HashGroupingValue>;
 
     auto node = tlx::make_counting<GroupByNode>(
         *this, key_extractor, groupby_function, hash_function);
@@ -404,6 +578,34 @@ auto DIA<ValueType, Stack>::GroupByKey(
     return DIA<ValueOut>(node);
 }
 
+template <typename ValueType, typename Stack>
+template <typename ValueOut, bool LocationDetectionValue,
+          typename KeyExtractor, typename GroupFunction, typename HashFunction>
+auto DIA<ValueType, Stack>::GroupByKey(
+    const LocationDetectionFlag<LocationDetectionValue>& location_detection,
+    const KeyExtractor& key_extractor,
+    const GroupFunction& groupby_function,
+    const HashFunction& hash_function) const {
+    // forward to method _without_ hash grouping
+    return GroupByKey<ValueOut>(
+        location_detection, NoHashGroupingTag,
+        key_extractor, groupby_function, hash_function);
+}
+
+template <typename ValueType, typename Stack>
+template <typename ValueOut, bool HashGroupingValue,
+          typename KeyExtractor, typename GroupFunction, typename HashFunction>
+auto DIA<ValueType, Stack>::GroupByKey(
+    const HashGroupingFlag<HashGroupingValue>& hash_grouping,
+    const KeyExtractor& key_extractor,
+    const GroupFunction& groupby_function,
+    const HashFunction& hash_function) const {
+    // forward to method _without_ location detection
+    return GroupByKey<ValueOut>(
+        NoLocationDetectionTag, hash_grouping,
+        key_extractor, groupby_function, hash_function);
+}
+
 template <typename ValueType, typename Stack>
 template <typename ValueOut, typename KeyExtractor,
           typename GroupFunction, typename HashFunction>
@@ -17,15 +17,28 @@
 #include <thrill/api/dop_node.hpp>
 #include <thrill/common/function_traits.hpp>
 #include <thrill/common/functional.hpp>
+#include <thrill/common/hash.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/common/stats_timer.hpp>
+#include <thrill/core/bloom_filter.hpp>
 #include <thrill/core/buffered_multiway_merge.hpp>
+#include <thrill/core/count_min_sketch.hpp>
 #include <thrill/core/location_detection.hpp>
+#include <thrill/core/multiway_merge.hpp>
+#include <thrill/data/cat_stream.hpp>
 #include <thrill/data/file.hpp>
+#include <tlx/math/integer_log2.hpp>
+#include <tlx/math/round_to_power_of_two.hpp>
+#include <tlx/vector_free.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <deque>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -53,6 +66,28 @@ namespace api {
  * \param key_extractor2 Key extractor for second DIA
  *
  * \param join_function Join function applied to all equal key pairs
+ *
+ * If the smaller input is small compared to the larger one and fits into RAM,
+ * it is broadcast to all workers, otherwise both inputs are hash partitioned
+ * among the workers. Each worker then builds a hash table from the smaller side
+ * and probes it with the items of the other. If the build side does not fit
+ * into RAM, both sides are split further into partitions by hash (grace hash
+ * join). A partition whose build side still does not fit, since it contains
+ * many equal keys, is joined by sorting both sides and merging them.
+ *
+ * Keys must be hashable by the HashFunction, comparable with ==, and, for
+ * the sort-merge fallback, ordered by operator <.
+ *
+ * With location detection, items whose keys occur only in one input are not
+ * sent at all. Without it, the larger input is filtered by a Bloom filter of
+ * the smaller input's keys if that is cheap, which removes most unmatched
+ * items of joins with a low match rate.
+ *
+ * Keys which are frequent in the inputs are detected by Count-Min sketches
+ * while buffering. For each such heavy key, the items of the input in which it
+ * is more frequent are spread round-robin over all workers, and the items of
+ * the other input with this key are replicated to all workers, so that no
+ * single worker has to join all items of the key.
  */
 template <typename ValueType, typename FirstDIA, typename SecondDIA,
           typename KeyExtractor1, typename KeyExtractor2,
@@ -142,6 +177,15 @@ public:
           key_extractor2_(key_extractor2),
           join_function_(join_function),
           hash_function_(hash_function) {
+        if (context_.num_workers() > 1) {
+            size_t width = std::min<size_t>(
+                1u << 16, std::max<size_t>(
+                    1024, tlx::round_up_to_power_of_two(
+                        16 * context_.num_workers())));
+            sketch1_ = std::make_unique<core::CountMinSketch>(width);
+            sketch2_ = std::make_unique<core::CountMinSketch>(width);
+        }
+
         auto pre_op_fn1 = [this](const InputTypeFirst& input) {
                               PreOp1(input);
                           };
@@ -158,6 +202,33 @@ public:
 
     void Execute() final {
 
+        ChooseBroadcast();
+
+        if (broadcast_side_ != 0) {
+            sLOG << "Join: broadcasting input" << broadcast_side_;
+
+            heavy_candidates_.clear();
+            sketch1_.reset();
+            sketch2_.reset();
+
+            if (UseLocationDetection)
+                location_detection_.Dispose();
+
+            if (broadcast_side_ == 1)
+                BroadcastFile<InputTypeFirst>(pre_file1_);
+            else
+                BroadcastFile<InputTypeSecond>(pre_file2_);
+
+            // the hash streams are not used, close them on all workers.
+            hash_writers1_.Close();
+            hash_writers2_.Close();
+            hash_stream1_.reset();
+            hash_stream2_.reset();
+            return;
+        }
+
+        ChooseHeavyKeys();
+
         if (UseLocationDetection) {
             std::unordered_map<size_t, size_t> target_processors;
             size_t max_hash = location_detection_.Flush(target_processors);
@@ -166,135 +237,94 @@ public:
             auto file1reader = pre_file1_.GetConsumeReader();
             while (file1reader.HasNext()) {
                 InputTypeFirst in1 = file1reader.template Next<InputTypeFirst>();
-                auto target_processor =
-                    target_processors.find(
-                        hash_function_(key_extractor1_(in1)) % max_hash);
+                size_t hash = hash_function_(key_extractor1_(in1));
+                auto target_processor = target_processors.find(hash % max_hash);
                 if (target_processor != target_processors.end()) {
-                    hash_writers1_[target_processor->second].Put(in1);
+                    SendItem(hash_writers1_, /* side */ 1, hash,
+                             target_processor->second, in1);
                 }
             }
 
             auto file2reader = pre_file2_.GetConsumeReader();
             while (file2reader.HasNext()) {
                 InputTypeSecond in2 = file2reader.template Next<InputTypeSecond>();
-                auto target_processor =
-                    target_processors.find(
-                        hash_function_(key_extractor2_(in2)) % max_hash);
+                size_t hash = hash_function_(key_extractor2_(in2));
+                auto target_processor = target_processors.find(hash % max_hash);
                 if (target_processor != target_processors.end()) {
-                    hash_writers2_[target_processor->second].Put(in2);
+                    SendItem(hash_writers2_, /* side */ 2, hash,
+                             target_processor->second, in2);
                 }
             }
         }
+        else {
+            ChooseBloomFilter();
 
-        hash_writers1_.Close();
-        hash_writers2_.Close();
+            auto file1reader = pre_file1_.GetConsumeReader();
+            while (file1reader.HasNext()) {
+                InputTypeFirst in1 = file1reader.template Next<InputTypeFirst>();
+                size_t hash = hash_function_(key_extractor1_(in1));
+                if (bloom_side_ == 1 && !bloom_filter_.Contains(hash))
+                    continue;
+                SendItem(hash_writers1_, /* side */ 1, hash,
+                         hash % context_.num_workers(), in1);
+            }
 
-        MainOp();
-    }
+            auto file2reader = pre_file2_.GetConsumeReader();
+            while (file2reader.HasNext()) {
+                InputTypeSecond in2 = file2reader.template Next<InputTypeSecond>();
+                size_t hash = hash_function_(key_extractor2_(in2));
+                if (bloom_side_ == 2 && !bloom_filter_.Contains(hash))
+                    continue;
+                SendItem(hash_writers2_, /* side */ 2, hash,
+                         hash % context_.num_workers(), in2);
+            }
 
-    template <typename ElementType, typename CompareFunction>
-    auto MakePuller(std::deque<data::File>& files,
-                    std::vector<data::File::Reader>& seq,
-                    CompareFunction compare_function, bool consume) {
+            bloom_filter_ = core::BloomFilter();
+        }
 
-        size_t merge_degree, prefetch;
-        std::tie(merge_degree, prefetch) =
-            context_.block_pool().MaxMergeDegreePrefetch(files.size());
-        // construct output merger of remaining Files
-        seq.reserve(files.size());
-        for (size_t t = 0; t < files.size(); ++t)
-            seq.emplace_back(files[t].GetReader(consume, /* prefetch */ 0));
-        StartPrefetch(seq, prefetch);
+        heavy_keys_.clear();
 
-        return core::make_buffered_multiway_merge_tree<ElementType>(
-            seq.begin(), seq.end(), compare_function);
+        hash_writers1_.Close();
+        hash_writers2_.Close();
+
+        MainOp();
     }
 
     void PushData(bool consume) final {
 
-        auto compare_function_1 =
-            [this](const InputTypeFirst& in1, const InputTypeFirst& in2) {
-                return key_extractor1_(in1) < key_extractor1_(in2);
-            };
-
-        auto compare_function_2 =
-            [this](const InputTypeSecond& in1, const InputTypeSecond& in2) {
-                return key_extractor2_(in1) < key_extractor2_(in2);
-            };
-
-        // no possible join results when at least one data set is empty
-        if (!files1_.size() || !files2_.size())
+        if (broadcast_side_ == 1) {
+            HashJoin<InputTypeFirst, InputTypeSecond>(
+                broadcast_file_, key_extractor1_,
+                pre_file2_, key_extractor2_, consume, JoinFirstSecond(this));
             return;
+        }
+        if (broadcast_side_ == 2) {
+            HashJoin<InputTypeSecond, InputTypeFirst>(
+                broadcast_file_, key_extractor2_,
+                pre_file1_, key_extractor1_, consume, JoinSecondFirst(this));
+            return;
+        }
 
-        //! Merge files when there are too many for the merge tree.
-        MergeFiles<InputTypeFirst>(files1_, compare_function_1);
-        MergeFiles<InputTypeSecond>(files2_, compare_function_2);
-
-        std::vector<data::File::Reader> seq1;
-        std::vector<data::File::Reader> seq2;
-
-        // construct output merger of remaining Files
-        auto puller1 = MakePuller<InputTypeFirst>(
-            files1_, seq1, compare_function_1, consume);
-        auto puller2 = MakePuller<InputTypeSecond>(
-            files2_, seq2, compare_function_2, consume);
-
-        bool puller1_done = false;
-        if (!puller1.HasNext())
-            puller1_done = true;
-
-        bool puller2_done = false;
-        if (!puller2.HasNext())
-            puller2_done = true;
-
-        //! cache for elements with equal keys, cartesian product of both caches
-        //! are joined with the join_function
-        std::vector<InputTypeFirst> equal_keys1;
-        std::vector<InputTypeSecond> equal_keys2;
-
-        while (!puller1_done && !puller2_done) {
-            //! find elements with equal key
-            if (key_extractor1_(puller1.Top()) <
-                key_extractor2_(puller2.Top())) {
-                if (!puller1.Update()) {
-                    puller1_done = true;
-                    break;
-                }
-            }
-            else if (key_extractor2_(puller2.Top()) <
-                     key_extractor1_(puller1.Top())) {
-                if (!puller2.Update()) {
-                    puller2_done = true;
-                    break;
-                }
-            }
-            else {
-                bool external1 = false;
-                bool external2 = false;
-                equal_keys1.clear();
-                equal_keys2.clear();
-                std::tie(puller1_done, external1) =
-                    AddEqualKeysToVec(equal_keys1, puller1,
-                                      key_extractor1_, join_file1_);
-
-                std::tie(puller2_done, external2) =
-                    AddEqualKeysToVec(equal_keys2, puller2,
-                                      key_extractor2_, join_file2_);
-
-                JoinAllElements(equal_keys1, external1, equal_keys2, external2);
-            }
+        for (Partition& partition : partitions_) {
+            JoinPartition(partition.first, partition.second, consume,
+                          /* level */ 1);
         }
     }
 
     void Dispose() final {
-        files1_.clear();
-        files2_.clear();
+        partitions_.clear();
+        pre_file1_.Clear();
+        pre_file2_.Clear();
+        broadcast_file_.Clear();
     }
 
 private:
-    //! files for sorted datasets
-    std::deque<data::File> files1_;
-    std::deque<data::File> files2_;
+    //! pair of Files with the items of both inputs whose keys have the same
+    //! hash partition
+    using Partition = std::pair<data::File, data::File>;
+
+    //! partitions of the received items, which are joined independently
+    std::vector<Partition> partitions_;
 
     //! user-defined functions
     KeyExtractor1 key_extractor1_;
@@ -317,355 +347,822 @@ private:
     core::LocationDetection<HashCount> location_detection_ { context_, Super::dia_id() };
     bool location_detection_initialized_ = false;
 
-    void PreOp1(const InputTypeFirst& input) {
-        size_t hash = hash_function_(key_extractor1_(input));
-        if (UseLocationDetection) {
-            pre_writer1_.Put(input);
-            location_detection_.Insert(HashCount { hash, 1, /* dia_mask */ 1 });
-        }
-        else {
-            hash_writers1_[hash % context_.num_workers()].Put(input);
-        }
+    //! \name Broadcast Join
+    //! \{
+
+    //! the smaller input is broadcast if its items take at most this fraction
+    //! of the memory limit, since each worker holds it in a hash table.
+    static constexpr double broadcast_memory_fraction_ = 0.25;
+
+    //! input which is replicated to all workers (1 or 2), or zero if both
+    //! inputs are hash partitioned.
+    size_t broadcast_side_ = 0;
+
+    //! all items of the replicated input
+    data::File broadcast_file_ { context_.GetFile(this) };
+
+    //! global byte sizes and item counts of both inputs
+    std::vector<size_t> global_sizes_;
+
+    //! smallest memory limit of all workers
+    size_t global_mem_limit_ = 0;
+
+    /*!
+     * Decide whether to broadcast one input from the global sizes of the
+     * buffered inputs. Broadcasting the smaller input of size S sends S * (p-1)
+     * bytes, while partitioning both sends about (S + L) * (p-1) / p, hence
+     * the broadcast is chosen if S * (p-1) < L and S fits into RAM.
+     */
+    void ChooseBroadcast() {
+        using VectorSizeT = std::vector<size_t>;
+
+        VectorSizeT sizes = {
+            pre_file1_.size_bytes(), pre_file2_.size_bytes(),
+            pre_file1_.num_items(), pre_file2_.num_items()
+        };
+        global_sizes_ = context_.net.AllReduce(
+            sizes, common::ComponentSum<VectorSizeT>());
+
+        global_mem_limit_ = context_.net.AllReduce(
+            DIABase::mem_limit_, common::minimum<size_t>());
+
+        const VectorSizeT& g = global_sizes_;
+        size_t side = g[0] <= g[1] ? 1 : 2;
+        size_t small_bytes = g[side - 1], large_bytes = g[2 - side];
+        size_t small_mem =
+            g[side + 1] * (side == 1 ? sizeof(InputTypeFirst)
+                           : sizeof(InputTypeSecond));
+
+        sLOG << "Join: global input bytes" << g[0] << g[1]
+             << "items" << g[2] << g[3];
+
+        if (small_bytes * (context_.num_workers() - 1) < large_bytes &&
+            small_mem <= broadcast_memory_fraction_ * global_mem_limit_)
+            broadcast_side_ = side;
     }
 
-    void PreOp2(const InputTypeSecond& input) {
-        size_t hash = hash_function_(key_extractor2_(input));
-        if (UseLocationDetection) {
-            pre_writer2_.Put(input);
-            location_detection_.Insert(HashCount { hash, 1, /* dia_mask */ 2 });
-        }
-        else {
-            hash_writers2_[hash % context_.num_workers()].Put(input);
+    //! send all items of the file to all workers, and collect the items from
+    //! all workers in broadcast_file_.
+    template <typename ItemType>
+    void BroadcastFile(data::File& file) {
+        data::CatStreamPtr stream = context_.GetNewCatStream(this);
+        data::CatStream::Writers writers = stream->GetWriters();
+        for (size_t w = 0; w < writers.size(); ++w) {
+            writers[w].AppendBlocks(file.blocks());
+            writers[w].Close();
         }
+        file.Clear();
+
+        data::File::Writer writer = broadcast_file_.GetWriter();
+        auto reader = stream->GetCatReader(/* consume */ true);
+        while (reader.HasNext())
+            writer.Put(reader.template Next<ItemType>());
+        writer.Close();
     }
 
-    //! Receive elements from other workers, create pre-sorted files
-    void MainOp() {
-        data::MixStream::MixReader reader1_ =
-            hash_stream1_->GetMixReader(/* consume */ true);
+    //! \}
+
+    //! \name Bloom Filter Semi-Join
+    //! \{
+
+    //! bits per item of the smaller input in the Bloom filter, which yields
+    //! about 1% false positives.
+    static constexpr size_t bloom_bits_per_item_ = 10;
+
+    //! Bloom filter of the keys of the smaller input
+    core::BloomFilter bloom_filter_;
+
+    //! input which is filtered by bloom_filter_ before being sent (1 or 2),
+    //! or zero if none.
+    size_t bloom_side_ = 0;
 
-        size_t capacity = DIABase::mem_limit_ / sizeof(InputTypeFirst) / 2;
+    /*!
+     * Without location detection, build a Bloom filter of the keys of the
+     * smaller input, combine it on all workers, and use it to drop the items
+     * of the larger input which have no join partner. The filter is only used
+     * if combining it costs much less than sending the larger input.
+     */
+    void ChooseBloomFilter() {
+        size_t num_workers = context_.num_workers();
+        if (num_workers == 1) return;
 
-        ReceiveItems<InputTypeFirst>(capacity, reader1_, files1_, key_extractor1_);
+        const std::vector<size_t>& g = global_sizes_;
+        size_t side = g[0] <= g[1] ? 1 : 2;
+        size_t large_bytes = g[2 - side];
 
-        data::MixStream::MixReader reader2_ =
-            hash_stream2_->GetMixReader(/* consume */ true);
+        size_t filter_bytes =
+            core::BloomFilter::SizeBytes(g[side + 1], bloom_bits_per_item_);
+        size_t allreduce_bytes =
+            filter_bytes * tlx::integer_log2_ceil(num_workers);
 
-        capacity = DIABase::mem_limit_ / sizeof(InputTypeSecond) / 2;
+        if (allreduce_bytes > large_bytes / num_workers / 4 ||
+            filter_bytes > global_mem_limit_ / 4)
+            return;
 
-        ReceiveItems<InputTypeSecond>(capacity, reader2_, files2_, key_extractor2_);
+        bloom_filter_ = core::BloomFilter(g[side + 1], bloom_bits_per_item_);
+        if (side == 1)
+            InsertBloomFilter<InputTypeFirst>(pre_file1_, key_extractor1_);
+        else
+            InsertBloomFilter<InputTypeSecond>(pre_file2_, key_extractor2_);
+
+        bloom_filter_.set_words(
+            context_.net.AllReduce(
+                bloom_filter_.words(),
+                common::ComponentSum<std::vector<uint64_t>,
+                                     std::bit_or<uint64_t> >()));
+
+        bloom_side_ = 3 - side;
+        sLOG << "Join: filtering input" << bloom_side_
+             << "with a Bloom filter of" << filter_bytes << "bytes";
     }
 
-    template <typename ItemType>
-    size_t JoinCapacity() {
-        return DIABase::mem_limit_ / sizeof(ItemType) / 4;
+    //! insert the key hashes of all items of file into bloom_filter_
+    template <typename ItemType, typename KeyExtractor>
+    void InsertBloomFilter(data::File& file,
+                           const KeyExtractor& key_extractor) {
+        auto reader = file.GetKeepReader();
+        while (reader.HasNext()) {
+            ItemType item = reader.template Next<ItemType>();
+            bloom_filter_.Insert(hash_function_(key_extractor(item)));
+        }
     }
 
-    /*!
-     * Adds all elements from merge tree to a vector, afterwards sets the first_element
-     * pointer to the first element with a different key.
-     *
-     * \param vec target vector
-     *
-     * \param puller Input merge tree
-     *
-     * \param key_extractor Key extractor function
-     *
-     * \param file_ptr Pointer to a data::File
-     *
-     * \return Pair of bools, first bool indicates whether the merge tree is
-     * emptied, second bool indicates whether external memory was needed.
-     */
-    template <typename ItemType, typename KeyExtractor, typename MergeTree>
-    std::pair<bool, bool> AddEqualKeysToVec(
-        std::vector<ItemType>& vec, MergeTree& puller,
-        const KeyExtractor& key_extractor, data::FilePtr& file_ptr) {
+    //! \}
 
-        vec.push_back(puller.Top());
-        Key key = key_extractor(puller.Top());
+    //! \name Skew Handling
+    //! \{
 
-        size_t capacity = JoinCapacity<ItemType>();
+    //! a key is heavy if its items in one input exceed this fraction of the
+    //! average number of items per worker
+    static constexpr double heavy_load_fraction_ = 0.5;
 
-        if (!puller.Update())
-            return std::make_pair(true, false);
+    //! minimum number of items of an input seen before its keys are
+    //! considered heavy
+    static constexpr size_t heavy_min_items_ = 4096;
 
-        while (key_extractor(puller.Top()) == key) {
+    //! maximum number of heavy key candidates per worker, and of heavy keys
+    static constexpr size_t heavy_max_keys_ = 32;
 
-            if (!mem::memory_exceeded && vec.size() < capacity) {
-                vec.push_back(puller.Top());
-            }
-            else {
-                file_ptr = context_.GetFilePtr(this);
-                data::File::Writer writer = file_ptr->GetWriter();
-                for (const ItemType& item : vec) {
-                    writer.Put(item);
-                }
-                writer.Put(puller.Top());
-                //! vec is very large when this happens
-                //! swap with empty vector to free the memory
-                tlx::vector_free(vec);
+    //! sketches counting the key hashes of both inputs, only if there are
+    //! multiple workers.
+    std::unique_ptr<core::CountMinSketch> sketch1_, sketch2_;
 
-                return AddEqualKeysToFile(puller, key_extractor, writer, key);
-            }
+    //! hashes of keys which are heavy in the local items
+    std::vector<size_t> heavy_candidates_;
 
-            if (!puller.Update())
-                return std::make_pair(true, false);
-        }
+    //! hashes of the globally heavy keys, mapped to the input (1 or 2) whose
+    //! items are spread round-robin. Items of the other input are replicated.
+    std::unordered_map<size_t, size_t> heavy_keys_;
 
-        return std::make_pair(false, false);
+    //! worker to which the next spread item of a heavy key is sent
+    size_t heavy_next_worker_ = 0;
+
+    //! count the hash of an item and record it as candidate if its key is
+    //! heavy in the items seen so far.
+    void CountHeavy(core::CountMinSketch& sketch, size_t hash) {
+        uint32_t count = sketch.Add(hash);
+        if (sketch.total() < heavy_min_items_ ||
+            count <= heavy_load_fraction_ * static_cast<double>(sketch.total())
+            / static_cast<double>(context_.num_workers()))
+            return;
+        if (heavy_candidates_.size() >= heavy_max_keys_ ||
+            std::find(heavy_candidates_.begin(), heavy_candidates_.end(),
+                      hash) != heavy_candidates_.end())
+            return;
+        heavy_candidates_.push_back(hash);
     }
 
     /*!
-     * Adds all elements from merge tree to a data::File, potentially to external memory,
-     * afterwards sets the first_element pointer to the first element with a different key.
-     *
-     * \param puller Input merge tree
-     *
-     * \param key_extractor Key extractor function
-     *
-     * \param writer File writer
-     *
-     * \param key target key
-     *
-     * \return Pair of bools, first bool indicates whether the merge tree is
-     * emptied, second bool indicates whether external memory was needed (always true, when
-     * this method was called).
+     * Collect the heavy key candidates of all workers, sum their estimated
+     * counts in both inputs, and keep those which are heavy globally. A key
+     * with more than heavy_load_fraction_ * N / p items is a candidate on at
+     * least one worker, since the sketches never underestimate.
      */
-    template <typename KeyExtractor, typename MergeTree>
-    std::pair<bool, bool> AddEqualKeysToFile(
-        MergeTree& puller, const KeyExtractor& key_extractor,
-        data::File::Writer& writer, const Key& key) {
-        if (!puller.Update()) {
-            return std::make_pair(true, true);
+    void ChooseHeavyKeys() {
+        size_t num_workers = context_.num_workers();
+        if (num_workers == 1) return;
+
+        using VectorSizeT = std::vector<size_t>;
+
+        std::sort(heavy_candidates_.begin(), heavy_candidates_.end());
+        VectorSizeT candidates = context_.net.AllReduce(
+            heavy_candidates_,
+            [](const VectorSizeT& a, const VectorSizeT& b) {
+                VectorSizeT c;
+                std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                               std::back_inserter(c));
+                return c;
+            });
+        tlx::vector_free(heavy_candidates_);
+
+        VectorSizeT counts(2 * candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            counts[2 * i] = sketch1_->Estimate(candidates[i]);
+            counts[2 * i + 1] = sketch2_->Estimate(candidates[i]);
         }
+        sketch1_.reset();
+        sketch2_.reset();
+
+        if (candidates.empty()) return;
+
+        counts = context_.net.AllReduce(
+            counts, common::ComponentSum<VectorSizeT>());
 
-        while (key_extractor(puller.Top()) == key) {
-            writer.Put(puller.Top());
-            if (!puller.Update())
-                return std::make_pair(true, true);
+        const VectorSizeT& g = global_sizes_;
+        double threshold = heavy_load_fraction_
+                           * static_cast<double>(g[2] + g[3])
+                           / static_cast<double>(num_workers);
+
+        // pairs of the larger count and index of the heavy keys
+        std::vector<std::pair<size_t, size_t> > heavy;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            size_t count = std::max(counts[2 * i], counts[2 * i + 1]);
+            if (count > threshold) heavy.emplace_back(count, i);
         }
 
-        return std::make_pair(false, true);
-    }
+        size_t max_keys = heavy_max_keys_;
+        std::sort(heavy.begin(), heavy.end(),
+                  std::greater<std::pair<size_t, size_t> >());
+        if (heavy.size() > max_keys) heavy.resize(max_keys);
+
+        for (const std::pair<size_t, size_t>& h : heavy) {
+            size_t i = h.second;
+            heavy_keys_[candidates[i]] =
+                counts[2 * i] >= counts[2 * i + 1] ? 1 : 2;
+            sLOG << "Join: heavy key hash" << candidates[i]
+                 << "items" << counts[2 * i] << counts[2 * i + 1];
+        }
 
-    DIAMemUse PreOpMemUse() final {
-        return DIAMemUse::Max();
+        heavy_next_worker_ = context_.my_rank();
     }
 
-    void StartPreOp(size_t parent_index) final {
-        LOG << *this << " running StartPreOp parent_index=" << parent_index;
-        if (!location_detection_initialized_ && UseLocationDetection) {
-            location_detection_.Initialize(DIABase::mem_limit_ / 2);
-            location_detection_initialized_ = true;
+    //! send an item of input side to worker target, or, if its key is heavy,
+    //! to the next worker round-robin or to all workers.
+    template <typename ItemType>
+    void SendItem(data::MixStream::Writers& writers, size_t side,
+                  size_t hash, size_t target, const ItemType& item) {
+        if (!heavy_keys_.empty()) {
+            auto it = heavy_keys_.find(hash);
+            if (it != heavy_keys_.end()) {
+                if (it->second == side) {
+                    writers[heavy_next_worker_].Put(item);
+                    heavy_next_worker_ =
+                        (heavy_next_worker_ + 1) % writers.size();
+                }
+                else {
+                    for (size_t w = 0; w < writers.size(); ++w)
+                        writers[w].Put(item);
+                }
+                return;
+            }
         }
+        writers[target].Put(item);
+    }
 
-        auto ids = this->parent_ids();
+    //! \}
 
-        if (parent_index == 0) {
-            pre_writer1_ = pre_file1_.GetWriter();
+    //! \name Hash Join
+    //! \{
+
+    //! maximum number of grace hash partitioning levels, after which the build
+    //! side is joined block-wise, as it must contain many equal keys.
+    static constexpr size_t max_grace_levels_ = 3;
+
+    //! maximum number of partitions created per grace hash partitioning level
+    static constexpr size_t max_grace_fanout_ = 64;
+
+    //! output join result of an item of the first and the second input
+    class JoinFirstSecond
+    {
+    public:
+        explicit JoinFirstSecond(JoinNode* node) : node_(node) { }
+        void operator () (const InputTypeFirst& in1,
+                          const InputTypeSecond& in2) const {
+            node_->PushItem(node_->join_function_(in1, in2));
         }
-        if (parent_index == 1) {
-            pre_writer2_ = pre_file2_.GetWriter();
+
+    private:
+        JoinNode* node_;
+    };
+
+    //! output join result of an item of the second and the first input
+    class JoinSecondFirst
+    {
+    public:
+        explicit JoinSecondFirst(JoinNode* node) : node_(node) { }
+        void operator () (const InputTypeSecond& in2,
+                          const InputTypeFirst& in1) const {
+            node_->PushItem(node_->join_function_(in1, in2));
         }
+
+    private:
+        JoinNode* node_;
+    };
+
+    //! estimated RAM used by a hash table of num_items items of ItemType: a
+    //! node holds the key, the item, a next pointer, and the cached hash, plus
+    //! there is a bucket pointer per item.
+    template <typename ItemType>
+    static size_t HashTableBytes(size_t num_items) {
+        return num_items
+               * (sizeof(Key) + sizeof(ItemType) + 3 * sizeof(void*));
     }
 
-    void StopPreOp(size_t parent_index) final {
-        LOG << *this << " running StopPreOp parent_index=" << parent_index;
+    //! RAM available for the hash table of the build side
+    size_t HashTableLimit() const {
+        return std::max<size_t>(DIABase::mem_limit_ / 2, 1);
+    }
 
-        if (parent_index == 0) {
-            pre_writer1_.Close();
+    //! RAM needed by the hash table of the smaller input
+    size_t BuildBytes(const data::File& file1, const data::File& file2) const {
+        return std::min(HashTableBytes<InputTypeFirst>(file1.num_items()),
+                        HashTableBytes<InputTypeSecond>(file2.num_items()));
+    }
+
+    /*!
+     * Join the items of a partition. The input with the smaller hash table is
+     * the build side. If it does not fit into RAM, the partition is split
+     * again with a different hash, or, after max_grace_levels_, joined by
+     * sort-merge.
+     */
+    void JoinPartition(data::File& file1, data::File& file2, bool consume,
+                       size_t level) {
+
+        if (file1.num_items() == 0 || file2.num_items() == 0) {
+            if (consume) file1.Clear(), file2.Clear();
+            return;
         }
-        if (parent_index == 1) {
-            pre_writer2_.Close();
+
+        if (BuildBytes(file1, file2) > HashTableLimit() &&
+            level < max_grace_levels_) {
+            std::vector<Partition> partitions;
+            GracePartition(file1, file2, consume, level, partitions);
+            for (Partition& partition : partitions) {
+                JoinPartition(partition.first, partition.second,
+                              /* consume */ true, level + 1);
+            }
+            return;
         }
-    }
 
-    DIAMemUse ExecuteMemUse() final {
-        return DIAMemUse::Max();
+        if (HashTableBytes<InputTypeFirst>(file1.num_items()) <=
+            HashTableBytes<InputTypeSecond>(file2.num_items())) {
+            HashJoin<InputTypeFirst, InputTypeSecond>(
+                file1, key_extractor1_, file2, key_extractor2_, consume,
+                JoinFirstSecond(this));
+        }
+        else {
+            HashJoin<InputTypeSecond, InputTypeFirst>(
+                file2, key_extractor2_, file1, key_extractor1_, consume,
+                JoinSecondFirst(this));
+        }
     }
 
-    DIAMemUse PushDataMemUse() final {
-        return DIAMemUse::Max();
+    /*!
+     * Build a hash table from the items of build_file and probe it with each
+     * item of probe_file. If the build side does not fit into RAM, both sides
+     * are joined by sort-merge instead.
+     */
+    template <typename BuildType, typename ProbeType,
+              typename BuildKeyExtractor, typename ProbeKeyExtractor,
+              typename Join>
+    void HashJoin(
+        data::File& build_file, const BuildKeyExtractor& build_key_extractor,
+        data::File& probe_file, const ProbeKeyExtractor& probe_key_extractor,
+        bool consume, const Join& join) {
+
+        size_t capacity = std::max<size_t>(
+            1, HashTableLimit() / HashTableBytes<BuildType>(1));
+
+        if (build_file.num_items() > capacity) {
+            SortMergeJoin<BuildType, ProbeType>(
+                build_file, build_key_extractor,
+                probe_file, probe_key_extractor, consume, join);
+            return;
+        }
+
+        std::unordered_multimap<Key, BuildType, HashFunction> table(
+            build_file.num_items(), hash_function_);
+
+        auto build_reader = build_file.GetReader(consume);
+        while (build_reader.HasNext()) {
+            BuildType item = build_reader.template Next<BuildType>();
+            Key key = build_key_extractor(item);
+            table.emplace(std::move(key), std::move(item));
+        }
+
+        auto probe_reader = probe_file.GetReader(consume);
+        while (probe_reader.HasNext()) {
+            ProbeType item = probe_reader.template Next<ProbeType>();
+            auto range = table.equal_range(probe_key_extractor(item));
+            for (auto it = range.first; it != range.second; ++it)
+                join(it->second, item);
+        }
     }
 
     /*!
-     * Recieve all elements from a stream and write them to files sorted by key.
+     * Grace hash join: split both inputs into partitions by a hash salted with
+     * the level, such that the build side of each partition fits into RAM.
+     * The partitions are appended to out.
      */
-    template <typename ItemType, typename KeyExtractor>
-    void ReceiveItems(
-        size_t capacity, data::MixStream::MixReader& reader,
-        std::deque<data::File>& files, const KeyExtractor& key_extractor) {
+    void GracePartition(data::File& file1, data::File& file2, bool consume,
+                        size_t level, std::vector<Partition>& out) {
+
+        size_t max_fanout = max_grace_fanout_;
+        size_t fanout = static_cast<size_t>(
+            std::ceil(1.25 * static_cast<double>(BuildBytes(file1, file2))
+                      / static_cast<double>(HashTableLimit())));
+        fanout = std::max<size_t>(2, std::min(max_fanout, fanout));
+
+        sLOG << "Join: grace hash partitioning" << file1.num_items()
+             << "and" << file2.num_items() << "items into" << fanout
+             << "partitions on level" << level;
+
+        size_t first = out.size();
+        for (size_t i = 0; i < fanout; ++i)
+            out.emplace_back(context_.GetFile(this), context_.GetFile(this));
+
+        std::vector<data::File::Writer> writers1, writers2;
+        for (size_t i = first; i < out.size(); ++i) {
+            writers1.emplace_back(out[i].first.GetWriter());
+            writers2.emplace_back(out[i].second.GetWriter());
+        }
 
-        std::vector<ItemType> vec;
-        vec.reserve(capacity);
+        SplitFile<InputTypeFirst>(
+            file1, key_extractor1_, consume, level, writers1);
+        SplitFile<InputTypeSecond>(
+            file2, key_extractor2_, consume, level, writers2);
+    }
 
+    //! distribute the items of file to the writers by a hash salted with level
+    template <typename ItemType, typename KeyExtractor>
+    void SplitFile(data::File& file, const KeyExtractor& key_extractor,
+                   bool consume, size_t level,
+                   std::vector<data::File::Writer>& writers) {
+        auto reader = file.GetReader(consume);
         while (reader.HasNext()) {
-            if (vec.size() < capacity) {
-                vec.push_back(reader.template Next<ItemType>());
-            }
-            else {
-                SortAndWriteToFile(vec, files, key_extractor);
-            }
+            ItemType item = reader.template Next<ItemType>();
+            uint64_t hash = common::Hash128to64(
+                level + 1, hash_function_(key_extractor(item)));
+            writers[hash % writers.size()].Put(item);
         }
+        for (data::File::Writer& writer : writers)
+            writer.Close();
+    }
+
+    //! \}
 
-        if (vec.size())
-            SortAndWriteToFile(vec, files, key_extractor);
+    //! \name Sort-Merge Join
+    //! \{
+
+    //! compares items by the key extracted from them
+    template <typename ItemType, typename KeyExtractor>
+    class KeyLess
+    {
+    public:
+        explicit KeyLess(const KeyExtractor& key_extractor)
+            : key_extractor_(key_extractor) { }
+        bool operator () (const ItemType& a, const ItemType& b) const {
+            return key_extractor_(a) < key_extractor_(b);
+        }
+
+    private:
+        const KeyExtractor& key_extractor_;
+    };
+
+    //! maximum number of items of ItemType held in RAM by each side
+    template <typename ItemType>
+    size_t SortMergeCapacity() const {
+        return std::max<size_t>(
+            1, DIABase::mem_limit_ / sizeof(ItemType) / 4);
     }
 
     /*!
-     * Merge files when there are too many for the merge tree to handle
+     * Sort-merge join, used if the build side does not fit into RAM even
+     * after grace hash partitioning, as it contains many equal keys. Both
+     * inputs are sorted externally by key and merged, hence they are read
+     * only once, except for the items of keys too large for RAM on both sides,
+     * whose output is quadratic anyway. Requires operator < on Key.
      */
-    template <typename ItemType, typename CompareFunction>
-    void MergeFiles(std::deque<data::File>& files,
-                    CompareFunction compare_function) {
+    template <typename ItemType1, typename ItemType2,
+              typename KeyExtractorA, typename KeyExtractorB,
+              typename Join>
+    void SortMergeJoin(
+        data::File& file1, const KeyExtractorA& key_extractor1,
+        data::File& file2, const KeyExtractorB& key_extractor2,
+        bool consume, const Join& join) {
+
+        if (file1.num_items() == 0 || file2.num_items() == 0) {
+            if (consume) file1.Clear(), file2.Clear();
+            return;
+        }
 
+        LOG1 << "Thrill: Warning: Too many equal keys for main memory "
+             << "in Join, joining " << file1.num_items() << " and "
+             << file2.num_items() << " items by sort-merge.";
+
+        using Less1 = KeyLess<ItemType1, KeyExtractorA>;
+        using Less2 = KeyLess<ItemType2, KeyExtractorB>;
+
+        std::deque<data::File> runs1, runs2;
+        SortRuns<ItemType1>(file1, consume, Less1(key_extractor1), runs1);
+        SortRuns<ItemType2>(file2, consume, Less2(key_extractor2), runs2);
+        MergeRuns<ItemType1>(runs1, Less1(key_extractor1));
+        MergeRuns<ItemType2>(runs2, Less2(key_extractor2));
+
+        std::vector<data::File::ConsumeReader> seq1, seq2;
+        auto puller1 = MakePuller<ItemType1>(
+            runs1, seq1, Less1(key_extractor1));
+        auto puller2 = MakePuller<ItemType2>(
+            runs2, seq2, Less2(key_extractor2));
+
+        // items of the current key, or Files if they do not fit into RAM
+        std::vector<ItemType1> equal1;
+        std::vector<ItemType2> equal2;
+        data::File spill1 = context_.GetFile(this);
+        data::File spill2 = context_.GetFile(this);
+
+        bool done1 = !puller1.HasNext(), done2 = !puller2.HasNext();
+        while (!done1 && !done2) {
+            if (key_extractor1(puller1.Top()) < key_extractor2(puller2.Top())) {
+                done1 = !puller1.Update();
+            }
+            else if (key_extractor2(puller2.Top()) <
+                     key_extractor1(puller1.Top())) {
+                done2 = !puller2.Update();
+            }
+            else {
+                Key key = key_extractor1(puller1.Top());
+                done1 = CollectEqualKeys(
+                    puller1, key_extractor1, key, equal1, spill1);
+                done2 = CollectEqualKeys(
+                    puller2, key_extractor2, key, equal2, spill2);
+                JoinEqualKeys(equal1, spill1, equal2, spill2, join);
+            }
+        }
+    }
+
+    //! sort the items of file in runs which fit into RAM, appended to runs.
+    template <typename ItemType, typename Less>
+    void SortRuns(data::File& file, bool consume, const Less& less,
+                  std::deque<data::File>& runs) {
+        size_t capacity = SortMergeCapacity<ItemType>();
+        std::vector<ItemType> vec;
+        vec.reserve(std::min(capacity, file.num_items()));
+
+        auto reader = file.GetReader(consume);
+        while (reader.HasNext()) {
+            vec.push_back(reader.template Next<ItemType>());
+            if (vec.size() < capacity && reader.HasNext()) continue;
+
+            std::sort(vec.begin(), vec.end(), less);
+            runs.emplace_back(context_.GetFile(this));
+            data::File::Writer writer = runs.back().GetWriter();
+            for (const ItemType& item : vec)
+                writer.Put(item);
+            writer.Close();
+            vec.clear();
+        }
+    }
+
+    //! merge runs until there are few enough for one merge tree
+    template <typename ItemType, typename Less>
+    void MergeRuns(std::deque<data::File>& runs, const Less& less) {
         size_t merge_degree, prefetch;
 
-        // merge batches of files if necessary
         while (std::tie(merge_degree, prefetch) =
-                   context_.block_pool().MaxMergeDegreePrefetch(files.size()),
-               files.size() > merge_degree)
+                   context_.block_pool().MaxMergeDegreePrefetch(runs.size()),
+               runs.size() > merge_degree)
         {
-            sLOG1 << "Partial multi-way-merge of"
-                  << merge_degree << "files with prefetch" << prefetch;
+            sLOG1 << "Join: partial multi-way-merge of"
+                  << merge_degree << "runs with prefetch" << prefetch;
 
-            // create merger for first merge_degree_ Files
             std::vector<data::File::ConsumeReader> seq;
             seq.reserve(merge_degree);
-
             for (size_t t = 0; t < merge_degree; ++t)
-                seq.emplace_back(files[t].GetConsumeReader(/* prefetch */ 0));
-
+                seq.emplace_back(runs[t].GetConsumeReader(/* prefetch */ 0));
             StartPrefetch(seq, prefetch);
 
             auto puller = core::make_multiway_merge_tree<ItemType>(
-                seq.begin(), seq.end(), compare_function);
-
-            // create new File for merged items
-            files.emplace_back(context_.GetFile(this));
-            auto writer = files.back().GetWriter();
+                seq.begin(), seq.end(), less);
 
-            while (puller.HasNext()) {
+            runs.emplace_back(context_.GetFile(this));
+            data::File::Writer writer = runs.back().GetWriter();
+            while (puller.HasNext())
                 writer.Put(puller.Next());
-            }
             writer.Close();
 
             // this clear is important to release references to the files.
             seq.clear();
-
-            // remove merged files
-            files.erase(files.begin(), files.begin() + merge_degree);
+            runs.erase(runs.begin(), runs.begin() + merge_degree);
         }
     }
 
-    data::FilePtr join_file1_;
-    data::FilePtr join_file2_;
+    //! construct a merge tree over the runs, which must not be empty.
+    template <typename ItemType, typename Less>
+    auto MakePuller(std::deque<data::File>& runs,
+                    std::vector<data::File::ConsumeReader>& seq,
+                    const Less& less) {
+        size_t merge_degree, prefetch;
+        std::tie(merge_degree, prefetch) =
+            context_.block_pool().MaxMergeDegreePrefetch(runs.size());
+
+        seq.reserve(runs.size());
+        for (data::File& run : runs)
+            seq.emplace_back(run.GetConsumeReader(/* prefetch */ 0));
+        StartPrefetch(seq, prefetch);
+
+        return core::make_buffered_multiway_merge_tree<ItemType>(
+            seq.begin(), seq.end(), less);
+    }
 
     /*!
-     * Joins all elements in cartesian product of both vectors. Uses files when
-     * one of the data sets is too large to fit in memory. (indicated by
-     * 'external' bools)
+     * Take all items with the given key from the top of puller. They are kept
+     * in vec, or, if there are too many for RAM, all are moved to spill.
+     * Returns true if the puller is exhausted.
      */
-    void JoinAllElements(
-        const std::vector<InputTypeFirst>& vec1, bool external1,
-        const std::vector<InputTypeSecond>& vec2, bool external2) {
-
-        if (!external1 && !external2) {
-            for (const InputTypeFirst& join1 : vec1) {
-                for (const InputTypeSecond& join2 : vec2) {
-                    assert(key_extractor1_(join1) == key_extractor2_(join2));
-                    this->PushItem(join_function_(join1, join2));
-                }
+    template <typename ItemType, typename KeyExtractor, typename MergeTree>
+    bool CollectEqualKeys(
+        MergeTree& puller, const KeyExtractor& key_extractor, const Key& key,
+        std::vector<ItemType>& vec, data::File& spill) {
+
+        size_t capacity = SortMergeCapacity<ItemType>();
+        vec.clear();
+        data::File::Writer writer;
+
+        do {
+            if (!writer.IsValid() &&
+                (vec.size() >= capacity || mem::memory_exceeded)) {
+                writer = spill.GetWriter();
+                for (const ItemType& item : vec)
+                    writer.Put(item);
+                // vec is very large, free its memory
+                tlx::vector_free(vec);
             }
-        }
-        else if (external1 && !external2) {
-            LOG1 << "Thrill: Warning: Too many equal keys for main memory "
-                 << "in first DIA";
 
-            data::File::ConsumeReader reader = join_file1_->GetConsumeReader();
+            if (writer.IsValid())
+                writer.Put(puller.Top());
+            else
+                vec.push_back(puller.Top());
+
+            if (!puller.Update()) return true;
+        } while (key_extractor(puller.Top()) == key);
 
+        return false;
+    }
+
+    /*!
+     * Join all pairs of the items of one key, each side is either in its
+     * vector or, if it did not fit into RAM, in its spill File. If both are
+     * spilled, the first side is loaded in chunks and the second is reread
+     * per chunk.
+     */
+    template <typename ItemType1, typename ItemType2, typename Join>
+    void JoinEqualKeys(
+        std::vector<ItemType1>& vec1, data::File& spill1,
+        std::vector<ItemType2>& vec2, data::File& spill2, const Join& join) {
+
+        if (spill1.num_items() == 0 && spill2.num_items() == 0) {
+            for (const ItemType1& item1 : vec1) {
+                for (const ItemType2& item2 : vec2)
+                    join(item1, item2);
+            }
+        }
+        else if (spill2.num_items() == 0) {
+            auto reader = spill1.GetConsumeReader();
             while (reader.HasNext()) {
-                InputTypeFirst join1 = reader.template Next<InputTypeFirst>();
-                for (auto const& join2 : vec2) {
-                    assert(key_extractor1_(join1) == key_extractor2_(join2));
-                    this->PushItem(join_function_(join1, join2));
-                }
+                ItemType1 item1 = reader.template Next<ItemType1>();
+                for (const ItemType2& item2 : vec2)
+                    join(item1, item2);
+            }
+        }
+        else if (spill1.num_items() == 0) {
+            auto reader = spill2.GetConsumeReader();
+            while (reader.HasNext()) {
+                ItemType2 item2 = reader.template Next<ItemType2>();
+                for (const ItemType1& item1 : vec1)
+                    join(item1, item2);
             }
         }
-        else if (!external1 && external2) {
+        else {
             LOG1 << "Thrill: Warning: Too many equal keys for main memory "
-                 << "in second DIA";
+                 << "in both inputs of Join. This is very slow.";
 
-            data::File::ConsumeReader reader = join_file2_->GetConsumeReader();
+            size_t capacity = SortMergeCapacity<ItemType1>();
+            auto reader1 = spill1.GetConsumeReader();
+            while (reader1.HasNext()) {
+                vec1.clear();
+                while (vec1.size() < capacity && reader1.HasNext())
+                    vec1.push_back(reader1.template Next<ItemType1>());
 
-            while (reader.HasNext()) {
-                InputTypeSecond join2 = reader.template Next<InputTypeSecond>();
-                for (const InputTypeFirst& join1 : vec1) {
-                    assert(key_extractor1_(join1) == key_extractor2_(join2));
-                    this->PushItem(join_function_(join1, join2));
+                auto reader2 = spill2.GetKeepReader();
+                while (reader2.HasNext()) {
+                    ItemType2 item2 = reader2.template Next<ItemType2>();
+                    for (const ItemType1& item1 : vec1)
+                        join(item1, item2);
                 }
             }
         }
-        else if (external1 && external2) {
-            LOG1 << "Thrill: Warning: Too many equal keys for main memory "
-                 << "in both DIAs. This is very slow.";
+        spill1.Clear();
+        spill2.Clear();
+    }
 
-            size_t capacity = JoinCapacity<InputTypeFirst>();
+    //! \}
 
-            std::vector<InputTypeFirst> temp_vec;
-            temp_vec.reserve(capacity);
+    void PreOp1(const InputTypeFirst& input) {
+        // buffer items until the join strategy is chosen
+        pre_writer1_.Put(input);
+        if (UseLocationDetection || sketch1_) {
+            size_t hash = hash_function_(key_extractor1_(input));
+            if (UseLocationDetection) {
+                location_detection_.Insert(
+                    HashCount { hash, 1, /* dia_mask */ 1 });
+            }
+            if (sketch1_)
+                CountHeavy(*sketch1_, hash);
+        }
+    }
 
-            //! file 2 needs to be read multiple times
-            data::File::ConsumeReader reader1 = join_file1_->GetConsumeReader();
+    void PreOp2(const InputTypeSecond& input) {
+        pre_writer2_.Put(input);
+        if (UseLocationDetection || sketch2_) {
+            size_t hash = hash_function_(key_extractor2_(input));
+            if (UseLocationDetection) {
+                location_detection_.Insert(
+                    HashCount { hash, 1, /* dia_mask */ 2 });
+            }
+            if (sketch2_)
+                CountHeavy(*sketch2_, hash);
+        }
+    }
 
-            while (reader1.HasNext()) {
+    //! Receive elements from other workers, and partition them if the build
+    //! side does not fit into RAM.
+    void MainOp() {
+        data::File file1 = context_.GetFile(this);
+        data::File file2 = context_.GetFile(this);
 
-                for (size_t i = 0; i < capacity && reader1.HasNext() &&
-                     !mem::memory_exceeded; ++i) {
-                    temp_vec.push_back(reader1.template Next<InputTypeFirst>());
-                }
+        ReceiveItems<InputTypeFirst>(hash_stream1_, file1);
+        ReceiveItems<InputTypeSecond>(hash_stream2_, file2);
 
-                data::File::Reader reader2 = join_file2_->GetReader(/* consume */ false);
+        if (BuildBytes(file1, file2) <= HashTableLimit()) {
+            partitions_.emplace_back(std::move(file1), std::move(file2));
+        }
+        else {
+            GracePartition(file1, file2, /* consume */ true, /* level */ 0,
+                           partitions_);
+        }
+    }
 
-                while (reader2.HasNext()) {
-                    InputTypeSecond join2 = reader2.template Next<InputTypeSecond>();
-                    for (const InputTypeFirst& join1 : temp_vec) {
-                        assert(key_extractor1_(join1) == key_extractor2_(join2));
-                        this->PushItem(join_function_(join1, join2));
-                    }
-                }
-                temp_vec.clear();
-            }
+    DIAMemUse PreOpMemUse() final {
+        return DIAMemUse::Max();
+    }
 
-            //! non-consuming reader, need to clear now
-            join_file2_->Clear();
+    void StartPreOp(size_t parent_index) final {
+        LOG << *this << " running StartPreOp parent_index=" << parent_index;
+        if (!location_detection_initialized_ && UseLocationDetection) {
+            location_detection_.Initialize(DIABase::mem_limit_ / 2);
+            location_detection_initialized_ = true;
         }
-    }
 
-    /*!
-     * Sorts all elements in a vector and writes them to a file.
-     */
-    template <typename ItemType, typename KeyExtractor>
-    void SortAndWriteToFile(
-        std::vector<ItemType>& vec, std::deque<data::File>& files,
-        const KeyExtractor& key_extractor) {
+        auto ids = this->parent_ids();
 
-        // advise block pool to write out data if necessary
-        context_.block_pool().AdviseFree(vec.size() * sizeof(ValueType));
+        if (parent_index == 0) {
+            pre_writer1_ = pre_file1_.GetWriter();
+        }
+        if (parent_index == 1) {
+            pre_writer2_ = pre_file2_.GetWriter();
+        }
+    }
 
-        std::sort(vec.begin(), vec.end(),
-                  [&key_extractor](const ItemType& i1, const ItemType& i2) {
-                      return key_extractor(i1) < key_extractor(i2);
-                  });
+    void StopPreOp(size_t parent_index) final {
+        LOG << *this << " running StopPreOp parent_index=" << parent_index;
 
-        files.emplace_back(context_.GetFile(this));
-        auto writer = files.back().GetWriter();
-        for (const ItemType& elem : vec) {
-            writer.Put(elem);
+        if (parent_index == 0) {
+            pre_writer1_.Close();
         }
-        writer.Close();
+        if (parent_index == 1) {
+            pre_writer2_.Close();
+        }
+    }
 
-        vec.clear();
+    DIAMemUse ExecuteMemUse() final {
+        return DIAMemUse::Max();
+    }
+
+    DIAMemUse PushDataMemUse() final {
+        return DIAMemUse::Max();
+    }
+
+    //! Receive all items from a stream into a File.
+    template <typename ItemType>
+    void ReceiveItems(data::MixStreamPtr& stream, data::File& file) {
+        data::MixStream::MixReader reader =
+            stream->GetMixReader(/* consume */ true);
+        data::File::Writer writer = file.GetWriter();
+        while (reader.HasNext())
+            writer.Put(reader.template Next<ItemType>());
+        writer.Close();
+        stream.reset();
     }
 };
 
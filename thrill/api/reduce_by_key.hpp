@@ -26,6 +26,7 @@
 #include <tlx/meta/is_std_pair.hpp>
 
 #include <functional>
+#include <memory>
 #include <thread>
 #include <type_traits>
 #include <typeinfo>
@@ -54,6 +55,16 @@ class DefaultReduceConfig : public core::DefaultReduceConfig
  * \tparam VolatileKey Whether to reuse the key once extracted in during pre reduce
  * (false) or let the post reduce extract the key again (true).
  *
+ * If ReduceConfig::use_hierarchical_ is set and there are multiple hosts with
+ * multiple workers each, the pre reduce has two levels: items are first
+ * partitioned among the workers of the host and reduced there, and only then
+ * partitioned among all workers and sent over the network. Since the host-level
+ * partition of a key is its global partition modulo workers_per_host, local
+ * worker j only sends to workers j of the other hosts, and each key leaves a
+ * host at most once. An additional thread reads the host-level stream during
+ * the pre op and inserts the items into the second level, which sends them on
+ * while the workers are still reducing.
+ *
  * \ingroup api_layer
  */
 template <typename ValueType,
@@ -80,6 +91,18 @@ private:
     static constexpr bool use_mix_stream_ = ReduceConfig::use_mix_stream_;
     static constexpr bool use_post_thread_ = ReduceConfig::use_post_thread_;
 
+    using PrePhase = core::ReducePrePhase<
+        TableItem, Key, ValueType, KeyExtractor,
+        ReduceFunction, VolatileKey, data::Stream::Writer, ReduceConfig,
+        HashIndexFunction, KeyEqualFunction, KeyHashFunction,
+        UseDuplicateDetection>;
+
+    //! pre phase reducing among the workers of the host
+    using HostPrePhase = core::ReducePrePhase<
+        TableItem, Key, ValueType, KeyExtractor,
+        ReduceFunction, VolatileKey, data::Stream::Writer, ReduceConfig,
+        HashIndexFunction, KeyEqualFunction, KeyHashFunction>;
+
     //! Emitter for PostPhase to push elements to next DIA object.
     class Emitter
     {
@@ -120,12 +143,36 @@ public:
           post_phase_(
               context_, Super::dia_id(), key_extractor, reduce_function,
               Emitter(this), config,
-              HashIndexFunction(key_hash_function), key_equal_function) {
+              HashIndexFunction(key_hash_function), key_equal_function),
+          hierarchical_(
+              ReduceConfig::use_hierarchical_ && !UseDuplicateDetection &&
+              parent.ctx().num_hosts() > 1 &&
+              parent.ctx().workers_per_host() > 1) {
+
+        if (hierarchical_) {
+            // keep only the writers to the workers of this host, the others
+            // are closed when writers goes out of scope.
+            host_stream_ = parent.ctx().GetNewCatStream(this);
+            data::Stream::Writers writers = host_stream_->GetWriters();
+            size_t first = context_.host_rank() * context_.workers_per_host();
+            for (size_t i = 0; i < context_.workers_per_host(); ++i)
+                host_emitters_.emplace_back(std::move(writers[first + i]));
+
+            host_pre_phase_ = std::make_unique<HostPrePhase>(
+                context_, Super::dia_id(), context_.workers_per_host(),
+                key_extractor, reduce_function, host_emitters_, config,
+                HashIndexFunction(key_hash_function), key_equal_function,
+                key_hash_function, /* duplicates */ false, first);
+        }
+
         // Hook PreOp: Locally hash elements of the current DIA onto buckets and
         // reduce each bucket to a single value, afterwards send data to another
         // worker given by the shuffle algorithm.
         auto pre_op_fn = [this](const ValueType& input) {
-                             return pre_phase_.Insert(input);
+                             if (hierarchical_)
+                                 host_pre_phase_->Insert(input);
+                             else
+                                 pre_phase_.Insert(input);
                          };
         // close the function stack with our pre op and register it at
         // parent node for output
@@ -143,10 +190,10 @@ public:
         LOG << *this << " running StartPreOp";
         if (!use_post_thread_) {
             // use pre_phase without extra thread
-            pre_phase_.Initialize(DIABase::mem_limit_);
+            InitializePrePhase(DIABase::mem_limit_);
         }
         else {
-            pre_phase_.Initialize(DIABase::mem_limit_ / 2);
+            InitializePrePhase(DIABase::mem_limit_ / 2);
             post_phase_.Initialize(DIABase::mem_limit_ / 2);
 
             // start additional thread to receive from the channel
@@ -156,6 +203,17 @@ public:
 
     void StopPreOp(size_t /* parent_index */) final {
         LOG << *this << " running StopPreOp";
+        if (hierarchical_) {
+            // flush the host-level table to the local workers, and wait for
+            // the thread reducing the items received from them in the pre
+            // phase to all workers.
+            host_pre_phase_->FlushAll();
+            host_pre_phase_->CloseAll();
+            host_pre_phase_.reset();
+
+            host_thread_.join();
+            host_stream_.reset();
+        }
         // Flush hash table before the postOp
         pre_phase_.FlushAll();
         pre_phase_.CloseAll();
@@ -214,6 +272,30 @@ public:
         post_phase_.Dispose();
     }
 
+    //! process the items from the workers of this host in the pre phase to
+    //! all workers, runs in host_thread_ during the pre op.
+    void ProcessHostStream() {
+        auto reader = host_stream_->GetCatReader(/* consume */ true);
+        while (reader.HasNext())
+            pre_phase_.InsertItem(reader.template Next<TableItem>());
+    }
+
+    //! initialize the pre phase with the given memory
+    void InitializePrePhase(size_t limit_memory_bytes) {
+        if (hierarchical_) {
+            // both levels run concurrently and share the memory.
+            host_pre_phase_->Initialize(limit_memory_bytes / 2);
+            pre_phase_.Initialize(limit_memory_bytes / 2);
+
+            // start additional thread to receive from the host stream
+            host_thread_ = common::CreateThread(
+                [this] { ProcessHostStream(); });
+        }
+        else {
+            pre_phase_.Initialize(limit_memory_bytes);
+        }
+    }
+
 private:
     // pointers for both Mix and CatStream. only one is used, the other costs
     // only a null pointer.
@@ -224,11 +306,7 @@ private:
     //! handle to additional thread for post phase
     std::thread thread_;
 
-    core::ReducePrePhase<
-        TableItem, Key, ValueType, KeyExtractor,
-        ReduceFunction, VolatileKey, data::Stream::Writer, ReduceConfig,
-        HashIndexFunction, KeyEqualFunction, KeyHashFunction,
-        UseDuplicateDetection> pre_phase_;
+    PrePhase pre_phase_;
 
     core::ReduceByHashPostPhase<
         TableItem, Key, ValueType, KeyExtractor, ReduceFunction, Emitter,
@@ -236,6 +314,26 @@ private:
         HashIndexFunction, KeyEqualFunction> post_phase_;
 
     bool reduced_ = false;
+
+    //! \name Hierarchical Pre Phase
+    //! \{
+
+    //! whether items are reduced among the workers of the host first
+    bool hierarchical_;
+
+    //! stream to the workers of this host
+    data::CatStreamPtr host_stream_;
+
+    //! writers of host_stream_ to the workers of this host
+    std::vector<data::Stream::Writer> host_emitters_;
+
+    //! pre phase partitioning among the workers of this host
+    std::unique_ptr<HostPrePhase> host_pre_phase_;
+
+    //! thread inserting the items of host_stream_ into pre_phase_
+    std::thread host_thread_;
+
+    //! \}
 };
 
 template <typename ValueType, typename Stack>
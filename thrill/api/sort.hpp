@@ -17,10 +17,13 @@
 #include <thrill/api/context.hpp>
 #include <thrill/api/dia.hpp>
 #include <thrill/api/dop_node.hpp>
+#include <thrill/common/functional.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/common/math.hpp>
+#include <thrill/common/parallel_sort.hpp>
 #include <thrill/common/porting.hpp>
 #include <thrill/common/qsort.hpp>
+#include <thrill/common/radix_sort.hpp>
 #include <thrill/common/reservoir_sampling.hpp>
 #include <thrill/core/multiway_merge.hpp>
 #include <thrill/data/file.hpp>
@@ -30,11 +33,14 @@
 #include <tlx/vector_free.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <numeric>
 #include <random>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -42,6 +48,46 @@
 namespace thrill {
 namespace api {
 
+/*!
+ * Configuration class to define operational parameters of SortNode. The
+ * defaults switch to the scalable exchange algorithms only on large clusters,
+ * tests lower them to run these with few workers.
+ */
+class DefaultSortConfig
+{
+public:
+    //! maximum number of workers exchanging items directly in a single
+    //! level. Non-stable sorts with more workers use MultiLevelExchange().
+    //! Stable sorts always exchange in a single level, as the multi-level
+    //! exchange does not keep equal items in their global order.
+    size_t max_single_level_workers_ = 1024;
+
+    //! maximum number of workers for which worker 0 gathers all samples to
+    //! select splitters. Above, SelectSplittersDistributed() is used.
+    size_t max_root_splitter_workers_ = 64;
+
+    //! \name Accessors
+    //! \{
+
+    //! Returns max_single_level_workers_, at least two.
+    size_t max_single_level_workers() const
+    { return std::max<size_t>(2, max_single_level_workers_); }
+
+    //! Returns max_root_splitter_workers_
+    size_t max_root_splitter_workers() const
+    { return max_root_splitter_workers_; }
+
+    //! \}
+};
+
+/*!
+ * Number of items of memory a SortAlgorithm uses per item of the sorted run,
+ * which is used to size the runs of SortNode. Sort algorithms with an extra
+ * merge buffer, like ParallelSortAlgorithm, specialize this to 2.
+ */
+template <typename SortAlgorithm>
+struct SortAlgorithmMemoryFactor : public std::integral_constant<size_t, 1> { };
+
 /*!
  * A DIANode which performs a Sort operation. Sort sorts a DIA according to a
  * given compare function
@@ -115,17 +161,24 @@ class SortNode final : public DOpNode<ValueType>
 
     static const bool use_background_thread_ = false;
 
+    //! sort and write runs in a background thread while the next run is
+    //! received into a second buffer.
+    static const bool use_background_sort_ = true;
+
 public:
     /*!
      * Constructor for a sort node.
      */
-    template <typename ParentDIA>
+    template <typename ParentDIA, typename SortConfig = DefaultSortConfig>
     SortNode(const ParentDIA& parent,
              const CompareFunction& compare_function,
-             const SortAlgorithm& sort_algorithm = SortAlgorithm())
+             const SortAlgorithm& sort_algorithm = SortAlgorithm(),
+             const SortConfig& sort_config = SortConfig())
         : Super(parent.ctx(), "Sort", { parent.id() }, { parent.node() }),
           compare_function_(compare_function),
           sort_algorithm_(sort_algorithm),
+          max_single_level_workers_(sort_config.max_single_level_workers()),
+          max_root_splitter_workers_(sort_config.max_root_splitter_workers()),
           parent_stack_empty_(ParentDIA::stack_empty) {
         // Hook PreOp(s)
         auto pre_op_fn = [this](const ValueType& input) {
@@ -281,6 +334,14 @@ private:
     //! Sort function class
     SortAlgorithm sort_algorithm_;
 
+    //! maximum number of workers exchanging items in a single level, see
+    //! DefaultSortConfig.
+    const size_t max_single_level_workers_;
+
+    //! maximum number of workers for which worker 0 selects all splitters,
+    //! see DefaultSortConfig.
+    const size_t max_root_splitter_workers_;
+
     //! Whether the parent stack is empty
     const bool parent_stack_empty_;
 
@@ -377,6 +438,133 @@ private:
             sample_writers[j].Close();
     }
 
+    //! Pivot for distributed splitter selection: a sample and the width of the
+    //! search range it was drawn from.
+    using SplitterPivot = std::pair<SampleIndexPair, size_t>;
+
+    //! Reduce functor selecting the pivot from the widest search range, ties
+    //! are broken by the sample index to make the operation commutative.
+    class ReduceSplitterPivots
+    {
+    public:
+        SplitterPivot operator () (
+            const SplitterPivot& a, const SplitterPivot& b) const {
+            if (a.second != b.second)
+                return a.second > b.second ? a : b;
+            return a.first.second < b.first.second ? a : b;
+        }
+    };
+
+    /*!
+     * Select p-1 splitters from the samples of all workers without gathering
+     * them on one worker: each worker sorts its local samples, then all
+     * splitters are searched for simultaneously by a distributed multi-select
+     * using collectives. In each round a random pivot is taken from the widest
+     * local search range of each splitter, its global rank is determined with
+     * an AllReduce, and all local search ranges are narrowed. The splitters are
+     * the samples of global ranks i * |S| / p, as in FindAndSendSplitters().
+     */
+    void SelectSplittersDistributed(
+        std::vector<SampleIndexPair>& splitters, size_t prefix_items) {
+
+        size_t num_total_workers = context_.num_workers();
+        size_t num_splitters = num_total_workers - 1;
+
+        auto less_sample = [this](
+            const SampleIndexPair& a, const SampleIndexPair& b) {
+                               return LessSampleIndex(a, b);
+                           };
+
+        // add the local prefix to index ranks and sort local samples
+        for (SampleIndexPair& sample : samples_)
+            sample.second += prefix_items;
+        std::sort(samples_.begin(), samples_.end(), less_sample);
+
+        size_t total_samples = context_.net.AllReduce(samples_.size());
+        if (total_samples == 0) return;
+
+        std::vector<size_t> target_ranks(num_splitters);
+        for (size_t i = 0; i < num_splitters; ++i)
+            target_ranks[i] = (i + 1) * total_samples / num_total_workers;
+
+        // local search ranges [left,right) of each splitter
+        std::vector<size_t> left(num_splitters, 0);
+        std::vector<size_t> right(num_splitters, samples_.size());
+
+        std::vector<SampleIndexPair> result(num_splitters);
+        std::vector<bool> found(num_splitters, false);
+        size_t num_found = 0, iterations = 0;
+
+        std::vector<SplitterPivot> pivots(num_splitters);
+        std::vector<size_t> local_ranks(2 * num_splitters);
+
+        while (num_found < num_splitters)
+        {
+            // propose a random pivot from each local search range
+            for (size_t i = 0; i < num_splitters; ++i) {
+                size_t width = found[i] ? 0 : right[i] - left[i];
+                if (width == 0) {
+                    pivots[i] = SplitterPivot(
+                        SampleIndexPair(ValueType(), 0), 0);
+                }
+                else {
+                    pivots[i] = SplitterPivot(
+                        samples_[left[i] + context_.rng_() % width], width);
+                }
+            }
+
+            pivots = context_.net.AllReduce(
+                pivots, common::ComponentSum<std::vector<SplitterPivot>,
+                                             ReduceSplitterPivots>());
+
+            // count local samples less and less-or-equal than the pivots
+            for (size_t i = 0; i < num_splitters; ++i) {
+                if (found[i]) {
+                    local_ranks[2 * i] = local_ranks[2 * i + 1] = 0;
+                    continue;
+                }
+                assert(pivots[i].second != 0);
+                const SampleIndexPair& pivot = pivots[i].first;
+                local_ranks[2 * i] =
+                    std::lower_bound(samples_.begin() + left[i],
+                                     samples_.begin() + right[i],
+                                     pivot, less_sample) - samples_.begin();
+                local_ranks[2 * i + 1] =
+                    std::upper_bound(samples_.begin() + local_ranks[2 * i],
+                                     samples_.begin() + right[i],
+                                     pivot, less_sample) - samples_.begin();
+            }
+
+            std::vector<size_t> global_ranks = context_.net.AllReduce(
+                local_ranks, common::ComponentSum<std::vector<size_t> >());
+
+            // narrow search ranges to the side containing the target rank
+            for (size_t i = 0; i < num_splitters; ++i) {
+                if (found[i]) continue;
+
+                if (target_ranks[i] < global_ranks[2 * i]) {
+                    right[i] = local_ranks[2 * i];
+                }
+                else if (target_ranks[i] >= global_ranks[2 * i + 1]) {
+                    left[i] = local_ranks[2 * i + 1];
+                }
+                else {
+                    result[i] = pivots[i].first;
+                    found[i] = true;
+                    ++num_found;
+                }
+            }
+
+            ++iterations;
+        }
+
+        LOG << "SelectSplittersDistributed() found " << num_splitters
+            << " splitters in " << iterations << " iterations";
+
+        tlx::vector_free(samples_);
+        splitters = std::move(result);
+    }
+
     class TreeBuilder
     {
     public:
@@ -425,10 +613,31 @@ private:
         return !compare_function_(a.first, b.first) && a.second >= b.second;
     }
 
-    //! round n down by k where k is a power of two.
-    template <typename Integral>
-    static inline size_t RoundDown(Integral n, Integral k) {
-        return (n & ~(k - 1));
+    //! number of items classified together in TransmitItems()
+    static constexpr size_t kClassifyBlockSize = 256;
+
+    /*!
+     * Determine the buckets of a block of items in the splitter tree with k
+     * leaves. The tree is descended level by level for all items, and the
+     * child index is computed arithmetically from the comparison result,
+     * hence the loop contains no data-dependent branches.
+     */
+    void ClassifyBlock(const ValueType* const tree, size_t k, size_t log_k,
+                       const ValueType* block, size_t block_size,
+                       size_t* oracle) {
+
+        for (size_t t = 0; t < block_size; ++t)
+            oracle[t] = 1;
+
+        for (size_t l = 0; l < log_k; ++l) {
+            for (size_t t = 0; t < block_size; ++t) {
+                oracle[t] = 2 * oracle[t] + static_cast<size_t>(
+                    !compare_function_(block[t], tree[oracle[t]]));
+            }
+        }
+
+        for (size_t t = 0; t < block_size; ++t)
+            oracle[t] -= k;
     }
 
     void TransmitItems(
@@ -441,13 +650,12 @@ private:
         size_t actual_k,
         const SampleIndexPair* const sorted_splitters,
         size_t prefix_items,
-        TranmissionStreamPtr& data_stream) {
+        // Writers to the actual_k buckets
+        std::vector<typename TranmissionStreamType::Writer>& data_writers) {
 
         data::File::ConsumeReader unsorted_reader =
             unsorted_file_.GetConsumeReader();
 
-        auto data_writers = data_stream->GetWriters();
-
         // enlarge emitters array to next power of two to have direct access,
         // because we fill the splitter set up with sentinels == last splitter,
         // hence all items land in the last bucket.
@@ -460,75 +668,43 @@ private:
 
         std::swap(data_writers[actual_k - 1], data_writers[k - 1]);
 
-        // classify all items (take two at once) and immediately transmit them.
+        // classify items in blocks in the style of super scalar sample sort:
+        // first read a block of items, then run all of them down the splitter
+        // tree one level at a time, which has no data-dependent branches and
+        // allows the CPU to overlap the comparisons of independent items. The
+        // resulting bucket oracle is then used to distribute the block.
 
-        const size_t stepsize = 2;
+        std::vector<ValueType> block(kClassifyBlockSize);
+        size_t oracle[kClassifyBlockSize];
 
         size_t i = prefix_items;
-        for ( ; i < prefix_items + RoundDown(local_items_, stepsize); i += stepsize)
+        while (i < prefix_items + local_items_)
         {
-            // take two items
-            size_t j0 = 1;
-            ValueType el0 = unsorted_reader.Next<ValueType>();
-
-            size_t j1 = 1;
-            ValueType el1 = unsorted_reader.Next<ValueType>();
-
-            // run items down the tree
-            for (size_t l = 0; l < log_k; l++)
-            {
-                j0 = 2 * j0 + (compare_function_(el0, tree[j0]) ? 0 : 1);
-                j1 = 2 * j1 + (compare_function_(el1, tree[j1]) ? 0 : 1);
-            }
-
-            size_t b0 = j0 - k;
-            size_t b1 = j1 - k;
-
-            while (b0 && EqualSampleGreaterIndex(
-                       sorted_splitters[b0 - 1], SampleIndexPair(el0, i + 0))) {
-                b0--;
+            size_t block_size = prefix_items + local_items_ - i;
+            if (block_size > kClassifyBlockSize)
+                block_size = kClassifyBlockSize;
 
-                // LOG0 << "el0 equal match b0 " << b0
-                //      << " prefix_items " << prefix_items
-                //      << " lhs.first = " << sorted_splitters[b0 - 1].first
-                //      << " lhs.second = " << sorted_splitters[b0 - 1].second
-                //      << " rhs.first = " << el0
-                //      << " rhs.second = " << i;
-            }
-
-            while (b1 && EqualSampleGreaterIndex(
-                       sorted_splitters[b1 - 1], SampleIndexPair(el1, i + 1))) {
-                b1--;
-            }
-
-            assert(data_writers[b0].IsValid());
-            assert(data_writers[b1].IsValid());
+            for (size_t t = 0; t < block_size; ++t)
+                block[t] = unsorted_reader.Next<ValueType>();
 
-            data_writers[b0].Put(el0);
-            data_writers[b1].Put(el1);
-        }
-
-        // last iteration of loop if we have an odd number of items.
-        for ( ; i < prefix_items + local_items_; i++)
-        {
-            size_t j0 = 1;
-            ValueType el0 = unsorted_reader.Next<ValueType>();
+            ClassifyBlock(tree, k, log_k, block.data(), block_size, oracle);
 
-            // run item down the tree
-            for (size_t l = 0; l < log_k; l++)
+            for (size_t t = 0; t < block_size; ++t)
             {
-                j0 = 2 * j0 + (compare_function_(el0, tree[j0]) ? 0 : 1);
-            }
+                size_t b = oracle[t];
 
-            size_t b0 = j0 - k;
+                // items equal to a splitter are assigned by their global index
+                while (b && EqualSampleGreaterIndex(
+                           sorted_splitters[b - 1],
+                           SampleIndexPair(block[t], i + t))) {
+                    b--;
+                }
 
-            while (b0 && EqualSampleGreaterIndex(
-                       sorted_splitters[b0 - 1], SampleIndexPair(el0, i))) {
-                b0--;
+                assert(data_writers[b].IsValid());
+                data_writers[b].Put(block[t]);
             }
 
-            assert(data_writers[b0].IsValid());
-            data_writers[b0].Put(el0);
+            i += block_size;
         }
 
         // implicitly close writers and flush data
@@ -559,19 +735,37 @@ private:
             return;
         }
 
-        // stream to send samples to process 0 and receive them back
-        data::MixStreamPtr sample_stream = context_.GetNewMixStream(this);
+        // stable sorts never use the multi-level exchange
+        if (!Stable && num_total_workers > max_single_level_workers_)
+            MultiLevelExchange();
+        else
+            SingleLevelExchange(prefix_items);
 
-        // Send all samples to worker 0.
-        data::MixStream::Writers sample_writers = sample_stream->GetWriters();
+        double balance = 0;
+        if (local_out_size_ > 0) {
+            balance = static_cast<double>(local_out_size_)
+                      * static_cast<double>(num_total_workers)
+                      / static_cast<double>(total_items);
+        }
 
-        for (const SampleIndexPair& sample : samples_) {
-            // send samples but add the local prefix to index ranks
-            sample_writers[0].Put(
-                SampleIndexPair(sample.first, prefix_items + sample.second));
+        if (balance > 1) {
+            balance = 1 / balance;
         }
-        sample_writers[0].Close();
-        tlx::vector_free(samples_);
+
+        Super::logger_
+            << "class" << "SortNode"
+            << "event" << "done"
+            << "workers" << num_total_workers
+            << "local_out_size" << local_out_size_
+            << "balance" << balance
+            << "sample_size" << samples_.size();
+    }
+
+    //! Exchange items among all workers using a single level of p-1
+    //! splitters, which are selected by worker 0 from all samples.
+    void SingleLevelExchange(size_t prefix_items) {
+
+        size_t num_total_workers = context_.num_workers();
 
         // Get the ceiling of log(num_total_workers), as SSSS needs 2^n buckets.
         size_t ceil_log = tlx::integer_log2_ceil(num_total_workers);
@@ -581,23 +775,42 @@ private:
         std::vector<SampleIndexPair> splitters;
         splitters.reserve(workers_algo);
 
-        if (context_.my_rank() == 0) {
-            FindAndSendSplitters(splitters, samples_.size(),
-                                 sample_stream, sample_writers);
+        if (num_total_workers > max_root_splitter_workers_) {
+            SelectSplittersDistributed(splitters, prefix_items);
         }
         else {
-            // Close unused emitters
-            for (size_t j = 1; j < num_total_workers; j++) {
-                sample_writers[j].Close();
+            // stream to send samples to process 0 and receive them back
+            data::MixStreamPtr sample_stream = context_.GetNewMixStream(this);
+
+            // Send all samples to worker 0.
+            data::MixStream::Writers sample_writers = sample_stream->GetWriters();
+
+            for (const SampleIndexPair& sample : samples_) {
+                // send samples but add the local prefix to index ranks
+                sample_writers[0].Put(
+                    SampleIndexPair(sample.first, prefix_items + sample.second));
             }
-            data::MixStream::MixReader reader =
-                sample_stream->GetMixReader(/* consume */ true);
-            while (reader.HasNext()) {
-                splitters.push_back(reader.template Next<SampleIndexPair>());
+            sample_writers[0].Close();
+            tlx::vector_free(samples_);
+
+            if (context_.my_rank() == 0) {
+                FindAndSendSplitters(splitters, samples_.size(),
+                                     sample_stream, sample_writers);
+            }
+            else {
+                // Close unused emitters
+                for (size_t j = 1; j < num_total_workers; j++) {
+                    sample_writers[j].Close();
+                }
+                data::MixStream::MixReader reader =
+                    sample_stream->GetMixReader(/* consume */ true);
+                while (reader.HasNext()) {
+                    splitters.push_back(reader.template Next<SampleIndexPair>());
+                }
             }
+            sample_writers.clear();
+            sample_stream.reset();
         }
-        sample_writers.clear();
-        sample_stream.reset();
 
         // code from SS2NPartition, slightly altered
 
@@ -624,14 +837,18 @@ private:
                 });
         }
 
-        TransmitItems(
-            splitter_tree.data(), // Tree. sizeof |splitter|
-            workers_algo,         // Number of buckets
-            ceil_log,
-            num_total_workers,
-            splitters.data(),
-            prefix_items,
-            data_stream);
+        {
+            auto data_writers = data_stream->GetWriters();
+
+            TransmitItems(
+                splitter_tree.data(), // Tree. sizeof |splitter|
+                workers_algo,         // Number of buckets
+                ceil_log,
+                num_total_workers,
+                splitters.data(),
+                prefix_items,
+                data_writers);
+        }
 
         tlx::vector_free(splitter_tree);
 
@@ -641,25 +858,188 @@ private:
             ReceiveItems(data_stream);
 
         data_stream.reset();
+    }
 
-        double balance = 0;
-        if (local_out_size_ > 0) {
-            balance = static_cast<double>(local_out_size_)
-                      * static_cast<double>(num_total_workers)
-                      / static_cast<double>(total_items);
+    /*!
+     * Exchange items in multiple levels, in the style of AMS-sort: the group of
+     * all workers is split into k contiguous sub-groups, and each worker sends
+     * its items to one worker in each sub-group, hence it communicates with
+     * only k workers. This is repeated recursively within the sub-groups until
+     * each group consists of a single worker. Splitters are selected by the
+     * first worker of each group from samples of the group's items.
+     */
+    void MultiLevelExchange() {
+
+        size_t num_total_workers = context_.num_workers();
+        size_t my_rank = context_.my_rank();
+
+        // the reservoir sample is only valid for the first level
+        tlx::vector_free(samples_);
+
+        // calculate number of levels and fan-out per level
+        size_t num_levels = 1, fan_out = num_total_workers;
+        while (fan_out > max_single_level_workers_) {
+            ++num_levels;
+            fan_out = static_cast<size_t>(std::ceil(
+                std::pow(static_cast<double>(num_total_workers),
+                         1.0 / static_cast<double>(num_levels))));
         }
 
-        if (balance > 1) {
-            balance = 1 / balance;
+        size_t group_begin = 0, group_end = num_total_workers;
+
+        for (size_t level = 0; level < num_levels; ++level)
+        {
+            size_t group_size = group_end - group_begin;
+            // the last level splits the group into single workers
+            size_t k = (level + 1 == num_levels)
+                       ? group_size : std::min(fan_out, group_size);
+
+            // global index of local items, used to break ties
+            size_t prefix_items = context_.net.ExPrefixSum(local_items_);
+
+            std::vector<SampleIndexPair> splitters;
+            FindGroupSplitters(group_begin, group_end, k, prefix_items,
+                               splitters);
+
+            // calculate sub-group containing this worker and targets
+            std::vector<size_t> targets(k);
+            size_t next_begin = group_begin, next_end = group_end;
+            for (size_t j = 0; j < k; ++j) {
+                size_t sub_begin = group_begin + j * group_size / k;
+                size_t sub_end = group_begin + (j + 1) * group_size / k;
+                targets[j] =
+                    sub_begin + (my_rank - group_begin) % (sub_end - sub_begin);
+                if (sub_begin <= my_rank && my_rank < sub_end)
+                    next_begin = sub_begin, next_end = sub_end;
+            }
+
+            auto data_stream =
+                context_.template GetNewStream<TranmissionStreamType>(
+                    this->dia_id());
+
+            {
+                auto all_writers = data_stream->GetWriters();
+
+                // no splitters are needed if the group is not split further
+                if (splitters.size() + 1 == k) {
+                    size_t ceil_log = tlx::integer_log2_ceil(k);
+                    size_t k_algo = size_t(1) << ceil_log;
+
+                    std::vector<typename TranmissionStreamType::Writer>
+                    data_writers;
+                    data_writers.reserve(k_algo);
+                    for (size_t j = 0; j < k; ++j)
+                        data_writers.emplace_back(
+                            std::move(all_writers[targets[j]]));
+
+                    // add sentinel splitters if fewer buckets than leaves.
+                    for (size_t i = k; i < k_algo; i++)
+                        splitters.push_back(splitters.back());
+
+                    std::vector<ValueType> splitter_tree(k_algo + 1);
+                    TreeBuilder(splitter_tree.data(), splitters.data(),
+                                k_algo - 1);
+
+                    TransmitItems(splitter_tree.data(), k_algo, ceil_log, k,
+                                  splitters.data(), prefix_items,
+                                  data_writers);
+                }
+                else {
+                    // the whole group has no items
+                    assert(local_items_ == 0);
+                }
+            }
+
+            group_begin = next_begin, group_end = next_end;
+
+            if (level + 1 == num_levels) {
+                ReceiveItems(data_stream);
+            }
+            else {
+                // collect items of next level in a new unsorted File
+                data::File file = context_.GetFile(this);
+                auto writer = file.GetWriter();
+                auto reader = data_stream->GetReader(/* consume */ true);
+                while (reader.HasNext())
+                    writer.Put(reader.template Next<ValueType>());
+                writer.Close();
+
+                unsorted_file_ = std::move(file);
+                local_items_ = unsorted_file_.num_items();
+            }
+
+            data_stream.reset();
         }
+    }
 
-        Super::logger_
-            << "class" << "SortNode"
-            << "event" << "done"
-            << "workers" << num_total_workers
-            << "local_out_size" << local_out_size_
-            << "balance" << balance
-            << "sample_size" << samples_.size();
+    /*!
+     * Select k-1 splitters for the group of workers [group_begin,group_end):
+     * all group members send random samples of their local items to the first
+     * worker of the group, which sorts them and returns equidistant splitters.
+     */
+    void FindGroupSplitters(
+        size_t group_begin, size_t group_end, size_t k, size_t prefix_items,
+        std::vector<SampleIndexPair>& splitters) {
+
+        size_t num_total_workers = context_.num_workers();
+        size_t my_rank = context_.my_rank();
+        size_t group_size = group_end - group_begin;
+
+        // oversample each bucket by 16 * log(k) items in total
+        size_t group_samples = k * 16 * (1 + tlx::integer_log2_ceil(k));
+        size_t sample_size =
+            local_items_ == 0 ? 0 :
+            std::min(local_items_,
+                     (group_samples + group_size - 1) / group_size);
+
+        data::MixStreamPtr sample_stream = context_.GetNewMixStream(this);
+        data::MixStream::Writers sample_writers = sample_stream->GetWriters();
+
+        for (size_t i = 0; i < sample_size; ++i) {
+            size_t index = context_.rng_() % local_items_;
+            sample_writers[group_begin].Put(
+                SampleIndexPair(unsorted_file_.GetItemAt<ValueType>(index),
+                                prefix_items + index));
+        }
+        sample_writers[group_begin].Close();
+
+        if (my_rank == group_begin) {
+            // keep writers to group members open for sending splitters
+            for (size_t j = 0; j < num_total_workers; ++j) {
+                if (j <= group_begin || j >= group_end)
+                    sample_writers[j].Close();
+            }
+
+            std::vector<SampleIndexPair> samples;
+            auto reader = sample_stream->GetMixReader(/* consume */ true);
+            while (reader.HasNext())
+                samples.push_back(reader.template Next<SampleIndexPair>());
+
+            if (samples.size() != 0) {
+                std::sort(samples.begin(), samples.end(),
+                          [this](
+                              const SampleIndexPair& a, const SampleIndexPair& b) {
+                              return LessSampleIndex(a, b);
+                          });
+
+                for (size_t i = 1; i < k; ++i) {
+                    splitters.push_back(samples[i * samples.size() / k]);
+                    for (size_t j = group_begin + 1; j < group_end; ++j)
+                        sample_writers[j].Put(splitters.back());
+                }
+            }
+
+            for (size_t j = group_begin + 1; j < group_end; ++j)
+                sample_writers[j].Close();
+        }
+        else {
+            for (size_t j = 0; j < num_total_workers; ++j)
+                sample_writers[j].Close();
+
+            auto reader = sample_stream->GetMixReader(/* consume */ true);
+            while (reader.HasNext())
+                splitters.push_back(reader.template Next<SampleIndexPair>());
+        }
     }
 
     void ReceiveItems(TranmissionStreamPtr& data_stream) {
@@ -668,20 +1048,67 @@ private:
 
         LOG0 << "Writing files";
 
-        // M/2 such that the other half is used to prepare the next bulk
-        size_t capacity = DIABase::mem_limit_ / sizeof(ValueType) / 2;
+        // M/2 per buffer, and M/4 if a second buffer is sorted and written
+        // in the background, such that both buffers together use at most M/2
+        // and the other half is used to prepare the next bulk. Divided by
+        // the extra memory needed by the sort algorithm.
+        size_t capacity = DIABase::mem_limit_ / sizeof(ValueType)
+                          / (use_background_sort_ ? 4 : 2)
+                          / SortAlgorithmMemoryFactor<SortAlgorithm>::value;
         size_t capacity_half = capacity / 2;
         std::vector<ValueType> vec;
         vec.reserve(capacity);
 
-        while (reader.HasNext()) {
-            if (vec.size() < capacity_half ||
-                (vec.size() < capacity && !mem::memory_exceeded)) {
-                vec.push_back(reader.template Next<ValueType>());
-            }
-            else {
-                SortAndWriteToFile(vec);
+        // second buffer, which is sorted and written in the background while
+        // vec is filled.
+        std::vector<ValueType> vec_sort;
+        std::thread thread;
+        // exception thrown by the background thread, rethrown after joining
+        std::exception_ptr sort_exception;
+
+        auto join_thread = [&thread, &sort_exception]() {
+                               if (thread.joinable())
+                                   thread.join();
+                               if (sort_exception)
+                                   std::rethrow_exception(sort_exception);
+                           };
+
+        try {
+            while (reader.HasNext()) {
+                if (vec.size() < capacity_half ||
+                    (vec.size() < capacity && !mem::memory_exceeded)) {
+                    vec.push_back(reader.template Next<ValueType>());
+                }
+                else if (use_background_sort_) {
+                    // wait for the previous run, then hand over the full
+                    // buffer and continue receiving into the emptied one.
+                    join_thread();
+                    std::swap(vec, vec_sort);
+                    if (vec.capacity() < capacity)
+                        vec.reserve(capacity);
+                    thread = common::CreateThread(
+                        [this, &vec_sort, &sort_exception]() {
+                            try {
+                                SortAndWriteToFile(vec_sort);
+                            }
+                            catch (...) {
+                                sort_exception = std::current_exception();
+                            }
+                        });
+                }
+                else {
+                    SortAndWriteToFile(vec);
+                }
             }
+
+            // the previous run must be written first to keep files_ in order.
+            join_thread();
+        }
+        catch (...) {
+            // a joinable std::thread terminates the program when destroyed
+            if (thread.joinable())
+                thread.join();
+            throw;
         }
 
         if (vec.size())
@@ -786,15 +1213,51 @@ private:
     }
 };
 
+/*!
+ * Default SortAlgorithm class: uses an in-place radix sort if the comparator is
+ * std::less on integral types, std::pair/std::tuple of these, or std::string,
+ * and std::sort otherwise.
+ */
 class DefaultSortAlgorithm
 {
 public:
     template <typename Iterator, typename CompareFunction>
     void operator () (Iterator begin, Iterator end, CompareFunction cmp) const {
-        return std::sort(begin, end, cmp);
+        return common::radix_sort_auto(
+            begin, end, cmp,
+            [](Iterator b, Iterator e, const CompareFunction& c) {
+                std::sort(b, e, c);
+            });
     }
 };
 
+/*!
+ * SortAlgorithm class for use with api::Sort() which sorts local runs with a
+ * parallel multiway mergesort, using the host-global pool of helper threads on
+ * cores not occupied by workers. Falls back to std::sort if there are no idle
+ * cores.
+ */
+class ParallelSortAlgorithm
+{
+public:
+    explicit ParallelSortAlgorithm(Context& ctx)
+        : pool_(ctx.idle_thread_pool()) { }
+
+    template <typename Iterator, typename CompareFunction>
+    void operator () (Iterator begin, Iterator end, CompareFunction cmp) const {
+        return common::parallel_sort(
+            begin, end, cmp, pool_, pool_ ? pool_->size() + 1 : 1);
+    }
+
+private:
+    tlx::ThreadPool* pool_;
+};
+
+//! the parallel mergesort needs a merge buffer as large as the run
+template <>
+struct SortAlgorithmMemoryFactor<ParallelSortAlgorithm>
+    : public std::integral_constant<size_t, 2> { };
+
 template <typename ValueType, typename Stack>
 template <typename CompareFunction>
 auto DIA<ValueType, Stack>::Sort(const CompareFunction& compare_function) const {
@@ -827,9 +1290,11 @@ auto DIA<ValueType, Stack>::Sort(const CompareFunction& compare_function) const
 }
 
 template <typename ValueType, typename Stack>
-template <typename CompareFunction, typename SortAlgorithm>
+template <typename CompareFunction, typename SortAlgorithm,
+          typename SortConfig>
 auto DIA<ValueType, Stack>::Sort(const CompareFunction& compare_function,
-                                 const SortAlgorithm& sort_algorithm) const {
+                                 const SortAlgorithm& sort_algorithm,
+                                 const SortConfig& sort_config) const {
     assert(IsValid());
 
     using SortNode = api::SortNode<
@@ -854,20 +1319,56 @@ auto DIA<ValueType, Stack>::Sort(const CompareFunction& compare_function,
         "CompareFunction has the wrong output type (should be bool)");
 
     auto node = tlx::make_counting<SortNode>(
-        *this, compare_function, sort_algorithm);
+        *this, compare_function, sort_algorithm, sort_config);
 
     return DIA<ValueType>(node);
 }
 
+/*!
+ * Default stable SortAlgorithm class: uses the same radix sorts as
+ * DefaultSortAlgorithm, which are stable in effect because items equal under
+ * std::less are identical for these types, and std::stable_sort otherwise.
+ */
 class DefaultStableSortAlgorithm
 {
 public:
     template <typename Iterator, typename CompareFunction>
     void operator () (Iterator begin, Iterator end, CompareFunction cmp) const {
-        return std::stable_sort(begin, end, cmp);
+        return common::radix_sort_auto(
+            begin, end, cmp,
+            [](Iterator b, Iterator e, const CompareFunction& c) {
+                std::stable_sort(b, e, c);
+            });
     }
 };
 
+/*!
+ * SortAlgorithm class for use with api::SortStable() which sorts local runs
+ * with a stable parallel multiway mergesort, using the host-global pool of
+ * helper threads on idle cores. Falls back to std::stable_sort if there are no
+ * idle cores.
+ */
+class ParallelStableSortAlgorithm
+{
+public:
+    explicit ParallelStableSortAlgorithm(Context& ctx)
+        : pool_(ctx.idle_thread_pool()) { }
+
+    template <typename Iterator, typename CompareFunction>
+    void operator () (Iterator begin, Iterator end, CompareFunction cmp) const {
+        return common::parallel_stable_sort(
+            begin, end, cmp, pool_, pool_ ? pool_->size() + 1 : 1);
+    }
+
+private:
+    tlx::ThreadPool* pool_;
+};
+
+//! the parallel mergesort needs a merge buffer as large as the run
+template <>
+struct SortAlgorithmMemoryFactor<ParallelStableSortAlgorithm>
+    : public std::integral_constant<size_t, 2> { };
+
 template <typename ValueType, typename Stack>
 template <typename CompareFunction>
 auto DIA<ValueType, Stack>::SortStable(
@@ -902,10 +1403,12 @@ auto DIA<ValueType, Stack>::SortStable(
 }
 
 template <typename ValueType, typename Stack>
-template <typename CompareFunction, typename SortAlgorithm>
+template <typename CompareFunction, typename SortAlgorithm,
+          typename SortConfig>
 auto DIA<ValueType, Stack>::SortStable(
     const CompareFunction& compare_function,
-    const SortAlgorithm& sort_algorithm) const {
+    const SortAlgorithm& sort_algorithm,
+    const SortConfig& sort_config) const {
 
     assert(IsValid());
 
@@ -931,7 +1434,7 @@ auto DIA<ValueType, Stack>::SortStable(
         "CompareFunction has the wrong output type (should be bool)");
 
     auto node = tlx::make_counting<SortStableNode>(
-        *this, compare_function, sort_algorithm);
+        *this, compare_function, sort_algorithm, sort_config);
 
     return DIA<ValueType>(node);
 }
@@ -49,6 +49,7 @@ static constexpr bool g_debug_push_file = false;
 
 #if __linux__
 #define THRILL_HAVE_LINUXAIO_FILE 1
+#define THRILL_HAVE_EPOLL 1
 #endif
 
 #if defined(_MSC_VER)
@@ -60,6 +61,11 @@ static constexpr bool g_debug_push_file = false;
 #define THRILL_HAVE_MMAP_FILE 1
 #endif
 
+// MSVC doesn't define __SSE2__, so also check for x64 // NOLINT
+#if defined(__SSE2__) || defined(_M_X64)
+#define THRILL_HAVE_SSE2
+#endif
+
 // MSVC doesn't define __SSE4_1__, so also check for __AVX__ // NOLINT
 #if defined(__SSE4_1__) || defined(__AVX__)
 #define THRILL_HAVE_SSE4_1
@@ -90,6 +90,22 @@ static inline uint32_t Hash64to32(uint64_t key) {
     return (uint32_t)key;
 }
 
+/*!
+ * Returns a uint64_t hash of a uint64_t, which spreads the bits of user hash
+ * functions like std::hash that may be the identity.
+ *
+ * This is the 64-bit finalizer of Austin Appleby's MurmurHash3 (public
+ * domain).
+ */
+static inline uint64_t Hash64to64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ull;
+    key ^= key >> 33;
+    return key;
+}
+
 /*!
  * Hashing helper that decides what is hashed
  *
@@ -0,0 +1,333 @@
+/*******************************************************************************
+ * thrill/common/parallel_sort.hpp
+ *
+ * Parallel multiway mergesort of an iterator range using a shared thread
+ * pool. The range is split into equal parts which are sorted independently,
+ * then the sorted runs are merged pairwise in rounds, where each pairwise merge
+ * is again split into equal output parts using co-ranking. The algorithm is
+ * stable if the run sorter is stable.
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_COMMON_PARALLEL_SORT_HEADER
+#define THRILL_COMMON_PARALLEL_SORT_HEADER
+
+#include <tlx/thread_pool.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace thrill {
+namespace common {
+namespace parallel_sort_local {
+
+/*!
+ * Run job(i) for all i in [0,num_jobs) using the thread pool. The calling
+ * thread executes job(0) itself and then waits for all other jobs to
+ * finish. Only completion of this batch is awaited, hence multiple threads may
+ * share the same pool. If jobs throw, all jobs are still awaited, and then the
+ * first exception is rethrown on the calling thread.
+ */
+template <typename Job>
+void RunJobs(tlx::ThreadPool& pool, size_t num_jobs, const Job& job) {
+    if (num_jobs == 0) return;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = num_jobs - 1;
+    std::exception_ptr error;
+
+    for (size_t i = 1; i < num_jobs; ++i) {
+        pool.enqueue(
+            [&, i]() {
+                std::exception_ptr e;
+                try {
+                    job(i);
+                }
+                catch (...) {
+                    e = std::current_exception();
+                }
+                // notify while holding the lock, such that the waiting thread
+                // cannot destroy cv before notify_one() returns.
+                std::unique_lock<std::mutex> lock(mutex);
+                if (e && !error) error = e;
+                if (--remaining == 0)
+                    cv.notify_one();
+            });
+    }
+
+    try {
+        job(0);
+    }
+    catch (...) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+    }
+
+    // the pool jobs reference the locals, hence wait even if job(0) threw.
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return remaining == 0; });
+
+    if (error) std::rethrow_exception(error);
+}
+
+/*!
+ * Calculate the number of items taken from the first sequence [a,a+a_size)
+ * when the first k items of the stable merge of [a,a+a_size) and [b,b+b_size)
+ * are output. Items from the first sequence precede equal ones from the second.
+ */
+template <typename Iterator, typename Comparator>
+size_t MergeCoRank(Iterator a, size_t a_size, Iterator b, size_t b_size,
+                   size_t k, const Comparator& cmp) {
+    size_t lo = k > b_size ? k - b_size : 0;
+    size_t hi = std::min(k, a_size);
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        // if a[mid] <= b[k - mid - 1] then a[mid] is among the first k items.
+        if (!cmp(b[k - mid - 1], a[mid]))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*!
+ * Output iterator which move-constructs the assigned items in uninitialized
+ * memory, used by the first merge round into the buffer.
+ */
+template <typename ValueType>
+class ConstructIterator
+{
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    explicit ConstructIterator(ValueType* p) : p_(p) { }
+
+    ConstructIterator& operator * () { return *this; }
+    ConstructIterator& operator ++ () { ++p_; return *this; }
+    ConstructIterator operator ++ (int) { return ConstructIterator(p_++); }
+
+    ConstructIterator operator + (size_t i) const {
+        return ConstructIterator(p_ + i);
+    }
+
+    ConstructIterator& operator = (ValueType&& v) {
+        new (p_)ValueType(std::move(v));
+        return *this;
+    }
+
+private:
+    ValueType* p_;
+};
+
+/*!
+ * Uninitialized buffer of n items for merging. The items are constructed by
+ * the first merge round and destroyed with the buffer, hence ValueType need
+ * not be default-constructible.
+ */
+template <typename ValueType>
+class MergeBuffer
+{
+public:
+    explicit MergeBuffer(size_t size)
+        : data_(std::allocator<ValueType>().allocate(size)), size_(size) { }
+
+    //! non-copyable: delete copy-constructor
+    MergeBuffer(const MergeBuffer&) = delete;
+    //! non-copyable: delete assignment operator
+    MergeBuffer& operator = (const MergeBuffer&) = delete;
+
+    ~MergeBuffer() {
+        if (constructed_) {
+            for (size_t i = 0; i < size_; ++i)
+                data_[i].~ValueType();
+        }
+        std::allocator<ValueType>().deallocate(data_, size_);
+    }
+
+    ValueType * data() const { return data_; }
+
+    bool constructed() const { return constructed_; }
+    void set_constructed() { constructed_ = true; }
+
+private:
+    ValueType* data_;
+    size_t size_;
+    bool constructed_ = false;
+};
+
+/*!
+ * One round of pairwise merging of the sorted runs delimited by bounds from src
+ * into dst. Each merge is cut into parts of about part_size output items, which
+ * are processed in parallel. bounds is updated to the merged runs.
+ */
+template <typename SrcIterator, typename DstIterator, typename Comparator>
+void MergeRound(tlx::ThreadPool& pool,
+                SrcIterator src, DstIterator dst, std::vector<size_t>& bounds,
+                size_t part_size, const Comparator& cmp) {
+
+    struct Part {
+        size_t a_begin, a_end, b_begin, b_end, out;
+    };
+    std::vector<Part> parts;
+    std::vector<size_t> new_bounds;
+
+    for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+        size_t a_begin = bounds[r], a_end = bounds[r + 1];
+        // an odd run without partner is merged with an empty sequence
+        size_t b_end = r + 2 < bounds.size() ? bounds[r + 2] : a_end;
+        size_t a_size = a_end - a_begin, b_size = b_end - a_end;
+        size_t m = a_size + b_size;
+
+        new_bounds.push_back(a_begin);
+
+        size_t num_parts = std::max<size_t>(1, (m + part_size - 1) / part_size);
+        size_t ka = 0, kb = 0;
+        for (size_t q = 0; q < num_parts; ++q) {
+            size_t k = m * (q + 1) / num_parts;
+            size_t na = MergeCoRank(src + a_begin, a_size, src + a_end, b_size,
+                                    k, cmp);
+            size_t nb = k - na;
+            parts.push_back(Part {
+                                a_begin + ka, a_begin + na,
+                                a_end + kb, a_end + nb,
+                                a_begin + ka + kb
+                            });
+            ka = na, kb = nb;
+        }
+    }
+    new_bounds.push_back(bounds.back());
+
+    RunJobs(pool, parts.size(),
+            [&](size_t i) {
+                const Part& p = parts[i];
+                std::merge(std::make_move_iterator(src + p.a_begin),
+                           std::make_move_iterator(src + p.a_end),
+                           std::make_move_iterator(src + p.b_begin),
+                           std::make_move_iterator(src + p.b_end),
+                           dst + p.out, cmp);
+            });
+
+    std::swap(bounds, new_bounds);
+}
+
+} // namespace parallel_sort_local
+
+/*!
+ * Sort the range [begin,end) using the threads of the given pool and the
+ * calling thread. The range is cut into num_threads parts, each sorted with
+ * run_sort(begin,end,cmp), which are then merged in parallel. Requires n extra
+ * items of memory, which callers must budget for, see api::SortNode. Falls
+ * back to calling run_sort() on the whole range if the input is small or no
+ * threads are available.
+ */
+template <typename Iterator, typename Comparator, typename RunSorter>
+void parallel_mergesort(
+    Iterator begin, Iterator end, const Comparator& cmp,
+    const RunSorter& run_sort, tlx::ThreadPool* pool, size_t num_threads,
+    size_t min_part_size = 64 * 1024) {
+
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using namespace parallel_sort_local;
+
+    size_t n = end - begin;
+    size_t num_parts = std::min(num_threads, n / min_part_size);
+
+    if (pool == nullptr || num_parts <= 1)
+        return run_sort(begin, end, cmp);
+
+    std::vector<size_t> bounds(num_parts + 1);
+    for (size_t i = 0; i <= num_parts; ++i)
+        bounds[i] = n * i / num_parts;
+
+    // sort parts in parallel
+    RunJobs(*pool, num_parts,
+            [&](size_t i) {
+                run_sort(begin + bounds[i], begin + bounds[i + 1], cmp);
+            });
+
+    // merge sorted runs pairwise, alternating between range and buffer.
+    MergeBuffer<value_type> buffer(n);
+    size_t part_size = (n + num_parts - 1) / num_parts;
+    bool in_buffer = false;
+
+    while (bounds.size() > 2) {
+        if (in_buffer) {
+            MergeRound(*pool, buffer.data(), begin, bounds, part_size, cmp);
+        }
+        else if (buffer.constructed()) {
+            MergeRound(*pool, begin, buffer.data(), bounds, part_size, cmp);
+        }
+        else {
+            MergeRound(*pool, begin,
+                       ConstructIterator<value_type>(buffer.data()),
+                       bounds, part_size, cmp);
+            buffer.set_constructed();
+        }
+        in_buffer = !in_buffer;
+    }
+
+    if (in_buffer) {
+        RunJobs(*pool, num_parts,
+                [&](size_t i) {
+                    size_t lo = n * i / num_parts, hi = n * (i + 1) / num_parts;
+                    std::move(buffer.data() + lo, buffer.data() + hi,
+                              begin + lo);
+                });
+    }
+}
+
+/*!
+ * Parallel unstable sort of [begin,end) using std::sort() for runs.
+ */
+template <typename Iterator, typename Comparator>
+void parallel_sort(Iterator begin, Iterator end, const Comparator& cmp,
+                   tlx::ThreadPool* pool, size_t num_threads) {
+    parallel_mergesort(
+        begin, end, cmp,
+        [](Iterator b, Iterator e, const Comparator& c) {
+            std::sort(b, e, c);
+        },
+        pool, num_threads);
+}
+
+/*!
+ * Parallel stable sort of [begin,end) using std::stable_sort() for runs.
+ */
+template <typename Iterator, typename Comparator>
+void parallel_stable_sort(Iterator begin, Iterator end, const Comparator& cmp,
+                          tlx::ThreadPool* pool, size_t num_threads) {
+    parallel_mergesort(
+        begin, end, cmp,
+        [](Iterator b, Iterator e, const Comparator& c) {
+            std::stable_sort(b, e, c);
+        },
+        pool, num_threads);
+}
+
+} // namespace common
+} // namespace thrill
+
+#endif // !THRILL_COMMON_PARALLEL_SORT_HEADER
+
+/******************************************************************************/
@@ -2,7 +2,9 @@
  * thrill/common/radix_sort.hpp
  *
  * An implementations of generic 8-bit radix sort using key caching (requires n
- * extra bytes of memory) and in-place permutation reordering.
+ * extra bytes of memory) and in-place permutation reordering. Additionally an
+ * in-place MSD radix sort for integral keys and tuples thereof, and multikey
+ * quicksort for std::string, which are selected automatically for std::less.
  *
  * Part of Project Thrill - http://project-thrill.org
  *
@@ -20,8 +22,13 @@
 #include <tlx/meta/no_operation.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace thrill {
 namespace common {
@@ -161,6 +168,266 @@ private:
     const size_t K_;
 };
 
+/******************************************************************************/
+// Radix Keys for std::less
+
+/*!
+ * Traits class to extract 8-bit digits, most significant first, from keys whose
+ * order under std::less is the lexicographic order of the digits. Specialized
+ * for integral types, and std::pair and std::tuple of those.
+ */
+template <typename Type, typename Enable = void>
+struct RadixKeyTraits {
+    static constexpr bool is_radix_key = false;
+};
+
+template <typename Type>
+struct RadixKeyTraits<
+    Type, typename std::enable_if<
+        std::is_integral<Type>::value && !std::is_same<Type, bool>::value>::type>
+{
+    static constexpr bool is_radix_key = true;
+    static constexpr size_t size = sizeof(Type);
+
+    static uint8_t at(const Type& v, size_t depth) {
+        using Unsigned = typename std::make_unsigned<Type>::type;
+        Unsigned u = static_cast<Unsigned>(v);
+        // flip sign bit such that negative numbers come first
+        if (std::is_signed<Type>::value)
+            u ^= Unsigned(1) << (8 * sizeof(Type) - 1);
+        return static_cast<uint8_t>(u >> (8 * (sizeof(Type) - 1 - depth)));
+    }
+};
+
+template <typename First, typename Second>
+struct RadixKeyTraits<
+    std::pair<First, Second>, typename std::enable_if<
+        RadixKeyTraits<First>::is_radix_key &&
+        RadixKeyTraits<Second>::is_radix_key>::type>
+{
+    static constexpr bool is_radix_key = true;
+    static constexpr size_t size =
+        RadixKeyTraits<First>::size + RadixKeyTraits<Second>::size;
+
+    static uint8_t at(const std::pair<First, Second>& v, size_t depth) {
+        if (depth < RadixKeyTraits<First>::size)
+            return RadixKeyTraits<First>::at(v.first, depth);
+        return RadixKeyTraits<Second>::at(
+            v.second, depth - RadixKeyTraits<First>::size);
+    }
+};
+
+//! test whether all Types are radix keys
+template <typename... Types>
+struct RadixKeyAll : public std::true_type { };
+
+template <typename Type, typename... Types>
+struct RadixKeyAll<Type, Types...>
+    : public std::integral_constant<
+          bool, RadixKeyTraits<Type>::is_radix_key && RadixKeyAll<Types...>::value>
+{ };
+
+//! sum of key sizes of all Types
+template <typename... Types>
+struct RadixKeySize : public std::integral_constant<size_t, 0> { };
+
+template <typename Type, typename... Types>
+struct RadixKeySize<Type, Types...>
+    : public std::integral_constant<
+          size_t, RadixKeyTraits<Type>::size + RadixKeySize<Types...>::value>
+{ };
+
+template <typename... Args>
+struct RadixKeyTraits<
+    std::tuple<Args...>, typename std::enable_if<
+        (sizeof ... (Args) > 0) && RadixKeyAll<Args...>::value>::type>
+{
+    using Tuple = std::tuple<Args...>;
+
+    static constexpr bool is_radix_key = true;
+    static constexpr size_t size = RadixKeySize<Args...>::value;
+
+    static uint8_t at(const Tuple& v, size_t depth) {
+        return at_index(v, depth, std::integral_constant<size_t, 0>());
+    }
+
+private:
+    template <size_t Index>
+    static uint8_t at_index(const Tuple& v, size_t depth,
+                            std::integral_constant<size_t, Index>) {
+        using Element = typename std::tuple_element<Index, Tuple>::type;
+        if (depth < RadixKeyTraits<Element>::size)
+            return RadixKeyTraits<Element>::at(std::get<Index>(v), depth);
+        return at_index(v, depth - RadixKeyTraits<Element>::size,
+                        std::integral_constant<size_t, Index + 1>());
+    }
+
+    static uint8_t at_index(const Tuple&, size_t,
+                            std::integral_constant<size_t, sizeof ... (Args)>) {
+        return 0;
+    }
+};
+
+/*!
+ * In-place MSD radix sort of [begin,end) on the 8-bit digits of the keys given
+ * by RadixKeyTraits, starting at depth. Buckets are permuted in-place as in
+ * American flag sort, and small buckets are sorted using std::sort().
+ */
+template <typename Iterator>
+static inline
+void radix_sort_msd(Iterator begin, Iterator end, size_t depth = 0) {
+
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using Traits = RadixKeyTraits<value_type>;
+
+    const size_t size = end - begin;
+    if (size < 64)
+        return std::sort(begin, end);
+
+    if (depth == Traits::size)
+        return;
+
+    // count digit occurrences
+    size_t bkt_size[256] = { 0 };
+    for (Iterator it = begin; it != end; ++it)
+        ++bkt_size[Traits::at(*it, depth)];
+
+    // exclusive prefix sum: next free position and end of each bucket
+    size_t bkt_next[256], bkt_end[256];
+    size_t sum = 0;
+    for (size_t i = 0; i < 256; ++i) {
+        bkt_next[i] = sum;
+        sum += bkt_size[i];
+        bkt_end[i] = sum;
+    }
+
+    // permute in-place
+    for (size_t b = 0; b < 256; ++b) {
+        while (bkt_next[b] < bkt_end[b]) {
+            uint8_t c = Traits::at(begin[bkt_next[b]], depth);
+            if (c == b) {
+                ++bkt_next[b];
+            }
+            else {
+                using std::swap;
+                swap(begin[bkt_next[b]], begin[bkt_next[c]++]);
+            }
+        }
+    }
+
+    // recurse
+    size_t bsum = 0;
+    for (size_t i = 0; i < 256; bsum += bkt_size[i++]) {
+        if (bkt_size[i] <= 1) continue;
+        radix_sort_msd(begin + bsum, begin + bsum + bkt_size[i], depth + 1);
+    }
+}
+
+/*!
+ * Multikey quicksort (Bentley and Sedgewick) of a range of std::string,
+ * resulting in the order of std::less<std::string>. All strings in the range
+ * must have a common prefix of length depth.
+ */
+template <typename Iterator>
+static inline
+void multikey_quicksort(Iterator begin, Iterator end, size_t depth = 0) {
+
+    // character at depth, or -1 if the string ends before
+    auto char_at = [](const std::string& s, size_t d) -> int {
+                       return d < s.size() ? static_cast<unsigned char>(s[d]) : -1;
+                   };
+
+    while (end - begin > 1)
+    {
+        const size_t size = end - begin;
+        if (size < 32)
+            return std::sort(begin, end);
+
+        // median of three characters as pivot
+        int a = char_at(begin[0], depth);
+        int b = char_at(begin[size / 2], depth);
+        int c = char_at(begin[size - 1], depth);
+        int pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+        // three-way partition into <, ==, > pivot
+        size_t lt = 0, i = 0, gt = size;
+        while (i < gt) {
+            int x = char_at(begin[i], depth);
+            using std::swap;
+            if (x < pivot)
+                swap(begin[lt++], begin[i++]);
+            else if (x > pivot)
+                swap(begin[i], begin[--gt]);
+            else
+                ++i;
+        }
+
+        multikey_quicksort(begin, begin + lt, depth);
+        multikey_quicksort(begin + gt, end, depth);
+
+        // equal strings which ended are done, others continue one deeper
+        if (pivot < 0) return;
+        end = begin + gt;
+        begin = begin + lt;
+        ++depth;
+    }
+}
+
+//! Whether radix_sort_auto() uses a radix sort for the range's value type and
+//! comparator.
+template <typename Type, typename Comparator>
+struct UseRadixSort
+    : public std::integral_constant<
+          bool, std::is_same<Comparator, std::less<Type> >::value && (
+              RadixKeyTraits<Type>::is_radix_key ||
+              std::is_same<Type, std::string>::value)>
+{ };
+
+//! \cond
+namespace radix_sort_local {
+
+template <typename Iterator, typename Comparator, typename FallbackSorter>
+void radix_sort_auto(Iterator begin, Iterator end, const Comparator& cmp,
+                     const FallbackSorter& fallback, std::false_type) {
+    fallback(begin, end, cmp);
+}
+
+template <typename Iterator>
+void radix_sort_string(Iterator begin, Iterator end, std::true_type) {
+    multikey_quicksort(begin, end);
+}
+
+template <typename Iterator>
+void radix_sort_string(Iterator begin, Iterator end, std::false_type) {
+    radix_sort_msd(begin, end);
+}
+
+template <typename Iterator, typename Comparator, typename FallbackSorter>
+void radix_sort_auto(Iterator begin, Iterator end, const Comparator&,
+                     const FallbackSorter&, std::true_type) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    radix_sort_string(begin, end, std::is_same<value_type, std::string>());
+}
+
+} // namespace radix_sort_local
+//! \endcond
+
+/*!
+ * Sort [begin,end) with the in-place MSD radix sort if the comparator is
+ * std::less on an integral type or std::pair/std::tuple of integral types, or
+ * with multikey quicksort for std::less on std::string, and otherwise call
+ * fallback(begin, end, cmp). Since items which are equal under std::less for
+ * these types are identical, the result is indistinguishable from a stable
+ * sort.
+ */
+template <typename Iterator, typename Comparator, typename FallbackSorter>
+void radix_sort_auto(Iterator begin, Iterator end, const Comparator& cmp,
+                     const FallbackSorter& fallback) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    radix_sort_local::radix_sort_auto(
+        begin, end, cmp, fallback, UseRadixSort<value_type, Comparator>());
+}
+
 } // namespace common
 } // namespace thrill
 
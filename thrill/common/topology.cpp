@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * thrill/common/topology.cpp
+ *
+ * Detection of the host's cpu topology and topology-aware worker placement
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/common/topology.hpp>
+
+#include <thrill/mem/numa_arena.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+namespace thrill {
+namespace common {
+
+//! read the first word of a sysfs file
+static bool ReadSysfs(const std::string& path, std::string* out) {
+    std::ifstream in(path);
+    return static_cast<bool>(in >> *out);
+}
+
+//! parse a cpu list like "0-3,8-11"
+static std::vector<size_t> ParseCpuList(const std::string& list) {
+    std::vector<size_t> cpus;
+    const char* p = list.c_str();
+    while (*p) {
+        char* end;
+        size_t first = std::strtoul(p, &end, 10), last = first;
+        if (end == p) break;
+        if (*end == '-') {
+            p = end + 1;
+            last = std::strtoul(p, &end, 10);
+        }
+        for (size_t c = first; c <= last; ++c) cpus.push_back(c);
+        if (*end != ',') break;
+        p = end + 1;
+    }
+    return cpus;
+}
+
+//! sort key of a cpu: position in the hierarchy
+static std::tuple<size_t, size_t, size_t, size_t, size_t>
+CpuKey(const CpuInfo& c) {
+    return std::make_tuple(c.socket, c.node, c.l3, c.core, c.smt);
+}
+
+//! count distinct values of a member over cpus
+template <typename Member>
+static size_t CountDistinct(const std::vector<CpuInfo>& cpus, Member m) {
+    std::vector<size_t> v;
+    for (const CpuInfo& c : cpus) v.push_back(c.*m);
+    std::sort(v.begin(), v.end());
+    return static_cast<size_t>(std::unique(v.begin(), v.end()) - v.begin());
+}
+
+Topology::Topology(std::vector<CpuInfo> cpus)
+    : cpus_(std::move(cpus)) {
+    std::sort(cpus_.begin(), cpus_.end(),
+              [](const CpuInfo& a, const CpuInfo& b) {
+                  return CpuKey(a) < CpuKey(b);
+              });
+    num_sockets_ = CountDistinct(cpus_, &CpuInfo::socket);
+    num_nodes_ = CountDistinct(cpus_, &CpuInfo::node);
+    num_l3_ = CountDistinct(cpus_, &CpuInfo::l3);
+}
+
+Topology Topology::Detect() {
+    size_t num_cpus = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<CpuInfo> cpus(num_cpus);
+
+    for (size_t i = 0; i < num_cpus; ++i) {
+        CpuInfo& c = cpus[i];
+        c.cpu = i;
+        c.socket = 0, c.node = 0, c.l3 = 0, c.core = i, c.smt = 0;
+#if __linux__
+        std::string base =
+            "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/";
+        std::string s;
+
+        // physical_package_id may be -1 on virtual machines
+        if (ReadSysfs(base + "topology/physical_package_id", &s) &&
+            s[0] != '-')
+            c.socket = std::strtoul(s.c_str(), nullptr, 10);
+        if (ReadSysfs(base + "topology/core_id", &s))
+            c.core = std::strtoul(s.c_str(), nullptr, 10);
+        if (ReadSysfs(base + "topology/thread_siblings_list", &s)) {
+            std::vector<size_t> siblings = ParseCpuList(s);
+            c.smt = static_cast<size_t>(
+                std::find(siblings.begin(), siblings.end(), i)
+                - siblings.begin());
+            if (c.smt == siblings.size()) c.smt = 0;
+        }
+
+        // the L3 domain is identified by the smallest cpu sharing it, if
+        // there is no L3 cache, it is the socket.
+        c.l3 = std::numeric_limits<size_t>::max();
+        for (size_t idx = 0; idx < 8; ++idx) {
+            std::string cache =
+                base + "cache/index" + std::to_string(idx) + "/";
+            if (!ReadSysfs(cache + "level", &s)) break;
+            if (s != "3") continue;
+            if (ReadSysfs(cache + "shared_cpu_list", &s)) {
+                std::vector<size_t> shared = ParseCpuList(s);
+                if (!shared.empty()) c.l3 = shared[0];
+            }
+            break;
+        }
+
+        c.node = mem::NumaNodeOfCpu(i);
+#endif
+    }
+
+    for (CpuInfo& c : cpus) {
+        if (c.l3 != std::numeric_limits<size_t>::max()) continue;
+        c.l3 = c.cpu;
+        for (const CpuInfo& o : cpus) {
+            if (o.socket == c.socket) c.l3 = std::min(c.l3, o.cpu);
+        }
+    }
+
+    return Topology(std::move(cpus));
+}
+
+const Topology& Topology::Host() {
+    static Topology topology = Detect();
+    return topology;
+}
+
+CpuInfo Topology::cpu(size_t cpu_id) const {
+    for (const CpuInfo& c : cpus_) {
+        if (c.cpu == cpu_id) return c;
+    }
+    return CpuInfo { cpu_id, 0, 0, 0, cpu_id, 0 };
+}
+
+std::vector<size_t> Topology::PlaceWorkers(
+    size_t num_workers, size_t core_offset) const {
+
+    std::vector<CpuInfo> avail;
+    for (const CpuInfo& c : cpus_) {
+        if (c.cpu >= core_offset) avail.push_back(c);
+    }
+    if (avail.empty()) avail = cpus_;
+
+    std::vector<size_t> result;
+    result.reserve(num_workers);
+
+    if (num_workers >= avail.size()) {
+        // all cpus are used, fill them in hierarchy order.
+        for (size_t i = 0; i < num_workers; ++i)
+            result.push_back(avail[i % avail.size()].cpu);
+        return result;
+    }
+
+    // split avail into sockets and give each socket a share of the workers
+    // proportional to its cpus.
+    std::vector<std::pair<size_t, size_t> > sockets;
+    for (size_t i = 0; i < avail.size(); ++i) {
+        if (i == 0 || avail[i].socket != avail[i - 1].socket)
+            sockets.emplace_back(i, i);
+        sockets.back().second = i + 1;
+    }
+
+    std::vector<size_t> quota(sockets.size());
+    size_t assigned = 0;
+    for (size_t s = 0; s < sockets.size(); ++s) {
+        size_t n = sockets[s].second - sockets[s].first;
+        quota[s] = num_workers * n / avail.size();
+        assigned += quota[s];
+    }
+    for (size_t s = 0; assigned < num_workers; s = (s + 1) % sockets.size()) {
+        if (quota[s] < sockets[s].second - sockets[s].first)
+            ++quota[s], ++assigned;
+    }
+
+    for (size_t s = 0; s < sockets.size(); ++s) {
+        // prefer the first SMT sibling of each core, but keep the hierarchy
+        // order among the chosen cpus.
+        std::vector<size_t> idx;
+        for (size_t i = sockets[s].first; i < sockets[s].second; ++i)
+            idx.push_back(i);
+        std::stable_sort(idx.begin(), idx.end(),
+                         [&](size_t a, size_t b) {
+                             return avail[a].smt < avail[b].smt;
+                         });
+        idx.resize(quota[s]);
+        std::sort(idx.begin(), idx.end());
+        for (size_t i : idx) result.push_back(avail[i].cpu);
+    }
+
+    return result;
+}
+
+std::vector<size_t> Topology::SocketGroups(
+    const std::vector<size_t>& cpus) const {
+    std::vector<size_t> groups(cpus.size());
+    for (size_t i = 1; i < cpus.size(); ++i) {
+        groups[i] = groups[i - 1]
+                    + (cpu(cpus[i]).socket != cpu(cpus[i - 1]).socket);
+    }
+    return groups;
+}
+
+std::ostream& operator << (std::ostream& os, const Topology& t) {
+    return os << t.num_cpus() << " cpus, "
+              << t.num_sockets() << " sockets, "
+              << t.num_nodes() << " NUMA nodes, "
+              << t.num_l3() << " L3 domains";
+}
+
+} // namespace common
+} // namespace thrill
+
+/******************************************************************************/
@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * thrill/common/topology.hpp
+ *
+ * Detection of the host's cpu topology and topology-aware worker placement
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_COMMON_TOPOLOGY_HEADER
+#define THRILL_COMMON_TOPOLOGY_HEADER
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace thrill {
+namespace common {
+
+//! Location of one logical cpu in the host's hierarchy.
+struct CpuInfo {
+    //! logical cpu id as used by SetCpuAffinity()
+    size_t cpu;
+    //! socket (physical package) id
+    size_t socket;
+    //! NUMA node id
+    size_t node;
+    //! id of the L3 cache domain, which is the smallest cpu id sharing it
+    size_t l3;
+    //! physical core id, unique only within the socket
+    size_t core;
+    //! index among the SMT siblings of the core, zero for the first
+    size_t smt;
+};
+
+/*!
+ * The host's topology of sockets, NUMA nodes, L3 cache domains, cores, and SMT
+ * siblings, detected from /sys/devices/system/cpu on Linux. On other systems,
+ * or if sysfs is unavailable, each cpu is a core of a single socket.
+ *
+ * PlaceWorkers() selects cpus for the workers such that they are spread evenly
+ * over the sockets, prefer separate cores over SMT siblings, and workers on the
+ * same socket have consecutive ids. The latter is required by the hierarchical
+ * collectives of net::FlowControlChannel.
+ */
+class Topology
+{
+public:
+    //! construct from a list of cpus, used for testing.
+    explicit Topology(std::vector<CpuInfo> cpus);
+
+    //! detect the topology of this host.
+    static Topology Detect();
+
+    //! the topology of this host, detected on first use.
+    static const Topology& Host();
+
+    //! all cpus, sorted by socket, node, L3 domain, core, and SMT sibling.
+    const std::vector<CpuInfo>& cpus() const { return cpus_; }
+
+    //! number of logical cpus
+    size_t num_cpus() const { return cpus_.size(); }
+
+    //! number of distinct sockets
+    size_t num_sockets() const { return num_sockets_; }
+
+    //! number of distinct NUMA nodes
+    size_t num_nodes() const { return num_nodes_; }
+
+    //! number of distinct L3 cache domains
+    size_t num_l3() const { return num_l3_; }
+
+    //! returns info of a cpu id. Unknown cpus are on socket 0.
+    CpuInfo cpu(size_t cpu_id) const;
+
+    /*!
+     * Select cpus for num_workers workers. The cpus with ids below core_offset
+     * are skipped, as with linear pinning. If there are more workers than
+     * cpus, the cpus are used round-robin.
+     *
+     * \return cpu id of each worker
+     */
+    std::vector<size_t> PlaceWorkers(
+        size_t num_workers, size_t core_offset = 0) const;
+
+    //! Returns the socket group of each worker, numbered consecutively from
+    //! zero, given the workers' cpus. Workers on the same socket must be
+    //! consecutive, otherwise they are put into separate groups.
+    std::vector<size_t> SocketGroups(const std::vector<size_t>& cpus) const;
+
+    //! print summary of the topology
+    friend std::ostream& operator << (std::ostream& os, const Topology& t);
+
+private:
+    //! cpus sorted by position in the hierarchy
+    std::vector<CpuInfo> cpus_;
+
+    //! number of sockets, nodes, and L3 domains
+    size_t num_sockets_ = 0, num_nodes_ = 0, num_l3_ = 0;
+};
+
+} // namespace common
+} // namespace thrill
+
+#endif // !THRILL_COMMON_TOPOLOGY_HEADER
+
+/******************************************************************************/
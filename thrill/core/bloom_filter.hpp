@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * thrill/core/bloom_filter.hpp
+ *
+ * Blocked Bloom filter over key hashes for semi-join filtering.
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_CORE_BLOOM_FILTER_HEADER
+#define THRILL_CORE_BLOOM_FILTER_HEADER
+
+#include <thrill/common/hash.hpp>
+
+#include <tlx/die.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace thrill {
+namespace core {
+
+/*!
+ * A blocked Bloom filter of 64-bit hashes. Each hash selects one block of 512
+ * bits, i.e. one cache line, and sets num_probes bits in it. With 10 bits per
+ * item, the false positive rate is about 1-2%, slightly more than that of a
+ * standard Bloom filter, but each query touches only one cache line.
+ *
+ * Filters of equal size built on different workers are combined by OR-ing
+ * their words(), e.g. by an AllReduce.
+ */
+class BloomFilter
+{
+public:
+    //! number of 64-bit words in a block
+    static constexpr size_t block_words = 8;
+
+    //! number of bits set per hash, each uses 9 bits of the mixed hash.
+    static constexpr size_t num_probes = 6;
+
+    //! create an empty filter which matches nothing.
+    BloomFilter() = default;
+
+    //! create a filter for num_items items with bits_per_item bits each.
+    explicit BloomFilter(size_t num_items, size_t bits_per_item = 10)
+        : num_blocks_(NumBlocks(num_items, bits_per_item)),
+          words_(num_blocks_ * block_words, 0) { }
+
+    //! number of bytes of a filter for num_items items.
+    static size_t SizeBytes(size_t num_items, size_t bits_per_item = 10) {
+        return NumBlocks(num_items, bits_per_item) * block_words
+               * sizeof(uint64_t);
+    }
+
+    //! insert a hash into the filter
+    void Insert(uint64_t hash) {
+        assert(num_blocks_ != 0);
+        uint64_t h = common::Hash64to64(hash);
+        uint64_t* block = &words_[(h % num_blocks_) * block_words];
+        uint64_t probes = common::Hash64to64(h ^ 0x9E3779B97F4A7C15ull);
+        for (size_t i = 0; i < num_probes; ++i) {
+            size_t bit = (probes >> (9 * i)) & 511;
+            block[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    //! returns false if the hash was definitely not inserted.
+    bool Contains(uint64_t hash) const {
+        if (num_blocks_ == 0) return false;
+        uint64_t h = common::Hash64to64(hash);
+        const uint64_t* block = &words_[(h % num_blocks_) * block_words];
+        uint64_t probes = common::Hash64to64(h ^ 0x9E3779B97F4A7C15ull);
+        for (size_t i = 0; i < num_probes; ++i) {
+            size_t bit = (probes >> (9 * i)) & 511;
+            if (!(block[bit / 64] & (uint64_t(1) << (bit % 64))))
+                return false;
+        }
+        return true;
+    }
+
+    //! combine with a filter of equal size
+    BloomFilter& operator |= (const BloomFilter& b) {
+        die_unless(words_.size() == b.words_.size());
+        for (size_t i = 0; i < words_.size(); ++i)
+            words_[i] |= b.words_[i];
+        return *this;
+    }
+
+    //! the bit array, e.g. for combining filters in an AllReduce.
+    const std::vector<uint64_t>& words() const { return words_; }
+
+    //! replace the bit array by one of equal size.
+    void set_words(std::vector<uint64_t> words) {
+        die_unless(words.size() == words_.size());
+        words_ = std::move(words);
+    }
+
+    //! number of bytes of the filter
+    size_t size_bytes() const { return words_.size() * sizeof(uint64_t); }
+
+private:
+    //! number of blocks
+    size_t num_blocks_ = 0;
+
+    //! num_blocks_ blocks of block_words words
+    std::vector<uint64_t> words_;
+
+    static size_t NumBlocks(size_t num_items, size_t bits_per_item) {
+        return std::max<size_t>(1, (num_items * bits_per_item + 511) / 512);
+    }
+};
+
+} // namespace core
+} // namespace thrill
+
+#endif // !THRILL_CORE_BLOOM_FILTER_HEADER
+
+/******************************************************************************/
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * thrill/core/count_min_sketch.hpp
+ *
+ * Count-Min sketch over key hashes for detecting heavy hitters.
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_CORE_COUNT_MIN_SKETCH_HEADER
+#define THRILL_CORE_COUNT_MIN_SKETCH_HEADER
+
+#include <thrill/common/hash.hpp>
+
+#include <tlx/die.hpp>
+#include <tlx/math/is_power_of_two.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace thrill {
+namespace core {
+
+/*!
+ * A Count-Min sketch counting the occurrences of 64-bit hashes in a stream.
+ * Each of the four rows has width counters, which are indexed by a different
+ * 16-bit slice of the mixed hash. The estimate of a hash is the minimum of its
+ * counters, which never underestimates the true count, and overestimates it by
+ * at most 2 * total() / width with high probability.
+ */
+class CountMinSketch
+{
+public:
+    //! number of rows, each uses 16 bits of the mixed hash.
+    static constexpr size_t depth = 4;
+
+    //! create a sketch with width counters per row, a power of two of at most
+    //! 2^16.
+    explicit CountMinSketch(size_t width = 1024)
+        : width_(width), counters_(depth * width, 0) {
+        die_unless(tlx::is_power_of_two(width) && width <= (1u << 16));
+    }
+
+    //! count the hash, returns its new estimated count.
+    uint32_t Add(uint64_t hash) {
+        uint64_t h = common::Hash64to64(hash);
+        uint32_t estimate = UINT32_MAX;
+        for (size_t r = 0; r < depth; ++r) {
+            uint32_t& c = counters_[r * width_ + Index(h, r)];
+            estimate = std::min(estimate, ++c);
+        }
+        ++total_;
+        return estimate;
+    }
+
+    //! returns the estimated count of the hash.
+    uint32_t Estimate(uint64_t hash) const {
+        uint64_t h = common::Hash64to64(hash);
+        uint32_t estimate = UINT32_MAX;
+        for (size_t r = 0; r < depth; ++r)
+            estimate = std::min(estimate, counters_[r * width_ + Index(h, r)]);
+        return estimate;
+    }
+
+    //! total number of hashes counted
+    uint64_t total() const { return total_; }
+
+private:
+    //! number of counters per row
+    size_t width_;
+
+    //! depth rows of width_ counters
+    std::vector<uint32_t> counters_;
+
+    //! total number of hashes counted
+    uint64_t total_ = 0;
+
+    size_t Index(uint64_t h, size_t row) const {
+        return (h >> (16 * row)) & (width_ - 1);
+    }
+};
+
+} // namespace core
+} // namespace thrill
+
+#endif // !THRILL_CORE_COUNT_MIN_SKETCH_HEADER
+
+/******************************************************************************/
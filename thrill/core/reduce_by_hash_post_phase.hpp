@@ -18,17 +18,22 @@
 
 #include <thrill/api/context.hpp>
 #include <thrill/common/logger.hpp>
+#include <thrill/core/hyperloglog.hpp>
+#include <thrill/core/multiway_merge.hpp>
 #include <thrill/core/reduce_bucket_hash_table.hpp>
 #include <thrill/core/reduce_functional.hpp>
 #include <thrill/core/reduce_old_probing_hash_table.hpp>
 #include <thrill/core/reduce_probing_hash_table.hpp>
+#include <thrill/core/reduce_swiss_hash_table.hpp>
 #include <thrill/data/file.hpp>
+#include <tlx/vector_free.hpp>
 
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <functional>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -51,7 +56,7 @@ public:
         TableItem, Value, Emitter, VolatileKey>;
 
     using Table = typename ReduceTableSelect<
-        ReduceConfig::table_impl_,
+        ReducePostTableImpl(ReduceConfig::table_impl_),
         TableItem, Key, Value,
         KeyExtractor, ReduceFunction, PhaseEmitter,
         VolatileKey, ReduceConfig,
@@ -88,7 +93,12 @@ public:
     }
 
     bool Insert(const TableItem& kv) {
-        return table_.Insert(kv);
+        // count the distinct keys, the full hash is recovered from the index,
+        // which is passed on to the table to hash the key only once.
+        typename IndexFunction::Result h = table_.calculate_index(kv);
+        distinct_keys_.insert_hash(
+            h.remaining_hash * table_.num_partitions() + h.partition_id);
+        return table_.Insert(kv, h);
     }
 
     //! Flushes all items in the whole table.
@@ -98,10 +108,17 @@ public:
 
         // list of remaining files, containing only partially reduced item pairs
         // or items
-        std::vector<data::File> remaining_files;
+        std::vector<SpilledPartition> remaining_files;
+
+        // the keys are spread evenly over the partitions by the hash, hence
+        // each spilled partition holds about this many distinct keys.
+        double keys_per_partition =
+            distinct_keys_.result()
+            / static_cast<double>(table_.num_partitions());
 
         // read primary hash table, since ReduceByHash delivers items in any
-        // order, we can just emit items from fully reduced partitions.
+        // order, we can just emit items from fully reduced partitions. These
+        // are the partitions which stayed resident in memory.
 
         {
             std::vector<data::File>& files = table_.partition_files();
@@ -118,7 +135,12 @@ public:
                     LOG << "partition " << id << " contains "
                         << file.num_items() << " partially reduced items";
 
-                    remaining_files.emplace_back(std::move(file));
+                    size_t distinct_keys = std::min(
+                        file.num_items(),
+                        static_cast<size_t>(std::ceil(keys_per_partition)));
+
+                    remaining_files.emplace_back(
+                        SpilledPartition { std::move(file), distinct_keys });
                 }
                 else {
                     LOG << "partition " << id << " contains "
@@ -145,8 +167,26 @@ public:
 
         assert(consume && "Items were spilled hence Flushing must consume");
 
-        // if partially reduce files remain, create new hash tables to process
-        // them iteratively.
+        // if a spilled partition has too many keys to be split into
+        // partitions fitting into RAM, hash partitioning would spill
+        // repeatedly. Instead, sort runs by key hash and merge them.
+        if (ReduceConfig::use_sort_reduce_ &&
+            std::any_of(remaining_files.begin(), remaining_files.end(),
+                        [this](const SpilledPartition& sp) {
+                            return RequiredFanout(sp.distinct_keys)
+                            > ReduceConfig::max_spill_fanout_;
+                        }))
+        {
+            SortReduce<DoCache>(remaining_files, writer);
+            LOG << "Flushed items";
+            return;
+        }
+
+        // if partially reduce files remain, re-reduce each of them in a new
+        // hash table, which has enough partitions such that each one fits into
+        // RAM. Hence, usually each item is written and read from disk at most
+        // once. Only if the number of distinct keys was underestimated, the
+        // partitions spilled again are processed in a further iteration.
 
         size_t iteration = 1;
 
@@ -157,24 +197,29 @@ public:
                  << "iteration" << iteration;
             sLOG << "-- Try to increase the amount of RAM to avoid this.";
 
-            std::vector<data::File> next_remaining_files;
-
-            Table subtable(
-                table_.ctx(), table_.dia_id(),
-                table_.key_extractor(), table_.reduce_function(), emitter_,
-                /* num_partitions */ 32, config_, /* immediate_flush */ false,
-                IndexFunction(iteration, table_.index_function()),
-                table_.key_equal_function());
-
-            subtable.Initialize(table_.limit_memory_bytes());
+            std::vector<SpilledPartition> next_remaining_files;
 
             size_t num_subfile = 0;
 
-            for (data::File& file : remaining_files)
+            for (SpilledPartition& spilled : remaining_files)
             {
+                data::File& file = spilled.file;
+                size_t fanout = SpillFanout(spilled.distinct_keys);
+
                 // insert all items from the partially reduced file
                 sLOG << "re-reducing subfile" << num_subfile++
-                     << "containing" << file.num_items() << "items";
+                     << "containing" << file.num_items() << "items"
+                     << "with about" << spilled.distinct_keys << "keys"
+                     << "into" << fanout << "partitions";
+
+                Table subtable(
+                    table_.ctx(), table_.dia_id(),
+                    table_.key_extractor(), table_.reduce_function(), emitter_,
+                    fanout, config_, /* immediate_flush */ false,
+                    IndexFunction(iteration, table_.index_function()),
+                    table_.key_equal_function());
+
+                subtable.Initialize(table_.limit_memory_bytes());
 
                 data::File::ConsumeReader reader = file.GetConsumeReader();
 
@@ -192,14 +237,20 @@ public:
                     // get the actual reader from the file
                     data::File& subfile = subfiles[id];
 
-                    // if items have been spilled, store for a second reduce
+                    // if items have been spilled, store for a further reduce.
+                    // The estimate was wrong, hence the number of items is
+                    // used as a safe bound on the number of keys.
                     if (subfile.num_items() > 0) {
                         subtable.SpillPartition(id);
 
                         sLOG << "partition" << id << "contains"
                              << subfile.num_items() << "partially reduced items";
 
-                        next_remaining_files.emplace_back(std::move(subfile));
+                        size_t distinct_keys = subfile.num_items();
+                        next_remaining_files.emplace_back(
+                            SpilledPartition {
+                                std::move(subfile), distinct_keys
+                            });
                     }
                     else {
                         sLOG << "partition" << id << "contains"
@@ -252,6 +303,7 @@ public:
 
     void Dispose() {
         table_.Dispose();
+        distinct_keys_ = HyperLogLogRegisters<12>();
         if (cache_) cache_.reset();
     }
 
@@ -267,6 +319,200 @@ public:
     //! \}
 
 private:
+    //! A spilled partition and an estimate of the distinct keys in it.
+    struct SpilledPartition {
+        data::File file;
+        size_t distinct_keys;
+    };
+
+    //! Estimated number of distinct keys inserted
+    HyperLogLogRegisters<12> distinct_keys_;
+
+    //! Number of partitions to split a spilled partition with distinct_keys
+    //! into, such that each fits into the table's memory with some headroom
+    //! for uneven partitions.
+    double RequiredFanout(size_t distinct_keys) const {
+        double capacity =
+            static_cast<double>(table_.limit_memory_bytes())
+            * config_.limit_partition_fill_rate()
+            / static_cast<double>(sizeof(TableItem));
+        return std::ceil(1.25 * static_cast<double>(distinct_keys)
+                         / std::max(capacity, 1.0));
+    }
+
+    //! RequiredFanout() limited to at most max_spill_fanout_.
+    size_t SpillFanout(size_t distinct_keys) const {
+        size_t max_fanout = ReduceConfig::max_spill_fanout_;
+        return std::max<size_t>(
+            1, std::min(max_fanout,
+                        static_cast<size_t>(RequiredFanout(distinct_keys))));
+    }
+
+    //! \name Sort-Based Reduce of Spilled Partitions
+    //! \{
+
+    //! item with the hash of its key, by which runs are sorted.
+    using SortItem = std::pair<uint64_t, TableItem>;
+
+    //! compare SortItems by key hash
+    struct SortItemLess {
+        bool operator () (const SortItem& a, const SortItem& b) const {
+            return a.first < b.first;
+        }
+    };
+
+    //! Puller interface over a vector for ReduceSorted()
+    class VectorPuller
+    {
+    public:
+        explicit VectorPuller(const std::vector<SortItem>& vec) : vec_(vec) { }
+        bool HasNext() const { return pos_ < vec_.size(); }
+        const SortItem& Next() { return vec_[pos_++]; }
+
+    private:
+        const std::vector<SortItem>& vec_;
+        size_t pos_ = 0;
+    };
+
+    //! returns the full hash of the item's key.
+    uint64_t KeyHash(const TableItem& t) const {
+        return table_.index_function()(
+            table_.key(t), /* num_partitions */ 1, 0, 0).remaining_hash;
+    }
+
+    //! add an item to a group of reduced items with equal key hash, usually
+    //! there is only one key in the group.
+    void AddToGroup(std::vector<SortItem>& group, const SortItem& s) const {
+        for (SortItem& g : group) {
+            if (table_.key_equal_function()(
+                    table_.key(g.second), table_.key(s.second))) {
+                g.second = table_.reduce(g.second, s.second);
+                return;
+            }
+        }
+        group.push_back(s);
+    }
+
+    //! reduce a sequence of items sorted by key hash, and pass the results to
+    //! output.
+    template <typename Puller, typename Output>
+    void ReduceSorted(Puller& puller, const Output& output) const {
+        std::vector<SortItem> group;
+        while (puller.HasNext()) {
+            SortItem s = puller.Next();
+            if (!group.empty() && group[0].first != s.first) {
+                for (const SortItem& g : group) output(g);
+                group.clear();
+            }
+            AddToGroup(group, s);
+        }
+        for (const SortItem& g : group) output(g);
+    }
+
+    //! sort run, combine items with equal keys, and write it to a new File.
+    data::File WriteRun(std::vector<SortItem>& run) const {
+        std::sort(run.begin(), run.end(), SortItemLess());
+
+        data::File file = table_.ctx().GetFile(table_.dia_id());
+        data::File::Writer writer = file.GetWriter();
+        VectorPuller puller(run);
+        ReduceSorted(puller, [&writer](const SortItem& s) { writer.Put(s); });
+        writer.Close();
+
+        run.clear();
+        return file;
+    }
+
+    /*!
+     * Re-reduce spilled partitions by sorting. Runs filling the memory limit
+     * are sorted by key hash and combined, then the runs are merged and items
+     * with equal keys are reduced during merging. Unlike hash partitioning,
+     * the I/O volume does not depend on the number of keys: each spilled item
+     * is written once more into a run, plus once per partial merge pass.
+     */
+    template <bool DoCache>
+    void SortReduce(std::vector<SpilledPartition>& spilled,
+                    data::File::Writer* writer) {
+        Context& ctx = table_.ctx();
+
+        size_t run_capacity = std::max<size_t>(
+            1, table_.limit_memory_bytes() / sizeof(SortItem));
+
+        std::vector<SortItem> run;
+        std::vector<data::File> runs;
+
+        for (SpilledPartition& sp : spilled) {
+            data::File::ConsumeReader reader = sp.file.GetConsumeReader();
+            while (reader.HasNext()) {
+                TableItem t = reader.Next<TableItem>();
+                run.emplace_back(KeyHash(t), t);
+                if (run.size() >= run_capacity)
+                    runs.emplace_back(WriteRun(run));
+            }
+        }
+        spilled.clear();
+
+        if (!run.empty())
+            runs.emplace_back(WriteRun(run));
+        tlx::vector_free(run);
+
+        sLOG << "ReducePostPhase: sort-based re-reduce of"
+             << runs.size() << "runs";
+
+        size_t merge_degree, prefetch;
+
+        // merge batches of runs if necessary
+        while (std::tie(merge_degree, prefetch) =
+                   ctx.block_pool().MaxMergeDegreePrefetch(runs.size()),
+               runs.size() > merge_degree)
+        {
+            std::vector<data::File> new_runs;
+
+            size_t fi;
+            for (fi = 0; fi + merge_degree < runs.size(); fi += merge_degree) {
+                std::vector<data::File::ConsumeReader> seq;
+                seq.reserve(merge_degree);
+                for (size_t t = 0; t < merge_degree; ++t) {
+                    seq.emplace_back(
+                        runs[fi + t].GetConsumeReader(/* prefetch */ 0));
+                }
+                StartPrefetch(seq, prefetch);
+
+                auto puller = make_multiway_merge_tree<SortItem>(
+                    seq.begin(), seq.end(), SortItemLess());
+
+                new_runs.emplace_back(ctx.GetFile(table_.dia_id()));
+                data::File::Writer run_writer = new_runs.back().GetWriter();
+                ReduceSorted(puller, [&run_writer](const SortItem& s) {
+                                 run_writer.Put(s);
+                             });
+                run_writer.Close();
+            }
+
+            for ( ; fi < runs.size(); ++fi)
+                new_runs.emplace_back(std::move(runs[fi]));
+
+            std::swap(runs, new_runs);
+        }
+
+        // final merge, emitting fully reduced items
+        std::vector<data::File::ConsumeReader> seq;
+        seq.reserve(runs.size());
+        for (size_t t = 0; t < runs.size(); ++t)
+            seq.emplace_back(runs[t].GetConsumeReader(/* prefetch */ 0));
+        StartPrefetch(seq, prefetch);
+
+        auto puller = make_multiway_merge_tree<SortItem>(
+            seq.begin(), seq.end(), SortItemLess());
+
+        ReduceSorted(puller, [this, writer](const SortItem& s) {
+                         if (DoCache) writer->Put(s.second);
+                         emitter_.Emit(s.second);
+                     });
+    }
+
+    //! \}
+
     //! Stored reduce config to initialize the subtable.
     ReduceConfig config_;
 
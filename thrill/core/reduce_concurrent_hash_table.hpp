@@ -0,0 +1,694 @@
+/*******************************************************************************
+ * thrill/core/reduce_concurrent_hash_table.hpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_CORE_REDUCE_CONCURRENT_HASH_TABLE_HEADER
+#define THRILL_CORE_REDUCE_CONCURRENT_HASH_TABLE_HEADER
+
+#include <thrill/common/config.hpp>
+#include <thrill/common/defines.hpp>
+#include <thrill/core/reduce_functional.hpp>
+#include <thrill/core/reduce_table.hpp>
+#include <thrill/mem/aligned_allocator.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace thrill {
+namespace core {
+
+/*!
+ * A linear probing hash table which is shared by all workers on a host. It is
+ * meant for the pre-phase of ReduceByKey and ReduceToIndex: a key which occurs
+ * on all local workers is reduced into a single slot and hence transmitted only
+ * once per host instead of once per worker.
+ *
+ * The slots are partitioned like in the ReduceProbingHashTable. Each slot has a
+ * state byte, which is EMPTY, BUSY or FULL. Inserting threads claim empty
+ * slots and lock full slots for comparing and reducing using compare-and-swap
+ * on the state byte, in the style of the folklore lock-free hash table. Since
+ * items of arbitrary type cannot be updated atomically, a slot is BUSY while
+ * its item is constructed, compared, or reduced.
+ *
+ * Each partition has a reader/writer lock: inserts take it shared, while
+ * growing, rehashing and flushing a partition take it exclusively. To keep
+ * inserts free of contended read-modify-write operations, each local worker
+ * announces shared use in its own reader flag, which an exclusive user waits
+ * on, and counts the items it inserted locally, publishing them to the
+ * partition in small batches. The worker whose published count reaches the
+ * fill limit of a partition grows it, or flushes it to the network using its
+ * own emitter, hence flushing is performed cooperatively by whichever worker
+ * is inserting. FlushAll() splits the partitions evenly among the local
+ * workers.
+ *
+ * The shared data is created by the first local worker in Initialize() and
+ * distributed to the other workers using FlowControlChannel::LocalBroadcast(),
+ * hence Initialize() and FlushAll() must be called collectively by all workers
+ * on a host.
+ */
+template <typename TableItem, typename Key, typename Value,
+          typename KeyExtractor, typename ReduceFunction, typename Emitter,
+          const bool VolatileKey,
+          typename ReduceConfig_,
+          typename IndexFunction,
+          typename KeyEqualFunction = std::equal_to<Key> >
+class ReduceConcurrentHashTable
+    : public ReduceTable<TableItem, Key, Value,
+                         KeyExtractor, ReduceFunction, Emitter,
+                         VolatileKey, ReduceConfig_,
+                         IndexFunction, KeyEqualFunction>
+{
+    using Super = ReduceTable<TableItem, Key, Value,
+                              KeyExtractor, ReduceFunction, Emitter,
+                              VolatileKey, ReduceConfig_, IndexFunction,
+                              KeyEqualFunction>;
+    using Super::debug;
+
+    //! states of a slot
+    static constexpr uint8_t kEmpty = 0;
+    static constexpr uint8_t kBusy = 1;
+    static constexpr uint8_t kFull = 2;
+
+    //! maximum number of inserts a worker counts locally before publishing
+    //! them to the partition's item counter.
+    static constexpr size_t kMaxCountBatch = 64;
+
+    //! std::vector whose storage starts on a cache line.
+    template <typename Type>
+    using AlignedVector = std::vector<
+              Type, mem::AlignedAllocator<
+                  Type, std::allocator<char>, common::g_cache_line_size> >;
+
+    //! Host-wide shared state of a partition, aligned such that no cache line
+    //! is shared among partitions.
+    struct alignas(common::g_cache_line_size) Partition {
+        //! set while a worker holds the partition exclusively.
+        std::atomic<bool> exclusive_ { false };
+        //! number of items published by the workers, which lags behind the
+        //! items in the partition by each worker's PendingItems.
+        std::atomic<size_t> items_ { 0 };
+        //! incremented whenever the partition is emptied, only changed
+        //! exclusively.
+        size_t epoch_ = 0;
+        //! current number of slots used, only changed exclusively.
+        size_t size_ = 0;
+        //! limit on the number of items before growing or flushing, only
+        //! changed exclusively.
+        size_t limit_items_ = 0;
+        //! number of inserts a worker counts before publishing them, only
+        //! changed exclusively.
+        size_t count_batch_ = 1;
+    };
+
+    //! Items inserted by this worker into a partition but not yet published.
+    struct PendingItems {
+        //! Partition::epoch_ in which the items were inserted
+        size_t epoch = 0;
+        //! number of unpublished items
+        size_t items = 0;
+    };
+
+    //! Host-wide data shared by the tables of all local workers.
+    class Shared
+    {
+    public:
+        Shared(size_t num_partitions, size_t num_buckets_per_partition,
+               size_t initial_size, double limit_fill_rate,
+               size_t workers_per_host)
+            : num_buckets_per_partition_(num_buckets_per_partition),
+              limit_fill_rate_(limit_fill_rate),
+              partitions_(num_partitions),
+              num_partitions_(num_partitions),
+              workers_per_host_(workers_per_host),
+              // round up, such that each worker's flags start a cache line.
+              readers_stride_(
+                  (num_partitions + common::g_cache_line_size - 1)
+                  / common::g_cache_line_size * common::g_cache_line_size),
+              readers_(workers_per_host * readers_stride_) {
+
+            size_t num_buckets = num_partitions * num_buckets_per_partition;
+
+            states_.reset(new std::atomic<uint8_t>[num_buckets]);
+            for (size_t i = 0; i < num_buckets; ++i)
+                states_[i].store(kEmpty, std::memory_order_relaxed);
+
+            // raw memory, items are constructed when slots are claimed.
+            items_ = static_cast<TableItem*>(
+                operator new (num_buckets * sizeof(TableItem)));
+
+            for (size_t i = 0; i < readers_.size(); ++i)
+                readers_[i].store(0, std::memory_order_relaxed);
+
+            for (size_t id = 0; id < num_partitions; ++id)
+                SetSize(partitions_[id], initial_size);
+        }
+
+        //! non-copyable: delete copy-constructor
+        Shared(const Shared&) = delete;
+        //! non-copyable: delete assignment operator
+        Shared& operator = (const Shared&) = delete;
+
+        ~Shared() {
+            size_t num_buckets = num_partitions_ * num_buckets_per_partition_;
+            for (size_t i = 0; i < num_buckets; ++i) {
+                if (states_[i].load(std::memory_order_relaxed) == kFull)
+                    items_[i].~TableItem();
+            }
+            operator delete (items_);
+        }
+
+        //! Set the number of slots used by a partition and the limits derived
+        //! from it, while holding it exclusively.
+        void SetSize(Partition& part, size_t size) {
+            part.size_ = size;
+            part.limit_items_ = std::max<size_t>(
+                1, static_cast<size_t>(
+                    static_cast<double>(size) * limit_fill_rate_));
+            // the unpublished items of all workers are at most a quarter of
+            // the limit.
+            size_t batch = part.limit_items_ / (4 * workers_per_host_);
+            part.count_batch_ = std::max<size_t>(
+                1, std::min(batch, size_t(kMaxCountBatch)));
+        }
+
+        //! reader flag of a local worker for a partition
+        std::atomic<uint8_t>& reader(size_t local_worker, size_t partition_id) {
+            return readers_[local_worker * readers_stride_ + partition_id];
+        }
+
+        void LockShared(size_t partition_id, size_t local_worker) {
+            Partition& part = partitions_[partition_id];
+            std::atomic<uint8_t>& flag = reader(local_worker, partition_id);
+            for ( ; ; ) {
+                // announce the reader, then check for an exclusive user. Both
+                // are sequentially consistent, such that at least one of the
+                // reader and an exclusive user sees the other.
+                flag.store(1, std::memory_order_seq_cst);
+                if (!part.exclusive_.load(std::memory_order_seq_cst))
+                    return;
+                flag.store(0, std::memory_order_release);
+                while (part.exclusive_.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+            }
+        }
+
+        void UnlockShared(size_t partition_id, size_t local_worker) {
+            reader(local_worker, partition_id).store(
+                0, std::memory_order_release);
+        }
+
+        void LockExclusive(size_t partition_id) {
+            Partition& part = partitions_[partition_id];
+            bool expected = false;
+            while (!part.exclusive_.compare_exchange_weak(
+                       expected, true, std::memory_order_seq_cst)) {
+                expected = false;
+                std::this_thread::yield();
+            }
+            // wait for shared users to leave
+            for (size_t w = 0; w < workers_per_host_; ++w) {
+                while (reader(w, partition_id).load(std::memory_order_seq_cst))
+                    std::this_thread::yield();
+            }
+        }
+
+        void UnlockExclusive(size_t partition_id) {
+            partitions_[partition_id].exclusive_.store(
+                false, std::memory_order_release);
+        }
+
+        //! number of slots available to each partition
+        size_t num_buckets_per_partition_;
+        //! limit on the fill rate of a partition
+        double limit_fill_rate_;
+        //! state bytes of all slots
+        std::unique_ptr<std::atomic<uint8_t>[]> states_;
+        //! raw storage of all slots
+        TableItem* items_;
+        //! shared state of partitions
+        AlignedVector<Partition> partitions_;
+        //! number of partitions
+        size_t num_partitions_;
+        //! number of local workers sharing the table
+        size_t workers_per_host_;
+        //! distance of the reader flags of consecutive local workers
+        size_t readers_stride_;
+        //! reader flags of all local workers for all partitions. Each worker
+        //! only writes its own flags, which start on their own cache line.
+        AlignedVector<std::atomic<uint8_t> > readers_;
+    };
+
+public:
+    using ReduceConfig = ReduceConfig_;
+
+    ReduceConcurrentHashTable(
+        Context& ctx, size_t dia_id,
+        const KeyExtractor& key_extractor,
+        const ReduceFunction& reduce_function,
+        Emitter& emitter,
+        size_t num_partitions,
+        const ReduceConfig& config = ReduceConfig(),
+        bool immediate_flush = false,
+        const IndexFunction& index_function = IndexFunction(),
+        const KeyEqualFunction& key_equal_function = KeyEqualFunction())
+        : Super(ctx, dia_id,
+                key_extractor, reduce_function, emitter,
+                num_partitions, config, immediate_flush,
+                index_function, key_equal_function)
+    { assert(num_partitions > 0); }
+
+    //! Construct the host-wide table collectively on all local workers. Each
+    //! worker contributes its memory limit to the shared table.
+    void Initialize(size_t limit_memory_bytes) {
+        assert(!shared_);
+
+        limit_memory_bytes_ = limit_memory_bytes;
+
+        // the worker's own parameters determine the index function mapping,
+        // which must be the same as with the other tables.
+        num_buckets_per_partition_ = std::max<size_t>(
+            1,
+            (size_t)(static_cast<double>(limit_memory_bytes_)
+                     / static_cast<double>(sizeof(TableItem))
+                     / static_cast<double>(num_partitions_)));
+
+        num_buckets_ = num_buckets_per_partition_ * num_partitions_;
+
+        std::shared_ptr<Shared> shared;
+        if (ctx_.local_worker_id() == 0) {
+            // the state byte is part of the memory used per slot
+            size_t host_buckets_per_partition = std::max<size_t>(
+                1,
+                (size_t)(static_cast<double>(limit_memory_bytes_)
+                         * static_cast<double>(ctx_.workers_per_host())
+                         / static_cast<double>(sizeof(TableItem) + 1)
+                         / static_cast<double>(num_partitions_)));
+
+            shared = std::make_shared<Shared>(
+                num_partitions_, host_buckets_per_partition,
+                std::min(size_t(config_.initial_items_per_partition_),
+                         host_buckets_per_partition),
+                config_.limit_partition_fill_rate(),
+                ctx_.workers_per_host());
+        }
+        shared_ = ctx_.net.LocalBroadcast(shared);
+
+        assert(shared_->num_partitions_ == num_partitions_);
+
+        pending_.resize(num_partitions_);
+    }
+
+    ~ReduceConcurrentHashTable() {
+        if (shared_) Dispose();
+    }
+
+    /*!
+     * Inserts a value into the shared table, potentially reducing it with an
+     * item of the same key. An insert may grow the partition or flush it to the
+     * next phase, if its fill limit is reached.
+     *
+     * \param kv Value to be inserted into the table.
+     *
+     * \return true if a new key was inserted to the table
+     */
+    bool Insert(const TableItem& kv) {
+        return Insert(kv, calculate_index(kv));
+    }
+
+    //! Inserts a value whose index h was already calculated by the caller.
+    bool Insert(const TableItem& kv,
+                const typename IndexFunction::Result& h) {
+        assert(h.partition_id < num_partitions_);
+
+        Partition& part = shared_->partitions_[h.partition_id];
+        size_t local_worker = ctx_.local_worker_id();
+
+        for ( ; ; ) {
+            shared_->LockShared(h.partition_id, local_worker);
+            InsertResult res = InsertShared(kv, h);
+            size_t epoch = part.epoch_, size = part.size_;
+            shared_->UnlockShared(h.partition_id, local_worker);
+
+            if (TLX_LIKELY(res == InsertResult::Reduced))
+                return false;
+
+            if (res == InsertResult::Inserted)
+                return true;
+
+            if (res == InsertResult::ReachedLimit) {
+                // the insert whose published count crossed the limit grows or
+                // flushes
+                GrowOrFlush(h.partition_id, epoch, size);
+                return true;
+            }
+
+            // the partition is completely full: grow or flush, then retry.
+            GrowOrFlush(h.partition_id, epoch, size);
+        }
+    }
+
+    //! Release this worker's reference to the shared table. The shared data is
+    //! deallocated by the last worker.
+    void Dispose() {
+        shared_.reset();
+        Super::Dispose();
+    }
+
+    //! \name Flushing Mechanisms to Next Stage or Phase
+    //! \{
+
+    template <typename Emit>
+    void FlushPartitionEmit(
+        size_t partition_id, bool consume, bool grow, Emit emit) {
+
+        shared_->LockExclusive(partition_id);
+        FlushPartitionExclusive(partition_id, consume, grow, emit);
+        shared_->UnlockExclusive(partition_id);
+    }
+
+    void FlushPartition(size_t partition_id, bool consume, bool grow) {
+        FlushPartitionEmit(
+            partition_id, consume, grow,
+            [this](const size_t& partition_id, const TableItem& p) {
+                this->emitter_.Emit(partition_id, p);
+            });
+    }
+
+    //! Flush all partitions cooperatively: the partitions are split among the
+    //! local workers, which must all call FlushAll() after their last insert.
+    void FlushAll() {
+        // wait for all local workers to finish inserting
+        ctx_.net.LocalBarrier();
+
+        size_t workers_per_host = ctx_.workers_per_host();
+        for (size_t i = ctx_.local_worker_id(); i < num_partitions_;
+             i += workers_per_host) {
+            FlushPartition(i, /* consume */ true, /* grow */ false);
+        }
+
+        // wait for all partitions to be flushed before the table is disposed
+        ctx_.net.LocalBarrier();
+    }
+
+    //! \}
+
+    //! \name Accessors
+    //! \{
+
+    //! Returns the total number of items published to the shared table, which
+    //! excludes fewer than Partition::count_batch_ items per worker and
+    //! partition.
+    size_t num_items() const {
+        size_t total = 0;
+        for (size_t id = 0; id < num_partitions_; ++id) {
+            total += shared_->partitions_[id].items_.load(
+                std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    //! \}
+
+public:
+    using Super::calculate_index;
+
+private:
+    using Super::config_;
+    using Super::ctx_;
+    using Super::immediate_flush_;
+    using Super::key;
+    using Super::key_equal_function_;
+    using Super::limit_memory_bytes_;
+    using Super::num_buckets_;
+    using Super::num_buckets_per_partition_;
+    using Super::num_partitions_;
+    using Super::partition_files_;
+    using Super::reduce;
+
+    //! result of InsertShared()
+    enum class InsertResult {
+        //! reduced into an existing item
+        Reduced,
+        //! inserted into an empty slot
+        Inserted,
+        //! inserted, and the partition reached its fill limit
+        ReachedLimit,
+        //! no empty slot was found
+        Full
+    };
+
+    //! Insert while holding the partition shared.
+    InsertResult InsertShared(const TableItem& kv,
+                              const typename IndexFunction::Result& h) {
+
+        Partition& part = shared_->partitions_[h.partition_id];
+        size_t offset = h.partition_id * shared_->num_buckets_per_partition_;
+
+        std::atomic<uint8_t>* states = shared_->states_.get() + offset;
+        TableItem* items = shared_->items_ + offset;
+
+        size_t size = part.size_;
+        size_t begin_index = h.local_index(size);
+        size_t i = begin_index;
+
+        for ( ; ; ) {
+            uint8_t state = states[i].load(std::memory_order_acquire);
+
+            if (state == kEmpty) {
+                // claim the empty slot
+                if (states[i].compare_exchange_weak(
+                        state, kBusy, std::memory_order_acquire)) {
+                    new (items + i)TableItem(kv);
+                    states[i].store(kFull, std::memory_order_release);
+                    return CountInsert(h.partition_id)
+                           ? InsertResult::ReachedLimit
+                           : InsertResult::Inserted;
+                }
+                // recheck the same slot
+                continue;
+            }
+
+            if (state == kBusy) {
+                // item in the slot is being constructed or reduced
+                continue;
+            }
+
+            // lock the full slot to compare and maybe reduce
+            if (!states[i].compare_exchange_weak(
+                    state, kBusy, std::memory_order_acquire))
+                continue;
+
+            if (key_equal_function_(key(items[i]), key(kv))) {
+                items[i] = reduce(items[i], kv);
+                states[i].store(kFull, std::memory_order_release);
+                return InsertResult::Reduced;
+            }
+
+            states[i].store(kFull, std::memory_order_release);
+
+            if (TLX_UNLIKELY(++i == size))
+                i = 0;
+
+            if (TLX_UNLIKELY(i == begin_index))
+                return InsertResult::Full;
+        }
+    }
+
+    //! Count an insert into a partition in this worker's pending items, and
+    //! publish them in batches, while holding the partition shared. Returns
+    //! true if the published items reached the fill limit.
+    bool CountInsert(size_t partition_id) {
+        Partition& part = shared_->partitions_[partition_id];
+        PendingItems& pending = pending_[partition_id];
+
+        if (pending.epoch != part.epoch_) {
+            // the pending items were flushed with the partition
+            pending.epoch = part.epoch_;
+            pending.items = 0;
+        }
+
+        if (TLX_LIKELY(++pending.items < part.count_batch_))
+            return false;
+
+        size_t items = part.items_.fetch_add(
+            pending.items, std::memory_order_relaxed);
+        size_t new_items = items + pending.items;
+        pending.items = 0;
+
+        // only the publish which crosses the limit grows or flushes
+        return items < part.limit_items_ && new_items >= part.limit_items_;
+    }
+
+    //! Grow the partition, or flush it if it cannot grow, unless another
+    //! worker has already done so since it reached its limit or became full,
+    //! which is detected using the epoch and size seen while inserting.
+    void GrowOrFlush(size_t partition_id, size_t epoch, size_t size) {
+        Partition& part = shared_->partitions_[partition_id];
+        shared_->LockExclusive(partition_id);
+
+        if (part.epoch_ != epoch || part.size_ != size) {
+            shared_->UnlockExclusive(partition_id);
+            return;
+        }
+
+        if (TLX_UNLIKELY(mem::memory_exceeded) ||
+            GrowSize(part.size_) == part.size_) {
+            SpillPartitionExclusive(partition_id);
+        }
+        else {
+            GrowAndRehashExclusive(partition_id);
+        }
+
+        shared_->UnlockExclusive(partition_id);
+    }
+
+    //! Returns the size of a partition after growing it, which is the same size
+    //! if it cannot grow, since in-place rehashing requires a multiple.
+    size_t GrowSize(size_t size) const {
+        size_t new_size = std::min(
+            shared_->num_buckets_per_partition_, 2 * size);
+        return new_size % size == 0 ? new_size : size;
+    }
+
+    //! Double the size of a partition and rehash the items in place, while
+    //! holding it exclusively.
+    void GrowAndRehashExclusive(size_t partition_id) {
+        Partition& part = shared_->partitions_[partition_id];
+        size_t offset = partition_id * shared_->num_buckets_per_partition_;
+
+        std::atomic<uint8_t>* states = shared_->states_.get() + offset;
+        TableItem* items = shared_->items_ + offset;
+
+        size_t old_size = part.size_;
+        size_t new_size = GrowSize(old_size);
+
+        sLOG << "Growing shared partition" << partition_id
+             << "from" << old_size << "to" << new_size;
+
+        shared_->SetSize(part, new_size);
+
+        // reinsert items until passing the old range and finding a hole, as in
+        // ReduceProbingHashTable::GrowAndRehash().
+        size_t i = 0;
+        bool passed_first_half = false, found_hole = false;
+        while (!passed_first_half || !found_hole) {
+            bool is_empty =
+                states[i].load(std::memory_order_relaxed) == kEmpty;
+            if (!is_empty) {
+                TableItem item = std::move(items[i]);
+                items[i].~TableItem();
+                states[i].store(kEmpty, std::memory_order_relaxed);
+
+                size_t j = calculate_index(item).local_index(new_size);
+                while (states[j].load(std::memory_order_relaxed) != kEmpty) {
+                    if (++j == new_size) j = 0;
+                }
+                new (items + j)TableItem(std::move(item));
+                states[j].store(kFull, std::memory_order_relaxed);
+            }
+
+            ++i;
+            found_hole = passed_first_half && is_empty;
+            passed_first_half = passed_first_half || i == old_size;
+            if (i == new_size) break;
+        }
+    }
+
+    //! Flush or spill all items of a partition, while holding it exclusively.
+    void SpillPartitionExclusive(size_t partition_id) {
+        if (immediate_flush_) {
+            FlushPartitionExclusive(
+                partition_id, /* consume */ true,
+                /* grow */ !mem::memory_exceeded,
+                [this](const size_t& partition_id, const TableItem& p) {
+                    this->emitter_.Emit(partition_id, p);
+                });
+            return;
+        }
+
+        // spill into this worker's File of the partition
+        data::File::Writer writer = partition_files_[partition_id].GetWriter();
+        FlushPartitionExclusive(
+            partition_id, /* consume */ true, /* grow */ false,
+            [&writer](const size_t&, const TableItem& p) { writer.Put(p); });
+    }
+
+    template <typename Emit>
+    void FlushPartitionExclusive(
+        size_t partition_id, bool consume, bool grow, Emit emit) {
+
+        Partition& part = shared_->partitions_[partition_id];
+        size_t offset = partition_id * shared_->num_buckets_per_partition_;
+
+        std::atomic<uint8_t>* states = shared_->states_.get() + offset;
+        TableItem* items = shared_->items_ + offset;
+
+        LOG << "Flushing " << part.items_ << " items of shared partition: "
+            << partition_id;
+
+        for (size_t i = 0; i < part.size_; ++i) {
+            if (states[i].load(std::memory_order_relaxed) != kFull)
+                continue;
+
+            emit(partition_id, items[i]);
+
+            if (consume) {
+                items[i].~TableItem();
+                states[i].store(kEmpty, std::memory_order_relaxed);
+            }
+        }
+
+        if (consume) {
+            part.items_.store(0, std::memory_order_relaxed);
+            // drop the workers' pending items
+            ++part.epoch_;
+        }
+
+        if (consume && grow && !mem::memory_exceeded) {
+            // grow the empty partition
+            shared_->SetSize(part, GrowSize(part.size_));
+        }
+    }
+
+    //! host-wide shared table data
+    std::shared_ptr<Shared> shared_;
+
+    //! this worker's unpublished items of each partition
+    std::vector<PendingItems> pending_;
+};
+
+template <typename TableItem, typename Key, typename Value,
+          typename KeyExtractor, typename ReduceFunction,
+          typename Emitter, const bool VolatileKey,
+          typename ReduceConfig, typename IndexFunction,
+          typename KeyEqualFunction>
+class ReduceTableSelect<
+        ReduceTableImpl::CONCURRENT,
+        TableItem, Key, Value, KeyExtractor, ReduceFunction,
+        Emitter, VolatileKey, ReduceConfig, IndexFunction, KeyEqualFunction>
+{
+public:
+    using type = ReduceConcurrentHashTable<
+        TableItem, Key, Value, KeyExtractor, ReduceFunction,
+        Emitter, VolatileKey, ReduceConfig,
+        IndexFunction, KeyEqualFunction>;
+};
+
+} // namespace core
+} // namespace thrill
+
+#endif // !THRILL_CORE_REDUCE_CONCURRENT_HASH_TABLE_HEADER
+
+/******************************************************************************/
@@ -42,6 +42,13 @@ public:
         size_t local_index(size_t size) const {
             return remaining_hash % size;
         }
+
+        //! 7-bit fingerprint of the hash, mostly independent of the low bits
+        //! used by local_index().
+        uint8_t fingerprint() const {
+            return static_cast<uint8_t>(
+                (remaining_hash * 0x9E3779B97F4A7C15ull) >> 57);
+        }
     };
 
     explicit ReduceByHash(
@@ -98,6 +105,12 @@ public:
             return global_index % num_buckets_per_partition
                    * size / num_buckets_per_partition;
         }
+
+        //! 7-bit fingerprint of the index, which distinguishes indexes mapped
+        //! to the same slot of a smaller table.
+        uint8_t fingerprint() const {
+            return static_cast<uint8_t>(global_index & 0x7F);
+        }
     };
 
     explicit ReduceByIndex(const common::Range& range)
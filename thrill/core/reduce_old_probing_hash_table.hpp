@@ -169,12 +169,16 @@ public:
          * \return true if a new key was inserted to the table
      */
     bool Insert(const TableItem& kv) {
+        return Insert(kv, calculate_index(kv));
+    }
+
+    //! Inserts a value whose index h was already calculated by the caller.
+    bool Insert(const TableItem& kv,
+                const typename IndexFunction::Result& h) {
 
         while (TLX_UNLIKELY(mem::memory_exceeded && num_items_ != 0))
             SpillAnyPartition();
 
-        typename IndexFunction::Result h = calculate_index(kv);
-
         assert(h.partition_id < num_partitions_);
 
         if (key_equal_function_(key(kv), Key())) {
@@ -17,21 +17,29 @@
 #define THRILL_CORE_REDUCE_PRE_PHASE_HEADER
 
 #include <thrill/common/defines.hpp>
+#include <thrill/common/functional.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/common/math.hpp>
+#include <thrill/core/count_min_sketch.hpp>
 #include <thrill/core/duplicate_detection.hpp>
 #include <thrill/core/reduce_bucket_hash_table.hpp>
+#include <thrill/core/reduce_concurrent_hash_table.hpp>
 #include <thrill/core/reduce_functional.hpp>
 #include <thrill/core/reduce_old_probing_hash_table.hpp>
 #include <thrill/core/reduce_probing_hash_table.hpp>
+#include <thrill/core/reduce_swiss_hash_table.hpp>
 #include <thrill/data/block_reader.hpp>
 #include <thrill/data/block_writer.hpp>
 #include <thrill/data/file.hpp>
 
+#include <tlx/vector_free.hpp>
+
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -122,10 +130,28 @@ public:
         KeyExtractor, ReduceFunction, Emitter,
         VolatileKey, ReduceConfig, IndexFunction, KeyEqualFunction>::type;
 
+    //! minimum number of items seen before keys are considered heavy
+    static constexpr size_t heavy_min_items_ = 4096;
+
+    //! maximum number of heavy keys reduced aside from the table
+    static constexpr size_t heavy_max_keys_ = 32;
+
     /*!
      * A data structure which takes an arbitrary value and extracts a key using
      * a key extractor function from that value. Afterwards, the value is hashed
      * based on the key into some slot.
+     *
+     * If config.heavy_hitter_fraction() is positive, key hashes are counted in
+     * a Count-Min sketch. Keys whose estimated count exceeds the fraction of
+     * the local items are heavy hitter candidates: they are reduced in a small
+     * list aside from the table. In FlushAll() the candidates of all workers
+     * are checked against the fraction of all items, and the partial
+     * aggregates of the global heavy hitters are combined collectively before
+     * they are emitted, see FlushHeavy().
+     *
+     * The emitters deliver partition i to the worker with global rank
+     * first_worker + i. Hence the workers form groups of num_partitions, each
+     * partitioning among itself, e.g. the hosts in a host-level pre phase.
      */
     ReducePrePhase(Context& ctx, size_t dia_id,
                    size_t num_partitions,
@@ -136,19 +162,24 @@ public:
                    const IndexFunction& index_function = IndexFunction(),
                    const KeyEqualFunction& key_equal_function = KeyEqualFunction(),
                    const HashFunction hash_function = HashFunction(),
-                   bool duplicates = false)
+                   bool duplicates = false,
+                   size_t first_worker = 0)
         : emit_(emit),
           key_extractor_(key_extractor),
           table_(ctx, dia_id,
                  key_extractor, reduce_function, emit_,
                  num_partitions, config, !duplicates,
-                 index_function, key_equal_function) {
-
-        tlx::unused(hash_function);
+                 index_function, key_equal_function),
+          key_hash_function_(hash_function),
+          heavy_fraction_(duplicates ? 0.0 : config.heavy_hitter_fraction()),
+          first_worker_(first_worker) {
 
         sLOG << "creating ReducePrePhase with" << emit.size() << "output emitters";
 
         assert(num_partitions == emit.size());
+
+        if (heavy_fraction_ > 0)
+            sketch_ = std::make_unique<CountMinSketch>();
     }
 
     //! non-copyable: delete copy-constructor
@@ -166,7 +197,14 @@ public:
 
     bool Insert(const Value& v) {
         // for VolatileKey this makes std::pair and extracts the key
-        return table_.Insert(MakeTableItem::Make(v, table_.key_extractor()));
+        return InsertItem(MakeTableItem::Make(v, table_.key_extractor()));
+    }
+
+    //! Insert a TableItem emitted by another pre-phase, without extracting the
+    //! key again.
+    bool InsertItem(const TableItem& t) {
+        if (sketch_ && InsertHeavy(t)) return false;
+        return table_.Insert(t);
     }
 
     void InsertSkip(const Value& v) {
@@ -177,9 +215,11 @@ public:
 
     //! Flush all partitions
     void FlushAll() {
-        for (size_t id = 0; id < table_.num_partitions(); ++id) {
-            FlushPartition(id, /* consume */ true, /* grow */ false);
-        }
+        // emit the heavy hitters, which were reduced aside from the table
+        if (sketch_) FlushHeavy();
+
+        // data is flushed immediately, there is no spilled data
+        table_.FlushAll();
     }
 
     //! Flushes a partition
@@ -215,6 +255,173 @@ protected:
 
     //! the first-level hash table implementation
     Table table_;
+
+    //! \name Heavy Hitters
+    //! \{
+
+    //! hash function of keys, used for the Count-Min sketch
+    HashFunction key_hash_function_;
+
+    //! fraction of items above which a key is heavy, zero disables detection
+    double heavy_fraction_;
+
+    //! global rank of the worker receiving partition 0 from this worker
+    size_t first_worker_;
+
+    //! sketch counting key hashes
+    std::unique_ptr<CountMinSketch> sketch_;
+
+    //! items of the heavy keys reduced so far
+    std::vector<TableItem> heavy_items_;
+
+    //! hashes of the heavy keys and the index of their item, sorted by hash
+    std::vector<std::pair<size_t, size_t> > heavy_index_;
+
+    //! number of items reduced into heavy_items_
+    size_t heavy_count_ = 0;
+
+    //! Reduce t into the heavy hitters if its key is already one, or becomes
+    //! one. Returns false if t must be inserted into the table.
+    bool InsertHeavy(const TableItem& t) {
+        Key key = table_.key(t);
+        size_t hash = key_hash_function_(key);
+
+        // binary search among the heavy keys with this hash
+        std::vector<std::pair<size_t, size_t> >::iterator it =
+            std::lower_bound(heavy_index_.begin(), heavy_index_.end(),
+                             std::make_pair(hash, size_t(0)));
+        for ( ; it != heavy_index_.end() && it->first == hash; ++it) {
+            TableItem& h = heavy_items_[it->second];
+            if (!table_.key_equal_function()(table_.key(h), key))
+                continue;
+            h = table_.reduce(h, t);
+            ++heavy_count_;
+            return true;
+        }
+
+        uint32_t count = sketch_->Add(hash);
+        if (sketch_->total() < heavy_min_items_ ||
+            heavy_items_.size() >= heavy_max_keys_ ||
+            count <= heavy_fraction_ * static_cast<double>(sketch_->total()))
+            return false;
+
+        // the key may already have items in the table, they are combined with
+        // the heavy item in the post-phase.
+        heavy_index_.emplace(it, hash, heavy_items_.size());
+        heavy_items_.push_back(t);
+        ++heavy_count_;
+        return true;
+    }
+
+    /*!
+     * Collect the heavy hitter candidates of all workers, sum their estimated
+     * counts, and keep those which are heavy globally. A key with more than
+     * heavy_fraction_ of all items is a candidate on at least one worker, since
+     * the sketches never underestimate. The partial aggregates of the global
+     * heavy hitters are combined along the reduction tree of an AllReduce,
+     * which spreads the work over all workers instead of sending every partial
+     * aggregate to the worker owning the key. Each combined item is then
+     * emitted by one worker only, and meets the remaining items of its key from
+     * the tables in the post-phase. Candidates which are heavy only locally
+     * are emitted directly.
+     */
+    void FlushHeavy() {
+        using VectorSizeT = std::vector<size_t>;
+        Context& ctx = table_.ctx();
+
+        VectorSizeT candidates;
+        for (const std::pair<size_t, size_t>& h : heavy_index_) {
+            if (candidates.empty() || candidates.back() != h.first)
+                candidates.push_back(h.first);
+        }
+        candidates = ctx.net.AllReduce(
+            candidates,
+            [](const VectorSizeT& a, const VectorSizeT& b) {
+                VectorSizeT c;
+                std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                               std::back_inserter(c));
+                return c;
+            });
+
+        // estimated counts of the candidates, followed by the number of items
+        VectorSizeT counts(candidates.size() + 1);
+        for (size_t i = 0; i < candidates.size(); ++i)
+            counts[i] = sketch_->Estimate(candidates[i]);
+        counts.back() = sketch_->total();
+        sketch_.reset();
+
+        if (!candidates.empty()) {
+            counts = ctx.net.AllReduce(
+                counts, common::ComponentSum<VectorSizeT>());
+        }
+
+        double threshold =
+            heavy_fraction_ * static_cast<double>(counts.back());
+
+        // partial aggregates of the global heavy hitters
+        std::vector<TableItem> heavy;
+        size_t num_heavy = 0;
+        for (size_t i = 0; i < candidates.size(); ++i)
+            num_heavy += counts[i] > threshold;
+
+        for (const std::pair<size_t, size_t>& h : heavy_index_) {
+            size_t c = std::lower_bound(candidates.begin(), candidates.end(),
+                                        h.first) - candidates.begin();
+            TableItem& t = heavy_items_[h.second];
+            if (counts[c] > threshold)
+                heavy.emplace_back(std::move(t));
+            else
+                emit_.Emit(table_.calculate_index(t).partition_id, t);
+        }
+
+        sLOG << "ReducePrePhase::FlushHeavy() candidates" << candidates.size()
+             << "global_heavy_keys" << num_heavy
+             << "local_heavy_items" << heavy_count_
+             << "of" << counts.back();
+
+        tlx::vector_free(heavy_items_);
+        tlx::vector_free(heavy_index_);
+
+        if (num_heavy == 0) return;
+
+        heavy = ctx.net.AllReduce(
+            heavy,
+            [this](const std::vector<TableItem>& a,
+                   const std::vector<TableItem>& b) {
+                std::vector<TableItem> c = a;
+                for (const TableItem& t : b) {
+                    auto it = std::find_if(
+                        c.begin(), c.end(),
+                        [this, &t](const TableItem& u) {
+                            return table_.key_equal_function()(
+                                table_.key(u), table_.key(t));
+                        });
+                    if (it != c.end())
+                        *it = table_.reduce(*it, t);
+                    else
+                        c.push_back(t);
+                }
+                return c;
+            });
+
+        // the combined item is emitted by the worker which receives its
+        // partition from itself, in the group of workers selected by the key's
+        // hash. Thus it is emitted once, and not sent over the network.
+        size_t num_partitions = emit_.writer_.size();
+        assert(ctx.num_workers() % num_partitions == 0);
+        assert(first_worker_ % num_partitions == 0);
+        size_t num_groups = ctx.num_workers() / num_partitions;
+        size_t group = first_worker_ / num_partitions;
+
+        for (const TableItem& t : heavy) {
+            size_t partition_id = table_.calculate_index(t).partition_id;
+            if (first_worker_ + partition_id == ctx.my_rank() &&
+                key_hash_function_(table_.key(t)) % num_groups == group)
+                emit_.Emit(partition_id, t);
+        }
+    }
+
+    //! \}
 };
 
 template <typename TableItem, typename Key, typename Value,
@@ -254,6 +461,10 @@ public:
                                  false>;
     using KeyValuePair = std::pair<Key, Value>;
 
+    static_assert(ReduceConfig::table_impl_ != ReduceTableImpl::CONCURRENT,
+                  "Duplicate detection requires a table local to each worker, "
+                  "since items of non-duplicate keys are sent to itself.");
+
     ReducePrePhase(Context& ctx, size_t dia_id,
                    size_t num_partitions,
                    KeyExtractor key_extractor,
@@ -188,8 +188,12 @@ public:
      * \return true if a new key was inserted to the table
      */
     bool Insert(const TableItem& kv) {
+        return Insert(kv, calculate_index(kv));
+    }
 
-        typename IndexFunction::Result h = calculate_index(kv);
+    //! Inserts a value whose index h was already calculated by the caller.
+    bool Insert(const TableItem& kv,
+                const typename IndexFunction::Result& h) {
         assert(h.partition_id < num_partitions_);
 
         if (TLX_UNLIKELY(key_equal_function_(key(kv), Key()))) {
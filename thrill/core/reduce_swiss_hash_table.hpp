@@ -0,0 +1,543 @@
+/*******************************************************************************
+ * thrill/core/reduce_swiss_hash_table.hpp
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_CORE_REDUCE_SWISS_HASH_TABLE_HEADER
+#define THRILL_CORE_REDUCE_SWISS_HASH_TABLE_HEADER
+
+#include <thrill/common/config.hpp>
+#include <thrill/core/reduce_functional.hpp>
+#include <thrill/core/reduce_table.hpp>
+
+#include <tlx/math/ffs.hpp>
+#include <tlx/vector_free.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(THRILL_HAVE_AVX2)
+#include <immintrin.h>
+#elif defined(THRILL_HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace thrill {
+namespace core {
+
+/*!
+ * A linear probing hash table with the same partitioning and growing scheme as
+ * the ReduceProbingHashTable, but with a Swiss table style layout: besides the
+ * array of items, a separate array of control bytes contains a 7-bit
+ * fingerprint of the hash of each item, or a marker for empty slots.
+ *
+ * Insert() probes groups of control bytes with SSE2 (16 bytes) or AVX2 (32
+ * bytes) compares, and only compares the full keys of items with a matching
+ * fingerprint. This avoids touching items during long probe sequences, which
+ * saves cache misses for large items such as string keys, and for tables
+ * filled up to the limit_partition_fill_rate_.
+ *
+ * Since emptiness is stored in the control bytes, the default-constructed key
+ * Key() is not reserved as sentinel.
+ */
+template <typename TableItem, typename Key, typename Value,
+          typename KeyExtractor, typename ReduceFunction, typename Emitter,
+          const bool VolatileKey,
+          typename ReduceConfig_,
+          typename IndexFunction,
+          typename KeyEqualFunction = std::equal_to<Key> >
+class ReduceSwissHashTable
+    : public ReduceTable<TableItem, Key, Value,
+                         KeyExtractor, ReduceFunction, Emitter,
+                         VolatileKey, ReduceConfig_,
+                         IndexFunction, KeyEqualFunction>
+{
+    using Super = ReduceTable<TableItem, Key, Value,
+                              KeyExtractor, ReduceFunction, Emitter,
+                              VolatileKey, ReduceConfig_, IndexFunction,
+                              KeyEqualFunction>;
+    using Super::debug;
+
+    //! control byte of an empty slot, fingerprints have the high bit cleared.
+    static constexpr uint8_t kEmpty = 0x80;
+
+    //! number of control bytes probed at once
+#if defined(THRILL_HAVE_AVX2)
+    static constexpr size_t kGroupSize = 32;
+#elif defined(THRILL_HAVE_SSE2)
+    static constexpr size_t kGroupSize = 16;
+#else
+    static constexpr size_t kGroupSize = 8;
+#endif
+
+    //! bit masks of slots in a group of control bytes
+    struct GroupMatch {
+        //! slots with matching fingerprint
+        uint32_t match;
+        //! empty slots
+        uint32_t empty;
+    };
+
+public:
+    using ReduceConfig = ReduceConfig_;
+
+    ReduceSwissHashTable(
+        Context& ctx, size_t dia_id,
+        const KeyExtractor& key_extractor,
+        const ReduceFunction& reduce_function,
+        Emitter& emitter,
+        size_t num_partitions,
+        const ReduceConfig& config = ReduceConfig(),
+        bool immediate_flush = false,
+        const IndexFunction& index_function = IndexFunction(),
+        const KeyEqualFunction& key_equal_function = KeyEqualFunction())
+        : Super(ctx, dia_id,
+                key_extractor, reduce_function, emitter,
+                num_partitions, config, immediate_flush,
+                index_function, key_equal_function)
+    { assert(num_partitions > 0); }
+
+    //! Construct the hash table itself: allocate the items and the control
+    //! bytes, which are padded by a group for loads beyond the last partition.
+    void Initialize(size_t limit_memory_bytes) {
+        assert(!items_);
+
+        limit_memory_bytes_ = limit_memory_bytes;
+
+        // calculate num_buckets_per_partition_ from the memory limit and the
+        // number of partitions required, each slot needs an item and a
+        // control byte.
+
+        num_buckets_per_partition_ = std::max<size_t>(
+            1,
+            (size_t)(static_cast<double>(limit_memory_bytes_)
+                     / static_cast<double>(sizeof(TableItem) + 1)
+                     / static_cast<double>(num_partitions_)));
+
+        num_buckets_ = num_buckets_per_partition_ * num_partitions_;
+
+        assert(num_buckets_per_partition_ > 0);
+        assert(num_buckets_ > 0);
+
+        partition_size_.resize(
+            num_partitions_,
+            std::min(size_t(config_.initial_items_per_partition_),
+                     num_buckets_per_partition_));
+
+        double limit_fill_rate = config_.limit_partition_fill_rate();
+
+        assert(limit_fill_rate >= 0.0 && limit_fill_rate <= 1.0
+               && "limit_partition_fill_rate must be between 0.0 and 1.0. "
+               "with a fill rate of 0.0, items are immediately flushed.");
+
+        limit_items_per_partition_.resize(
+            num_partitions_,
+            static_cast<size_t>(
+                static_cast<double>(partition_size_[0]) * limit_fill_rate));
+
+        ctrl_.resize(num_buckets_ + kGroupSize, uint8_t(kEmpty));
+
+        // items are constructed when inserted into empty slots
+        items_ = static_cast<TableItem*>(
+            operator new (num_buckets_ * sizeof(TableItem)));
+    }
+
+    ~ReduceSwissHashTable() {
+        if (items_) Dispose();
+    }
+
+    /*!
+     * Inserts a value into the table, potentially reducing it in case both the
+     * key of the value already in the table and the key of the value to be
+     * inserted are the same.
+     *
+     * An insert may trigger a resize of the partition or a spill, like in the
+     * ReduceProbingHashTable.
+     *
+     * \param kv Value to be inserted into the table.
+     *
+     * \return true if a new key was inserted to the table
+     */
+    bool Insert(const TableItem& kv) {
+        return Insert(kv, calculate_index(kv));
+    }
+
+    //! Inserts a value whose index h was already calculated by the caller.
+    bool Insert(const TableItem& kv,
+                const typename IndexFunction::Result& h) {
+        assert(h.partition_id < num_partitions_);
+
+        const uint8_t fingerprint = h.fingerprint();
+        const size_t size = partition_size_[h.partition_id];
+
+        uint8_t* ctrl = ctrl_.data()
+                        + h.partition_id * num_buckets_per_partition_;
+        TableItem* items = items_
+                           + h.partition_id * num_buckets_per_partition_;
+
+        size_t i = h.local_index(size);
+
+        for (size_t probed = 0; probed < size; ) {
+            // the group may extend beyond the partition's current size
+            size_t width = size - i;
+            if (width > kGroupSize) width = kGroupSize;
+            uint32_t valid = width == 32 ? ~uint32_t(0)
+                             : (uint32_t(1) << width) - 1;
+
+            GroupMatch g = MatchGroup(ctrl + i, fingerprint);
+            g.match &= valid, g.empty &= valid;
+
+            // only slots before the first empty one are on the probe sequence
+            uint32_t probe = g.empty ? (g.empty & (~g.empty + 1)) - 1 : valid;
+
+            for (uint32_t m = g.match & probe; m != 0; m &= m - 1) {
+                TableItem& item = items[i + tlx::ffs(m) - 1];
+                if (key_equal_function_(key(item), key(kv))) {
+                    item = reduce(item, kv);
+                    return false;
+                }
+            }
+
+            if (g.empty) {
+                size_t j = i + tlx::ffs(g.empty) - 1;
+
+                // insert new pair
+                new (items + j)TableItem(kv);
+                ctrl[j] = fingerprint;
+
+                // increase counter for partition
+                ++items_per_partition_[h.partition_id];
+                ++num_items_;
+
+                while (TLX_UNLIKELY(
+                           items_per_partition_[h.partition_id] >=
+                           limit_items_per_partition_[h.partition_id])) {
+                    LOG << "Grow due to "
+                        << items_per_partition_[h.partition_id] << " >= "
+                        << limit_items_per_partition_[h.partition_id]
+                        << " among " << partition_size_[h.partition_id];
+                    GrowAndRehash(h.partition_id);
+                }
+
+                return true;
+            }
+
+            probed += width;
+            i += width;
+
+            // wrap around if beyond the current partition
+            if (i == size) i = 0;
+        }
+
+        // flush partition and retry, if all slots are reserved
+        GrowAndRehash(h.partition_id);
+        return Insert(kv);
+    }
+
+    //! Deallocate items and memory
+    void Dispose() {
+        if (!items_) return;
+
+        // dispose the items by destructor
+
+        for (size_t id = 0; id < num_partitions_; ++id) {
+            size_t offset = id * num_buckets_per_partition_;
+            for (size_t i = 0; i < partition_size_[id]; ++i) {
+                if (ctrl_[offset + i] != kEmpty)
+                    items_[offset + i].~TableItem();
+            }
+        }
+
+        operator delete (items_);
+        items_ = nullptr;
+        tlx::vector_free(ctrl_);
+
+        Super::Dispose();
+    }
+
+    void GrowAndRehash(size_t partition_id) {
+
+        size_t old_size = partition_size_[partition_id];
+        GrowPartition(partition_id);
+        if (partition_size_[partition_id] == old_size) {
+            SpillPartition(partition_id);
+            return;
+        }
+
+        if (partition_size_[partition_id] % old_size != 0) {
+            // in place rehashing won't work properly so we spill rather than
+            // potentially blasting memory limits by using an extra vector for
+            // temporary item storage
+            SpillPartition(partition_id);
+            return;
+        }
+
+        // initialize pointers to old range - the second half is still empty
+        size_t offset = partition_id * num_buckets_per_partition_;
+        uint8_t* ctrl = ctrl_.data() + offset;
+        TableItem* items = items_ + offset;
+
+        size_t i = 0;
+        bool passed_first_half = false;
+        bool found_hole = false;
+        while (!passed_first_half || !found_hole) {
+            bool is_empty = (ctrl[i] == kEmpty);
+            if (!is_empty) {
+                --items_per_partition_[partition_id];
+                --num_items_;
+                TableItem item = std::move(items[i]);
+                items[i].~TableItem();
+                ctrl[i] = kEmpty;
+                Insert(item);
+            }
+
+            i++;
+            found_hole = passed_first_half && is_empty;
+            passed_first_half = passed_first_half || i == old_size;
+        }
+    }
+
+    //! Grow a partition after a spill or flush (if possible)
+    void GrowPartition(size_t partition_id) {
+
+        if (TLX_UNLIKELY(mem::memory_exceeded)) {
+            SpillPartition(partition_id);
+            return;
+        }
+
+        if (partition_size_[partition_id] == num_buckets_per_partition_)
+            return;
+
+        size_t new_size = std::min(
+            num_buckets_per_partition_, 2 * partition_size_[partition_id]);
+
+        sLOG << "Growing partition" << partition_id
+             << "from" << partition_size_[partition_id] << "to" << new_size
+             << "limit_items" << new_size * config_.limit_partition_fill_rate();
+
+        // control bytes of the new range are still empty
+        partition_size_[partition_id] = new_size;
+        limit_items_per_partition_[partition_id]
+            = new_size * config_.limit_partition_fill_rate();
+    }
+
+    //! \name Spilling Mechanisms to External Memory Files
+    //! \{
+
+    //! Spill all items of a partition into an external memory File.
+    void SpillPartition(size_t partition_id) {
+
+        if (immediate_flush_) {
+            return FlushPartition(
+                partition_id, /* consume */ true, /* grow */ !mem::memory_exceeded);
+        }
+
+        LOG << "Spilling " << items_per_partition_[partition_id]
+            << " items of partition with id: " << partition_id;
+
+        if (items_per_partition_[partition_id] == 0)
+            return;
+
+        data::File::Writer writer = partition_files_[partition_id].GetWriter();
+
+        size_t offset = partition_id * num_buckets_per_partition_;
+        uint8_t* ctrl = ctrl_.data() + offset;
+        TableItem* items = items_ + offset;
+
+        for (size_t i = 0; i < partition_size_[partition_id]; ++i) {
+            if (ctrl[i] != kEmpty) {
+                writer.Put(items[i]);
+                items[i].~TableItem();
+                ctrl[i] = kEmpty;
+            }
+        }
+
+        // reset partition specific counter
+        num_items_ -= items_per_partition_[partition_id];
+        items_per_partition_[partition_id] = 0;
+        assert(num_items_ == this->num_items_calc());
+
+        LOG << "Spilled items of partition with id: " << partition_id;
+    }
+
+    //! Spill all items of an arbitrary partition into an external memory File.
+    void SpillAnyPartition() {
+        // maybe make a policy later -tb
+        return SpillLargestPartition();
+    }
+
+    //! Spill all items of the largest partition into an external memory File.
+    void SpillLargestPartition() {
+        // get partition with max size
+        size_t size_max = 0, index = 0;
+
+        for (size_t i = 0; i < num_partitions_; ++i)
+        {
+            if (items_per_partition_[i] > size_max)
+            {
+                size_max = items_per_partition_[i];
+                index = i;
+            }
+        }
+
+        if (size_max == 0) {
+            return;
+        }
+
+        return SpillPartition(index);
+    }
+
+    //! \}
+
+    //! \name Flushing Mechanisms to Next Stage or Phase
+    //! \{
+
+    template <typename Emit>
+    void FlushPartitionEmit(
+        size_t partition_id, bool consume, bool grow, Emit emit) {
+
+        LOG << "Flushing " << items_per_partition_[partition_id]
+            << " items of partition: " << partition_id;
+
+        size_t offset = partition_id * num_buckets_per_partition_;
+        uint8_t* ctrl = ctrl_.data() + offset;
+        TableItem* items = items_ + offset;
+
+        for (size_t i = 0; i < partition_size_[partition_id]; ++i)
+        {
+            if (ctrl[i] != kEmpty) {
+                emit(partition_id, items[i]);
+
+                if (consume) {
+                    items[i].~TableItem();
+                    ctrl[i] = kEmpty;
+                }
+            }
+        }
+
+        if (consume) {
+            // reset partition specific counter
+            num_items_ -= items_per_partition_[partition_id];
+            items_per_partition_[partition_id] = 0;
+            assert(num_items_ == this->num_items_calc());
+        }
+
+        LOG << "Done flushed items of partition: " << partition_id;
+
+        if (grow)
+            GrowPartition(partition_id);
+    }
+
+    void FlushPartition(size_t partition_id, bool consume, bool grow) {
+        FlushPartitionEmit(
+            partition_id, consume, grow,
+            [this](const size_t& partition_id, const TableItem& p) {
+                this->emitter_.Emit(partition_id, p);
+            });
+    }
+
+    void FlushAll() {
+        for (size_t i = 0; i < num_partitions_; ++i) {
+            FlushPartition(i, /* consume */ true, /* grow */ false);
+        }
+    }
+
+    //! \}
+
+public:
+    using Super::calculate_index;
+
+private:
+    using Super::config_;
+    using Super::immediate_flush_;
+    using Super::index_function_;
+    using Super::items_per_partition_;
+    using Super::key;
+    using Super::key_equal_function_;
+    using Super::limit_memory_bytes_;
+    using Super::num_buckets_;
+    using Super::num_buckets_per_partition_;
+    using Super::num_items_;
+    using Super::num_partitions_;
+    using Super::partition_files_;
+    using Super::reduce;
+
+    //! Compare kGroupSize control bytes starting at ctrl with the fingerprint,
+    //! and find empty slots.
+    static GroupMatch MatchGroup(const uint8_t* ctrl, uint8_t fingerprint) {
+#if defined(THRILL_HAVE_AVX2)
+        __m256i group = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(ctrl));
+        __m256i match = _mm256_cmpeq_epi8(
+            group, _mm256_set1_epi8(static_cast<char>(fingerprint)));
+        return GroupMatch {
+                   static_cast<uint32_t>(_mm256_movemask_epi8(match)),
+                   // the high bit is only set in kEmpty
+                   static_cast<uint32_t>(_mm256_movemask_epi8(group))
+        };
+#elif defined(THRILL_HAVE_SSE2)
+        __m128i group = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(ctrl));
+        __m128i match = _mm_cmpeq_epi8(
+            group, _mm_set1_epi8(static_cast<char>(fingerprint)));
+        return GroupMatch {
+                   static_cast<uint32_t>(_mm_movemask_epi8(match)),
+                   // the high bit is only set in kEmpty
+                   static_cast<uint32_t>(_mm_movemask_epi8(group))
+        };
+#else
+        GroupMatch g { 0, 0 };
+        for (size_t i = 0; i < kGroupSize; ++i) {
+            g.match |= uint32_t(ctrl[i] == fingerprint) << i;
+            g.empty |= uint32_t(ctrl[i] == kEmpty) << i;
+        }
+        return g;
+#endif
+    }
+
+    //! Storing the actual hash table items.
+    TableItem* items_ = nullptr;
+
+    //! Control bytes: fingerprint of the item in a slot or kEmpty.
+    std::vector<uint8_t> ctrl_;
+
+    //! Current sizes of the partitions because the valid allocated areas grow
+    std::vector<size_t> partition_size_;
+
+    //! Current limits on the number of items in a partitions, different for
+    //! different partitions, because the valid allocated areas grow.
+    std::vector<size_t> limit_items_per_partition_;
+};
+
+template <typename TableItem, typename Key, typename Value,
+          typename KeyExtractor, typename ReduceFunction,
+          typename Emitter, const bool VolatileKey,
+          typename ReduceConfig, typename IndexFunction,
+          typename KeyEqualFunction>
+class ReduceTableSelect<
+        ReduceTableImpl::SWISS,
+        TableItem, Key, Value, KeyExtractor, ReduceFunction,
+        Emitter, VolatileKey, ReduceConfig, IndexFunction, KeyEqualFunction>
+{
+public:
+    using type = ReduceSwissHashTable<
+        TableItem, Key, Value, KeyExtractor, ReduceFunction,
+        Emitter, VolatileKey, ReduceConfig,
+        IndexFunction, KeyEqualFunction>;
+};
+
+} // namespace core
+} // namespace thrill
+
+#endif // !THRILL_CORE_REDUCE_SWISS_HASH_TABLE_HEADER
+
+/******************************************************************************/
@@ -27,11 +27,19 @@
 namespace thrill {
 namespace core {
 
-//! Enum class to select a hash table implementation.
+//! Enum class to select a hash table implementation. CONCURRENT selects a
+//! table shared by all workers on a host in the pre-phase, and PROBING in the
+//! post-phase.
 enum class ReduceTableImpl {
-    PROBING, OLD_PROBING, BUCKET
+    PROBING, OLD_PROBING, BUCKET, CONCURRENT, SWISS
 };
 
+//! Returns the hash table implementation used in post-phases, which are local
+//! to each worker.
+static constexpr ReduceTableImpl ReducePostTableImpl(ReduceTableImpl impl) {
+    return impl == ReduceTableImpl::CONCURRENT ? ReduceTableImpl::PROBING : impl;
+}
+
 /*!
  * Configuration class to define operational parameters of reduce hash tables
  * and reduce phases. Most members can be defined static constexpr or be mutable
@@ -48,6 +56,12 @@ public:
     //! relative to the maximum possible number.
     double bucket_rate_ = 0.6;
 
+    //! only for pre-phases: keys occurring in more than this fraction of all
+    //! items are detected by Count-Min sketches and reduced aside from the
+    //! table, and their partial aggregates are combined collectively in the
+    //! final flush. Zero disables the detection.
+    double heavy_hitter_fraction_ = 0.0;
+
     //! select the hash table in the reduce phase by enum
     static constexpr ReduceTableImpl table_impl_ = ReduceTableImpl::PROBING;
 
@@ -66,6 +80,20 @@ public:
     //! the pre and post phases simultaneously.
     static constexpr bool use_post_thread_ = true;
 
+    //! only for ReduceNode: reduce items among the workers of a host first,
+    //! and send only the host-wide aggregate of each key to the other hosts.
+    //! This saves network volume if keys occur on many workers of a host.
+    static constexpr bool use_hierarchical_ = false;
+
+    //! only for ReduceByHashPostPhase: maximum number of partitions a spilled
+    //! partition is split into when it is re-reduced.
+    static constexpr size_t max_spill_fanout_ = 256;
+
+    //! only for ReduceByHashPostPhase: if a spilled partition has more keys
+    //! than max_spill_fanout_ partitions can hold in RAM, re-reduce the spilled
+    //! items by sorting runs by key hash and merging them instead.
+    static constexpr bool use_sort_reduce_ = true;
+
     //! \name Accessors
     //! \{
 
@@ -76,6 +104,9 @@ public:
     //! Returns bucket_rate_
     double bucket_rate() const { return bucket_rate_; }
 
+    //! Returns heavy_hitter_fraction_
+    double heavy_hitter_fraction() const { return heavy_hitter_fraction_; }
+
     //! \}
 };
 
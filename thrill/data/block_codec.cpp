@@ -0,0 +1,327 @@
+/*******************************************************************************
+ * thrill/data/block_codec.cpp
+ *
+ * Compression codecs for whole ByteBlocks sent over the network or swapped out
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/data/block_codec.hpp>
+
+#include <thrill/common/logger.hpp>
+
+#include <tlx/die.hpp>
+#include <tlx/unused.hpp>
+
+#if THRILL_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#if THRILL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace thrill {
+namespace data {
+
+BlockCodec default_block_codec = BlockCodec::None;
+
+CompressMode default_net_compress = CompressMode::Adaptive;
+
+CompressMode default_swap_compress = CompressMode::On;
+
+bool BlockCodecAvailable(BlockCodec codec) {
+    switch (codec) {
+    case BlockCodec::None:
+        return true;
+    case BlockCodec::LZ4:
+#if THRILL_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case BlockCodec::Zstd:
+#if THRILL_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char* BlockCodecName(BlockCodec codec) {
+    switch (codec) {
+    case BlockCodec::None:
+        return "none";
+    case BlockCodec::LZ4:
+        return "lz4";
+    case BlockCodec::Zstd:
+        return "zstd";
+    }
+    return "invalid";
+}
+
+bool ParseBlockCodec(const std::string& name, BlockCodec* codec) {
+    if (name == "none" || name == "off")
+        *codec = BlockCodec::None;
+    else if (name == "lz4")
+        *codec = BlockCodec::LZ4;
+    else if (name == "zstd")
+        *codec = BlockCodec::Zstd;
+    else
+        return false;
+    return true;
+}
+
+bool ParseCompressMode(const std::string& name, CompressMode* mode) {
+    if (name == "off" || name == "0")
+        *mode = CompressMode::Off;
+    else if (name == "on" || name == "1")
+        *mode = CompressMode::On;
+    else if (name == "adaptive")
+        *mode = CompressMode::Adaptive;
+    else
+        return false;
+    return true;
+}
+
+#if THRILL_HAVE_ZSTD
+//! zstd contexts are expensive to create, hence each thread keeps one.
+class ZstdContexts
+{
+public:
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+
+    ~ZstdContexts() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+static ZstdContexts& GetZstdContexts() {
+    static thread_local ZstdContexts contexts;
+    return contexts;
+}
+
+//! fast compression level, the network is the bottleneck we trade against.
+static const int zstd_level = 1;
+#endif
+
+size_t BlockCompressBound(BlockCodec codec, size_t size) {
+    switch (codec) {
+    case BlockCodec::None:
+        return size;
+    case BlockCodec::LZ4:
+#if THRILL_HAVE_LZ4
+        die_unless(size <= LZ4_MAX_INPUT_SIZE);
+        return static_cast<size_t>(LZ4_compressBound(static_cast<int>(size)));
+#else
+        break;
+#endif
+    case BlockCodec::Zstd:
+#if THRILL_HAVE_ZSTD
+        return ZSTD_compressBound(size);
+#else
+        break;
+#endif
+    }
+    return size;
+}
+
+size_t BlockCompress(BlockCodec codec, const uint8_t* src, size_t size,
+                     uint8_t* dst, size_t capacity) {
+    switch (codec) {
+    case BlockCodec::None:
+        return 0;
+    case BlockCodec::LZ4: {
+#if THRILL_HAVE_LZ4
+        if (size > LZ4_MAX_INPUT_SIZE) return 0;
+        int r = LZ4_compress_default(
+            reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+            static_cast<int>(size),
+            static_cast<int>(std::min<size_t>(
+                                 capacity, std::numeric_limits<int>::max())));
+        return r > 0 ? static_cast<size_t>(r) : 0;
+#else
+        break;
+#endif
+    }
+    case BlockCodec::Zstd: {
+#if THRILL_HAVE_ZSTD
+        size_t r = ZSTD_compressCCtx(
+            GetZstdContexts().cctx, dst, capacity, src, size, zstd_level);
+        return ZSTD_isError(r) ? 0 : r;
+#else
+        break;
+#endif
+    }
+    }
+    tlx::unused(src, size, dst, capacity);
+    return 0;
+}
+
+bool BlockDecompress(BlockCodec codec, const uint8_t* src, size_t size,
+                     uint8_t* dst, size_t raw_size) {
+    switch (codec) {
+    case BlockCodec::None:
+        if (size != raw_size) return false;
+        std::copy(src, src + size, dst);
+        return true;
+    case BlockCodec::LZ4: {
+#if THRILL_HAVE_LZ4
+        if (size > LZ4_MAX_INPUT_SIZE || raw_size > LZ4_MAX_INPUT_SIZE)
+            return false;
+        int r = LZ4_decompress_safe(
+            reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+            static_cast<int>(size), static_cast<int>(raw_size));
+        return r >= 0 && static_cast<size_t>(r) == raw_size;
+#else
+        break;
+#endif
+    }
+    case BlockCodec::Zstd: {
+#if THRILL_HAVE_ZSTD
+        size_t r = ZSTD_decompressDCtx(
+            GetZstdContexts().dctx, dst, raw_size, src, size);
+        return !ZSTD_isError(r) && r == raw_size;
+#else
+        break;
+#endif
+    }
+    }
+    return false;
+}
+
+/******************************************************************************/
+// CompressionPolicy
+
+CompressionPolicy::CompressionPolicy(
+    size_t parallelism, BlockCodec codec, CompressMode mode)
+    : parallelism_(std::max<size_t>(parallelism, 1)),
+      codec_(codec), mode_(mode) {
+    if (!BlockCodecAvailable(codec_)) {
+        LOG1 << "CompressionPolicy: block codec " << BlockCodecName(codec_)
+             << " was not compiled in, disabling compression.";
+        codec_ = BlockCodec::None;
+    }
+    if (mode_ == CompressMode::Default)
+        mode_ = CompressMode::Adaptive;
+}
+
+bool CompressionPolicy::ShouldCompress(CompressMode mode) {
+    if (codec_ == BlockCodec::None) return false;
+    if (mode == CompressMode::Default) mode = mode_;
+
+    if (mode == CompressMode::Off) return false;
+    if (mode == CompressMode::On) return true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // probe while nothing is known and periodically to track the data.
+    if (samples_ == 0 || decisions_++ % probe_interval == 0)
+        return true;
+
+    // no bandwidth measurement yet: assume the network is the bottleneck.
+    if (bandwidth_ == 0.0) return true;
+
+    double saved = 1.0 - ratio_;
+    return speed_ * static_cast<double>(parallelism_) * saved > bandwidth_;
+}
+
+size_t CompressionPolicy::Compress(
+    const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+
+    steady_clock::time_point begin = steady_clock::now();
+    size_t csize = BlockCompress(codec_, src, size, dst, capacity);
+    double secs = std::chrono::duration<double>(
+        steady_clock::now() - begin).count();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        double ratio = csize ? static_cast<double>(csize) / size : 1.0;
+        double speed = secs > 0 ? size / secs : speed_;
+
+        if (samples_++ == 0) {
+            ratio_ = ratio, speed_ = speed;
+        }
+        else {
+            ratio_ = 0.75 * ratio_ + 0.25 * ratio;
+            speed_ = 0.75 * speed_ + 0.25 * speed;
+        }
+    }
+
+    LOG << "CompressionPolicy::Compress()"
+        << " codec=" << BlockCodecName(codec_)
+        << " size=" << size << " csize=" << csize << " secs=" << secs;
+
+    // not worth transmitting the compressed variant
+    if (csize == 0 || csize >= size - size / 16)
+        return 0;
+
+    return csize;
+}
+
+void CompressionPolicy::OnSendQueued(size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queued_ == 0)
+        busy_begin_ = steady_clock::now();
+    queued_ += bytes;
+}
+
+void CompressionPolicy::OnSendDone(size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(queued_ >= bytes);
+    queued_ -= bytes;
+    window_bytes_ += bytes;
+
+    if (queued_ != 0 && window_bytes_ < bandwidth_window) return;
+
+    steady_clock::time_point now = steady_clock::now();
+    window_busy_ += now - busy_begin_;
+    busy_begin_ = now;
+
+    if (window_bytes_ < bandwidth_window) return;
+
+    double secs = std::chrono::duration<double>(window_busy_).count();
+    if (secs > 0) {
+        double bw = window_bytes_ / secs;
+        bandwidth_ = bandwidth_ == 0.0 ? bw : 0.75 * bandwidth_ + 0.25 * bw;
+    }
+
+    LOG << "CompressionPolicy: window_bytes=" << window_bytes_
+        << " busy=" << secs << " bandwidth=" << bandwidth_
+        << " ratio=" << ratio_ << " speed=" << speed_;
+
+    window_bytes_ = 0;
+    window_busy_ = steady_clock::duration::zero();
+}
+
+double CompressionPolicy::bandwidth() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return bandwidth_;
+}
+
+double CompressionPolicy::ratio() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return ratio_;
+}
+
+double CompressionPolicy::speed() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return speed_;
+}
+
+} // namespace data
+} // namespace thrill
+
+/******************************************************************************/
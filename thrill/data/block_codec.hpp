@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * thrill/data/block_codec.hpp
+ *
+ * Compression codecs for whole ByteBlocks sent over the network or swapped out
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_DATA_BLOCK_CODEC_HEADER
+#define THRILL_DATA_BLOCK_CODEC_HEADER
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace thrill {
+namespace data {
+
+//! \addtogroup data_layer
+//! \{
+
+//! Compression codecs for ByteBlocks. The numeric values are sent in
+//! MultiplexerHeaders, hence they must not be changed.
+enum class BlockCodec : uint8_t {
+    None = 0, LZ4 = 1, Zstd = 2
+};
+
+//! Whether to compress blocks: Default delegates the decision to the next
+//! higher level (Stream -> Multiplexer, File -> BlockPool), Adaptive compresses
+//! only if this is expected to be faster than sending the raw block.
+enum class CompressMode : uint8_t {
+    Default = 0, Off, On, Adaptive
+};
+
+//! default codec for network and swap compression, set by THRILL_BLOCK_CODEC.
+extern BlockCodec default_block_codec;
+
+//! default compression mode of Streams, set by THRILL_NET_COMPRESS.
+extern CompressMode default_net_compress;
+
+//! default compression mode of swapped out Blocks, set by THRILL_SWAP_COMPRESS.
+extern CompressMode default_swap_compress;
+
+//! returns true if the codec was compiled in.
+bool BlockCodecAvailable(BlockCodec codec);
+
+//! returns the name of the codec
+const char * BlockCodecName(BlockCodec codec);
+
+//! parse "none", "lz4", or "zstd" into codec, returns false if unknown.
+bool ParseBlockCodec(const std::string& name, BlockCodec* codec);
+
+//! parse "off", "on", or "adaptive" into mode, returns false if unknown.
+bool ParseCompressMode(const std::string& name, CompressMode* mode);
+
+//! maximum compressed size of size bytes, which must be available in the
+//! output of BlockCompress().
+size_t BlockCompressBound(BlockCodec codec, size_t size);
+
+/*!
+ * Compress size bytes from src into dst with capacity bytes available. Returns
+ * the compressed size, or zero if the codec is not available or the compressed
+ * data does not fit into capacity. Hence, capacity can be used to discard
+ * incompressible blocks early.
+ */
+size_t BlockCompress(BlockCodec codec, const uint8_t* src, size_t size,
+                     uint8_t* dst, size_t capacity);
+
+//! Decompress size bytes from src into dst, which must expand to exactly
+//! raw_size bytes. Returns false on corrupt data.
+bool BlockDecompress(BlockCodec codec, const uint8_t* src, size_t size,
+                     uint8_t* dst, size_t raw_size);
+
+/*!
+ * Decides whether to compress blocks sent over the network and collects the
+ * statistics needed for this.
+ *
+ * In adaptive mode, compression pays off if the time to compress a block and
+ * send the smaller result is less than sending it raw: size / bandwidth >
+ * size / speed + ratio * size / bandwidth, where speed is the aggregate
+ * compression speed of all workers and ratio the average compression
+ * ratio. The network bandwidth is measured as the rate at which queued writes
+ * complete while the send queue is not empty. Every probe_interval-th block is
+ * compressed anyway to keep the ratio and speed estimates current.
+ *
+ * All methods are thread-safe, since they are called by the workers' sinks and
+ * the dispatcher thread.
+ */
+class CompressionPolicy
+{
+    static constexpr bool debug = false;
+
+public:
+    using steady_clock = std::chrono::steady_clock;
+
+    //! compress every n-th block in adaptive mode even if not worthwhile
+    static constexpr size_t probe_interval = 32;
+
+    //! minimum number of bytes between bandwidth estimates
+    static constexpr size_t bandwidth_window = 16 * 1024 * 1024;
+
+    explicit CompressionPolicy(
+        size_t parallelism = 1,
+        BlockCodec codec = default_block_codec,
+        CompressMode mode = default_net_compress);
+
+    //! non-copyable: delete copy-constructor
+    CompressionPolicy(const CompressionPolicy&) = delete;
+    //! non-copyable: delete assignment operator
+    CompressionPolicy& operator = (const CompressionPolicy&) = delete;
+
+    //! codec used to compress blocks
+    BlockCodec codec() const { return codec_; }
+
+    //! compression mode if streams use CompressMode::Default
+    CompressMode mode() const { return mode_; }
+
+    //! Decide whether to compress the next block. mode is the stream's
+    //! override, which is used unless it is CompressMode::Default.
+    bool ShouldCompress(CompressMode mode);
+
+    //! Compress a block and record ratio and speed. Returns zero if the block
+    //! did not compress to less than 15/16 of its size or did not fit into
+    //! capacity, which must be BlockCompressBound() for a successful result.
+    size_t Compress(const uint8_t* src, size_t size,
+                    uint8_t* dst, size_t capacity);
+
+    //! record that bytes were queued for sending.
+    void OnSendQueued(size_t bytes);
+
+    //! record that bytes were sent out.
+    void OnSendDone(size_t bytes);
+
+    //! \name Statistics
+    //! \{
+
+    //! estimated network bandwidth in bytes/s, zero if not yet measured
+    double bandwidth() const;
+
+    //! average compressed size / raw size, one if not yet measured
+    double ratio() const;
+
+    //! average compression speed of one worker in bytes/s
+    double speed() const;
+
+    //! \}
+
+private:
+    //! mutex protecting the estimates
+    mutable std::mutex mutex_;
+
+    //! number of workers compressing in parallel
+    size_t parallelism_;
+
+    //! codec used to compress
+    BlockCodec codec_;
+
+    //! host default compression mode
+    CompressMode mode_;
+
+    //! number of decisions in adaptive mode, used for probing
+    size_t decisions_ = 0;
+
+    //! number of compressed blocks measured
+    size_t samples_ = 0;
+
+    //! exponentially weighted averages of ratio and speed
+    double ratio_ = 1.0, speed_ = 0.0;
+
+    //! exponentially weighted average of bandwidth
+    double bandwidth_ = 0.0;
+
+    //! bytes currently queued for sending
+    size_t queued_ = 0;
+
+    //! bytes sent in the current bandwidth window
+    size_t window_bytes_ = 0;
+
+    //! busy time (queue non-empty) in the current bandwidth window
+    steady_clock::duration window_busy_ = steady_clock::duration::zero();
+
+    //! time point when the queue became non-empty
+    steady_clock::time_point busy_begin_;
+};
+
+//! \}
+
+} // namespace data
+} // namespace thrill
+
+#endif // !THRILL_DATA_BLOCK_CODEC_HEADER
+
+/******************************************************************************/
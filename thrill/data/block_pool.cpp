@@ -8,11 +8,13 @@
  * All rights reserved. Published under the BSD-2 license in the LICENSE file.
  ******************************************************************************/
 
+#include <thrill/common/config.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/common/math.hpp>
 #include <thrill/data/block.hpp>
 #include <thrill/data/block_pool.hpp>
 #include <thrill/mem/aligned_allocator.hpp>
+#include <thrill/mem/numa_arena.hpp>
 #include <thrill/mem/pool.hpp>
 
 #include <foxxll/io/file.hpp>
@@ -20,12 +22,17 @@
 #include <tlx/container/lru_cache.hpp>
 #include <tlx/die.hpp>
 #include <tlx/math/is_power_of_two.hpp>
+#include <tlx/math/round_to_power_of_two.hpp>
 #include <tlx/string/join_generic.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -35,6 +42,8 @@
 namespace thrill {
 namespace data {
 
+size_t default_hugepage_size = 0;
+
 //! debug block life cycle output: create, destroy
 static constexpr bool debug_blc = false;
 
@@ -175,6 +184,9 @@ struct BlockPool::PinCount {
     //! decrement pin counter for thread_id by given size in bytes
     void Decrement(size_t local_worker_id, size_t size);
 
+    //! add the counters of another shard, the maxima are summed up.
+    void Add(const PinCount& p);
+
     //! assert that it is zero.
     void AssertZero() const;
 };
@@ -204,6 +216,17 @@ void BlockPool::PinCount::Decrement(size_t local_worker_id, size_t size) {
     total_pinned_bytes_ -= size;
 }
 
+void BlockPool::PinCount::Add(const PinCount& p) {
+    for (size_t i = 0; i < pin_count_.size(); ++i) {
+        pin_count_[i] += p.pin_count_[i];
+        pinned_bytes_[i] += p.pinned_bytes_[i];
+    }
+    total_pins_ += p.total_pins_;
+    total_pinned_bytes_ += p.total_pinned_bytes_;
+    max_pins += p.max_pins;
+    max_pinned_bytes += p.max_pinned_bytes;
+}
+
 void BlockPool::PinCount::AssertZero() const {
     die_unless(total_pins_ == 0);
     die_unless(total_pinned_bytes_ == 0);
@@ -224,7 +247,7 @@ std::ostream& operator << (std::ostream& os, const BlockPool::PinCount& p) {
 }
 
 /******************************************************************************/
-// BlockPool::Data
+// BlockPool::Shard
 
 //! type of set of ByteBlocks currently begin written to EM.
 using WritingMap = std::unordered_map<
@@ -239,6 +262,100 @@ using ReadingMap = std::unordered_map<
     mem::GPoolAllocator<
         std::pair<ByteBlock* const, PinRequestPtr> > >;
 
+//! type of set of ByteBlocks
+using ByteBlockSet = std::unordered_set<
+    ByteBlock*, std::hash<ByteBlock*>, std::equal_to<>,
+    mem::GPoolAllocator<ByteBlock*> >;
+
+struct alignas(common::g_cache_line_size) BlockPool::Shard {
+    //! locked while the states of the shard's ByteBlocks change, always after
+    //! BlockPool::mutex_ if both are locked.
+    std::mutex mutex_;
+
+    //! list of all blocks that are _in_memory_ but are _not_ pinned.
+    tlx::LruCacheSet<
+        ByteBlock*, mem::GPoolAllocator<ByteBlock*> > unpinned_blocks_;
+
+    //! size of unpinned_blocks_, which is read without locking the shard.
+    std::atomic<size_t> num_unpinned_ { 0 };
+
+    //! number of unpinned bytes
+    Counter unpinned_bytes_;
+
+    //! pin counter of the shard's blocks
+    PinCount pin_count_ { 0 };
+
+    //! set of ByteBlocks currently begin written to EM.
+    WritingMap writing_;
+
+    //! set of ByteBlocks currently begin read from EM.
+    ReadingMap reading_;
+
+    //! set of ByteBlock currently in EM.
+    ByteBlockSet swapped_;
+
+    //! set of ByteBlocks taken from the LRU list for eviction, whose write is
+    //! not issued yet. They are compressed while the mutexes are unlocked.
+    ByteBlockSet evicting_;
+
+    //! insert a block at the most recently used end of the LRU list
+    void PutUnpinned(ByteBlock* block_ptr) {
+        die_unless(!unpinned_blocks_.exists(block_ptr));
+        unpinned_blocks_.put(block_ptr);
+        unpinned_bytes_ += block_ptr->size();
+        num_unpinned_.store(unpinned_blocks_.size(), std::memory_order_relaxed);
+    }
+
+    //! remove a block from the LRU list
+    void EraseUnpinned(ByteBlock* block_ptr) {
+        die_unless(unpinned_blocks_.exists(block_ptr));
+        unpinned_blocks_.erase(block_ptr);
+        unpinned_bytes_ -= block_ptr->size();
+        num_unpinned_.store(unpinned_blocks_.size(), std::memory_order_relaxed);
+    }
+
+    //! remove the least recently used block from the LRU list
+    ByteBlock * PopUnpinned() {
+        ByteBlock* block_ptr = unpinned_blocks_.pop();
+        die_unless(block_ptr);
+        unpinned_bytes_ -= block_ptr->size();
+        num_unpinned_.store(unpinned_blocks_.size(), std::memory_order_relaxed);
+        return block_ptr;
+    }
+};
+
+/******************************************************************************/
+// BlockPool::WriteBatch
+
+//! A batch of evicted blocks written into one EM extent by a single request.
+//! The blocks' data or compressed copies are gathered into a staging buffer,
+//! hence a block can be detached from the batch while it is being written.
+struct BlockPool::WriteBatch {
+    //! the block pool to report the completion to
+    BlockPool* block_pool_;
+
+    //! staging buffer of the extent, and its size
+    Byte* buffer_;
+    size_t size_;
+
+    //! blocks written into the extent, in order of their offsets
+    std::vector<ByteBlock*> blocks_;
+
+    //! EM blocks of blocks detached while writing, freed after completion.
+    std::vector<foxxll::BID<0> > detached_;
+
+    //! the write request of the extent
+    foxxll::request_ptr req_;
+
+    //! completion handler of the write request
+    void OnComplete(foxxll::request* req, bool success) {
+        block_pool_->OnWriteBatchComplete(this, req, success);
+    }
+};
+
+/******************************************************************************/
+// BlockPool::Data
+
 class BlockPool::Data
 {
 public:
@@ -256,20 +373,16 @@ public:
     //! print a message on the first block evicted to external memory
     bool notify_em_used_ = false;
 
-    //! list of all blocks that are _in_memory_ but are _not_ pinned.
-    tlx::LruCacheSet<
-        ByteBlock*, mem::GPoolAllocator<ByteBlock*> > unpinned_blocks_;
-
-    //! set of ByteBlocks currently begin written to EM.
-    WritingMap writing_;
+    //! the shards of the ByteBlock states, their number is a power of two.
+    std::vector<Shard, mem::AlignedAllocator<
+                    Shard, std::allocator<char>, common::g_cache_line_size> >
+    shards_;
 
-    //! set of ByteBlocks currently begin read from EM.
-    ReadingMap reading_;
+    //! next shard to take an eviction victim from
+    size_t evict_shard_ = 0;
 
-    //! set of ByteBlock currently in EM.
-    std::unordered_set<
-        ByteBlock*, std::hash<ByteBlock*>, std::equal_to<>,
-        mem::GPoolAllocator<ByteBlock*> > swapped_;
+    //! for waiting on blocks leaving a shard's evicting_ set, with mutex_.
+    std::condition_variable cv_evicted_;
 
     //! I/O layer stats when BlockPool was created.
     foxxll::stats_data io_stats_first_;
@@ -280,18 +393,24 @@ public:
     //! reference to io block manager
     foxxll::block_manager* bm_;
 
+    //! the BlockPool, whose methods complete the batch writes.
+    BlockPool& block_pool_;
+
     //! Allocator for ByteBlocks such that they are aligned for faster
     //! I/O. Allocations are counted via mem_manager_.
     mem::AlignedAllocator<Byte, mem::Allocator<char> > aligned_alloc_;
 
-    //! next unique File id
-    std::atomic<size_t> next_file_id_ { 0 };
+    //! hugepage arena for ByteBlock memory, if enabled.
+    std::unique_ptr<mem::NumaArena> arena_;
 
-    //! number of unpinned bytes
-    Counter unpinned_bytes_;
+    //! NUMA node of each worker's cpu, set by SetWorkerCpus().
+    std::vector<size_t> worker_node_;
+
+    //! number of pins of Blocks on another NUMA node, counted without locking.
+    std::atomic<size_t> remote_pins_ { 0 };
 
-    //! pin counter class
-    PinCount pin_count_;
+    //! next unique File id
+    std::atomic<size_t> next_file_id_ { 0 };
 
     //! number of bytes currently begin requested from RAM.
     size_t requested_bytes_ = 0;
@@ -302,6 +421,9 @@ public:
     //! total number of bytes in swapped blocks
     Counter swapped_bytes_;
 
+    //! codec to compress blocks with when swapping them out
+    BlockCodec swap_codec_ = BlockCodec::None;
+
     //! number of bytes currently being read from to EM.
     Counter reading_bytes_;
 
@@ -325,6 +447,43 @@ public:
     std::chrono::steady_clock::time_point tp_last_
         = std::chrono::steady_clock::now();
 
+    //! \name Background Eviction
+    //! \{
+
+    //! thread evicting unpinned blocks ahead of demand, only started if there
+    //! is a soft limit.
+    std::thread evict_thread_;
+
+    //! for waking up the eviction thread
+    std::condition_variable cv_evict_;
+
+    //! flag to terminate the eviction thread
+    bool evict_terminate_ = false;
+
+    //! the eviction thread starts once the free memory below the soft limit
+    //! drops under the low watermark, and evicts until it reaches the high
+    //! watermark.
+    size_t evict_low_watermark_ = 0, evict_high_watermark_ = 0;
+
+    //! maximum number of bytes evicted in one batch.
+    static constexpr size_t evict_batch_bytes_ = 16 * 1024 * 1024;
+
+    //! set while the eviction thread waits for blocks to be unpinned, which
+    //! happens with only their shard locked, see NotifyUnpinned().
+    std::atomic<bool> evict_waiting_ { false };
+
+    //! batches currently being written, by their request.
+    std::unordered_map<foxxll::request*, std::unique_ptr<WriteBatch> >
+    write_batches_;
+
+    //! number of batches written, to stripe their extents over the disks.
+    size_t num_write_batches_ = 0;
+
+    //! number of blocks evicted by the eviction thread and by other threads.
+    size_t evict_background_blocks_ = 0, evict_foreground_blocks_ = 0;
+
+    //! \}
+
 public:
     Data(BlockPool& block_pool,
          size_t soft_ram_limit, size_t hard_ram_limit,
@@ -332,8 +491,95 @@ public:
         : soft_ram_limit_(soft_ram_limit),
           hard_ram_limit_(hard_ram_limit),
           bm_(foxxll::block_manager::get_instance()),
+          block_pool_(block_pool),
           aligned_alloc_(mem::Allocator<char>(block_pool.mem_manager_)),
-          pin_count_(workers_per_host) { }
+          shards_(tlx::round_up_to_power_of_two(4 * workers_per_host)),
+          worker_node_(workers_per_host) {
+        for (Shard& shard : shards_)
+            shard.pin_count_ = PinCount(workers_per_host);
+        if (default_hugepage_size != 0 && mem::NumaArena::IsSupported()) {
+            arena_ = std::make_unique<mem::NumaArena>(
+                &block_pool.mem_manager_, default_hugepage_size);
+        }
+        evict_low_watermark_ = soft_ram_limit_ / 16;
+        evict_high_watermark_ = soft_ram_limit_ / 8;
+        if (default_swap_compress != CompressMode::Off &&
+            BlockCodecAvailable(default_block_codec))
+            swap_codec_ = default_block_codec;
+    }
+
+    //! Returns the shard holding the state of a block.
+    Shard& shard(const ByteBlock* block_ptr) {
+        // Fibonacci hashing of the address, which is aligned by the GPool.
+        uint64_t h = static_cast<uint64_t>(
+            reinterpret_cast<uintptr_t>(block_ptr) >> 4);
+        h = (h * 0x9E3779B97F4A7C15ull) >> 32;
+        return shards_[h & (shards_.size() - 1)];
+    }
+
+    //! Number of unpinned blocks in all shards, read without locking them.
+    size_t IntUnpinnedBlocks() const {
+        size_t n = 0;
+        for (const Shard& shard : shards_)
+            n += shard.num_unpinned_.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    //! Sum of the pin counters of all shards, locks each shard.
+    PinCount IntPinCount();
+
+    //! Returns the codec to compress the block with when swapping it out.
+    BlockCodec SwapCodec(const ByteBlock* block_ptr) const {
+        CompressMode mode = block_ptr->swap_compress_;
+        if (mode == CompressMode::Off) return BlockCodec::None;
+        if (mode == CompressMode::Default || swap_codec_ != BlockCodec::None)
+            return swap_codec_;
+        // forced by the File, but disabled in the BlockPool
+        return BlockCodecAvailable(default_block_codec)
+               ? default_block_codec : BlockCodec::None;
+    }
+
+    //! Size of the buffer for a compressed copy of a swapped block. The
+    //! compressed copy is only used if it saves at least one I/O block.
+    static size_t SwapBufferSize(const ByteBlock* block_ptr) {
+        return (block_ptr->size() - 1) / THRILL_DEFAULT_ALIGN
+               * THRILL_DEFAULT_ALIGN;
+    }
+
+    //! Deallocate the buffer of a block's compressed copy, and release its
+    //! memory, which is counted in total_ram_bytes_ while allocated.
+    void IntReleaseSwapBuffer(ByteBlock* block_ptr) {
+        aligned_alloc_.deallocate(
+            block_ptr->swap_buffer_, SwapBufferSize(block_ptr));
+        block_ptr->swap_buffer_ = nullptr;
+        IntReleaseInternalMemory(SwapBufferSize(block_ptr));
+    }
+
+    //! Allocate memory of a ByteBlock on the NUMA node, from the arena if
+    //! enabled. Thread-safe, called without holding the mutex.
+    Byte* AllocateBlockData(size_t size, size_t node) {
+        if (arena_)
+            return static_cast<Byte*>(arena_->allocate(size, node));
+        return aligned_alloc_.allocate(size);
+    }
+
+    //! Deallocate the memory of a ByteBlock.
+    void DeallocateBlockData(ByteBlock* block_ptr) {
+        if (arena_) {
+            arena_->deallocate(
+                block_ptr->data_, block_ptr->size(), block_ptr->numa_node_);
+        }
+        else {
+            aligned_alloc_.deallocate(block_ptr->data_, block_ptr->size());
+        }
+    }
+
+    //! Count a pin of a Block in memory if it resides on another NUMA node
+    //! than local_worker_id.
+    void CountRemotePin(const ByteBlock* block_ptr, size_t local_worker_id) {
+        if (arena_ && block_ptr->numa_node_ != worker_node_[local_worker_id])
+            remote_pins_.fetch_add(1, std::memory_order_relaxed);
+    }
 
     //! Updates the memory manager for internal memory. If the hard limit is
     //! reached, the call is blocked intil memory is free'd
@@ -343,17 +589,105 @@ public:
     //! BlockPool::RequestInternalMemory calls
     void IntReleaseInternalMemory(size_t size);
 
-    //! Unpins a block. If all pins are removed, the block might be swapped.
-    //! Returns immediately. Actual unpinning is async.
-    void IntUnpinBlock(
-        BlockPool& bp, ByteBlock* block_ptr, size_t local_worker_id);
+    //! Pins a block which is pinned by another worker or unpinned in memory,
+    //! with only its shard locked. Returns false if the block must be read or
+    //! waited for.
+    bool IntPinInMemory(BlockPool& bp, Shard& shard,
+                        ByteBlock* block_ptr, size_t local_worker_id);
+
+    //! Unpins a block, with only its shard locked. If all pins are removed,
+    //! the block might be swapped, and true is returned. Returns immediately.
+    bool IntUnpinBlock(BlockPool& bp, Shard& shard,
+                       ByteBlock* block_ptr, size_t local_worker_id);
+
+    //! Wake up the eviction thread if it waits for an unpinned block. Called
+    //! after IntUnpinBlock() returned true, with no mutex locked.
+    void NotifyUnpinned(std::mutex& mutex) {
+        // pairs with the fence in BlockPool::EvictThread(): either this sees
+        // the flag, or the eviction thread sees the new unpinned block.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!evict_waiting_.load(std::memory_order_relaxed)) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        cv_evict_.notify_one();
+    }
 
-    //! Evict a block from the lru list into external memory
-    foxxll::request_ptr IntEvictBlockLRU();
+    //! Evict a block from the lru list into external memory. May unlock the
+    //! mutex while compressing the block.
+    foxxll::request_ptr IntEvictBlockLRU(std::unique_lock<std::mutex>& lock);
+
+    //! Evict a block into external memory. The block must already be prepared
+    //! by IntPrepareEvictBlock(). May unlock the mutex while compressing the
+    //! block.
+    foxxll::request_ptr IntEvictBlock(
+        std::unique_lock<std::mutex>& lock, ByteBlock* block_ptr);
+
+    //! Take the least recently used block of the next shard with unpinned
+    //! blocks, round-robin over the shards, and prepare it for eviction.
+    //! Returns false if there are no unpinned blocks. victim is set to nullptr
+    //! if the block's memory was released without writing.
+    bool IntPopVictim(ByteBlock*& victim);
+
+    //! Evict blocks prepared by IntPrepareEvictBlock() into external memory.
+    //! The blocks are compressed while the mutex is unlocked, then a single
+    //! block is written on its own, and more are written as one WriteBatch.
+    void IntEvictBlocks(std::unique_lock<std::mutex>& lock,
+                        const std::vector<ByteBlock*>& blocks);
+
+    //! First part of IntEvictBlocks(), with the block's shard locked and the
+    //! block removed from its LRU list: count the block as being written and
+    //! put it into the shard's evicting_ set. Returns false if the block's
+    //! memory was released without writing, because it is mapped from an
+    //! external file.
+    bool IntPrepareEvictBlock(Shard& shard, ByteBlock* block_ptr);
+
+    //! Second part of IntEvictBlocks(): compress the block into a swap buffer
+    //! if this saves at least one I/O block. Called without holding the
+    //! mutexes, while the block is in evicting_.
+    void CompressSwapBlock(ByteBlock* block_ptr, BlockCodec codec);
+
+    //! Third part of IntEvictBlocks(): allocate the EM block for the block or
+    //! its compressed copy.
+    void IntAllocateEmBlock(ByteBlock* block_ptr);
+
+    //! Last part of IntEvictBlocks(): issue the write request, and move the
+    //! block from evicting_ to writing_.
+    foxxll::request_ptr IntWriteBlock(ByteBlock* block_ptr);
+
+    //! Alternative to the last two parts of IntEvictBlocks() for more than one
+    //! block: allocate one extent for all blocks, gather them into a staging
+    //! buffer while the mutex is unlocked, and write it with one request.
+    void IntWriteBatch(std::unique_lock<std::mutex>& lock,
+                       const std::vector<ByteBlock*>& blocks);
+
+    //! Finish the write of a block which was removed from writing_. On
+    //! success the block's memory is released, otherwise it returns to the
+    //! LRU list and its EM block is freed, or handed to the batch whose
+    //! extent is still being written.
+    void IntWriteDone(Shard& shard, ByteBlock* block_ptr, bool success,
+                      WriteBatch* batch = nullptr);
+
+    //! If the block in writing_ is written as part of a WriteBatch, detach it
+    //! from the batch instead of canceling the request, and return true.
+    bool IntDetachBatchWrite(Shard& shard, WritingMap::iterator it);
+
+    //! Evict a batch of LRU blocks until free memory reaches target_free.
+    void IntEvictBatch(std::unique_lock<std::mutex>& lock, size_t target_free);
+
+    //! Free memory below the soft limit, where blocks currently being written
+    //! are already counted as free.
+    size_t IntFreeBytes() const {
+        size_t used = total_ram_bytes_ + requested_bytes_;
+        used = used > writing_bytes_ ? used - writing_bytes_ : 0;
+        return used < soft_ram_limit_ ? soft_ram_limit_ - used : 0;
+    }
 
-    //! Evict a block into external memory. The block must be unpinned and not
-    //! swapped.
-    foxxll::request_ptr IntEvictBlock(ByteBlock* block_ptr);
+    //! Wake up the eviction thread if free memory dropped under the low
+    //! watermark.
+    void IntCheckEvictWatermark() {
+        if (evict_thread_.joinable() && IntUnpinnedBlocks() &&
+            IntFreeBytes() < evict_low_watermark_)
+            cv_evict_.notify_one();
+    }
 
     //! \name Block Statistics
     //! \{
@@ -395,6 +729,9 @@ BlockPool::BlockPool(size_t soft_ram_limit, size_t hard_ram_limit,
     d_->io_stats_first_ = d_->io_stats_prev_ =
         foxxll::stats_data(*foxxll::stats::get_instance());
 
+    if (soft_ram_limit != 0)
+        d_->evict_thread_ = std::thread(&BlockPool::EvictThread, this);
+
     logger_ << "class" << "BlockPool"
             << "event" << "create"
             << "soft_ram_limit" << soft_ram_limit
@@ -404,54 +741,79 @@ BlockPool::BlockPool(size_t soft_ram_limit, size_t hard_ram_limit,
 BlockPool::~BlockPool() {
     std::unique_lock<std::mutex> lock(mutex_);
 
-    // check that not writing any block.
-    while (d_->writing_.begin() != d_->writing_.end()) {
+    // stop eviction thread, which may still issue writes.
+    if (d_->evict_thread_.joinable()) {
+        d_->evict_terminate_ = true;
+        d_->cv_evict_.notify_one();
+        lock.unlock();
+        d_->evict_thread_.join();
+        lock.lock();
+    }
 
-        ByteBlock* block_ptr = d_->writing_.begin()->first;
-        foxxll::request_ptr req = d_->writing_.begin()->second;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
 
-        LOGC(debug_em)
-            << "BlockPool::~BlockPool() block=" << block_ptr
-            << " is currently begin written to external memory, canceling.";
+        // check that not writing any block.
+        while (shard.writing_.begin() != shard.writing_.end()) {
 
-        lock.unlock();
-        // cancel I/O request
-        if (!req->cancel()) {
+            ByteBlock* block_ptr = shard.writing_.begin()->first;
+            foxxll::request_ptr req = shard.writing_.begin()->second;
 
             LOGC(debug_em)
                 << "BlockPool::~BlockPool() block=" << block_ptr
-                << " is currently begin written to external memory,"
-                << " cancel failed, waiting.";
+                << " is currently begin written to external memory, canceling.";
 
-            // must still wait for cancellation to complete and the I/O handler.
-            req->wait();
-        }
-        lock.lock();
+            slock.unlock();
+            lock.unlock();
+            // cancel I/O request
+            if (!req->cancel()) {
 
-        LOGC(debug_em)
-            << "BlockPool::PinBlock block=" << block_ptr
-            << " is currently begin written to external memory,"
-            << " cancel/wait done.";
-    }
+                LOGC(debug_em)
+                    << "BlockPool::~BlockPool() block=" << block_ptr
+                    << " is currently begin written to external memory,"
+                    << " cancel failed, waiting.";
 
-    die_unless(d_->writing_bytes_ == 0);
+                // must still wait for cancellation to complete and the I/O
+                // handler.
+                req->wait();
+            }
+            lock.lock();
+            slock.lock();
 
-    // check that not reading any block.
-    while (d_->reading_.begin() != d_->reading_.end()) {
+            LOGC(debug_em)
+                << "BlockPool::PinBlock block=" << block_ptr
+                << " is currently begin written to external memory,"
+                << " cancel/wait done.";
+        }
 
-        ByteBlock* block_ptr = d_->reading_.begin()->first;
-        PinRequestPtr read = d_->reading_.begin()->second;
+        // check that not reading any block.
+        while (shard.reading_.begin() != shard.reading_.end()) {
 
-        LOGC(debug_em)
-            << "BlockPool::~BlockPool() block=" << block_ptr
-            << " is currently begin read from external memory, waiting.";
+            ByteBlock* block_ptr = shard.reading_.begin()->first;
+            PinRequestPtr read = shard.reading_.begin()->second;
 
+            LOGC(debug_em)
+                << "BlockPool::~BlockPool() block=" << block_ptr
+                << " is currently begin read from external memory, waiting.";
+
+            slock.unlock();
+            lock.unlock();
+            // wait for I/O request for completion and the I/O handler.
+            read->req_->wait();
+            lock.lock();
+            slock.lock();
+        }
+    }
+
+    // wait for batches whose blocks were all detached.
+    while (!d_->write_batches_.empty()) {
+        foxxll::request_ptr req = d_->write_batches_.begin()->second->req_;
         lock.unlock();
-        // wait for I/O request for completion and the I/O handler.
-        read->req_->wait();
+        req->wait();
         lock.lock();
     }
 
+    die_unless(d_->writing_bytes_ == 0);
     die_unless(d_->reading_bytes_ == 0);
 
     // wait for deletion of last ByteBlocks. this may actually be needed, when
@@ -460,26 +822,42 @@ BlockPool::~BlockPool() {
     while (d_->total_byte_blocks_ != 0)
         d_->cv_total_byte_blocks_.wait(lock);
 
-    d_->pin_count_.AssertZero();
+    PinCount pin_count = d_->IntPinCount();
+    pin_count.AssertZero();
     die_unequal(d_->total_ram_bytes_, 0u);
     die_unequal(d_->total_bytes_, 0u);
-    die_unequal(d_->unpinned_blocks_.size(), 0u);
+    die_unequal(d_->IntUnpinnedBlocks(), 0u);
 
     LOGC(debug_pin)
         << "~BlockPool()"
-        << " max_pin=" << d_->pin_count_.max_pins
-        << " max_pinned_bytes=" << d_->pin_count_.max_pinned_bytes;
+        << " max_pin=" << pin_count.max_pins
+        << " max_pinned_bytes=" << pin_count.max_pinned_bytes;
 
     logger_ << "class" << "BlockPool"
             << "event" << "destroy"
-            << "max_pins" << d_->pin_count_.max_pins
-            << "max_pinned_bytes" << d_->pin_count_.max_pinned_bytes;
+            << "max_pins" << pin_count.max_pins
+            << "max_pinned_bytes" << pin_count.max_pinned_bytes
+            << "evict_background_blocks" << d_->evict_background_blocks_
+            << "evict_foreground_blocks" << d_->evict_foreground_blocks_
+            << "remote_pins" << d_->remote_pins_.load();
 
     std::unique_lock<std::recursive_mutex> s_new_lock(s_new_mutex);
     s_blockpools.erase(
         std::find(s_blockpools.begin(), s_blockpools.end(), this));
 }
 
+void BlockPool::SetWorkerCpus(const std::vector<size_t>& cpus) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // the node is only needed to place and count blocks of the arena.
+    if (!d_->arena_) return;
+
+    for (size_t i = 0; i < workers_per_host_ && i < cpus.size(); ++i) {
+        d_->worker_node_[i] = mem::NumaNodeOfCpu(cpus[i]);
+        LOGC(debug_alloc)
+            << "BlockPool: worker " << i << " on node " << d_->worker_node_[i];
+    }
+}
+
 PinnedByteBlockPtr
 BlockPool::AllocateByteBlock(size_t size, size_t local_worker_id) {
     assert(local_worker_id < workers_per_host_);
@@ -495,23 +873,30 @@ BlockPool::AllocateByteBlock(size_t size, size_t local_worker_id) {
 
     d_->IntRequestInternalMemory(lock, size);
 
-    // allocate block memory. -- unlock mutex for that time, since it may
-    // require block eviction.
+    // allocate block memory on the worker's node. -- unlock mutex for that
+    // time, since it may require block eviction.
+    size_t node = d_->worker_node_[local_worker_id];
     lock.unlock();
-    Byte* data = d_->aligned_alloc_.allocate(size);
+    Byte* data = d_->AllocateBlockData(size, node);
     LOGC(debug_alloc)
-        << "ByteBlock aligned_alloc: " << (void*)data << " size " << size;
+        << "ByteBlock aligned_alloc: " << (void*)data << " size " << size
+        << " node " << node;
     lock.lock();
 
     // create tlx::CountingPtr, no need for special make_shared()-equivalent
     PinnedByteBlockPtr block_ptr(
         mem::GPool().make<ByteBlock>(this, data, size), local_worker_id);
+    block_ptr->numa_node_ = node;
     ++d_->total_byte_blocks_;
     d_->total_bytes_ += size;
     d_->max_total_bytes_ = std::max(d_->max_total_bytes_, d_->total_bytes_.value);
-    IntIncBlockPinCount(block_ptr.get(), local_worker_id);
 
-    d_->pin_count_.Increment(local_worker_id, size);
+    {
+        Shard& shard = d_->shard(block_ptr.get());
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        IntIncBlockPinCount(block_ptr.get(), local_worker_id);
+        shard.pin_count_.Increment(local_worker_id, size);
+    }
 
     LOGC(debug_blc)
         << "BlockPool::AllocateBlock()"
@@ -520,7 +905,7 @@ BlockPool::AllocateByteBlock(size_t size, size_t local_worker_id) {
         << " local_worker_id=" << local_worker_id
         << " total_blocks()=" << d_->int_total_blocks()
         << " total_bytes()=" << d_->int_total_bytes()
-        << d_->pin_count_;
+        << d_->IntPinCount();
 
     return block_ptr;
 }
@@ -547,150 +932,180 @@ ByteBlockPtr BlockPool::MapExternalBlock(
 //! Pins a block by swapping it in if required.
 PinRequestPtr BlockPool::PinBlock(const Block& block, size_t local_worker_id) {
     assert(local_worker_id < workers_per_host_);
-    std::unique_lock<std::mutex> lock(mutex_);
 
     ByteBlock* block_ptr = block.byte_block().get();
 
-    if (block_ptr->pin_count_[local_worker_id] > 0) {
+    if (block_ptr->TryIncPinCount(local_worker_id)) {
         // We may get a Block who's underlying is already pinned, since
         // PinnedBlock become Blocks when transfered between Files or delivered
-        // via GetItemRange() or Scatter().
-
-        die_unless(!d_->unpinned_blocks_.exists(block_ptr));
-        die_unless(d_->reading_.find(block_ptr) == d_->reading_.end());
+        // via GetItemRange() or Scatter(). In this case, the pin count is
+        // incremented without locking.
 
         LOGC(debug_pin)
             << "BlockPool::PinBlock block=" << &block
             << " already pinned by thread";
 
-        IntIncBlockPinCount(block_ptr, local_worker_id);
+        d_->CountRemotePin(block_ptr, local_worker_id);
 
         return PinRequestPtr(mem::GPool().make<PinRequest>(
                                  this, PinnedBlock(block, local_worker_id)));
     }
 
-    if (block_ptr->total_pins_ > 0) {
-        // This block was already pinned by another thread, hence we only need
-        // to get a pin for the new thread.
-
-        die_unless(!d_->unpinned_blocks_.exists(block_ptr));
-        die_unless(d_->reading_.find(block_ptr) == d_->reading_.end());
-
-        LOGC(debug_pin)
-            << "BlockPool::PinBlock block=" << block
-            << " already pinned by another thread"
-            << d_->pin_count_;
-
-        IntIncBlockPinCount(block_ptr, local_worker_id);
-        d_->pin_count_.Increment(local_worker_id, block_ptr->size());
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
 
+    // Block pinned by another worker or unpinned in memory: only the shard's
+    // state changes.
+    if (d_->IntPinInMemory(*this, shard, block_ptr, local_worker_id)) {
         return PinRequestPtr(mem::GPool().make<PinRequest>(
                                  this, PinnedBlock(block, local_worker_id)));
     }
 
-    // check that not writing the block.
-    WritingMap::iterator write_it;
-    while ((write_it = d_->writing_.find(block_ptr)) != d_->writing_.end()) {
-
-        LOGC(debug_em)
-            << "BlockPool::PinBlock() block=" << block_ptr
-            << " is currently begin written to external memory, canceling.";
+    // otherwise the block is being evicted, written, read, or swapped out,
+    // which requires the BlockPool's mutex, locked before the shard's.
+    slock.unlock();
+    std::unique_lock<std::mutex> lock(mutex_);
+    slock.lock();
+
+    // memory requested for reading the block
+    size_t read_bytes = 0;
+
+    for ( ; ; ) {
+        if (d_->IntPinInMemory(*this, shard, block_ptr, local_worker_id)) {
+            // pinned or written back in the meantime.
+            if (read_bytes)
+                d_->IntReleaseInternalMemory(read_bytes);
+            return PinRequestPtr(
+                mem::GPool().make<PinRequest>(
+                    this, PinnedBlock(block, local_worker_id)));
+        }
 
-        die_unless(!block_ptr->ext_file_);
+        if (shard.evicting_.count(block_ptr)) {
+            // wait until the block's write was issued, then cancel it.
+            slock.unlock();
+            d_->cv_evicted_.wait(lock);
+            slock.lock();
+            continue;
+        }
 
-        // get reference count to request, since complete handler removes it
-        // from the map.
-        foxxll::request_ptr req = write_it->second;
-        lock.unlock();
-        // cancel I/O request
-        if (!req->cancel()) {
+        // check that not writing the block.
+        WritingMap::iterator write_it = shard.writing_.find(block_ptr);
+        if (write_it != shard.writing_.end()) {
 
             LOGC(debug_em)
                 << "BlockPool::PinBlock() block=" << block_ptr
-                << " is currently begin written to external memory, "
-                << "cancel failed, waiting.";
+                << " is currently begin written to external memory, canceling.";
 
-            // must still wait for cancellation to complete and the I/O
-            // handler.
-            req->wait();
-        }
-        lock.lock();
+            die_unless(!block_ptr->ext_file_);
 
-        LOGC(debug_em)
-            << "BlockPool::PinBlock() block=" << block_ptr
-            << " is currently begin written to external memory, "
-            << "cancel/wait done.";
+            // a block of a batch is written from the staging buffer, hence it
+            // is only detached and then pinned in memory.
+            if (d_->IntDetachBatchWrite(shard, write_it))
+                continue;
 
-        // recheck whether block is being written, it may have been evicting
-        // the unlocked time.
-    }
+            // get reference count to request, since complete handler removes
+            // it from the map.
+            foxxll::request_ptr req = write_it->second;
+            slock.unlock();
+            lock.unlock();
+            // cancel I/O request
+            if (!req->cancel()) {
 
-    // check if block is being loaded. in this case, just deliver the
-    // shared_future.
-    ReadingMap::iterator read_it = d_->reading_.find(block_ptr);
-    if (read_it != d_->reading_.end())
-        return read_it->second;
+                LOGC(debug_em)
+                    << "BlockPool::PinBlock() block=" << block_ptr
+                    << " is currently begin written to external memory, "
+                    << "cancel failed, waiting.";
 
-    if (block_ptr->in_memory())
-    {
-        // unpinned block in memory, no need to load from EM.
+                // must still wait for cancellation to complete and the I/O
+                // handler.
+                req->wait();
+            }
+            lock.lock();
+            slock.lock();
 
-        // remove from unpinned list
-        die_unless(d_->unpinned_blocks_.exists(block_ptr));
-        d_->unpinned_blocks_.erase(block_ptr);
-        d_->unpinned_bytes_ -= block_ptr->size();
+            LOGC(debug_em)
+                << "BlockPool::PinBlock() block=" << block_ptr
+                << " is currently begin written to external memory, "
+                << "cancel/wait done.";
 
-        IntIncBlockPinCount(block_ptr, local_worker_id);
-        d_->pin_count_.Increment(local_worker_id, block_ptr->size());
+            // recheck whether block is being written, it may have been
+            // evicting the unlocked time.
+            continue;
+        }
 
-        LOGC(debug_pin)
-            << "BlockPool::PinBlock block=" << &block
-            << " pinned from internal memory"
-            << d_->pin_count_;
+        // check if block is being loaded. in this case, just deliver the
+        // shared_future.
+        ReadingMap::iterator read_it = shard.reading_.find(block_ptr);
+        if (read_it != shard.reading_.end()) {
+            if (read_bytes)
+                d_->IntReleaseInternalMemory(read_bytes);
+            return read_it->second;
+        }
 
-        return PinRequestPtr(mem::GPool().make<PinRequest>(
-                                 this, PinnedBlock(block, local_worker_id)));
+        // else need to initiate an async read to get the data.
+        die_unless(!block_ptr->in_memory());
+        die_unless(block_ptr->em_bid_.storage);
+
+        // the buffer for a compressed copy is requested along.
+        size_t need_bytes = block_ptr->size() +
+                            (block_ptr->swap_codec_ != BlockCodec::None
+                             ? Data::SwapBufferSize(block_ptr) : 0);
+        if (read_bytes == need_bytes)
+            break;
+        if (read_bytes)
+            d_->IntReleaseInternalMemory(read_bytes);
+
+        // maybe blocking call until memory is available, this also swaps out
+        // other blocks, possibly of this shard, hence it is unlocked.
+        read_bytes = need_bytes;
+        slock.unlock();
+        d_->IntRequestInternalMemory(lock, read_bytes);
+        slock.lock();
+
+        // recheck the block's state, it may have been pinned in the meantime.
     }
 
-    // else need to initiate an async read to get the data.
-
-    die_unless(block_ptr->em_bid_.storage);
-
-    // maybe blocking call until memory is available, this also swaps out other
-    // blocks.
-    d_->IntRequestInternalMemory(lock, block_ptr->size());
-
     // the requested memory is already counted as a pin.
-    d_->pin_count_.Increment(local_worker_id, block_ptr->size());
+    shard.pin_count_.Increment(local_worker_id, block_ptr->size());
 
     // initiate reading from EM -- already create PinnedBlock, which will hold
     // the read data
     PinRequestPtr read(
         mem::GPool().make<PinRequest>(
             this, PinnedBlock(block, local_worker_id), /* ready */ false));
-    d_->reading_[block_ptr] = read;
+    shard.reading_[block_ptr] = read;
 
-    // allocate block memory.
+    // allocate block memory on the worker's node, and a buffer for the
+    // compressed copy.
+    block_ptr->numa_node_ = d_->worker_node_[local_worker_id];
+    slock.unlock();
     lock.unlock();
     Byte* data = read->byte_block()->data_ =
-        d_->aligned_alloc_.allocate(block_ptr->size());
+        d_->AllocateBlockData(block_ptr->size(), block_ptr->numa_node_);
+    size_t read_size = block_ptr->size();
+    if (block_ptr->swap_codec_ != BlockCodec::None) {
+        read_size = block_ptr->em_bid_.size;
+        data = block_ptr->swap_buffer_ =
+            d_->aligned_alloc_.allocate(Data::SwapBufferSize(block_ptr));
+    }
     lock.lock();
+    slock.lock();
 
     if (!block_ptr->ext_file_) {
-        d_->swapped_.erase(block_ptr);
+        shard.swapped_.erase(block_ptr);
         d_->swapped_bytes_ -= block_ptr->size();
     }
 
     LOGC(debug_em)
         << "BlockPool::PinBlock block=" << block
         << " requested from external memory"
-        << d_->pin_count_;
+        << shard.pin_count_;
 
     // issue I/O request, hold the reference to the request in the hashmap
     read->req_ =
         block_ptr->em_bid_.storage->aread(
             // parameters for the read
-            data, block_ptr->em_bid_.offset, block_ptr->size(),
+            data, block_ptr->em_bid_.offset, read_size,
             // construct an immediate CompletionHandler callback
             foxxll::completion_handler::make<
                 PinRequest, &PinRequest::OnComplete>(*read));
@@ -700,6 +1115,60 @@ PinRequestPtr BlockPool::PinBlock(const Block& block, size_t local_worker_id) {
     return read;
 }
 
+bool BlockPool::Data::IntPinInMemory(
+    BlockPool& bp, Shard& shard, ByteBlock* block_ptr, size_t local_worker_id) {
+
+    if (block_ptr->pin_count_[local_worker_id] > 0) {
+        // pinned by this thread in the meantime.
+
+        die_unless(!shard.unpinned_blocks_.exists(block_ptr));
+        die_unless(shard.reading_.find(block_ptr) == shard.reading_.end());
+
+        bp.IntIncBlockPinCount(block_ptr, local_worker_id);
+        CountRemotePin(block_ptr, local_worker_id);
+        return true;
+    }
+
+    if (block_ptr->IsPinned()) {
+        // This block was already pinned by another thread, hence we only need
+        // to get a pin for the new thread.
+
+        die_unless(!shard.unpinned_blocks_.exists(block_ptr));
+        die_unless(shard.reading_.find(block_ptr) == shard.reading_.end());
+
+        LOGC(debug_pin)
+            << "BlockPool::PinBlock block=" << block_ptr
+            << " already pinned by another thread"
+            << shard.pin_count_;
+
+        bp.IntIncBlockPinCount(block_ptr, local_worker_id);
+        shard.pin_count_.Increment(local_worker_id, block_ptr->size());
+        CountRemotePin(block_ptr, local_worker_id);
+        return true;
+    }
+
+    if (shard.unpinned_blocks_.exists(block_ptr))
+    {
+        // unpinned block in memory, no need to load from EM.
+        die_unless(block_ptr->in_memory());
+
+        // remove from unpinned list
+        shard.EraseUnpinned(block_ptr);
+
+        bp.IntIncBlockPinCount(block_ptr, local_worker_id);
+        shard.pin_count_.Increment(local_worker_id, block_ptr->size());
+        CountRemotePin(block_ptr, local_worker_id);
+
+        LOGC(debug_pin)
+            << "BlockPool::PinBlock block=" << block_ptr
+            << " pinned from internal memory"
+            << shard.pin_count_;
+        return true;
+    }
+
+    return false;
+}
+
 std::pair<size_t, size_t> BlockPool::MaxMergeDegreePrefetch(size_t num_files) {
     size_t avail_bytes = hard_ram_limit() / workers_per_host_ / 2;
     size_t avail_blocks = avail_bytes / default_block_size;
@@ -727,6 +1196,9 @@ void BlockPool::OnReadComplete(
     ByteBlock* block_ptr = read->block_.byte_block().get();
     size_t block_size = block_ptr->size();
 
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+
     LOGC(debug_em)
         << "OnReadComplete():"
         << " req " << req << " block " << *block_ptr
@@ -740,7 +1212,7 @@ void BlockPool::OnReadComplete(
         // e.g. because the Block was deleted.
 
         if (!block_ptr->ext_file_) {
-            d_->swapped_.insert(block_ptr);
+            shard.swapped_.insert(block_ptr);
             d_->swapped_bytes_ += block_size;
         }
 
@@ -748,12 +1220,15 @@ void BlockPool::OnReadComplete(
         sLOGC(debug_alloc)
             << "ByteBlock  deallocate"
             << (void*)read->byte_block()->data_ << "size" << block_size;
-        d_->aligned_alloc_.deallocate(read->byte_block()->data_, block_size);
+        d_->DeallocateBlockData(block_ptr);
+
+        if (block_ptr->swap_buffer_)
+            d_->IntReleaseSwapBuffer(block_ptr);
 
         d_->IntReleaseInternalMemory(block_size);
 
         // the requested memory was already counted as a pin.
-        d_->pin_count_.Decrement(read->block_.local_worker_id_, block_size);
+        shard.pin_count_.Decrement(read->block_.local_worker_id_, block_size);
 
         // set delivered PinnedBlock as invalid.
         read->byte_block().reset();
@@ -763,6 +1238,18 @@ void BlockPool::OnReadComplete(
         // set pin on ByteBlock
         IntIncBlockPinCount(block_ptr, read->block_.local_worker_id_);
 
+        if (block_ptr->swap_codec_ != BlockCodec::None) {
+            // expand compressed copy into the block's memory
+            die_unless(BlockDecompress(
+                           block_ptr->swap_codec_, block_ptr->swap_buffer_,
+                           block_ptr->swap_size_,
+                           block_ptr->data_, block_size));
+
+            d_->IntReleaseSwapBuffer(block_ptr);
+            block_ptr->swap_codec_ = BlockCodec::None;
+            block_ptr->swap_size_ = 0;
+        }
+
         if (!block_ptr->ext_file_) {
             d_->bm_->delete_block(block_ptr->em_bid_);
             block_ptr->em_bid_ = foxxll::BID<0>();
@@ -786,82 +1273,103 @@ void BlockPool::OnReadComplete(
     // all). In that case, deletion of PinRequest will call Unpin, which creates
     // a deadlock on the mutex_. Hence, we first move the PinRequest out of the
     // map, then unlock, and delete it. -tb
-    auto it = d_->reading_.find(block_ptr);
-    die_unless(it != d_->reading_.end());
+    auto it = shard.reading_.find(block_ptr);
+    die_unless(it != shard.reading_.end());
     PinRequestPtr holder = std::move(it->second);
-    d_->reading_.erase(it);
+    shard.reading_.erase(it);
+    slock.unlock();
     lock.unlock();
 }
 
 void BlockPool::IncBlockPinCount(ByteBlock* block_ptr, size_t local_worker_id) {
-    std::unique_lock<std::mutex> lock(mutex_);
     assert(local_worker_id < workers_per_host_);
-    die_unless(block_ptr->pin_count_[local_worker_id] > 0);
-    return IntIncBlockPinCount(block_ptr, local_worker_id);
+    // the worker already holds a pin, hence this never needs the mutex.
+    die_unless(block_ptr->TryIncPinCount(local_worker_id));
+
+    LOGC(debug_pin)
+        << "BlockPool::IncBlockPinCount()"
+        << " byte_block=" << block_ptr
+        << " ++block.pin_count[" << local_worker_id << "]="
+        << block_ptr->pin_count_[local_worker_id];
 }
 
 void BlockPool::IntIncBlockPinCount(ByteBlock* block_ptr, size_t local_worker_id) {
     assert(local_worker_id < workers_per_host_);
 
     ++block_ptr->pin_count_[local_worker_id];
-    ++block_ptr->total_pins_;
 
     LOGC(debug_pin)
         << "BlockPool::IncBlockPinCount()"
         << " byte_block=" << block_ptr
         << " ++block.pin_count[" << local_worker_id << "]="
-        << block_ptr->pin_count_[local_worker_id]
-        << " ++block.total_pins_=" << block_ptr->total_pins_
-        << d_->pin_count_;
+        << block_ptr->pin_count_[local_worker_id];
 }
 
 void BlockPool::DecBlockPinCount(ByteBlock* block_ptr, size_t local_worker_id) {
-    std::unique_lock<std::mutex> lock(mutex_);
-
     assert(local_worker_id < workers_per_host_);
+
+    // fast path: not the last pin of this worker, nothing else changes.
+    if (block_ptr->TryDecPinCount(local_worker_id))
+        return;
+
+    // the last pin of this worker: only the block's shard is locked.
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+
     die_unless(block_ptr->pin_count_[local_worker_id] > 0);
-    die_unless(block_ptr->total_pins_ > 0);
 
     size_t p = --block_ptr->pin_count_[local_worker_id];
-    size_t tp = --block_ptr->total_pins_;
 
     LOGC(debug_pin)
         << "BlockPool::DecBlockPinCount()"
         << " byte_block=" << block_ptr
         << " --block.pin_count[" << local_worker_id << "]=" << p
-        << " --block.total_pins_=" << tp
         << " local_worker_id=" << local_worker_id;
 
-    if (p == 0)
-        d_->IntUnpinBlock(*this, block_ptr, local_worker_id);
+    if (p == 0 && d_->IntUnpinBlock(*this, shard, block_ptr, local_worker_id)) {
+        slock.unlock();
+        d_->NotifyUnpinned(mutex_);
+    }
 }
 
-void BlockPool::Data::IntUnpinBlock(
-    BlockPool& bp, ByteBlock* block_ptr, size_t local_worker_id) {
+bool BlockPool::Data::IntUnpinBlock(
+    BlockPool& bp, Shard& shard, ByteBlock* block_ptr, size_t local_worker_id) {
     die_unless(local_worker_id < bp.workers_per_host_);
 
     // decrease per-thread total pin count (memory locked by thread)
     die_unless(block_ptr->pin_count(local_worker_id) == 0);
 
-    pin_count_.Decrement(local_worker_id, block_ptr->size());
+    shard.pin_count_.Decrement(local_worker_id, block_ptr->size());
 
-    if (block_ptr->total_pins_ != 0) {
+    // the other workers' counts only change from and to zero while holding
+    // the shard's mutex, hence this is exact even with concurrent lock-free
+    // pins and unpins.
+    if (block_ptr->IsPinned()) {
         LOGC(debug_pin)
             << "BlockPool::IntUnpinBlock()"
-            << " --block.total_pins_=" << block_ptr->total_pins_;
-        return;
+            << " block still pinned by " << block_ptr->pin_count_str();
+        return false;
     }
 
-    // if all per-thread pins are zero, allow this Block to be swapped out.
-    die_unless(!unpinned_blocks_.exists(block_ptr));
-    unpinned_blocks_.put(block_ptr);
-    unpinned_bytes_ += block_ptr->size();
+    // if all per-thread pins are zero, allow this Block to be swapped out. The
+    // eviction thread is woken up by the caller via NotifyUnpinned(), since
+    // IntCheckEvictWatermark() requires mutex_.
+    shard.PutUnpinned(block_ptr);
 
     LOGC(debug_pin)
         << "BlockPool::IntUnpinBlock()"
         << " byte_block=" << block_ptr
-        << " --total_pins_=" << block_ptr->total_pins_
         << " allow swap out.";
+    return true;
+}
+
+BlockPool::PinCount BlockPool::Data::IntPinCount() {
+    PinCount pin_count(worker_node_.size());
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        pin_count.Add(shard.pin_count_);
+    }
+    return pin_count;
 }
 
 size_t BlockPool::total_blocks() noexcept {
@@ -870,17 +1378,24 @@ size_t BlockPool::total_blocks() noexcept {
 }
 
 size_t BlockPool::Data::int_total_blocks() noexcept {
+    size_t pinned = 0, unpinned = 0, writing = 0, swapped = 0, reading = 0;
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        pinned += shard.pin_count_.total_pins_;
+        unpinned += shard.unpinned_blocks_.size();
+        writing += shard.writing_.size();
+        swapped += shard.swapped_.size();
+        reading += shard.reading_.size();
+    }
 
     LOG << "BlockPool::total_blocks()"
-        << " pinned_blocks_=" << pin_count_.total_pins_
-        << " unpinned_blocks_=" << unpinned_blocks_.size()
-        << " writing_.size()=" << writing_.size()
-        << " swapped_.size()=" << swapped_.size()
-        << " reading_.size()=" << reading_.size();
-
-    return pin_count_.total_pins_
-           + unpinned_blocks_.size() + writing_.size()
-           + swapped_.size() + reading_.size();
+        << " pinned_blocks_=" << pinned
+        << " unpinned_blocks_=" << unpinned
+        << " writing_.size()=" << writing
+        << " swapped_.size()=" << swapped
+        << " reading_.size()=" << reading;
+
+    return pinned + unpinned + writing + swapped + reading;
 }
 
 size_t BlockPool::hard_ram_limit() noexcept {
@@ -899,41 +1414,76 @@ size_t BlockPool::max_total_bytes() noexcept {
 }
 
 size_t BlockPool::Data::int_total_bytes() noexcept {
+    size_t pinned_bytes = 0, unpinned_bytes = 0;
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        pinned_bytes += shard.pin_count_.total_pinned_bytes_;
+        unpinned_bytes += shard.unpinned_bytes_;
+    }
+
     LOG << "BlockPool::total_bytes()"
-        << " pinned_bytes_=" << pin_count_.total_pinned_bytes_
-        << " unpinned_bytes_=" << unpinned_bytes_
+        << " pinned_bytes_=" << pinned_bytes
+        << " unpinned_bytes_=" << unpinned_bytes
         << " writing_bytes_=" << writing_bytes_
         << " swapped_bytes_=" << swapped_bytes_
         << " reading_bytes_=" << reading_bytes_;
 
-    return pin_count_.total_pinned_bytes_
-           + unpinned_bytes_ + writing_bytes_
+    return pinned_bytes + unpinned_bytes + writing_bytes_
            + swapped_bytes_ + reading_bytes_;
 }
 
 size_t BlockPool::pinned_blocks() noexcept {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->pin_count_.total_pins_;
+    return d_->IntPinCount().total_pins_;
 }
 
 size_t BlockPool::unpinned_blocks() noexcept {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->unpinned_blocks_.size();
+    size_t n = 0;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        n += shard.unpinned_blocks_.size();
+    }
+    return n;
 }
 
 size_t BlockPool::writing_blocks() noexcept {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->writing_.size();
+    size_t n = 0;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        n += shard.writing_.size();
+    }
+    return n;
 }
 
 size_t BlockPool::swapped_blocks() noexcept {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->swapped_.size();
+    size_t n = 0;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        n += shard.swapped_.size();
+    }
+    return n;
 }
 
 size_t BlockPool::reading_blocks() noexcept {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->reading_.size();
+    size_t n = 0;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        n += shard.reading_.size();
+    }
+    return n;
+}
+
+size_t BlockPool::evicted_background_blocks() noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return d_->evict_background_blocks_;
+}
+
+size_t BlockPool::remote_pins() noexcept {
+    return d_->remote_pins_.load();
 }
 
 void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
@@ -941,22 +1491,38 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
     // counter reaches zero to deallocate the block.
     std::unique_lock<std::mutex> lock(mutex_);
 
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+
     LOGC(debug_blc)
         << "BlockPool::DestroyBlock() block_ptr=" << block_ptr
         << " byte_block=" << *block_ptr;
 
     // pinned blocks cannot be destroyed since they are always unpinned first
-    die_unless(block_ptr->total_pins_ == 0);
+    die_unless(!block_ptr->IsPinned());
 
     // delete pin_count_ -> mark block as being deleted
     block_ptr->pin_count_.clear();
 
+    // wait until the write of a block being evicted was issued, which is
+    // canceled below.
+    while (shard.evicting_.count(block_ptr)) {
+        slock.unlock();
+        d_->cv_evicted_.wait(lock);
+        slock.lock();
+    }
+
     do {
         if (block_ptr->in_memory())
         {
             // block was evicted, may still be writing to EM.
-            WritingMap::iterator it = d_->writing_.find(block_ptr);
-            if (it != d_->writing_.end()) {
+            WritingMap::iterator it = shard.writing_.find(block_ptr);
+            if (it != shard.writing_.end()) {
+                // a block of a batch is only detached, its memory is
+                // released below.
+                if (d_->IntDetachBatchWrite(shard, it))
+                    break;
+
                 // get reference count to request, since complete handler
                 // removes it from the map.
                 foxxll::request_ptr req = it->second;
@@ -966,6 +1532,7 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
                     << " canceling write I/O request " << req
                     << " for block " << *block_ptr;
 
+                slock.unlock();
                 lock.unlock();
                 // cancel I/O request
                 if (!req->cancel()) {
@@ -974,6 +1541,7 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
                     req->wait();
                 }
                 lock.lock();
+                slock.lock();
 
                 // recheck whether block is being written, it may have been
                 // evicting the unlocked time.
@@ -983,8 +1551,8 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
         else
         {
             // block was being pinned. cancel read operation
-            ReadingMap::iterator it = d_->reading_.find(block_ptr);
-            if (it != d_->reading_.end()) {
+            ReadingMap::iterator it = shard.reading_.find(block_ptr);
+            if (it != shard.reading_.end()) {
                 // get reference count to request, since complete handler
                 // removes it from the map.
                 foxxll::request_ptr req = it->second->req_;
@@ -994,6 +1562,7 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
                     << " canceling read I/O request " << req
                     << " for block " << *block_ptr;
 
+                slock.unlock();
                 lock.unlock();
                 // cancel I/O request
                 if (!req->cancel()) {
@@ -1002,6 +1571,7 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
                     req->wait();
                 }
                 lock.lock();
+                slock.lock();
 
                 // recheck whether block is being read, it may have been
                 // evicting again in the unlocked time.
@@ -1017,15 +1587,13 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
             << "BlockPool::DestroyBlock() block_ptr=" << block_ptr
             << " external block, in memory: release memory.";
 
-        die_unless(d_->unpinned_blocks_.exists(block_ptr));
-        d_->unpinned_blocks_.erase(block_ptr);
-        d_->unpinned_bytes_ -= block_ptr->size();
+        shard.EraseUnpinned(block_ptr);
 
         // release memory
         sLOGC(debug_alloc)
             << "ByteBlock deallocate"
             << (void*)block_ptr->data_ << "size" << block_ptr->size();
-        d_->aligned_alloc_.deallocate(block_ptr->data_, block_ptr->size());
+        d_->DeallocateBlockData(block_ptr);
         block_ptr->data_ = nullptr;
 
         d_->IntReleaseInternalMemory(block_ptr->size());
@@ -1043,16 +1611,14 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
             << "BlockPool::DestroyBlock() block_ptr=" << block_ptr
             << " unpinned block in memory, remove from list";
 
-        if (d_->unpinned_blocks_.exists(block_ptr)) {
-            d_->unpinned_blocks_.erase(block_ptr);
-            d_->unpinned_bytes_ -= block_ptr->size();
-        }
+        if (shard.unpinned_blocks_.exists(block_ptr))
+            shard.EraseUnpinned(block_ptr);
 
         // release memory
         sLOGC(debug_alloc)
             << "ByteBlock deallocate"
             << (void*)block_ptr->data_ << "size" << block_ptr->size();
-        d_->aligned_alloc_.deallocate(block_ptr->data_, block_ptr->size());
+        d_->DeallocateBlockData(block_ptr);
         block_ptr->data_ = nullptr;
 
         d_->IntReleaseInternalMemory(block_ptr->size());
@@ -1063,15 +1629,17 @@ void BlockPool::DestroyBlock(ByteBlock* block_ptr) {
             << "BlockPool::DestroyBlock() block_ptr=" << block_ptr
             << " block in external memory, delete block";
 
-        auto it = d_->swapped_.find(block_ptr);
-        die_unless(it != d_->swapped_.end());
+        auto it = shard.swapped_.find(block_ptr);
+        die_unless(it != shard.swapped_.end());
 
-        d_->swapped_.erase(it);
+        shard.swapped_.erase(it);
         d_->swapped_bytes_ -= block_ptr->size();
 
         d_->bm_->delete_block(block_ptr->em_bid_);
         block_ptr->em_bid_ = foxxll::BID<0>();
+        block_ptr->swap_codec_ = BlockCodec::None;
     }
+    slock.unlock();
 
     assert(d_->total_byte_blocks_ > 0);
     assert(d_->total_bytes_ >= block_ptr->size());
@@ -1090,6 +1658,10 @@ void BlockPool::Data::IntRequestInternalMemory(
 
     requested_bytes_ += size;
 
+    // let the eviction thread catch up, such that hopefully the following
+    // loops do not have to evict blocks in this thread.
+    IntCheckEvictWatermark();
+
     LOGC(debug_mem)
         << "BlockPool::RequestInternalMemory()"
         << " size=" << size
@@ -1098,16 +1670,16 @@ void BlockPool::Data::IntRequestInternalMemory(
         << " requested_bytes_=" << requested_bytes_
         << " soft_ram_limit_=" << soft_ram_limit_
         << " hard_ram_limit_=" << hard_ram_limit_
-        << pin_count_
-        << " unpinned_blocks_.size()=" << unpinned_blocks_.size()
-        << " swapped_.size()=" << swapped_.size();
+        << IntPinCount()
+        << " unpinned_blocks=" << IntUnpinnedBlocks()
+        << " swapped_bytes_=" << swapped_bytes_;
 
     while (soft_ram_limit_ != 0 &&
-           unpinned_blocks_.size() &&
+           IntUnpinnedBlocks() &&
            total_ram_bytes_ + requested_bytes_ > soft_ram_limit_ + writing_bytes_)
     {
         // evict blocks: schedule async writing which increases writing_bytes_.
-        IntEvictBlockLRU();
+        IntEvictBlockLRU(lock);
     }
 
     // wait up to 60 seconds for other threads to free up memory or pins
@@ -1119,11 +1691,11 @@ void BlockPool::Data::IntRequestInternalMemory(
     while (hard_ram_limit_ != 0 && total_ram_bytes_ + size > hard_ram_limit_)
     {
         while (hard_ram_limit_ != 0 &&
-               unpinned_blocks_.size() &&
+               IntUnpinnedBlocks() &&
                total_ram_bytes_ + requested_bytes_ > hard_ram_limit_ + writing_bytes_)
         {
             // evict blocks: schedule async writing which increases writing_bytes_.
-            IntEvictBlockLRU();
+            IntEvictBlockLRU(lock);
         }
 
         cv_memory_change_.wait_for(lock, std::chrono::seconds(1));
@@ -1135,9 +1707,9 @@ void BlockPool::Data::IntRequestInternalMemory(
             << " requested_bytes_=" << requested_bytes_
             << " soft_ram_limit_=" << soft_ram_limit_
             << " hard_ram_limit_=" << hard_ram_limit_
-            << pin_count_
-            << " unpinned_blocks_.size()=" << unpinned_blocks_.size()
-            << " swapped_.size()=" << swapped_.size();
+            << IntPinCount()
+            << " unpinned_blocks=" << IntUnpinnedBlocks()
+            << " swapped_bytes_=" << swapped_bytes_;
 
         if (writing_bytes_ == 0 &&
             total_ram_bytes_ + requested_bytes_ > hard_ram_limit_) {
@@ -1148,9 +1720,9 @@ void BlockPool::Data::IntRequestInternalMemory(
                  << " requested_bytes_=" << requested_bytes_
                  << " soft_ram_limit_=" << soft_ram_limit_
                  << " hard_ram_limit_=" << hard_ram_limit_
-                 << pin_count_
-                 << " unpinned_blocks_.size()=" << unpinned_blocks_.size()
-                 << " swapped_.size()=" << swapped_.size();
+                 << IntPinCount()
+                 << " unpinned_blocks=" << IntUnpinnedBlocks()
+                 << " swapped_bytes_=" << swapped_bytes_;
 
             if (writing_bytes_ == last_writing_bytes) {
                 if (--retry == 0)
@@ -1178,17 +1750,25 @@ void BlockPool::AdviseFree(size_t size) {
         << " requested_bytes_=" << d_->requested_bytes_
         << " soft_ram_limit_=" << d_->soft_ram_limit_
         << " hard_ram_limit_=" << d_->hard_ram_limit_
-        << d_->pin_count_
-        << " unpinned_blocks_.size()=" << d_->unpinned_blocks_.size()
-        << " swapped_.size()=" << d_->swapped_.size();
+        << d_->IntPinCount()
+        << " unpinned_blocks=" << d_->IntUnpinnedBlocks()
+        << " swapped_bytes_=" << d_->swapped_bytes_;
 
-    while (d_->soft_ram_limit_ != 0 && d_->unpinned_blocks_.size() &&
+    while (d_->soft_ram_limit_ != 0 && d_->IntUnpinnedBlocks() &&
            d_->total_ram_bytes_ + d_->requested_bytes_ + size > d_->hard_ram_limit_ + d_->writing_bytes_)
     {
         // evict blocks: schedule async writing which increases writing_bytes_.
-        d_->IntEvictBlockLRU();
+        d_->IntEvictBlockLRU(lock);
     }
 }
+
+void BlockPool::AdviseWillNeed(ByteBlock* block_ptr) {
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+    // move block to the most recently used end of the LRU list, if unpinned.
+    shard.unpinned_blocks_.touch_if_exists(block_ptr);
+}
+
 void BlockPool::ReleaseInternalMemory(size_t size) {
     std::unique_lock<std::mutex> lock(mutex_);
     return d_->IntReleaseInternalMemory(size);
@@ -1207,41 +1787,211 @@ void BlockPool::Data::IntReleaseInternalMemory(size_t size) {
     cv_memory_change_.notify_all();
 }
 
+void BlockPool::set_swap_codec(BlockCodec codec) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    die_unless(BlockCodecAvailable(codec));
+    d_->swap_codec_ = codec;
+}
+
+BlockCodec BlockPool::swap_codec() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return d_->swap_codec_;
+}
+
 void BlockPool::EvictBlock(ByteBlock* block_ptr) {
     std::unique_lock<std::mutex> lock(mutex_);
 
     die_unless(block_ptr->in_memory());
 
-    die_unless(d_->unpinned_blocks_.exists(block_ptr));
-    d_->unpinned_blocks_.erase(block_ptr);
-    d_->unpinned_bytes_ -= block_ptr->size();
+    {
+        Shard& shard = d_->shard(block_ptr);
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        shard.EraseUnpinned(block_ptr);
+        if (!d_->IntPrepareEvictBlock(shard, block_ptr))
+            return;
+    }
 
-    d_->IntEvictBlock(block_ptr);
+    d_->IntEvictBlock(lock, block_ptr);
 }
 
 foxxll::request_ptr BlockPool::GetAnyWriting() {
     std::unique_lock<std::mutex> lock(mutex_);
-    if (!d_->writing_.size()) return foxxll::request_ptr();
-    return d_->writing_.begin()->second;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        if (shard.writing_.size())
+            return shard.writing_.begin()->second;
+    }
+    return foxxll::request_ptr();
 }
 
 foxxll::request_ptr BlockPool::EvictBlockLRU() {
     std::unique_lock<std::mutex> lock(mutex_);
-    return d_->IntEvictBlockLRU();
+    return d_->IntEvictBlockLRU(lock);
+}
+
+foxxll::request_ptr BlockPool::Data::IntEvictBlockLRU(
+    std::unique_lock<std::mutex>& lock) {
+
+    ByteBlock* block_ptr;
+    if (!IntPopVictim(block_ptr)) return foxxll::request_ptr();
+    ++evict_foreground_blocks_;
+
+    // memory of a block mapped from an external file is already released.
+    if (!block_ptr) return foxxll::request_ptr();
+
+    return IntEvictBlock(lock, block_ptr);
+}
+
+bool BlockPool::Data::IntPopVictim(ByteBlock*& victim) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[evict_shard_];
+        evict_shard_ = (evict_shard_ + 1) & (shards_.size() - 1);
+
+        if (!shard.num_unpinned_.load(std::memory_order_relaxed))
+            continue;
+
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        if (!shard.unpinned_blocks_.size()) continue;
+
+        ByteBlock* block_ptr = shard.PopUnpinned();
+        victim = IntPrepareEvictBlock(shard, block_ptr) ? block_ptr : nullptr;
+        return true;
+    }
+    return false;
+}
+
+void BlockPool::Data::IntEvictBatch(
+    std::unique_lock<std::mutex>& lock, size_t target_free) {
+    std::vector<ByteBlock*> batch;
+    size_t batch_bytes = 0;
+
+    ByteBlock* block_ptr;
+    while (IntFreeBytes() < target_free && batch_bytes < evict_batch_bytes_ &&
+           IntPopVictim(block_ptr))
+    {
+        ++evict_background_blocks_;
+        if (!block_ptr) continue;
+
+        batch_bytes += block_ptr->size();
+        batch.push_back(block_ptr);
+    }
+
+    IntEvictBlocks(lock, batch);
+
+    LOGC(debug_em)
+        << "IntEvictBatch(): evicted " << batch_bytes << " bytes"
+        << " in " << batch.size() << " blocks,"
+        << " free bytes " << IntFreeBytes();
+}
+
+void BlockPool::EvictThread() {
+    common::NameThisThread("block pool evict");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // whether evicting until the high watermark is reached
+    bool active = false;
+
+    while (!d_->evict_terminate_)
+    {
+        size_t free = d_->IntFreeBytes();
+
+        size_t unpinned = d_->IntUnpinnedBlocks();
+
+        if (unpinned == 0 || free >= d_->evict_high_watermark_)
+            active = false;
+        else if (free < d_->evict_low_watermark_)
+            active = true;
+
+        if (!active) {
+            if (unpinned == 0 && free < d_->evict_low_watermark_) {
+                // short of memory: ask NotifyUnpinned() for a wake-up, and
+                // recheck for blocks unpinned before the flag was visible.
+                d_->evict_waiting_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (d_->IntUnpinnedBlocks() == 0)
+                    d_->cv_evict_.wait(lock);
+                d_->evict_waiting_.store(false, std::memory_order_relaxed);
+            }
+            else {
+                d_->cv_evict_.wait(lock);
+            }
+            continue;
+        }
+
+        d_->IntEvictBatch(lock, d_->evict_high_watermark_);
+
+        // let workers and I/O handlers in between batches
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+foxxll::request_ptr BlockPool::Data::IntEvictBlock(
+    std::unique_lock<std::mutex>& lock, ByteBlock* block_ptr) {
+    IntEvictBlocks(lock, std::vector<ByteBlock*>(1, block_ptr));
+
+    Shard& shard = this->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+    WritingMap::iterator it = shard.writing_.find(block_ptr);
+    if (it == shard.writing_.end()) return foxxll::request_ptr();
+    return it->second;
 }
 
-foxxll::request_ptr BlockPool::Data::IntEvictBlockLRU() {
+void BlockPool::Data::IntEvictBlocks(
+    std::unique_lock<std::mutex>& lock,
+    const std::vector<ByteBlock*>& blocks) {
+
+    // blocks to write, and the codec to compress them with
+    std::vector<std::pair<ByteBlock*, BlockCodec> > batch;
+    bool compress = false;
+
+    for (ByteBlock* block_ptr : blocks) {
+        BlockCodec codec = SwapCodec(block_ptr);
+        if (block_ptr->size() <= THRILL_DEFAULT_ALIGN)
+            codec = BlockCodec::None;
+
+        if (codec != BlockCodec::None) {
+            // the swap buffer is counted without waiting for the hard limit,
+            // since the block's larger memory is released after writing.
+            total_ram_bytes_ += SwapBufferSize(block_ptr);
+            compress = true;
+        }
+        batch.emplace_back(block_ptr, codec);
+    }
 
-    if (!unpinned_blocks_.size()) return foxxll::request_ptr();
+    if (compress) {
+        // compress without holding the mutex. Pinning or destroying a block
+        // in evicting_ waits until its write is issued.
+        lock.unlock();
+        for (const std::pair<ByteBlock*, BlockCodec>& b : batch) {
+            if (b.second != BlockCodec::None)
+                CompressSwapBlock(b.first, b.second);
+        }
+        lock.lock();
 
-    ByteBlock* block_ptr = unpinned_blocks_.pop();
-    die_unless(block_ptr);
-    unpinned_bytes_ -= block_ptr->size();
+        for (const std::pair<ByteBlock*, BlockCodec>& b : batch) {
+            if (b.second == BlockCodec::None) continue;
+            // release the swap buffer's memory if compression did not pay off
+            if (!b.first->swap_buffer_)
+                IntReleaseInternalMemory(SwapBufferSize(b.first));
+        }
+    }
 
-    return IntEvictBlock(block_ptr);
+    if (blocks.size() == 1) {
+        IntAllocateEmBlock(blocks[0]);
+        IntWriteBlock(blocks[0]);
+    }
+    else if (blocks.size() > 1) {
+        IntWriteBatch(lock, blocks);
+    }
+
+    if (blocks.size())
+        cv_evicted_.notify_all();
 }
 
-foxxll::request_ptr BlockPool::Data::IntEvictBlock(ByteBlock* block_ptr) {
+bool BlockPool::Data::IntPrepareEvictBlock(Shard& shard, ByteBlock* block_ptr) {
 
     // die_unless(block_ptr->block_pool_ == this);
 
@@ -1256,11 +2006,11 @@ foxxll::request_ptr BlockPool::Data::IntEvictBlock(ByteBlock* block_ptr) {
         sLOGC(debug_alloc)
             << "ByteBlock deallocate"
             << (void*)block_ptr->data_ << "size" << block_ptr->size();
-        aligned_alloc_.deallocate(block_ptr->data_, block_ptr->size());
+        DeallocateBlockData(block_ptr);
         block_ptr->data_ = nullptr;
 
         IntReleaseInternalMemory(block_ptr->size());
-        return foxxll::request_ptr();
+        return false;
     }
 
     if (!notify_em_used_) {
@@ -1273,25 +2023,145 @@ foxxll::request_ptr BlockPool::Data::IntEvictBlock(ByteBlock* block_ptr) {
 
     die_unless(block_ptr->em_bid_.storage == nullptr);
 
-    // allocate EM block
-    block_ptr->em_bid_.size = block_ptr->size();
+    writing_bytes_ += block_ptr->size();
+    shard.evicting_.insert(block_ptr);
+    return true;
+}
+
+void BlockPool::Data::CompressSwapBlock(
+    ByteBlock* block_ptr, BlockCodec codec) {
+
+    size_t capacity = SwapBufferSize(block_ptr);
+    Byte* buffer = aligned_alloc_.allocate(capacity);
+
+    size_t csize = BlockCompress(
+        codec, block_ptr->data_, block_ptr->size(), buffer, capacity);
+
+    if (csize != 0) {
+        block_ptr->swap_codec_ = codec;
+        block_ptr->swap_size_ = csize;
+        block_ptr->swap_buffer_ = buffer;
+    }
+    else {
+        aligned_alloc_.deallocate(buffer, capacity);
+    }
+}
+
+void BlockPool::Data::IntAllocateEmBlock(ByteBlock* block_ptr) {
+    // write the compressed copy rounded up to I/O blocks, if any.
+    size_t write_size = block_ptr->size();
+    if (block_ptr->swap_buffer_) {
+        write_size = (block_ptr->swap_size_ + THRILL_DEFAULT_ALIGN - 1)
+                     / THRILL_DEFAULT_ALIGN * THRILL_DEFAULT_ALIGN;
+    }
+
+    block_ptr->em_bid_.size = write_size;
     bm_->new_block(foxxll::fully_random(), block_ptr->em_bid_);
 
     LOGC(debug_em)
         << "EvictBlock(): " << block_ptr << " - " << *block_ptr
-        << " to em_bid " << block_ptr->em_bid_;
+        << " to em_bid " << block_ptr->em_bid_
+        << " codec " << BlockCodecName(block_ptr->swap_codec_);
+}
 
-    writing_bytes_ += block_ptr->size();
+foxxll::request_ptr BlockPool::Data::IntWriteBlock(ByteBlock* block_ptr) {
+    Shard& shard = this->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+    die_unequal(shard.evicting_.erase(block_ptr), 1u);
+
+    // write either the block or its compressed copy
+    Byte* write_data = block_ptr->swap_buffer_
+                       ? block_ptr->swap_buffer_ : block_ptr->data_;
 
     // initiate writing to EM.
     foxxll::request_ptr req =
         block_ptr->em_bid_.storage->awrite(
-            block_ptr->data_, block_ptr->em_bid_.offset, block_ptr->size(),
+            write_data, block_ptr->em_bid_.offset, block_ptr->em_bid_.size,
             // construct an immediate CompletionHandler callback
             foxxll::completion_handler::make<
                 ByteBlock, &ByteBlock::OnWriteComplete>(block_ptr));
 
-    return (writing_[block_ptr] = std::move(req));
+    return (shard.writing_[block_ptr] = std::move(req));
+}
+
+void BlockPool::Data::IntWriteBatch(
+    std::unique_lock<std::mutex>& lock,
+    const std::vector<ByteBlock*>& blocks) {
+
+    std::unique_ptr<WriteBatch> batch = std::make_unique<WriteBatch>();
+    batch->block_pool_ = &block_pool_;
+    batch->blocks_ = blocks;
+
+    // each block or its compressed copy takes an aligned part of the extent.
+    std::vector<size_t> write_size(blocks.size());
+    size_t total_size = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        size_t size = blocks[i]->swap_buffer_
+                      ? blocks[i]->swap_size_ : blocks[i]->size();
+        write_size[i] = size;
+        total_size += (size + THRILL_DEFAULT_ALIGN - 1)
+                      / THRILL_DEFAULT_ALIGN * THRILL_DEFAULT_ALIGN;
+    }
+    batch->size_ = total_size;
+
+    // allocate one extent, consecutive batches are striped over the disks.
+    foxxll::BID<0> extent;
+    extent.size = total_size;
+    bm_->new_block(foxxll::striping(), extent, num_write_batches_++);
+
+    size_t offset = extent.offset;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        size_t size = (write_size[i] + THRILL_DEFAULT_ALIGN - 1)
+                      / THRILL_DEFAULT_ALIGN * THRILL_DEFAULT_ALIGN;
+        blocks[i]->em_bid_ = foxxll::BID<0>(extent.storage, offset, size);
+        offset += size;
+
+        LOGC(debug_em)
+            << "EvictBlock(): " << blocks[i] << " - " << *blocks[i]
+            << " to em_bid " << blocks[i]->em_bid_
+            << " codec " << BlockCodecName(blocks[i]->swap_codec_);
+    }
+
+    // the staging buffer is counted without waiting for the hard limit, like
+    // the swap buffers, since the blocks' memory is released after writing.
+    total_ram_bytes_ += total_size;
+
+    // gather the blocks without holding the mutex, they are in evicting_.
+    lock.unlock();
+    batch->buffer_ = aligned_alloc_.allocate(total_size);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        ByteBlock* block_ptr = blocks[i];
+        Byte* dest = batch->buffer_ +
+                     (block_ptr->em_bid_.offset - extent.offset);
+        std::copy_n(block_ptr->swap_buffer_
+                    ? block_ptr->swap_buffer_ : block_ptr->data_,
+                    write_size[i], dest);
+        std::fill(dest + write_size[i], dest + block_ptr->em_bid_.size,
+                  Byte(0));
+    }
+    lock.lock();
+
+    // the compressed copies are in the staging buffer now.
+    for (ByteBlock* block_ptr : blocks) {
+        if (block_ptr->swap_buffer_)
+            IntReleaseSwapBuffer(block_ptr);
+    }
+
+    // issue the single write request, the completion handler waits for the
+    // mutex until the batch is registered.
+    foxxll::request_ptr req = batch->req_ = extent.storage->awrite(
+        batch->buffer_, extent.offset, total_size,
+        foxxll::completion_handler::make<
+            WriteBatch, &WriteBatch::OnComplete>(batch.get()));
+
+    for (ByteBlock* block_ptr : blocks) {
+        Shard& shard = this->shard(block_ptr);
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        die_unequal(shard.evicting_.erase(block_ptr), 1u);
+        shard.writing_[block_ptr] = req;
+    }
+
+    write_batches_[req.get()] = std::move(batch);
 }
 
 void BlockPool::OnWriteComplete(
@@ -1304,9 +2174,57 @@ void BlockPool::OnWriteComplete(
         << " success = " << success;
     req->check_errors();
 
+    Shard& shard = d_->shard(block_ptr);
+    std::unique_lock<std::mutex> slock(shard.mutex_);
+
     die_unless(!block_ptr->ext_file_);
-    die_unequal(d_->writing_.erase(block_ptr), 1u);
-    d_->writing_bytes_ -= block_ptr->size();
+    die_unequal(shard.writing_.erase(block_ptr), 1u);
+    d_->IntWriteDone(shard, block_ptr, success);
+}
+
+void BlockPool::OnWriteBatchComplete(
+    WriteBatch* batch, foxxll::request* req, bool success) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    LOGC(debug_em)
+        << "OnWriteBatchComplete(): request " << req << " done,"
+        << " blocks " << batch->blocks_.size()
+        << " detached " << batch->detached_.size()
+        << " success = " << success;
+    req->check_errors();
+
+    for (ByteBlock* block_ptr : batch->blocks_) {
+        Shard& shard = d_->shard(block_ptr);
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+
+        // skip blocks detached from the batch, they may even be deleted or
+        // written again by another request.
+        WritingMap::iterator it = shard.writing_.find(block_ptr);
+        if (it == shard.writing_.end() || it->second.get() != req)
+            continue;
+
+        shard.writing_.erase(it);
+        d_->IntWriteDone(shard, block_ptr, success);
+    }
+
+    for (const foxxll::BID<0>& bid : batch->detached_)
+        d_->bm_->delete_block(bid);
+
+    d_->aligned_alloc_.deallocate(batch->buffer_, batch->size_);
+    d_->IntReleaseInternalMemory(batch->size_);
+
+    // deletes the batch, whose handler only returns afterwards.
+    die_unequal(d_->write_batches_.erase(req), 1u);
+}
+
+void BlockPool::Data::IntWriteDone(
+    Shard& shard, ByteBlock* block_ptr, bool success, WriteBatch* batch) {
+
+    writing_bytes_ -= block_ptr->size();
+
+    // the compressed copy is not needed any more, or was written.
+    if (block_ptr->swap_buffer_)
+        IntReleaseSwapBuffer(block_ptr);
 
     if (!success)
     {
@@ -1314,33 +2232,54 @@ void BlockPool::OnWriteComplete(
         // e.g. because the block was deleted or if it was re-pinned while being
         // written to disk.
 
-        if (!block_ptr->is_deleted()) {
-            die_unless(!d_->unpinned_blocks_.exists(block_ptr));
-            d_->unpinned_blocks_.put(block_ptr);
-            d_->unpinned_bytes_ += block_ptr->size();
-        }
+        if (!block_ptr->is_deleted())
+            shard.PutUnpinned(block_ptr);
 
-        d_->bm_->delete_block(block_ptr->em_bid_);
+        if (batch)
+            batch->detached_.push_back(block_ptr->em_bid_);
+        else
+            bm_->delete_block(block_ptr->em_bid_);
         block_ptr->em_bid_ = foxxll::BID<0>();
+        block_ptr->swap_codec_ = BlockCodec::None;
+        block_ptr->swap_size_ = 0;
     }
     else
     {
         // success
 
-        d_->swapped_.insert(block_ptr);
-        d_->swapped_bytes_ += block_ptr->size();
+        shard.swapped_.insert(block_ptr);
+        swapped_bytes_ += block_ptr->size();
 
         // release memory
         sLOGC(debug_alloc)
             << "ByteBlock deallocate"
             << (void*)block_ptr->data_ << "size" << block_ptr->size();
-        d_->aligned_alloc_.deallocate(block_ptr->data_, block_ptr->size());
+        DeallocateBlockData(block_ptr);
         block_ptr->data_ = nullptr;
 
-        d_->IntReleaseInternalMemory(block_ptr->size());
+        IntReleaseInternalMemory(block_ptr->size());
     }
 }
 
+bool BlockPool::Data::IntDetachBatchWrite(
+    Shard& shard, WritingMap::iterator it) {
+
+    auto batch_it = write_batches_.find(it->second.get());
+    if (batch_it == write_batches_.end()) return false;
+
+    ByteBlock* block_ptr = it->first;
+    shard.writing_.erase(it);
+
+    LOGC(debug_em)
+        << "IntDetachBatchWrite(): block " << block_ptr
+        << " detached from batch " << batch_it->second.get();
+
+    // the block's memory was not written, its part of the extent is freed
+    // once the batch's request completed.
+    IntWriteDone(shard, block_ptr, /* success */ false, batch_it->second.get());
+    return true;
+}
+
 void BlockPool::RunTask(const std::chrono::steady_clock::time_point& tp) {
     std::unique_lock<std::mutex> lock(mutex_);
 
@@ -1357,30 +2296,48 @@ void BlockPool::RunTask(const std::chrono::steady_clock::time_point& tp) {
     // LOG0 << stp;
     // LOG0 << stf;
 
-    size_t unpinned_bytes = d_->unpinned_bytes_.hmax_update();
+    // the maxima of the shards' counters are summed up, which is an upper
+    // bound of the maximum of the total.
+    size_t unpinned_bytes = 0, pinned_bytes = 0;
+    size_t pinned_blocks = 0, unpinned_blocks = 0;
+    size_t writing_blocks = 0, swapped_blocks = 0, reading_blocks = 0;
+    size_t max_pinned_blocks = 0, max_pinned_bytes = 0;
+    for (Shard& shard : d_->shards_) {
+        std::unique_lock<std::mutex> slock(shard.mutex_);
+        unpinned_bytes += shard.unpinned_bytes_.hmax_update();
+        pinned_bytes += shard.pin_count_.total_pinned_bytes_.hmax_update();
+        pinned_blocks += shard.pin_count_.total_pins_;
+        unpinned_blocks += shard.unpinned_blocks_.size();
+        writing_blocks += shard.writing_.size();
+        swapped_blocks += shard.swapped_.size();
+        reading_blocks += shard.reading_.size();
+        max_pinned_blocks += shard.pin_count_.max_pins;
+        max_pinned_bytes += shard.pin_count_.max_pinned_bytes;
+    }
     size_t writing_bytes = d_->writing_bytes_.hmax_update();
     size_t reading_bytes = d_->reading_bytes_.hmax_update();
-    size_t pinned_bytes = d_->pin_count_.total_pinned_bytes_.hmax_update();
 
     logger_ << "class" << "BlockPool"
             << "event" << "profile"
-            << "total_blocks" << d_->int_total_blocks()
+            << "total_blocks"
+            << (pinned_blocks + unpinned_blocks + writing_blocks
+                + swapped_blocks + reading_blocks)
             << "total_bytes" << d_->total_bytes_.hmax_update()
             << "max_total_bytes" << d_->max_total_bytes_
             << "total_ram_bytes" << d_->total_ram_bytes_.hmax_update()
             << "ram_bytes"
             << (unpinned_bytes + pinned_bytes + writing_bytes + reading_bytes)
-            << "pinned_blocks" << d_->pin_count_.total_pins_
+            << "pinned_blocks" << pinned_blocks
             << "pinned_bytes" << pinned_bytes
-            << "unpinned_blocks" << d_->unpinned_blocks_.size()
+            << "unpinned_blocks" << unpinned_blocks
             << "unpinned_bytes" << unpinned_bytes
-            << "swapped_blocks" << d_->swapped_.size()
+            << "swapped_blocks" << swapped_blocks
             << "swapped_bytes" << d_->swapped_bytes_.hmax_update()
-            << "max_pinned_blocks" << d_->pin_count_.max_pins
-            << "max_pinned_bytes" << d_->pin_count_.max_pinned_bytes
-            << "writing_blocks" << d_->writing_.size()
+            << "max_pinned_blocks" << max_pinned_blocks
+            << "max_pinned_bytes" << max_pinned_bytes
+            << "writing_blocks" << writing_blocks
             << "writing_bytes" << writing_bytes
-            << "reading_blocks" << d_->reading_.size()
+            << "reading_blocks" << reading_blocks
             << "reading_bytes" << reading_bytes
             << "rd_ops_total" << stf.get_read_count()
             << "rd_bytes_total" << stf.get_read_bytes()
@@ -1392,7 +2349,10 @@ void BlockPool::RunTask(const std::chrono::steady_clock::time_point& tp) {
             << "wr_ops" << stp.get_write_count()
             << "wr_bytes" << stp.get_write_bytes()
             << "wr_speed" << static_cast<double>(stp.get_write_bytes()) / elapsed
-            << "disk_allocation" << d_->bm_->current_allocation();
+            << "disk_allocation" << d_->bm_->current_allocation()
+            << "evict_background_blocks" << d_->evict_background_blocks_
+            << "evict_foreground_blocks" << d_->evict_foreground_blocks_
+            << "remote_pins" << d_->remote_pins_.load();
 }
 
 size_t BlockPool::next_file_id() {
@@ -26,6 +26,7 @@
 #include <functional>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -35,9 +36,29 @@ namespace data {
 //! \addtogroup data_layer
 //! \{
 
+//! page size of the hugepage arena for ByteBlock memory, zero allocates
+//! ByteBlocks with the aligned allocator. Set by THRILL_HUGEPAGES.
+extern size_t default_hugepage_size;
+
 /*!
  * Pool to allocate, keep, swap out/in, and free all ByteBlocks on the host.
  * Starts a backgroud thread which is responsible for disk I/O
+ *
+ * With a soft RAM limit, an additional eviction thread keeps free memory below
+ * the soft limit between a low and a high watermark by writing out unpinned
+ * Blocks ahead of demand, such that workers rarely have to evict Blocks
+ * themselves in RequestInternalMemory() or AllocateByteBlock().
+ *
+ * The states of the ByteBlocks -- the LRU list of unpinned Blocks, their pin
+ * counters, and the sets of Blocks being written, read, or swapped -- are
+ * split into shards by hashing the ByteBlock's address, each with its own
+ * mutex. Pinning and unpinning Blocks in memory only locks the Block's shard,
+ * while the memory accounting, eviction and I/O additionally lock mutex_,
+ * which is always locked before a shard's mutex.
+ *
+ * If default_hugepage_size is set, ByteBlock memory is carved out of a
+ * mem::NumaArena, and each worker's ByteBlocks are placed on the NUMA node of
+ * the cpu it is pinned to, see SetWorkerCpus().
  */
 class BlockPool : public common::ProfileTask
 {
@@ -99,6 +120,10 @@ public:
     //! future request.
     void AdviseFree(size_t size);
 
+    //! Advise the block pool that an unpinned Block will be read soon, which
+    //! makes it the last victim for eviction.
+    void AdviseWillNeed(ByteBlock* block_ptr);
+
     //! Return any currently being written block (for waiting on completion)
     foxxll::request_ptr GetAnyWriting();
 
@@ -106,6 +131,11 @@ public:
     //! nullptr if no blocks available, or if the Block was not dirty.
     foxxll::request_ptr EvictBlockLRU();
 
+    //! Set the cpus the workers are pinned to: local worker i runs on cpu
+    //! cpus[i]. Used to place the workers' ByteBlocks on their NUMA nodes,
+    //! must be called before the workers start.
+    void SetWorkerCpus(const std::vector<size_t>& cpus);
+
     //! Allocates a byte block with the request size. May block this thread if
     //! the hard memory limit is reached, until memory is freed by another
     //! thread.  The returned Block is allocated in RAM, but with a zero pin
@@ -130,6 +160,13 @@ public:
     //! swapped.
     void EvictBlock(ByteBlock* block_ptr);
 
+    //! Set the codec to compress Blocks with when swapping them out, None
+    //! disables compression. Files may override this per ByteBlock.
+    void set_swap_codec(BlockCodec codec);
+
+    //! Returns the codec to compress Blocks with when swapping them out.
+    BlockCodec swap_codec();
+
     //! \name Block Statistics
     //! \{
 
@@ -160,6 +197,13 @@ public:
     //! Total number of blocks currently begin read from EM.
     size_t reading_blocks() noexcept;
 
+    //! Total number of blocks evicted by the background eviction thread.
+    size_t evicted_background_blocks() noexcept;
+
+    //! Total number of pins of Blocks in memory on another NUMA node than the
+    //! node of the pinning worker.
+    size_t remote_pins() noexcept;
+
     //! \}
 
     //! \name Methods for ProfileTask
@@ -177,7 +221,8 @@ public:
     std::pair<size_t, size_t> MaxMergeDegreePrefetch(size_t num_files);
 
 private:
-    //! locked before internal state is changed
+    //! locked before the memory accounting is changed, and before any
+    //! shard's mutex.
     std::mutex mutex_;
 
     //! For waiting on read/pin requests to finish (we use only one
@@ -199,21 +244,34 @@ private:
     //! substructure containing pin counters
     struct PinCount;
 
+    //! states of the ByteBlocks of one shard, with their own mutex
+    struct Shard;
+
+    //! evicted blocks written into one extent by a single request
+    struct WriteBatch;
+
     //! pimpl data structure
     class Data;
 
     //! pimpl data structure
     std::unique_ptr<Data> d_;
 
-    //! Increment a ByteBlock's pin count - without locking the mutex
+    //! Increment a ByteBlock's pin count - with the block's shard locked
     void IntIncBlockPinCount(ByteBlock* block_ptr, size_t local_worker_id);
 
     //! callback for async write of blocks during eviction
     void OnWriteComplete(ByteBlock* block_ptr, foxxll::request* req, bool success);
 
+    //! callback for async write of a batch of blocks during eviction
+    void OnWriteBatchComplete(
+        WriteBatch* batch, foxxll::request* req, bool success);
+
     //! callback for async read of blocks for pin requests
     void OnReadComplete(PinRequest* read, foxxll::request* req, bool success);
 
+    //! main loop of the background eviction thread
+    void EvictThread();
+
     //! make ostream-able
     friend std::ostream& operator << (std::ostream& os, const PinCount& p);
 
@@ -45,7 +45,7 @@ ByteBlock::ByteBlock(
 void ByteBlock::Deleter::operator () (ByteBlock* bb) const {
     sLOG << "ByteBlock[" << bb << "]::deleter()"
          << "pin_count_" << bb->pin_count_str();
-    assert(bb->total_pins_ == 0);
+    assert(!bb->IsPinned());
     assert(bb->reference_count() == 0);
 
     // call BlockPool's DestroyBlock() to de-register ByteBlock and free data
@@ -81,7 +81,7 @@ std::ostream& operator << (std::ostream& os, const ByteBlock& b) {
        << " data_=" << static_cast<const void*>(b.data_)
        << " size_=" << b.size_
        << " block_pool_=" << b.block_pool_
-       << " total_pins_=" << b.total_pins_
+       << " pin_count_=" << b.pin_count_str()
        << " ext_file_=" << b.ext_file_;
     return os << "]";
 }
@@ -12,12 +12,14 @@
 #ifndef THRILL_DATA_BYTE_BLOCK_HEADER
 #define THRILL_DATA_BYTE_BLOCK_HEADER
 
+#include <thrill/data/block_codec.hpp>
 #include <thrill/mem/pool.hpp>
 
 #include <foxxll/io/file.hpp>
 #include <foxxll/mng/bid.hpp>
 #include <tlx/counting_ptr.hpp>
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -104,6 +106,13 @@ public:
         return pin_count_.empty();
     }
 
+    //! Set whether the block is compressed when swapped out, Default uses the
+    //! BlockPool's setting.
+    void set_swap_compress(CompressMode mode) { swap_compress_ = mode; }
+
+    //! return whether the block is compressed when swapped out.
+    CompressMode swap_compress() const { return swap_compress_; }
+
     //! increment pin count, must be >= 1 before.
     void IncPinCount(size_t local_worker_id);
 
@@ -111,6 +120,39 @@ public:
     void DecPinCount(size_t local_worker_id);
 
 private:
+    //! Increment pin count of local_worker_id without locking, which succeeds
+    //! only if the worker already holds a pin. The block is then in memory and
+    //! the BlockPool's structures need not change.
+    bool TryIncPinCount(size_t local_worker_id) {
+        std::atomic<size_t>& pc = pin_count_[local_worker_id];
+        size_t p = pc.load(std::memory_order_relaxed);
+        do {
+            if (p == 0) return false;
+        } while (!pc.compare_exchange_weak(p, p + 1));
+        return true;
+    }
+
+    //! Decrement pin count of local_worker_id without locking, which succeeds
+    //! only if it is not the worker's last pin.
+    bool TryDecPinCount(size_t local_worker_id) {
+        std::atomic<size_t>& pc = pin_count_[local_worker_id];
+        size_t p = pc.load(std::memory_order_relaxed);
+        do {
+            if (p <= 1) return false;
+        } while (!pc.compare_exchange_weak(p, p - 1));
+        return true;
+    }
+
+    //! true if any worker holds a pin. This is exact only while holding the
+    //! mutex of the block's BlockPool shard, since the pin counts change from
+    //! and to zero only under it.
+    bool IsPinned() const {
+        for (const std::atomic<size_t>& pc : pin_count_) {
+            if (pc.load(std::memory_order_relaxed) != 0) return true;
+        }
+        return false;
+    }
+
     //! the memory block itself is referenced as it is in a a separate memory
     //! region that can be swapped out
     Byte* data_;
@@ -121,12 +163,12 @@ private:
     //! reference to BlockPool for deletion.
     BlockPool* block_pool_;
 
-    //! counts the number of pins in this block per thread_id.
-    std::vector<size_t, mem::GPoolAllocator<size_t> > pin_count_;
-
-    //! counts the total number of pins, the data_ may be swapped out when this
-    //! reaches zero.
-    size_t total_pins_ = 0;
+    //! counts the number of pins in this block per thread_id. Changes from
+    //! and to zero are made while holding the mutex of the block's BlockPool
+    //! shard, all others may be made without it, see TryIncPinCount() and
+    //! TryDecPinCount(). The data_ may be swapped out when all are zero.
+    std::vector<std::atomic<size_t>,
+                mem::GPoolAllocator<std::atomic<size_t> > > pin_count_;
 
     //! external memory block, which contains a pointer to foxxll::file, an
     //! offset into the file, and (unfortunately) also the size.
@@ -136,6 +178,22 @@ private:
     //! was created for directly reading binary files.
     foxxll::file_ptr ext_file_;
 
+    //! whether to compress the block when swapping out. Set by Files without
+    //! locking, hence atomic.
+    std::atomic<CompressMode> swap_compress_ { CompressMode::Default };
+
+    //! codec of the swapped out copy in em_bid_, None if stored raw.
+    BlockCodec swap_codec_ = BlockCodec::None;
+
+    //! exact size of the compressed copy in em_bid_, which is rounded up.
+    size_t swap_size_ = 0;
+
+    //! buffer holding the compressed copy while it is written or read.
+    Byte* swap_buffer_ = nullptr;
+
+    //! NUMA node data_ was allocated on, if it is from the BlockPool's arena.
+    size_t numa_node_ = 0;
+
     // BlockPool is a friend to call ctor and to manipulate data_.
     friend class BlockPool;
     // Block is a friend to call {Increase,Reduce}PinCount()
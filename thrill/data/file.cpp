@@ -46,6 +46,7 @@ File File::Copy() const {
     f.size_bytes_ = size_bytes_;
     f.stats_bytes_ = stats_bytes_;
     f.stats_items_ = stats_items_;
+    f.swap_compress_ = swap_compress_;
     return f;
 }
 
@@ -139,6 +140,7 @@ void KeepFileBlockSource::Prefetch(size_t prefetch_size) {
             fetching_bytes_ += b.size();
             fetching_blocks_.emplace_back(b.Pin(local_worker_id_));
         }
+        AdviseWillNeed();
     }
     else if (prefetch_size < prefetch_size_) {
         prefetch_size_ = prefetch_size;
@@ -165,6 +167,7 @@ PinnedBlock KeepFileBlockSource::NextBlock() {
             fetching_bytes_ += b.size();
             fetching_blocks_.emplace_back(b.Pin(local_worker_id_));
         }
+        AdviseWillNeed();
 
         // this might block if the prefetching is not finished
         PinnedBlock b = fetching_blocks_.front()->Wait();
@@ -193,6 +196,20 @@ PinnedBlock KeepFileBlockSource::AcquirePin(const Block& block) {
     return block.PinWait(local_worker_id_);
 }
 
+void KeepFileBlockSource::AdviseWillNeed() {
+    // find the end of the look-ahead window, at least one Block
+    size_t end = current_block_;
+    for (size_t bytes = 0; end < file_.num_blocks() &&
+         (end == current_block_ || bytes < prefetch_size_); ++end) {
+        bytes += file_.block(end).size();
+    }
+    // advise the nearest Block last, it becomes the most recently used.
+    for (size_t i = end; i-- > current_block_; ) {
+        file_.block_pool()->AdviseWillNeed(
+            file_.block(i).byte_block().get());
+    }
+}
+
 /******************************************************************************/
 // ConsumeFileBlockSource
 
@@ -222,6 +239,7 @@ void ConsumeFileBlockSource::Prefetch(size_t prefetch_size) {
             fetching_blocks_.emplace_back(b.Pin(local_worker_id_));
             file_->blocks_.pop_front();
         }
+        AdviseWillNeed();
     }
     else if (prefetch_size < prefetch_size_) {
         prefetch_size_ = prefetch_size;
@@ -248,6 +266,7 @@ PinnedBlock ConsumeFileBlockSource::NextBlock() {
         fetching_blocks_.emplace_back(b.Pin(local_worker_id_));
         file_->blocks_.pop_front();
     }
+    AdviseWillNeed();
 
     // this might block if the prefetching is not finished
     PinnedBlock b = fetching_blocks_.front()->Wait();
@@ -279,6 +298,20 @@ PinnedBlock ConsumeFileBlockSource::AcquirePin(const Block& block) {
     return block.PinWait(local_worker_id_);
 }
 
+void ConsumeFileBlockSource::AdviseWillNeed() {
+    // find the end of the look-ahead window, at least one Block
+    size_t end = 0;
+    for (size_t bytes = 0; end < file_->blocks_.size() &&
+         (end == 0 || bytes < prefetch_size_); ++end) {
+        bytes += file_->blocks_[end].size();
+    }
+    // advise the nearest Block last, it becomes the most recently used.
+    for (size_t i = end; i-- > 0; ) {
+        file_->block_pool()->AdviseWillNeed(
+            file_->blocks_[i].byte_block().get());
+    }
+}
+
 ConsumeFileBlockSource::~ConsumeFileBlockSource() {
     if (file_ != nullptr)
         file_->Clear();
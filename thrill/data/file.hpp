@@ -87,6 +87,8 @@ public:
     //! items after the offset first.
     void AppendBlock(const Block& b) {
         if (b.size() == 0) return;
+        if (swap_compress_ != CompressMode::Default)
+            b.byte_block()->set_swap_compress(swap_compress_);
         num_items_sum_.push_back(num_items() + b.num_items());
         size_bytes_ += b.size();
         stats_bytes_ += b.size();
@@ -98,6 +100,8 @@ public:
     //! items after the offset first.
     void AppendBlock(Block&& b) {
         if (b.size() == 0) return;
+        if (swap_compress_ != CompressMode::Default)
+            b.byte_block()->set_swap_compress(swap_compress_);
         num_items_sum_.push_back(num_items() + b.num_items());
         size_bytes_ += b.size();
         stats_bytes_ += b.size();
@@ -251,6 +255,11 @@ public:
     //! construction)
     void set_dia_id(size_t dia_id) { dia_id_ = dia_id; }
 
+    //! Set whether Blocks appended hereafter are compressed when swapped out,
+    //! overriding the BlockPool's codec. Blocks shared with other Files take
+    //! the setting of the File they were appended to last.
+    void set_swap_compress(CompressMode mode) { swap_compress_ = mode; }
+
 private:
     //! unique file id
     size_t id_;
@@ -277,6 +286,9 @@ private:
     //! decreases.
     size_t stats_items_ = 0;
 
+    //! compression of appended Blocks when swapped out
+    CompressMode swap_compress_ = CompressMode::Default;
+
     //! for access to blocks_ and num_items_sum_
     friend class KeepFileBlockSource;
     friend class ConsumeFileBlockSource;
@@ -374,6 +386,11 @@ protected:
     //! NextBlockUnpinned().
     Block MakeNextBlock();
 
+    //! Advise the BlockPool that the Blocks of up to another prefetch_size_
+    //! bytes after the prefetched ones will be read next, such that they are
+    //! not evicted.
+    void AdviseWillNeed();
+
 private:
     //! sentinel value for not changing the first_item item
     static constexpr size_t keep_first_item = size_t(-1);
@@ -445,6 +462,11 @@ public:
     ~ConsumeFileBlockSource();
 
 private:
+    //! Advise the BlockPool that the Blocks of up to another prefetch_size_
+    //! bytes after the prefetched ones will be read next, such that they are
+    //! not evicted.
+    void AdviseWillNeed();
+
     //! file to consume blocks from (ptr to make moving easier)
     File* file_;
 
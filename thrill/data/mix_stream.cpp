@@ -233,6 +233,27 @@ void MixStreamData::OnStreamBlockOrdered(size_t from, Block&& b) {
     seq_[from].seq_++;
 }
 
+void MixStreamData::OnLoopbackBlock(size_t from, Block&& b) {
+    assert(from < num_workers());
+    rx_timespan_.StartEventually();
+
+    sLOG << "MixStreamData::OnLoopbackBlock" << b
+         << "stream" << id_
+         << "from" << from
+         << "for worker" << my_worker_rank();
+
+    if (!b.IsValid()) {
+        // close message: same processing as from the network
+        return OnStreamBlockOrdered(from, std::move(b));
+    }
+
+    rx_int_items_ += b.num_items();
+    rx_int_bytes_ += b.size();
+    rx_int_blocks_++;
+
+    queue_.AppendBlock(from, std::move(b));
+}
+
 /******************************************************************************/
 // MixStream
 
@@ -112,6 +112,11 @@ private:
 
     //! called to process PinnedBlock in sequence
     void OnStreamBlockOrdered(size_t from, Block&& b);
+
+    //! called from a StreamSink on the same host: hands the Block directly
+    //! into the MixBlockQueue. No reordering is needed, since a local sender
+    //! delivers its Blocks in order.
+    void OnLoopbackBlock(size_t from, Block&& b);
 };
 
 // we have two types of MixStream smart pointers: one for internal use in the
@@ -133,6 +133,7 @@ Multiplexer::Multiplexer(mem::Manager& mem_manager, BlockPool& block_pool,
       dispatcher_(dispatcher),
       group_(group),
       workers_per_host_(workers_per_host),
+      net_compression_(workers_per_host),
       d_(std::make_unique<Data>(group_.num_hosts(), workers_per_host)) {
 
     num_parallel_async_ = group_.num_parallel_async();
@@ -311,17 +312,14 @@ void Multiplexer::OnMultiplexerHeader(
         << " num_items=" << header.num_items
         << " first_item=" << header.first_item
         << " typecode_verify=" << header.typecode_verify
+        << " codec=" << BlockCodecName(header.codec)
+        << " wire_size=" << header.wire_size
         << " stream_id=" << header.stream_id;
 
     // received stream id
     StreamId id = header.stream_id;
     size_t local_worker = header.receiver_local_worker;
 
-    // round of allocation size to next power of two
-    size_t alloc_size = header.size;
-    if (alloc_size < THRILL_DEFAULT_ALIGN) alloc_size = THRILL_DEFAULT_ALIGN;
-    alloc_size = tlx::round_up_to_power_of_two(alloc_size);
-
     if (header.magic == MagicByte::CatStreamBlock)
     {
         if (header.IsAllWorkers()) {
@@ -369,14 +367,10 @@ void Multiplexer::OnMultiplexerHeader(
                  << "seq" << header.seq
                  << "size" << header.size;
 
-            PinnedByteBlockPtr bytes = block_pool_.AllocateByteBlock(
-                alloc_size, local_worker);
-            sLOG << "new PinnedByteBlockPtr bytes=" << *bytes;
-
             d_->ongoing_requests_[peer]++;
 
-            dispatcher_.AsyncRead(
-                s, seq + 1, header.size, std::move(bytes),
+            AsyncReadStreamBlock(
+                s, seq + 1, header, local_worker,
                 [this, peer, header, stream](
                     Connection& s, PinnedByteBlockPtr&& bytes) {
                     OnCatStreamBlock(peer, s, header, stream, std::move(bytes));
@@ -428,13 +422,10 @@ void Multiplexer::OnMultiplexerHeader(
                  << "seq" << header.seq
                  << "size" << header.size;
 
-            PinnedByteBlockPtr bytes = block_pool_.AllocateByteBlock(
-                alloc_size, local_worker);
-
             d_->ongoing_requests_[peer]++;
 
-            dispatcher_.AsyncRead(
-                s, seq + 1, header.size, std::move(bytes),
+            AsyncReadStreamBlock(
+                s, seq + 1, header, local_worker,
                 [this, peer, header, stream](
                     Connection& s, PinnedByteBlockPtr&& bytes) mutable {
                     OnMixStreamBlock(peer, s, header, stream, std::move(bytes));
@@ -448,6 +439,39 @@ void Multiplexer::OnMultiplexerHeader(
     AsyncReadMultiplexerHeader(peer, s);
 }
 
+void Multiplexer::AsyncReadStreamBlock(
+    Connection& s, uint32_t seq, const StreamMultiplexerHeader& header,
+    size_t local_worker, const net::AsyncReadByteBlockCallback& done_cb) {
+
+    // round of allocation size to next power of two
+    size_t alloc_size = header.size;
+    if (alloc_size < THRILL_DEFAULT_ALIGN) alloc_size = THRILL_DEFAULT_ALIGN;
+    alloc_size = tlx::round_up_to_power_of_two(alloc_size);
+
+    PinnedByteBlockPtr bytes = block_pool_.AllocateByteBlock(
+        alloc_size, local_worker);
+    sLOG << "new PinnedByteBlockPtr bytes=" << *bytes;
+
+    if (header.codec == BlockCodec::None) {
+        return dispatcher_.AsyncRead(
+            s, seq, header.size, std::move(bytes), done_cb);
+    }
+
+    // compressed payload: receive into a Buffer and expand into the ByteBlock.
+    dispatcher_.AsyncRead(
+        s, seq, header.wire_size,
+        [header, bytes, done_cb](Connection& s, net::Buffer&& buffer) mutable {
+            // received invalid Buffer: the connection has closed?
+            if (!buffer.IsValid()) return;
+
+            die_unless(BlockDecompress(
+                           header.codec, buffer.data(), buffer.size(),
+                           bytes->data(), header.size));
+
+            done_cb(s, std::move(bytes));
+        });
+}
+
 void Multiplexer::OnCatStreamBlock(
     size_t peer, Connection& s, const StreamMultiplexerHeader& header,
     const CatStreamDataPtr& stream, PinnedByteBlockPtr&& bytes) {
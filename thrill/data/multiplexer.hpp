@@ -14,6 +14,7 @@
 #define THRILL_DATA_MULTIPLEXER_HEADER
 
 #include <thrill/common/json_logger.hpp>
+#include <thrill/data/block_codec.hpp>
 #include <thrill/net/dispatcher_thread.hpp>
 #include <thrill/net/group.hpp>
 
@@ -116,6 +117,27 @@ public:
     //! get network group connection
     net::Group& group() { return group_; }
 
+    //! policy and statistics for compressing Blocks sent over the network
+    CompressionPolicy& net_compression() { return net_compression_; }
+
+    //! \name Statistics
+    //! \{
+
+    //! bytes sent by Streams to workers on the same host, which were handed
+    //! over without copying.
+    size_t tx_int_bytes() const { return tx_int_bytes_; }
+
+    //! bytes sent by Streams to workers on other hosts.
+    size_t tx_net_bytes() const { return tx_net_bytes_; }
+
+    //! Blocks sent by Streams to workers on the same host.
+    size_t tx_int_blocks() const { return tx_int_blocks_; }
+
+    //! Blocks sent by Streams to workers on other hosts.
+    size_t tx_net_blocks() const { return tx_net_blocks_; }
+
+    //! \}
+
     //! \name CatStreamData
     //! \{
 
@@ -163,6 +185,9 @@ private:
     //! Number of workers per host
     size_t workers_per_host_;
 
+    //! decides whether to compress outgoing Blocks, shared by all StreamSinks
+    CompressionPolicy net_compression_;
+
     //! protects critical sections
     std::mutex mutex_;
 
@@ -181,10 +206,18 @@ private:
     //! maximu number of active Cat/MixStreams
     std::atomic<size_t> max_active_streams_ { 0 };
 
+    //! host-wide sums of the Streams' statistics of intra-host (loopback) and
+    //! inter-host (network) transfers, added when all writers of a Stream are
+    //! closed.
+    std::atomic<size_t>
+    tx_int_bytes_ { 0 }, tx_net_bytes_ { 0 },
+    tx_int_blocks_ { 0 }, tx_net_blocks_ { 0 };
+
     //! friends for access to network components
     friend class CatStreamData;
     friend class MixStreamData;
     friend class StreamSink;
+    friend class StreamData;
 
     //! Pointer to queue that is used for communication between two workers on
     //! the same host.
@@ -222,6 +255,12 @@ private:
     void OnMultiplexerHeader(
         size_t peer, uint32_t seq, Connection& s, net::Buffer&& buffer);
 
+    //! Receives the payload of a Block announced by header into a new
+    //! ByteBlock, decompressing it if needed, and passes it to done_cb.
+    void AsyncReadStreamBlock(
+        Connection& s, uint32_t seq, const StreamMultiplexerHeader& header,
+        size_t local_worker, const net::AsyncReadByteBlockCallback& done_cb);
+
     //! Receives and dispatches a Block to a CatStreamData
     void OnCatStreamBlock(
         size_t peer, Connection& s, const StreamMultiplexerHeader& header,
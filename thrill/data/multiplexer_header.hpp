@@ -14,6 +14,7 @@
 #define THRILL_DATA_MULTIPLEXER_HEADER_HEADER
 
 #include <thrill/data/block.hpp>
+#include <thrill/data/block_codec.hpp>
 #include <thrill/data/stream.hpp>
 #include <thrill/net/buffer_builder.hpp>
 #include <thrill/net/buffer_reader.hpp>
@@ -47,6 +48,10 @@ public:
     uint32_t typecode_verify : 1;
     //! is last block piggybacked indicator
     uint32_t is_last_block : 1;
+    //! codec of the block payload, if compressed
+    BlockCodec codec = BlockCodec::None;
+    //! bytes of payload following the header, equals size if not compressed
+    uint32_t wire_size = 0;
 
     MultiplexerHeader() = default;
 
@@ -55,13 +60,14 @@ public:
           size(static_cast<uint32_t>(b.size())),
           num_items(static_cast<uint32_t>(b.num_items())),
           first_item(static_cast<uint32_t>(b.first_item_relative())),
-          typecode_verify(b.typecode_verify()) {
+          typecode_verify(b.typecode_verify()),
+          wire_size(static_cast<uint32_t>(b.size())) {
         if (!self_verify)
             assert(!typecode_verify);
     }
 
     static constexpr size_t header_size =
-        sizeof(MagicByte) + 3 * sizeof(uint32_t);
+        sizeof(MagicByte) + sizeof(BlockCodec) + 4 * sizeof(uint32_t);
 
     static constexpr size_t total_size =
         header_size + sizeof(size_t) + 3 * sizeof(uint32_t);
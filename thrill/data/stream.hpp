@@ -57,6 +57,10 @@ public:
     //! once, otherwise the block sequence is incorrectly interleaved!
     virtual Writers GetWriters() = 0;
 
+    //! Set whether Blocks sent over the network are compressed, overriding
+    //! the host-wide policy. Must be called before GetWriters().
+    void set_compress(CompressMode mode) { data().set_compress(mode); }
+
     /*!
      * Scatters a File to many worker: elements from [offset[0],offset[1]) are
      * sent to the first worker, elements from [offset[1], offset[2]) are sent
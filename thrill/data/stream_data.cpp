@@ -59,6 +59,11 @@ void StreamData::OnWriterClosed(size_t peer_worker_rank, bool sent) {
 }
 
 void StreamData::OnAllWritersClosed() {
+    multiplexer_.tx_int_bytes_ += tx_int_bytes_;
+    multiplexer_.tx_net_bytes_ += tx_net_bytes_;
+    multiplexer_.tx_int_blocks_ += tx_int_blocks_;
+    multiplexer_.tx_net_blocks_ += tx_net_blocks_;
+
     multiplexer_.logger()
         << "class" << "StreamData"
         << "event" << "close"
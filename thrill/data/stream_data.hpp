@@ -100,6 +100,11 @@ public:
     //! Number of workers in system
     size_t num_workers() const { return multiplexer_.num_workers(); }
 
+    //! Returns compression mode of Blocks sent over the network
+    CompressMode compress() const { return compress_; }
+    //! Set compression mode of Blocks sent over the network
+    void set_compress(CompressMode mode) { compress_ = mode; }
+
     //! Returns workers_per_host
     size_t workers_per_host() const { return multiplexer_.workers_per_host(); }
     //! Returns my_worker_rank_
@@ -176,6 +181,10 @@ protected:
     //! reference to multiplexer
     Multiplexer& multiplexer_;
 
+    //! compression of Blocks sent over the network, Default uses the
+    //! Multiplexer's CompressionPolicy.
+    CompressMode compress_ = CompressMode::Default;
+
     //! number of remaining expected stream closing operations. Required to know
     //! when to stop rx_lifetime
     std::atomic<size_t> remaining_closing_blocks_;
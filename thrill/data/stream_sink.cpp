@@ -98,70 +98,63 @@ size_t StreamSink::peer_worker_rank() const {
 void StreamSink::AppendBlock(const Block& block, bool is_last_block) {
     if (block.size() == 0) return;
 
-    if (block_queue_) {
-        LOG << "StreamSink::AppendBlock()"
-            << " block=" << block
-            << " is_last_block=" << is_last_block
-            << " id_= " << id_
-            << " host_rank_=" << host_rank_
-            << " local_worker_id_=" << local_worker_id_
-            << " peer_rank_=" << peer_rank_
-            << " peer_local_worker_=" << peer_local_worker_
-            << " item_counter_=" << item_counter_
-            << " byte_counter_=" << byte_counter_
-            << " block_counter_=" << block_counter_;
-
-        // StreamSink statistics
-        item_counter_ += block.num_items();
-        byte_counter_ += block.size();
-        block_counter_++;
-
-        // StreamData statistics for internal transfer
-        stream_->tx_int_items_ += block.num_items();
-        stream_->tx_int_bytes_ += block.size();
-        stream_->tx_int_blocks_++;
+    if (block_queue_ || target_mix_stream_)
+        return AppendLoopbackBlock(Block(block), is_last_block);
 
-        return block_queue_->AppendBlock(block, is_last_block);
-    }
-    if (target_mix_stream_) {
-        LOG << "StreamSink::AppendBlock()"
-            << " block=" << block
-            << " is_last_block=" << is_last_block
-            << " id_= " << id_
-            << " host_rank_=" << host_rank_
-            << " local_worker_id_=" << local_worker_id_
-            << " peer_rank_=" << peer_rank_
-            << " peer_local_worker_=" << peer_local_worker_
-            << " item_counter_=" << item_counter_
-            << " byte_counter_=" << byte_counter_
-            << " block_counter_=" << block_counter_;
-
-        // StreamSink statistics
-        item_counter_ += block.num_items();
-        byte_counter_ += block.size();
-        block_counter_++;
+    // otherwise: pin for network transfer
+    return AppendPinnedBlock(block.PinWait(local_worker_id()), is_last_block);
+}
 
-        // StreamData statistics for internal transfer
-        stream_->tx_int_items_ += block.num_items();
-        stream_->tx_int_bytes_ += block.size();
-        stream_->tx_int_blocks_++;
+void StreamSink::AppendBlock(Block&& block, bool is_last_block) {
+    if (block.size() == 0) return;
 
-        return target_mix_stream_->OnStreamBlock(
-            my_worker_rank(), block_counter_ - 1, Block(block));
-    }
+    if (block_queue_ || target_mix_stream_)
+        return AppendLoopbackBlock(std::move(block), is_last_block);
 
     // otherwise: pin for network transfer
     return AppendPinnedBlock(block.PinWait(local_worker_id()), is_last_block);
 }
 
-void StreamSink::AppendBlock(Block&& block, bool is_last_block) {
-    die("FIXME: this should never be used?");
-    return AppendBlock(block, is_last_block);
+void StreamSink::AppendLoopbackBlock(Block&& block, bool is_last_block) {
+    LOG << "StreamSink::AppendLoopbackBlock()"
+        << " block=" << block
+        << " is_last_block=" << is_last_block
+        << " id_= " << id_
+        << " host_rank_=" << host_rank_
+        << " local_worker_id_=" << local_worker_id_
+        << " peer_rank_=" << peer_rank_
+        << " peer_local_worker_=" << peer_local_worker_
+        << " item_counter_=" << item_counter_
+        << " byte_counter_=" << byte_counter_
+        << " block_counter_=" << block_counter_;
+
+    // StreamSink statistics
+    item_counter_ += block.num_items();
+    byte_counter_ += block.size();
+    block_counter_++;
+
+    // StreamData statistics for internal transfer
+    stream_->tx_int_items_ += block.num_items();
+    stream_->tx_int_bytes_ += block.size();
+    stream_->tx_int_blocks_++;
+
+    // hand over the Block reference: no header, no dispatcher, no copy.
+    if (block_queue_)
+        return block_queue_->AppendBlock(std::move(block), is_last_block);
+
+    return target_mix_stream_->OnLoopbackBlock(
+        my_worker_rank(), std::move(block));
 }
 
 void StreamSink::AppendPinnedBlock(PinnedBlock&& block, bool is_last_block) {
     if (block.size() == 0) return;
 
+    if (block_queue_ || target_mix_stream_) {
+        // the pin is not needed by the receiving worker
+        return AppendLoopbackBlock(
+            std::move(block).MoveToBlock(), is_last_block);
+    }
+
     LOG << "StreamSink::AppendPinnedBlock()"
         << " block=" << block
         << " is_last_block=" << is_last_block
@@ -179,25 +172,6 @@ void StreamSink::AppendPinnedBlock(PinnedBlock&& block, bool is_last_block) {
     byte_counter_ += block.size();
     block_counter_++;
 
-    if (block_queue_) {
-        // StreamData statistics for internal transfer
-        stream_->tx_int_items_ += block.num_items();
-        stream_->tx_int_bytes_ += block.size();
-        stream_->tx_int_blocks_++;
-
-        return block_queue_->AppendPinnedBlock(std::move(block), is_last_block);
-    }
-    if (target_mix_stream_) {
-        // StreamData statistics for internal transfer
-        stream_->tx_int_items_ += block.num_items();
-        stream_->tx_int_bytes_ += block.size();
-        stream_->tx_int_blocks_++;
-
-        return target_mix_stream_->OnStreamBlock(
-            my_worker_rank(), block_counter_ - 1,
-            std::move(block).MoveToBlock());
-    }
-
     LOG0 << "StreamSink::AppendPinnedBlock()"
          << " data=" << tlx::hexdump(block.ToString());
 
@@ -208,28 +182,65 @@ void StreamSink::AppendPinnedBlock(PinnedBlock&& block, bool is_last_block) {
     header.seq = block_counter_ - 1;
     header.is_last_block = is_last_block;
 
+    CompressionPolicy& policy = stream_->multiplexer_.net_compression_;
+
     net::BufferBuilder bb;
+    size_t wire_size = 0;
+
+    if (policy.ShouldCompress(stream_->compress_)) {
+        // compress the block directly behind the header, such that both are
+        // sent out in one piece.
+        const size_t header_size = MultiplexerHeader::total_size;
+        bb.Reserve(
+            header_size + BlockCompressBound(policy.codec(), block.size()));
+        wire_size = policy.Compress(
+            block.data_begin(), block.size(),
+            bb.data() + header_size, bb.capacity() - header_size);
+    }
+
+    if (wire_size != 0) {
+        header.codec = policy.codec();
+        header.wire_size = static_cast<uint32_t>(wire_size);
+    }
+
     header.Serialize(bb);
+    assert(bb.size() == MultiplexerHeader::total_size);
+
+    if (wire_size != 0)
+        bb.set_size(bb.size() + wire_size);
 
     net::Buffer buffer = bb.ToBuffer();
-    assert(buffer.size() == MultiplexerHeader::total_size);
 
-    size_t send_size = buffer.size() + block.size();
+    size_t send_size = buffer.size() + (wire_size != 0 ? 0 : block.size());
     // stream_->sem_queue_.wait(send_size);
 
-    // StreamData statistics for network transfer
+    // StreamData statistics for network transfer, these count uncompressed
+    // bytes such that they match the receiver's statistics.
     stream_->tx_net_items_ += block.num_items();
-    stream_->tx_net_bytes_ += send_size;
+    stream_->tx_net_bytes_ += MultiplexerHeader::total_size + block.size();
     stream_->tx_net_blocks_++;
-    byte_counter_ += buffer.size();
+    byte_counter_ += MultiplexerHeader::total_size;
+
+    policy.OnSendQueued(send_size);
 
-    stream_->multiplexer_.dispatcher_.AsyncWrite(
-        *connection_, 42 + (connection_->tx_seq_.fetch_add(2) & 0xFFFF),
-        // send out Buffer and Block, guaranteed to be successive
-        std::move(buffer), std::move(block),
-        [s = stream_, send_size](net::Connection&) {
+    auto done_cb =
+        [s = stream_, send_size, &policy](net::Connection&) {
+            policy.OnSendDone(send_size);
             s->sem_queue_.signal(send_size);
-        });
+        };
+
+    if (wire_size != 0) {
+        stream_->multiplexer_.dispatcher_.AsyncWrite(
+            *connection_, 42 + (connection_->tx_seq_.fetch_add(2) & 0xFFFF),
+            // send out header and compressed block in one Buffer
+            std::move(buffer), done_cb);
+    }
+    else {
+        stream_->multiplexer_.dispatcher_.AsyncWrite(
+            *connection_, 42 + (connection_->tx_seq_.fetch_add(2) & 0xFFFF),
+            // send out Buffer and Block, guaranteed to be successive
+            std::move(buffer), std::move(block), done_cb);
+    }
 
     if (is_last_block) {
         assert(!closed_);
@@ -270,8 +281,7 @@ void StreamSink::Close() {
         // StreamData statistics for internal transfer
         stream_->tx_int_blocks_++;
         stream_->OnWriterClosed(peer_worker_rank(), /* sent */ true);
-        return target_mix_stream_->OnStreamBlock(
-            my_worker_rank(), block_counter_ - 1, Block());
+        return target_mix_stream_->OnLoopbackBlock(my_worker_rank(), Block());
     }
 
     stream_->OnWriterClosed(peer_worker_rank(), /* sent */ false);
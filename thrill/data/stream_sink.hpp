@@ -105,6 +105,10 @@ public:
 private:
     StreamDataPtr stream_;
 
+    //! Hands a Block to a worker on the same host. Only the Block reference
+    //! is passed into the destination's queue.
+    void AppendLoopbackBlock(Block&& block, bool is_last_block);
+
     //! \name StreamSink To Network
     //! \{
 
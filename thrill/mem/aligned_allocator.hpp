@@ -61,7 +61,9 @@ public:
 
     //! Return allocator for different type.
     template <typename U>
-    struct rebind { using other = AlignedAllocator<U, BaseAllocator>; };
+    struct rebind {
+        using other = AlignedAllocator<U, BaseAllocator, Alignment>;
+    };
 
     //! Construct with base allocator
     explicit AlignedAllocator(const BaseAllocator& base = BaseAllocator())
@@ -72,7 +74,9 @@ public:
 
     //! copy-constructor from a rebound allocator
     template <typename OtherType>
-    AlignedAllocator(const AlignedAllocator<OtherType>& other) noexcept
+    AlignedAllocator(
+        const AlignedAllocator<OtherType, BaseAllocator, Alignment>& other)
+    noexcept
         : base_(other.base()) { }
 
     //! copy-assignment operator
@@ -96,14 +100,18 @@ public:
 
     //! Compare to another allocator of same type
     template <typename Other>
-    bool operator == (const AlignedAllocator<Other>& other) const noexcept {
-        return (base_ == other.base_);
+    bool operator == (
+        const AlignedAllocator<Other, BaseAllocator, Alignment>& other)
+    const noexcept {
+        return (base_ == other.base());
     }
 
     //! Compare to another allocator of same type
     template <typename Other>
-    bool operator != (const AlignedAllocator<Other>& other) const noexcept {
-        return (base_ != other.base_);
+    bool operator != (
+        const AlignedAllocator<Other, BaseAllocator, Alignment>& other)
+    const noexcept {
+        return (base_ != other.base());
     }
 
     /**************************************************************************/
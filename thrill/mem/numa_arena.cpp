@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * thrill/mem/numa_arena.cpp
+ *
+ * Arena carving memory blocks out of hugepages bound to NUMA nodes
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/mem/numa_arena.hpp>
+
+#include <thrill/common/logger.hpp>
+
+#include <tlx/die.hpp>
+#include <tlx/math/integer_log2.hpp>
+#include <tlx/math/is_power_of_two.hpp>
+#include <tlx/math/round_to_power_of_two.hpp>
+#include <tlx/unused.hpp>
+
+#if __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <utility>
+
+#if __linux__
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#endif
+
+namespace thrill {
+namespace mem {
+
+size_t NumaNumNodes() {
+#if __linux__
+    // contains a list of node ranges like "0" or "0-3"
+    std::ifstream in("/sys/devices/system/node/possible");
+    std::string list;
+    if (!(in >> list) || list.empty()) return 1;
+
+    size_t pos = list.find_last_of(",-");
+    size_t last = std::strtoul(
+        list.c_str() + (pos == std::string::npos ? 0 : pos + 1), nullptr, 10);
+    return last + 1;
+#else
+    return 1;
+#endif
+}
+
+size_t NumaNodeOfCpu(size_t cpu_id) {
+#if __linux__
+    // the cpu's sysfs directory contains a link to its node
+    std::string path =
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu_id) + "/node";
+    size_t num_nodes = NumaNumNodes();
+    for (size_t n = 0; n < num_nodes; ++n) {
+        if (access((path + std::to_string(n)).c_str(), F_OK) == 0)
+            return n;
+    }
+#else
+    tlx::unused(cpu_id);
+#endif
+    return 0;
+}
+
+/******************************************************************************/
+// NumaArena
+
+NumaArena::NumaArena(Manager* manager, size_t page_size)
+    : manager_(manager), page_size_(page_size),
+      num_nodes_(NumaNumNodes()) {
+    die_unless(tlx::is_power_of_two(page_size_) && page_size_ >= min_size);
+    free_.resize(num_nodes_);
+    for (std::vector<std::vector<void*> >& f : free_)
+        f.resize(tlx::integer_log2_floor(page_size_) + 1);
+}
+
+NumaArena::~NumaArena() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    die_unequal(num_blocks_, 0u);
+    for (const std::pair<const uintptr_t, size_t>& c : chunks_)
+        UnmapChunk(reinterpret_cast<void*>(c.first), page_size_);
+
+    LOG << "~NumaArena() hugetlb=" << !hugetlb_failed_;
+}
+
+bool NumaArena::IsSupported() {
+#if __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t NumaArena::RoundSize(size_t size) {
+    return size <= min_size ? min_size : tlx::round_up_to_power_of_two(size);
+}
+
+void* NumaArena::allocate(size_t size, size_t node) {
+    if (node >= num_nodes_) node = 0;
+    size = RoundSize(size);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    void* ptr;
+    if (size >= page_size_) {
+        // large blocks are mapped individually
+        ptr = MapChunk(size, node);
+        if (!ptr) throw std::bad_alloc();
+    }
+    else {
+        std::vector<void*>& list = free_[node][tlx::integer_log2_floor(size)];
+        if (list.empty()) {
+            // cut a new chunk into blocks
+            void* chunk = MapChunk(page_size_, node);
+            if (!chunk) throw std::bad_alloc();
+            chunks_.emplace(reinterpret_cast<uintptr_t>(chunk), 0);
+
+            char* p = reinterpret_cast<char*>(chunk) + page_size_;
+            for (size_t i = page_size_ / size; i != 0; --i)
+                list.push_back(p -= size);
+        }
+        ptr = list.back();
+        list.pop_back();
+        ++chunks_[ChunkOf(ptr)];
+    }
+
+    ++num_blocks_;
+    if (manager_) manager_->add(size);
+    return ptr;
+}
+
+void NumaArena::deallocate(void* ptr, size_t size, size_t node) noexcept {
+    if (node >= num_nodes_) node = 0;
+    size = RoundSize(size);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (size >= page_size_) {
+        UnmapChunk(ptr, size);
+    }
+    else {
+        std::vector<void*>& list = free_[node][tlx::integer_log2_floor(size)];
+        list.push_back(ptr);
+
+        // unmap the chunk if all its blocks are free, and the free list holds
+        // at least another chunk's worth of blocks.
+        uintptr_t chunk = ChunkOf(ptr);
+        if (--chunks_[chunk] == 0 && list.size() >= 2 * (page_size_ / size)) {
+            list.erase(
+                std::remove_if(list.begin(), list.end(),
+                               [this, chunk](void* p) {
+                                   return ChunkOf(p) == chunk;
+                               }),
+                list.end());
+            chunks_.erase(chunk);
+            UnmapChunk(reinterpret_cast<void*>(chunk), page_size_);
+        }
+    }
+
+    --num_blocks_;
+    if (manager_) manager_->subtract(size);
+}
+
+size_t NumaArena::mapped_bytes() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return mapped_bytes_;
+}
+
+bool NumaArena::hugetlb() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !hugetlb_failed_;
+}
+
+void* NumaArena::MapChunk(size_t size, size_t node) {
+#if __linux__
+    void* ptr = MAP_FAILED;
+
+    if (!hugetlb_failed_) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+                    | (static_cast<int>(tlx::integer_log2_floor(page_size_))
+                       << MAP_HUGE_SHIFT);
+        ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (ptr == MAP_FAILED) {
+            LOG1 << "NumaArena: could not map " << page_size_
+                 << " byte hugepages: " << strerror(errno)
+                 << ", falling back to transparent hugepages.";
+            hugetlb_failed_ = true;
+        }
+    }
+
+    if (ptr == MAP_FAILED) {
+        // map more to align the chunk to page_size_, then trim both ends.
+        size_t map_size = size + page_size_;
+        char* p = reinterpret_cast<char*>(
+            mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (p == MAP_FAILED) return nullptr;
+
+        char* aligned = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(p) + page_size_ - 1)
+            & ~(page_size_ - 1));
+        size_t head = static_cast<size_t>(aligned - p);
+        if (head != 0)
+            munmap(p, head);
+        if (head != page_size_)
+            munmap(aligned + size, page_size_ - head);
+        ptr = aligned;
+
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+
+    // bind to node before the first touch allocates the pages
+    if (num_nodes_ > 1) {
+        std::vector<unsigned long> mask(
+            num_nodes_ / (8 * sizeof(unsigned long)) + 1);
+        mask[node / (8 * sizeof(unsigned long))] =
+            1ul << (node % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, mask.data(),
+                    mask.size() * 8 * sizeof(unsigned long), 0) != 0 &&
+            !mbind_failed_) {
+            LOG1 << "NumaArena: mbind() to node " << node
+                 << " failed: " << strerror(errno)
+                 << ", memory is not bound to NUMA nodes.";
+            mbind_failed_ = true;
+        }
+    }
+
+    mapped_bytes_ += size;
+
+    LOG << "NumaArena::MapChunk() ptr=" << ptr << " size=" << size
+        << " node=" << node;
+
+    return ptr;
+#else
+    tlx::unused(size, node);
+    return nullptr;
+#endif
+}
+
+void NumaArena::UnmapChunk(void* ptr, size_t size) noexcept {
+#if __linux__
+    munmap(ptr, size);
+    mapped_bytes_ -= size;
+#else
+    tlx::unused(ptr, size);
+#endif
+}
+
+} // namespace mem
+} // namespace thrill
+
+/******************************************************************************/
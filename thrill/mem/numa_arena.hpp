@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * thrill/mem/numa_arena.hpp
+ *
+ * Arena carving memory blocks out of hugepages bound to NUMA nodes
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_MEM_NUMA_ARENA_HEADER
+#define THRILL_MEM_NUMA_ARENA_HEADER
+
+#include <thrill/mem/manager.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace thrill {
+namespace mem {
+
+//! returns the number of NUMA nodes of the machine, one if unknown.
+size_t NumaNumNodes();
+
+//! returns the NUMA node of a cpu, zero if unknown.
+size_t NumaNodeOfCpu(size_t cpu_id);
+
+/*!
+ * An arena which carves power-of-two sized memory blocks out of hugepages,
+ * which are bound to a NUMA node. The arena is used by the BlockPool for the
+ * memory of ByteBlocks, such that a worker's blocks reside on the node it is
+ * pinned to.
+ *
+ * Blocks smaller than a hugepage are cut from hugepage-sized chunks and kept in
+ * per-node and per-size free lists after deallocation. A chunk whose blocks
+ * are all free is unmapped, unless it is the only free chunk of its node and
+ * size, which is kept to avoid remapping it repeatedly. Larger blocks are
+ * mapped individually and unmapped on deallocation.
+ *
+ * Chunks are mapped from the hugetlbfs pool with MAP_HUGETLB. If no hugepages
+ * are reserved, the arena falls back to aligned normal pages and advises the
+ * kernel to back them with transparent hugepages. Binding to NUMA nodes is done
+ * with mbind(MPOL_PREFERRED) before the pages are first touched, and only on
+ * machines with more than one node. A failure of mbind() is reported once.
+ *
+ * Allocated bytes are counted in the given mem::Manager. All methods are
+ * thread-safe.
+ */
+class NumaArena
+{
+    static constexpr bool debug = false;
+
+public:
+    //! smallest block size, smaller requests are rounded up.
+    static constexpr size_t min_size = 4096;
+
+    //! Create an arena with the given hugepage size (2 MiB or 1 GiB).
+    NumaArena(Manager* manager, size_t page_size);
+
+    //! non-copyable: delete copy-constructor
+    NumaArena(const NumaArena&) = delete;
+    //! non-copyable: delete assignment operator
+    NumaArena& operator = (const NumaArena&) = delete;
+
+    //! unmaps all chunks, all blocks must have been deallocated.
+    ~NumaArena();
+
+    //! returns true if hugepage arenas can be used on this system.
+    static bool IsSupported();
+
+    //! allocate a block of size bytes on the NUMA node.
+    void * allocate(size_t size, size_t node);
+
+    //! deallocate a block, size and node must match the allocation.
+    void deallocate(void* ptr, size_t size, size_t node) noexcept;
+
+    //! hugepage size of this arena
+    size_t page_size() const { return page_size_; }
+
+    //! number of NUMA nodes the arena binds to
+    size_t num_nodes() const { return num_nodes_; }
+
+    //! total number of bytes mapped from the system
+    size_t mapped_bytes() const;
+
+    //! whether chunks are mapped from hugetlbfs pages, false after the
+    //! arena fell back to transparent hugepages.
+    bool hugetlb() const;
+
+private:
+    //! mutex protecting the free lists
+    mutable std::mutex mutex_;
+
+    //! memory manager counting allocated blocks
+    Manager* manager_;
+
+    //! hugepage size, and chunk size of small blocks
+    size_t page_size_;
+
+    //! number of NUMA nodes
+    size_t num_nodes_;
+
+    //! whether mapping hugetlbfs pages failed once, after which only the
+    //! fallback is used.
+    bool hugetlb_failed_ = false;
+
+    //! whether binding a chunk to a node failed once, after which failures
+    //! are no longer reported.
+    bool mbind_failed_ = false;
+
+    //! free blocks indexed by node and log2 of the block size
+    std::vector<std::vector<std::vector<void*> > > free_;
+
+    //! chunks mapped for small blocks and their number of allocated blocks,
+    //! indexed by the chunk's address, which is aligned to page_size_.
+    std::unordered_map<uintptr_t, size_t> chunks_;
+
+    //! total number of bytes currently mapped
+    size_t mapped_bytes_ = 0;
+
+    //! number of blocks currently allocated
+    size_t num_blocks_ = 0;
+
+    //! round size up to a power of two, at least min_size.
+    static size_t RoundSize(size_t size);
+
+    //! address of the chunk containing a small block
+    uintptr_t ChunkOf(void* ptr) const {
+        return reinterpret_cast<uintptr_t>(ptr) & ~(page_size_ - 1);
+    }
+
+    //! map size bytes (a multiple of page_size_) bound to node. Returns
+    //! nullptr if the system is out of memory.
+    void * MapChunk(size_t size, size_t node);
+
+    //! unmap a chunk
+    void UnmapChunk(void* ptr, size_t size) noexcept;
+};
+
+} // namespace mem
+} // namespace thrill
+
+#endif // !THRILL_MEM_NUMA_ARENA_HEADER
+
+/******************************************************************************/
@@ -736,7 +736,7 @@ public:
     }
 
     //! Check whether there are still AsyncWrite()s in the queue.
-    bool HasAsyncWrites() const {
+    virtual bool HasAsyncWrites() const {
         return (async_write_.size() != 0) || (async_write_block_.size() != 0);
     }
 
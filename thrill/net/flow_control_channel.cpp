@@ -21,12 +21,17 @@ namespace net {
 FlowControlChannel::FlowControlChannel(
     Group& group, size_t local_id, size_t thread_count,
     common::ThreadBarrier& barrier, LocalData* shmem,
-    std::atomic<size_t>& generation)
+    std::atomic<size_t>& generation,
+    const std::vector<size_t>* group_begin,
+    std::vector<std::unique_ptr<common::ThreadBarrier> >* group_barrier,
+    std::unique_ptr<common::ThreadBarrier>* host_barrier)
     : group_(group),
       host_rank_(group_.my_host_rank()), num_hosts_(group_.num_hosts()),
       local_id_(local_id),
       thread_count_(thread_count),
-      barrier_(barrier), shmem_(shmem), generation_(generation) { }
+      barrier_(barrier), group_begin_(group_begin),
+      group_barrier_(group_barrier), host_barrier_(host_barrier),
+      shmem_(shmem), generation_(generation) { }
 
 FlowControlChannel::~FlowControlChannel() {
     sLOGC(enable_stats)
@@ -53,7 +58,7 @@ void FlowControlChannel::Barrier() {
 
     LOG << "FCC::Barrier() ENTER count=" << count_barrier_;
 
-    barrier_.wait(
+    HierarchicalWait(
         [&]() {
             RunTimer net_timer(timer_communication_);
 
@@ -23,8 +23,10 @@
 #include <array>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -44,6 +46,14 @@ namespace net {
  * methods of two different instances of FlowControlChannel simultaniously by
  * different threads, since the internal synchronization state (the barrier) is
  * shared globally.
+ *
+ * If the local workers are split into socket groups, see
+ * FlowControlChannelManager::SetSocketGroups(), the collectives synchronize
+ * hierarchically: the workers of a socket first meet in their group's barrier,
+ * where the last one combines the socket's values, and only these
+ * representatives meet in the host barrier. Hence waiting workers only spin on
+ * cache lines of their socket, and the host-level step only touches one value
+ * per socket.
  */
 class FlowControlChannel
 {
@@ -93,6 +103,18 @@ private:
     //! node.
     common::ThreadBarrier& barrier_;
 
+    //! Socket groups of the local workers: group g consists of the workers
+    //! [group_begin_[g], group_begin_[g+1]). Owned by the manager.
+    const std::vector<size_t>* group_begin_;
+
+    //! Barriers of the socket groups, and the barrier among the groups'
+    //! representatives. Owned by the manager, unused with only one group.
+    std::vector<std::unique_ptr<common::ThreadBarrier> >* group_barrier_;
+    std::unique_ptr<common::ThreadBarrier>* host_barrier_;
+
+    //! socket group of this worker
+    size_t socket_group_ = 0;
+
     //! Thread local data structure: aligned such that no cache line is
     //! shared. The actual vector is in the FlowControlChannelManager.
     class LocalData
@@ -157,6 +179,8 @@ private:
     //! \{
 
     size_t GetNextStep() {
+        if (group_begin_->size() > 2)
+            return ((*group_barrier_)[socket_group_]->step() + 1) % 2;
         return (barrier_.step() + 1) % 2;
     }
 
@@ -183,12 +207,58 @@ private:
 
     //! \}
 
+    //! \name Hierarchical Barrier
+    //! \{
+
+    //! first worker of each socket group, followed by thread_count_
+    const std::vector<size_t>& GroupBegin() const { return *group_begin_; }
+
+    /*!
+     * Two-level barrier: pre(begin, end) runs once per socket group after its
+     * workers [begin,end) arrived, host() runs once after all groups arrived,
+     * and post(begin, end) runs once per group before its workers are
+     * released. With only one group, all three run in one barrier.
+     */
+    template <typename GroupPre, typename HostFunction, typename GroupPost>
+    void HierarchicalWait(const GroupPre& pre, const HostFunction& host,
+                          const GroupPost& post) {
+        const std::vector<size_t>& begin = *group_begin_;
+        if (begin.size() <= 2) {
+            barrier_.wait(
+                [&]() {
+                    pre(size_t(0), thread_count_);
+                    host();
+                    post(size_t(0), thread_count_);
+                });
+            return;
+        }
+        size_t b = begin[socket_group_], e = begin[socket_group_ + 1];
+        (*group_barrier_)[socket_group_]->wait(
+            [&]() {
+                pre(b, e);
+                (*host_barrier_)->wait(host);
+                post(b, e);
+            });
+    }
+
+    //! Two-level barrier running host() once after all workers arrived.
+    template <typename HostFunction>
+    void HierarchicalWait(const HostFunction& host) {
+        auto noop = [](size_t, size_t) { };
+        HierarchicalWait(noop, host, noop);
+    }
+
+    //! \}
+
 public:
     //! Creates a new instance of this class, wrapping a net::Group.
     FlowControlChannel(
         Group& group, size_t local_id, size_t thread_count,
         common::ThreadBarrier& barrier, LocalData* shmem,
-        std::atomic<size_t>& generation);
+        std::atomic<size_t>& generation,
+        const std::vector<size_t>* group_begin,
+        std::vector<std::unique_ptr<common::ThreadBarrier> >* group_barrier,
+        std::unique_ptr<common::ThreadBarrier>* host_barrier);
 
     //! Return the associated net::Group. USE AT YOUR OWN RISK.
     Group& group() { return group_; }
@@ -240,53 +310,76 @@ public:
         if (enable_stats || debug) ++count_prefixsum_;
         LOG << "FCC::PrefixSum() ENTER count=" << count_prefixsum_;
 
-        T local_value = value;
+        // the value and the offset of the worker's socket group
+        using Shared = std::pair<T, T>;
+
+        Shared local { value, initial };
 
         size_t step = GetNextStep();
 
-        SetLocalShared(step, &local_value);
+        SetLocalShared(step, &local);
 
-        barrier_.wait(
+        HierarchicalWait(
+            [&](size_t begin, size_t end) {
+                // inclusive prefix sum inside the socket group
+                for (size_t i = begin + 1; i < end; i++) {
+                    Shared* s = GetLocalShared<Shared>(step, i);
+                    s->first = sum_op(
+                        GetLocalShared<Shared>(step, i - 1)->first, s->first);
+                }
+            },
             [&]() {
                 RunTimer net_timer(timer_communication_);
 
                 LOG << "FCC::PrefixSum() COMMUNICATE BEGIN"
                     << " count=" << count_prefixsum_;
 
-                // global prefix
-                T** locals = reinterpret_cast<T**>(alloca(thread_count_ * sizeof(T*)));
-
-                for (size_t i = 0; i < thread_count_; i++) {
-                    locals[i] = GetLocalShared<T>(step, i);
-                }
-
-                T local_sum = *(locals[0]);
-                for (size_t i = 1; i < thread_count_; i++) {
-                    *(locals[i]) = local_sum = sum_op(local_sum, *(locals[i]));
+                // prefix sum over the groups' totals, store each group's
+                // offset at its first worker.
+                const std::vector<size_t>& begin = GroupBegin();
+                size_t groups = begin.size() - 1;
+
+                T local_sum = GetLocalShared<Shared>(step, begin[1] - 1)->first;
+                for (size_t g = 1; g < groups; g++) {
+                    GetLocalShared<Shared>(step, begin[g])->second = local_sum;
+                    local_sum = sum_op(
+                        local_sum,
+                        GetLocalShared<Shared>(step, begin[g + 1] - 1)->first);
                 }
 
                 T base_sum = local_sum;
                 group_.ExPrefixSum(base_sum, sum_op, initial);
 
+                GetLocalShared<Shared>(step, 0)->second = base_sum;
+                for (size_t g = 1; g < groups; g++) {
+                    Shared* s = GetLocalShared<Shared>(step, begin[g]);
+                    s->second = sum_op(base_sum, s->second);
+                }
+
+                LOG << "FCC::PrefixSum() COMMUNICATE END"
+                    << " count=" << count_prefixsum_;
+            },
+            [&](size_t begin, size_t end) {
+                // add the group's offset
+                T offset = GetLocalShared<Shared>(step, begin)->second;
                 if (inclusive) {
-                    for (size_t i = 0; i < thread_count_; i++) {
-                        *(locals[i]) = sum_op(base_sum, *(locals[i]));
+                    for (size_t i = begin; i < end; i++) {
+                        Shared* s = GetLocalShared<Shared>(step, i);
+                        s->first = sum_op(offset, s->first);
                     }
                 }
                 else {
-                    for (size_t i = thread_count_ - 1; i > 0; i--) {
-                        *(locals[i]) = sum_op(base_sum, *(locals[i - 1]));
+                    for (size_t i = end - 1; i > begin; i--) {
+                        GetLocalShared<Shared>(step, i)->first = sum_op(
+                            offset, GetLocalShared<Shared>(step, i - 1)->first);
                     }
-                    *(locals[0]) = base_sum;
+                    GetLocalShared<Shared>(step, begin)->first = offset;
                 }
-
-                LOG << "FCC::PrefixSum() COMMUNICATE END"
-                    << " count=" << count_prefixsum_;
             });
 
         LOG << "FCC::PrefixSum() EXIT count=" << count_prefixsum_;
 
-        return local_value;
+        return local.first;
     }
 
     /*!
@@ -355,30 +448,42 @@ public:
         if (enable_stats || debug) ++count_prefixsum_;
         LOG << "FCC::ExPrefixSumTotal() ENTER count=" << count_prefixsum_;
 
-        using Result = std::pair<T*, T>;
+        // pointer to the value, the total, and the offset of the worker's
+        // socket group
+        using Result = std::tuple<T*, T, T>;
 
-        Result result { &value, initial };
+        Result result { &value, initial, initial };
         size_t step = GetNextStep();
         SetLocalShared(step, &result);
 
-        barrier_.wait(
+        HierarchicalWait(
+            [&](size_t begin, size_t end) {
+                // inclusive prefix sum inside the socket group
+                for (size_t i = begin + 1; i < end; ++i) {
+                    T* v = std::get<0>(*GetLocalShared<Result>(step, i));
+                    *v = sum_op(
+                        *std::get<0>(*GetLocalShared<Result>(step, i - 1)), *v);
+                }
+            },
             [&]() {
                 RunTimer net_timer(timer_communication_);
 
                 LOG << "FCC::ExPrefixSumTotal() COMMUNICATE BEGIN"
                     << " count=" << count_prefixsum_;
 
-                Result** locals = reinterpret_cast<Result**>(
-                    alloca(thread_count_ * sizeof(Result*)));
-
-                for (size_t i = 0; i < thread_count_; ++i) {
-                    locals[i] = GetLocalShared<Result>(step, i);
-                }
-
-                T local_sum = *(locals[0]->first);
-                for (size_t i = 1; i < thread_count_; ++i) {
-                    local_sum = sum_op(local_sum, *(locals[i]->first));
-                    *(locals[i]->first) = local_sum;
+                // prefix sum over the groups' totals, store each group's
+                // offset and the total at its first worker.
+                const std::vector<size_t>& begin = GroupBegin();
+                size_t groups = begin.size() - 1;
+
+                T local_sum =
+                    *std::get<0>(*GetLocalShared<Result>(step, begin[1] - 1));
+                for (size_t g = 1; g < groups; ++g) {
+                    std::get<2>(*GetLocalShared<Result>(step, begin[g])) =
+                        local_sum;
+                    local_sum = sum_op(
+                        local_sum, *std::get<0>(
+                            *GetLocalShared<Result>(step, begin[g + 1] - 1)));
                 }
 
                 T base_sum = local_sum;
@@ -389,20 +494,33 @@ public:
                     total_sum = sum_op(base_sum, local_sum);
                 group_.Broadcast(total_sum, num_hosts_ - 1);
 
-                for (size_t i = thread_count_ - 1; i > 0; --i) {
-                    *(locals[i]->first) = sum_op(base_sum, *(locals[i - 1]->first));
-                    locals[i]->second = total_sum;
+                for (size_t g = 0; g < groups; ++g) {
+                    Result* r = GetLocalShared<Result>(step, begin[g]);
+                    std::get<2>(*r) =
+                        g == 0 ? base_sum : sum_op(base_sum, std::get<2>(*r));
+                    std::get<1>(*r) = total_sum;
                 }
-                *(locals[0]->first) = base_sum;
-                locals[0]->second = total_sum;
 
                 LOG << "FCC::ExPrefixSumTotal() COMMUNICATE END"
                     << " count=" << count_prefixsum_;
+            },
+            [&](size_t begin, size_t end) {
+                // shift to exclusive prefix sums and add the group's offset
+                Result* first = GetLocalShared<Result>(step, begin);
+                T offset = std::get<2>(*first), total_sum = std::get<1>(*first);
+                for (size_t i = end - 1; i > begin; --i) {
+                    Result* r = GetLocalShared<Result>(step, i);
+                    *std::get<0>(*r) = sum_op(
+                        offset,
+                        *std::get<0>(*GetLocalShared<Result>(step, i - 1)));
+                    std::get<1>(*r) = total_sum;
+                }
+                *std::get<0>(*first) = offset;
             });
 
         LOG << "FCC::ExPrefixSumTotal() EXIT count=" << count_prefixsum_;
 
-        return result.second;
+        return std::get<1>(result);
     }
 
     /*!
@@ -441,19 +559,28 @@ public:
             group_.Broadcast(local, origin / thread_count_);
         }
 
-        barrier_.wait(
+        HierarchicalWait(
+            [](size_t, size_t) { },
             [&]() {
                 LOG << "FCC::Broadcast() COMMUNICATE BEGIN"
                     << " count=" << count_broadcast_;
 
-                // copy from primary PE to all others
+                // copy from primary PE to the first worker of each group
                 T res = *GetLocalShared<T>(step, primary_pe);
-                for (size_t i = 0; i < thread_count_; i++) {
-                    *GetLocalShared<T>(step, i) = res;
+                const std::vector<size_t>& begin = GroupBegin();
+                for (size_t g = 0; g + 1 < begin.size(); g++) {
+                    *GetLocalShared<T>(step, begin[g]) = res;
                 }
 
                 LOG << "FCC::Broadcast() COMMUNICATE END"
                     << " count=" << count_broadcast_;
+            },
+            [&](size_t begin, size_t end) {
+                // copy inside the group
+                T res = *GetLocalShared<T>(step, begin);
+                for (size_t i = begin + 1; i < end; i++) {
+                    *GetLocalShared<T>(step, i) = res;
+                }
             });
 
         LOG << "FCC::Broadcast() EXIT count=" << count_broadcast_;
@@ -461,6 +588,47 @@ public:
         return local;
     }
 
+    /*!
+     * Broadcasts a value of type T from one worker to all other workers on the
+     * same host. Since no network communication is performed, T need not be
+     * serializable, which allows sharing pointers to host-wide data structures.
+     *
+     * \param value The value to broadcast. This value is ignored for each
+     * worker except the origin.
+     *
+     * \param origin Local worker id to broadcast value from.
+     *
+     * \return The value of the origin worker.
+     */
+    template <typename T>
+    T TLX_ATTRIBUTE_WARN_UNUSED_RESULT
+    LocalBroadcast(const T& value, size_t origin = 0) {
+
+        RunTimer run_timer(timer_broadcast_);
+        if (enable_stats || debug) ++count_broadcast_;
+        LOG << "FCC::LocalBroadcast() ENTER count=" << count_broadcast_;
+
+        assert(origin < thread_count_);
+
+        T local = value;
+
+        size_t step = GetNextStep();
+        SetLocalShared(step, &local);
+
+        HierarchicalWait(
+            [&]() {
+                // copy from origin to all others
+                T res = *GetLocalShared<T>(step, origin);
+                for (size_t i = 0; i < thread_count_; i++) {
+                    *GetLocalShared<T>(step, i) = res;
+                }
+            });
+
+        LOG << "FCC::LocalBroadcast() EXIT count=" << count_broadcast_;
+
+        return local;
+    }
+
     /*!
      * Gathers the value of a serializable type T over all workers and
      * provides result to all workers as a shared pointer to a
@@ -486,7 +654,7 @@ public:
         size_t step = GetNextStep();
         SetLocalShared(step, &local);
 
-        barrier_.wait(
+        HierarchicalWait(
             [&]() {
                 RunTimer net_timer(timer_communication_);
 
@@ -553,17 +721,26 @@ public:
         size_t step = GetNextStep();
         SetLocalShared(step, &local);
 
-        barrier_.wait(
+        HierarchicalWait(
+            [&](size_t begin, size_t end) {
+                // reduce inside the socket group to its first worker
+                T* first = GetLocalShared<T>(step, begin);
+                for (size_t i = begin + 1; i < end; i++) {
+                    *first = sum_op(*first, *GetLocalShared<T>(step, i));
+                }
+            },
             [&]() {
                 RunTimer net_timer(timer_communication_);
 
                 LOG << "FCC::Reduce() COMMUNICATE BEGIN"
                     << " count=" << count_reduce_;
 
-                // local reduce
+                // local reduce over the groups
+                const std::vector<size_t>& begin = GroupBegin();
                 T local_sum = *GetLocalShared<T>(step, 0);
-                for (size_t i = 1; i < thread_count_; i++) {
-                    local_sum = sum_op(local_sum, *GetLocalShared<T>(step, i));
+                for (size_t g = 1; g + 1 < begin.size(); g++) {
+                    local_sum = sum_op(
+                        local_sum, *GetLocalShared<T>(step, begin[g]));
                 }
 
                 // global reduce
@@ -575,7 +752,8 @@ public:
 
                 LOG << "FCC::Reduce() COMMUNICATE END"
                     << " count=" << count_reduce_;
-            });
+            },
+            [](size_t, size_t) { });
 
         LOG << "FCC::Reduce() EXIT count=" << count_reduce_;
 
@@ -607,29 +785,45 @@ public:
         size_t step = GetNextStep();
         SetLocalShared(step, &local);
 
-        barrier_.wait(
+        HierarchicalWait(
+            [&](size_t begin, size_t end) {
+                // reduce inside the socket group to its first worker
+                T* first = GetLocalShared<T>(step, begin);
+                for (size_t i = begin + 1; i < end; i++) {
+                    *first = sum_op(*first, *GetLocalShared<T>(step, i));
+                }
+            },
             [&]() {
                 RunTimer net_timer(timer_communication_);
 
                 LOG << "FCC::AllReduce() COMMUNICATE BEGIN"
                     << " count=" << count_allreduce_;
 
-                // local reduce
+                // local reduce over the groups
+                const std::vector<size_t>& begin = GroupBegin();
                 T local_sum = *GetLocalShared<T>(step, 0);
-                for (size_t i = 1; i < thread_count_; i++) {
-                    local_sum = sum_op(local_sum, *GetLocalShared<T>(step, i));
+                for (size_t g = 1; g + 1 < begin.size(); g++) {
+                    local_sum = sum_op(
+                        local_sum, *GetLocalShared<T>(step, begin[g]));
                 }
 
                 // global reduce
                 group_.AllReduce(local_sum, sum_op);
 
-                // distribute back to local workers
-                for (size_t i = 0; i < thread_count_; i++) {
-                    *GetLocalShared<T>(step, i) = local_sum;
+                // distribute back to the groups
+                for (size_t g = 0; g + 1 < begin.size(); g++) {
+                    *GetLocalShared<T>(step, begin[g]) = local_sum;
                 }
 
                 LOG << "FCC::AllReduce() COMMUNICATE END"
                     << " count=" << count_allreduce_;
+            },
+            [&](size_t begin, size_t end) {
+                // distribute back to local workers
+                T res = *GetLocalShared<T>(step, begin);
+                for (size_t i = begin + 1; i < end; i++) {
+                    *GetLocalShared<T>(step, i) = res;
+                }
             });
 
         LOG << "FCC::AllReduce() EXIT count=" << count_allreduce_;
@@ -764,12 +958,12 @@ public:
         }
 
         // await until all threads have retrieved their value.
-        barrier_.wait([this]() {
-                          LOG << "FCC::Predecessor() COMMUNICATE"
-                              << " count=" << count_predecessor_;
+        HierarchicalWait([this]() {
+                             LOG << "FCC::Predecessor() COMMUNICATE"
+                                 << " count=" << count_predecessor_;
 
-                          generation_++;
-                      });
+                             generation_++;
+                         });
 
         LOG << "FCC::Predecessor() EXIT count=" << count_predecessor_;
 
@@ -17,6 +17,7 @@
 #include <thrill/net/flow_control_channel.hpp>
 #include <thrill/net/group.hpp>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -45,6 +46,15 @@ private:
     //! Host-global generation counter
     std::atomic<size_t> generation_ { 0 };
 
+    //! first worker of each socket group, followed by the number of workers
+    std::vector<size_t> group_begin_;
+
+    //! barriers of the socket groups, only used with more than one group
+    std::vector<std::unique_ptr<common::ThreadBarrier> > group_barrier_;
+
+    //! barrier among the last arriving workers of the socket groups
+    std::unique_ptr<common::ThreadBarrier> host_barrier_;
+
 public:
     /*!
      * Initializes a certain count of flow control channels.
@@ -54,15 +64,55 @@ public:
      */
     FlowControlChannelManager(Group& group, size_t local_worker_count)
         : barrier_(local_worker_count),
-          shmem_(local_worker_count) {
+          shmem_(local_worker_count),
+          group_begin_({ 0, local_worker_count }) {
         assert(shmem_.size() == local_worker_count);
         channels_.reserve(local_worker_count);
         for (size_t i = 0; i < local_worker_count; i++) {
             channels_.emplace_back(group, i, local_worker_count,
-                                   barrier_, shmem_.data(), generation_);
+                                   barrier_, shmem_.data(), generation_,
+                                   &group_begin_, &group_barrier_,
+                                   &host_barrier_);
         }
     }
 
+    /*!
+     * Splits the local workers into socket groups for hierarchical
+     * collectives. Workers of a group must have consecutive ids, and group ids
+     * are consecutive starting from zero, as returned by
+     * common::Topology::SocketGroups(). Must be called before the workers use
+     * their channels.
+     *
+     * \param group_of_worker socket group of each local worker
+     */
+    void SetSocketGroups(const std::vector<size_t>& group_of_worker) {
+        assert(group_of_worker.size() == channels_.size());
+        group_begin_.clear();
+        for (size_t i = 0; i < group_of_worker.size(); i++) {
+            if (i == 0 || group_of_worker[i] != group_of_worker[i - 1]) {
+                assert(group_of_worker[i] == group_begin_.size());
+                group_begin_.push_back(i);
+            }
+            channels_[i].socket_group_ = group_begin_.size() - 1;
+        }
+        group_begin_.push_back(channels_.size());
+
+        size_t num_groups = group_begin_.size() - 1;
+        group_barrier_.clear();
+        host_barrier_.reset();
+        if (num_groups <= 1) return;
+
+        for (size_t g = 0; g < num_groups; g++) {
+            group_barrier_.emplace_back(
+                std::make_unique<common::ThreadBarrier>(
+                    group_begin_[g + 1] - group_begin_[g]));
+        }
+        host_barrier_ = std::make_unique<common::ThreadBarrier>(num_groups);
+    }
+
+    //! number of socket groups of the local workers
+    size_t num_socket_groups() const { return group_begin_.size() - 1; }
+
     /*!
      * \brief Gets all flow control channels for all threads.
      * \return A flow channel for each thread.
@@ -12,7 +12,6 @@
 #include <thrill/net/tcp/connection.hpp>
 #include <thrill/net/tcp/construct.hpp>
 #include <thrill/net/tcp/group.hpp>
-#include <thrill/net/tcp/select_dispatcher.hpp>
 
 #include <tlx/die.hpp>
 
@@ -34,7 +33,7 @@ class Construction
     static constexpr bool debug = false;
 
 public:
-    Construction(SelectDispatcher& dispatcher,
+    Construction(net::Dispatcher& dispatcher,
                  std::unique_ptr<Group>* groups, size_t group_count)
         : dispatcher_(dispatcher),
           groups_(groups),
@@ -128,7 +127,7 @@ private:
     mem::Manager mem_manager_ { nullptr, "Construction" };
 
     //! Dispatcher instance used by this Manager to perform async operations.
-    SelectDispatcher& dispatcher_;
+    net::Dispatcher& dispatcher_;
 
     //! Link to groups to initialize
     std::unique_ptr<Group>* groups_;
@@ -540,7 +539,7 @@ private:
 
 //! Connect to peers via endpoints using TCP sockets. Construct a group_count
 //! tcp::Group objects at once. Within each Group this host has my_rank.
-void Construct(SelectDispatcher& dispatcher, size_t my_rank,
+void Construct(net::Dispatcher& dispatcher, size_t my_rank,
                const std::vector<std::string>& endpoints,
                std::unique_ptr<Group>* groups, size_t group_count) {
     Construction(dispatcher, groups, group_count)
@@ -550,7 +549,7 @@ void Construct(SelectDispatcher& dispatcher, size_t my_rank,
 //! Connect to peers via endpoints using TCP sockets. Construct a group_count
 //! net::Group objects at once. Within each Group this host has my_rank.
 std::vector<std::unique_ptr<net::Group> >
-Construct(SelectDispatcher& dispatcher, size_t my_rank,
+Construct(net::Dispatcher& dispatcher, size_t my_rank,
           const std::vector<std::string>& endpoints, size_t group_count) {
     std::vector<std::unique_ptr<tcp::Group> > tcp_groups(group_count);
     Construction(dispatcher, &tcp_groups[0], tcp_groups.size())
@@ -13,6 +13,7 @@
 #ifndef THRILL_NET_TCP_CONSTRUCT_HEADER
 #define THRILL_NET_TCP_CONSTRUCT_HEADER
 
+#include <thrill/net/dispatcher.hpp>
 #include <thrill/net/tcp/group.hpp>
 
 #include <memory>
@@ -28,14 +29,14 @@ namespace tcp {
 
 //! Connect to peers via endpoints using TCP sockets. Construct a group_count
 //! tcp::Group objects at once. Within each Group this host has my_rank.
-void Construct(SelectDispatcher& dispatcher, size_t my_rank,
+void Construct(net::Dispatcher& dispatcher, size_t my_rank,
                const std::vector<std::string>& endpoints,
                std::unique_ptr<Group>* groups, size_t group_count);
 
 //! Connect to peers via endpoints using TCP sockets. Construct a group_count
 //! net::Group objects at once. Within each Group this host has my_rank.
 std::vector<std::unique_ptr<net::Group> >
-Construct(SelectDispatcher& dispatcher, size_t my_rank,
+Construct(net::Dispatcher& dispatcher, size_t my_rank,
           const std::vector<std::string>& endpoints, size_t group_count);
 
 //! \}
@@ -0,0 +1,260 @@
+/*******************************************************************************
+ * thrill/net/tcp/epoll_dispatcher.cpp
+ *
+ * Asynchronous callback wrapper around edge-triggered epoll()
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/net/tcp/epoll_dispatcher.hpp>
+
+#if THRILL_HAVE_EPOLL
+
+#include <thrill/common/porting.hpp>
+
+#include <unistd.h>
+
+#include <csignal>
+
+namespace thrill {
+namespace net {
+namespace tcp {
+
+EPollDispatcher::EPollDispatcher() : net::Dispatcher(), events_(256) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+        throw Exception("EPollDispatcher() could not create epoll fd", errno);
+
+    // allocate self-pipe
+    common::MakePipe(self_pipe_);
+
+    if (!Socket::SetNonBlocking(self_pipe_[0], true)) {
+        LOG1 << "EPollDispatcher() cannot set up self-pipe for non-blocking reads";
+    }
+
+    // Ignore PIPE signals (received when writing to closed sockets)
+    signal(SIGPIPE, SIG_IGN);
+
+    // wait interrupts via self-pipe.
+    AddRead(self_pipe_[0],
+            Callback::make<EPollDispatcher,
+                           & EPollDispatcher::SelfPipeCallback>(this));
+}
+
+EPollDispatcher::~EPollDispatcher() {
+    ::close(epoll_fd_);
+    ::close(self_pipe_[0]);
+    ::close(self_pipe_[1]);
+}
+
+void EPollDispatcher::Arm(int fd) {
+    Watch& w = watch_[fd];
+
+    uint32_t events = w.events | EPOLLET;
+    if (w.read_cb.size()) events |= EPOLLIN | EPOLLRDHUP;
+    if (w.write_cb.size()) events |= EPOLLOUT;
+    if (w.except_cb) events |= EPOLLPRI;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+
+    // the kernel silently drops closed fds from the interest set, hence a
+    // reused fd may be registered in watch_ but not in epoll, or vice versa.
+    int r = epoll_ctl(epoll_fd_, w.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                      fd, &ev);
+    if (r != 0 && errno == ENOENT)
+        r = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    else if (r != 0 && errno == EEXIST)
+        r = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+
+    if (r != 0)
+        throw Exception("EPollDispatcher() epoll_ctl failed on fd "
+                        + std::to_string(fd), errno);
+
+    w.events = events;
+}
+
+void EPollDispatcher::Disarm(int fd, uint32_t events) {
+    Watch& w = watch_[fd];
+    w.events &= ~events;
+
+    if ((w.events & ~static_cast<uint32_t>(EPOLLET)) == 0) {
+        // nothing left to wait for: remove fd, errors are irrelevant.
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        w.events = 0;
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = w.events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) != 0)
+        throw Exception("EPollDispatcher() epoll_ctl failed on fd "
+                        + std::to_string(fd), errno);
+}
+
+void EPollDispatcher::Cancel(net::Connection& c) {
+    assert(dynamic_cast<Connection*>(&c));
+    Connection& tc = static_cast<Connection&>(c);
+    int fd = tc.GetSocket().fd();
+    CheckSize(fd);
+
+    Watch& w = watch_[fd];
+
+    if (w.read_cb.size() == 0 && w.write_cb.size() == 0)
+        LOG << "EPollDispatcher::Cancel() fd=" << fd
+            << " called with no callbacks registered.";
+
+    w.read_cb.clear();
+    w.write_cb.clear();
+    w.except_cb = Callback();
+
+    if (w.events != 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        w.events = 0;
+    }
+}
+
+bool EPollDispatcher::RunCallbacks(int fd, bool write) {
+    // we use a pointer into the watch_ table. however, since the std::vector
+    // may regrow when callback handlers are called, this pointer is reset a
+    // lot of times.
+    Watch* w = &watch_[fd];
+
+    while ((write ? w->write_cb : w->read_cb).size())
+    {
+        errno = 0;
+        bool again = (write ? w->write_cb : w->read_cb).front()();
+        int err = errno;
+        w = &watch_[fd];
+
+        if (again) {
+            // callback wants to be called again. if it hit EAGAIN, the fd is
+            // drained and the next edge will trigger. otherwise, rearm it.
+            return err != EAGAIN && err != EWOULDBLOCK;
+        }
+
+        // the callback may have cancelled all callbacks on the fd.
+        auto& queue = write ? w->write_cb : w->read_cb;
+        if (queue.size()) queue.pop_front();
+    }
+    return false;
+}
+
+//! Run one iteration of dispatching epoll_wait().
+void EPollDispatcher::DispatchOne(const std::chrono::milliseconds& timeout) {
+
+    int n = epoll_wait(epoll_fd_, events_.data(),
+                       static_cast<int>(events_.size()),
+                       static_cast<int>(timeout.count()));
+
+    if (n < 0) {
+        // if we caught a signal, this is intended to interrupt epoll_wait().
+        if (errno == EINTR) {
+            LOG << "Dispatch(): epoll_wait() was interrupted due to a signal.";
+            return;
+        }
+
+        throw Exception("Dispatch::EPoll() failed!", errno);
+    }
+
+    LOG << "Dispatch(): epoll_wait() returned " << n << " events";
+
+    for (int i = 0; i < n; ++i)
+    {
+        int fd = events_[i].data.fd;
+        uint32_t ev = events_[i].events;
+
+        if (static_cast<size_t>(fd) >= watch_.size()) continue;
+
+        bool rearm = false;
+        uint32_t unused = 0;
+
+        // errors and hang ups are delivered to the callbacks, which then see
+        // the failure in recv() or send().
+        if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            if (watch_[fd].read_cb.size()) {
+                rearm |= RunCallbacks(fd, /* write */ false);
+            }
+            else if (ev & EPOLLIN) {
+                LOG << "EPollDispatcher: got read event for fd "
+                    << fd << " without a read handler.";
+                unused |= EPOLLIN | EPOLLRDHUP;
+            }
+        }
+
+        if (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        {
+            if (watch_[fd].write_cb.size()) {
+                rearm |= RunCallbacks(fd, /* write */ true);
+            }
+            else if (ev & EPOLLOUT) {
+                LOG << "EPollDispatcher: got write event for fd "
+                    << fd << " without a write handler.";
+                unused |= EPOLLOUT;
+            }
+        }
+
+        if (ev & EPOLLPRI)
+        {
+            Watch& w = watch_[fd];
+            if (w.except_cb) {
+                if (!w.except_cb()) {
+                    // callback returned false: remove exception callback
+                    watch_[fd].except_cb = Callback();
+                    unused |= EPOLLPRI;
+                }
+            }
+            else {
+                DefaultExceptionCallback();
+            }
+        }
+
+        Watch& w = watch_[fd];
+        if (w.events == 0) continue;
+
+        if (unused) {
+            // lazily stop listening for directions without callbacks, like
+            // the select() dispatcher does.
+            Disarm(fd, unused);
+        }
+        else if (rearm) {
+            // rearming an edge-triggered fd reports it again if still ready.
+            Arm(fd);
+        }
+    }
+
+    // all slots were used: grow buffer to fetch more events next time.
+    if (static_cast<size_t>(n) == events_.size())
+        events_.resize(2 * events_.size());
+}
+
+void EPollDispatcher::Interrupt() {
+    // send one byte to wake up the epoll_wait() handler.
+    ssize_t wb;
+    while ((wb = write(self_pipe_[1], this, 1)) == 0) {
+        LOG1 << "WakeUp: error sending to self-pipe: " << errno;
+    }
+    die_unless(wb == 1);
+}
+
+bool EPollDispatcher::SelfPipeCallback() {
+    while (read(self_pipe_[0],
+                self_pipe_buffer_, sizeof(self_pipe_buffer_)) > 0) {
+        /* repeat, until empty pipe */
+    }
+    return true;
+}
+
+} // namespace tcp
+} // namespace net
+} // namespace thrill
+
+#endif // THRILL_HAVE_EPOLL
+
+/******************************************************************************/
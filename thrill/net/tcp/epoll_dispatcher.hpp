@@ -0,0 +1,192 @@
+/*******************************************************************************
+ * thrill/net/tcp/epoll_dispatcher.hpp
+ *
+ * Asynchronous callback wrapper around edge-triggered epoll()
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_NET_TCP_EPOLL_DISPATCHER_HEADER
+#define THRILL_NET_TCP_EPOLL_DISPATCHER_HEADER
+
+#include <thrill/common/config.hpp>
+
+#if THRILL_HAVE_EPOLL
+
+#include <thrill/common/logger.hpp>
+#include <thrill/mem/allocator.hpp>
+#include <thrill/net/connection.hpp>
+#include <thrill/net/dispatcher.hpp>
+#include <thrill/net/exception.hpp>
+#include <thrill/net/tcp/connection.hpp>
+#include <thrill/net/tcp/socket.hpp>
+#include <tlx/delegate.hpp>
+#include <tlx/die.hpp>
+
+#include <sys/epoll.h>
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace thrill {
+namespace net {
+namespace tcp {
+
+//! \addtogroup net_tcp TCP Socket API
+//! \{
+
+/*!
+ * EPollDispatcher is a higher level wrapper for edge-triggered epoll(). It
+ * provides the same interface as SelectDispatcher, but the cost of one
+ * dispatch is proportional to the number of ready file descriptors instead of
+ * the number of watched ones, and there is no FD_SETSIZE limit.
+ *
+ * Since epoll is used in edge-triggered mode, a file descriptor is only
+ * reported again once new data arrives or buffer space is freed. Callbacks
+ * follow the same protocol as for select(): they return true if they want to be
+ * called again. If a callback returns true and errno is EAGAIN, then the file
+ * descriptor was drained and we wait for the next edge. Otherwise, we cannot
+ * know whether the descriptor is still ready, and rearm it via EPOLL_CTL_MOD,
+ * which reports it again if it is.
+ */
+class EPollDispatcher final : public net::Dispatcher
+{
+    static constexpr bool debug = false;
+
+public:
+    //! type for file descriptor readiness callbacks
+    using Callback = AsyncCallback;
+
+    //! constructor
+    EPollDispatcher();
+
+    //! non-copyable: delete copy-constructor
+    EPollDispatcher(const EPollDispatcher&) = delete;
+    //! non-copyable: delete assignment operator
+    EPollDispatcher& operator = (const EPollDispatcher&) = delete;
+
+    ~EPollDispatcher();
+
+    //! Grow table if needed
+    void CheckSize(int fd) {
+        assert(fd >= 0);
+        if (static_cast<size_t>(fd) >= watch_.size())
+            watch_.resize(fd + 1);
+    }
+
+    //! Register a buffered read callback and a default exception callback.
+    void AddRead(int fd, const Callback& read_cb) {
+        CheckSize(fd);
+        Watch& w = watch_[fd];
+        w.read_cb.emplace_back(read_cb);
+        // a newly queued callback cannot rely on a past edge: (re)arm fd.
+        if (w.read_cb.size() == 1) Arm(fd);
+    }
+
+    //! Register a buffered read callback and a default exception callback.
+    void AddRead(net::Connection& c, const Callback& read_cb) final {
+        assert(dynamic_cast<Connection*>(&c));
+        Connection& tc = static_cast<Connection&>(c);
+        return AddRead(tc.GetSocket().fd(), read_cb);
+    }
+
+    //! Register a buffered write callback and a default exception callback.
+    void AddWrite(net::Connection& c, const Callback& write_cb) final {
+        assert(dynamic_cast<Connection*>(&c));
+        Connection& tc = static_cast<Connection&>(c);
+        int fd = tc.GetSocket().fd();
+        CheckSize(fd);
+        Watch& w = watch_[fd];
+        w.write_cb.emplace_back(write_cb);
+        if (w.write_cb.size() == 1) Arm(fd);
+    }
+
+    //! Register a buffered write callback and a default exception callback.
+    void SetExcept(net::Connection& c, const Callback& except_cb) {
+        assert(dynamic_cast<Connection*>(&c));
+        Connection& tc = static_cast<Connection&>(c);
+        int fd = tc.GetSocket().fd();
+        CheckSize(fd);
+        watch_[fd].except_cb = except_cb;
+        Arm(fd);
+    }
+
+    //! Cancel all callbacks on a given fd.
+    void Cancel(net::Connection& c) final;
+
+    //! Run one iteration of dispatching epoll_wait().
+    void DispatchOne(const std::chrono::milliseconds& timeout) final;
+
+    //! Interrupt the current epoll_wait() via self-pipe
+    void Interrupt() final;
+
+private:
+    //! epoll file descriptor
+    int epoll_fd_;
+
+    //! self-pipe to wake up epoll_wait().
+    int self_pipe_[2];
+
+    //! buffer to receive one byte signals from self-pipe
+    char self_pipe_buffer_[32];
+
+    //! callback vectors per watched file descriptor
+    struct Watch {
+        //! epoll event mask currently registered in the kernel, zero if the
+        //! fd is not registered.
+        uint32_t events = 0;
+        //! queue of callbacks for fd.
+        std::deque<Callback, mem::GPoolAllocator<Callback> >
+                 read_cb, write_cb;
+        //! only one exception callback for the fd.
+        Callback except_cb;
+    };
+
+    //! handlers for all registered file descriptors, indexed by fd.
+    std::vector<Watch> watch_;
+
+    //! buffer for events returned by epoll_wait(), grows if filled up.
+    std::vector<struct epoll_event> events_;
+
+    //! Add or modify the fd's epoll interest set to include all directions
+    //! with queued callbacks. This also rearms the edge trigger, hence the fd
+    //! is reported again if it is still ready.
+    void Arm(int fd);
+
+    //! Remove events from the fd's epoll interest set, and remove the fd
+    //! entirely if nothing is left.
+    void Disarm(int fd, uint32_t events);
+
+    //! Run the read or write callback queue of fd until a callback wants to be
+    //! called again or the queue is empty. Returns true if the fd must be
+    //! rearmed because it was not drained.
+    bool RunCallbacks(int fd, bool write);
+
+    //! Default exception handler
+    static bool DefaultExceptionCallback() {
+        throw Exception("EPollDispatcher() exception on socket!", errno);
+    }
+
+    //! Self-pipe callback
+    bool SelfPipeCallback();
+};
+
+//! \}
+
+} // namespace tcp
+} // namespace net
+} // namespace thrill
+
+#endif // THRILL_HAVE_EPOLL
+
+#endif // !THRILL_NET_TCP_EPOLL_DISPATCHER_HEADER
+
+/******************************************************************************/
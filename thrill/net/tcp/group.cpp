@@ -15,6 +15,8 @@
 #include <thrill/common/logger.hpp>
 #include <thrill/net/tcp/construct.hpp>
 #include <thrill/net/tcp/group.hpp>
+#include <thrill/net/tcp/epoll_dispatcher.hpp>
+#include <thrill/net/tcp/io_uring_dispatcher.hpp>
 #include <thrill/net/tcp/select_dispatcher.hpp>
 
 #include <random>
@@ -29,8 +31,30 @@ namespace tcp {
 
 std::unique_ptr<Dispatcher>
 Group::ConstructDispatcher() const {
-    // construct tcp::SelectDispatcher
-    return std::make_unique<SelectDispatcher>();
+    // construct default tcp::Dispatcher
+    return std::make_unique<Dispatcher>();
+}
+
+std::unique_ptr<net::Dispatcher>
+Group::ConstructDispatcher(const std::string& name) {
+    if (name.empty())
+        return std::make_unique<Dispatcher>();
+    if (name == "select")
+        return std::make_unique<SelectDispatcher>();
+#if THRILL_HAVE_EPOLL
+    if (name == "epoll")
+        return std::make_unique<EPollDispatcher>();
+#endif
+    if (name == "uring") {
+#if THRILL_HAVE_IO_URING
+        if (IoUringDispatcher::IsSupported())
+            return std::make_unique<IoUringDispatcher>();
+#endif
+        LOG1 << "tcp::Group: io_uring is not supported by the kernel or"
+             << " binary, falling back to the default dispatcher.";
+        return std::make_unique<Dispatcher>();
+    }
+    return nullptr;
 }
 
 std::vector<std::unique_ptr<Group> > Group::ConstructLoopbackMesh(
@@ -88,7 +112,7 @@ std::vector<std::unique_ptr<Group> > Group::ConstructLocalRealTCPMesh(
         threads[i] = std::thread(
             [i, &endpoints, &groups]() {
                 // construct Group i with endpoints -- with temporary Dispatcher
-                net::tcp::SelectDispatcher dispatcher;
+                Dispatcher dispatcher;
                 Construct(dispatcher, i, endpoints, groups.data() + i, 1);
             });
     }
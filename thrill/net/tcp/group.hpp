@@ -16,6 +16,7 @@
 #ifndef THRILL_NET_TCP_GROUP_HEADER
 #define THRILL_NET_TCP_GROUP_HEADER
 
+#include <thrill/common/config.hpp>
 #include <thrill/common/logger.hpp>
 #include <thrill/net/group.hpp>
 #include <thrill/net/tcp/connection.hpp>
@@ -35,6 +36,7 @@ namespace tcp {
 //! \{
 
 class SelectDispatcher;
+class EPollDispatcher;
 
 /*!
  * Collection of NetConnections to workers, allows point-to-point client
@@ -101,10 +103,26 @@ public:
         return tcp_connection(id);
     }
 
+    //! default dispatcher type: select(), or edge-triggered epoll() if
+    //! enabled with THRILL_USE_EPOLL_DISPATCHER. Otherwise, the epoll()
+    //! dispatcher is opt-in via THRILL_NET=tcp-epoll.
+#if THRILL_HAVE_EPOLL && THRILL_DEFAULT_EPOLL_DISPATCHER
+    using Dispatcher = tcp::EPollDispatcher;
+#else
     using Dispatcher = tcp::SelectDispatcher;
+#endif
 
     std::unique_ptr<net::Dispatcher> ConstructDispatcher() const final;
 
+    /*!
+     * Construct a TCP dispatcher by name: "select", "epoll", "uring", or ""
+     * for the default Dispatcher type. "uring" falls back to the default if
+     * the kernel lacks io_uring. Returns nullptr if the name is unknown or the
+     * dispatcher is not supported on this platform.
+     */
+    static std::unique_ptr<net::Dispatcher>
+    ConstructDispatcher(const std::string& name);
+
     /*!
      * Assigns a connection to this net group.  This method swaps the net
      * connection to memory managed by this group.  The reference given to that
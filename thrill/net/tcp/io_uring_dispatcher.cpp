@@ -0,0 +1,576 @@
+/*******************************************************************************
+ * thrill/net/tcp/io_uring_dispatcher.cpp
+ *
+ * Asynchronous callback and block transfer dispatcher using Linux io_uring
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#include <thrill/net/tcp/io_uring_dispatcher.hpp>
+
+#if THRILL_HAVE_IO_URING
+
+#include <thrill/common/porting.hpp>
+#include <thrill/net/tcp/socket.hpp>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+namespace thrill {
+namespace net {
+namespace tcp {
+
+/******************************************************************************/
+// raw io_uring system calls, we do not depend on liburing.
+
+static inline int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static inline int sys_io_uring_enter(
+    int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                nullptr, 0));
+}
+
+static inline int sys_io_uring_register(
+    int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/******************************************************************************/
+// IoUringDispatcher::Request
+
+uint8_t* IoUringDispatcher::Request::data() const {
+    switch (type) {
+    case READ_BUFFER:
+    case WRITE_BUFFER:
+        return const_cast<uint8_t*>(buffer.data());
+    case READ_BYTE_BLOCK:
+        return byte_block->data();
+    case WRITE_BLOCK:
+        return const_cast<uint8_t*>(block.data_begin());
+    }
+    abort();
+}
+
+void IoUringDispatcher::Request::DoCallback() {
+    switch (type) {
+    case READ_BUFFER:
+        if (read_buffer_cb) read_buffer_cb(*conn, std::move(buffer));
+        break;
+    case READ_BYTE_BLOCK:
+        if (read_byte_block_cb) read_byte_block_cb(*conn, std::move(byte_block));
+        break;
+    case WRITE_BUFFER:
+    case WRITE_BLOCK:
+        if (write_cb) write_cb(*conn);
+        // release Pin
+        block.Reset();
+        break;
+    }
+}
+
+/******************************************************************************/
+// IoUringDispatcher
+
+IoUringDispatcher::IoUringDispatcher(unsigned entries) : net::Dispatcher() {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ring_fd_ = sys_io_uring_setup(entries, &p);
+    if (ring_fd_ < 0)
+        throw Exception("IoUringDispatcher() io_uring_setup failed", errno);
+
+    sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+
+    sq_ptr_ = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED)
+        throw Exception("IoUringDispatcher() mmap of SQ ring failed", errno);
+
+    if (single_mmap) {
+        cq_ptr_ = sq_ptr_;
+    }
+    else {
+        cq_ptr_ = mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED)
+            throw Exception("IoUringDispatcher() mmap of CQ ring failed", errno);
+    }
+
+    sqes_map_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_map_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        throw Exception("IoUringDispatcher() mmap of SQEs failed", errno);
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sq_entries_ = p.sq_entries;
+
+    char* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    sq_local_tail_ = *sq_tail_;
+
+    // allocate self-pipe
+    common::MakePipe(self_pipe_);
+
+    if (!Socket::SetNonBlocking(self_pipe_[0], true)) {
+        LOG1 << "IoUringDispatcher() cannot set up self-pipe for non-blocking reads";
+    }
+
+    // Ignore PIPE signals (received when writing to closed sockets)
+    signal(SIGPIPE, SIG_IGN);
+
+    // wait interrupts via self-pipe.
+    AddRead(self_pipe_[0],
+            Callback::make<IoUringDispatcher,
+                           & IoUringDispatcher::SelfPipeCallback>(this));
+}
+
+IoUringDispatcher::~IoUringDispatcher() {
+    // in-flight recv and send requests point into the Requests in watch_ and
+    // zombies_, which are destroyed after the ring.
+    try {
+        Drain();
+    }
+    catch (Exception& e) {
+        LOG1 << "~IoUringDispatcher() cannot drain the ring: " << e.what();
+    }
+
+    munmap(sqes_, sqes_map_size_);
+    if (cq_ptr_ != sq_ptr_)
+        munmap(cq_ptr_, cq_map_size_);
+    munmap(sq_ptr_, sq_map_size_);
+    ::close(ring_fd_);
+    ::close(self_pipe_[0]);
+    ::close(self_pipe_[1]);
+}
+
+bool IoUringDispatcher::IsSupported() {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = sys_io_uring_setup(4, &p);
+    if (fd < 0) {
+        LOG << "IoUringDispatcher: io_uring_setup failed, errno " << errno;
+        return false;
+    }
+
+    // probe for opcodes, which are available since kernel 5.6.
+    std::vector<uint8_t> buf(
+        sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    struct io_uring_probe* probe =
+        reinterpret_cast<struct io_uring_probe*>(buf.data());
+
+    bool supported =
+        sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    for (unsigned op : {
+             IORING_OP_SEND, IORING_OP_RECV, IORING_OP_POLL_ADD,
+             IORING_OP_POLL_REMOVE, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL
+         }) {
+        if (!supported) break;
+        supported = op <= probe->last_op &&
+                    (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    ::close(fd);
+    return supported;
+}
+
+struct io_uring_sqe* IoUringDispatcher::GetSqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    while (sq_local_tail_ - head >= sq_entries_) {
+        // submission queue is full: flush it to the kernel.
+        if (Enter(0, 0) < 0) {
+            if (errno == EBUSY || errno == EAGAIN) {
+                // completion queue is full: move completions aside.
+                ReapDeferred();
+            }
+            else if (errno != EINTR) {
+                throw Exception("IoUringDispatcher() io_uring_enter failed",
+                                errno);
+            }
+        }
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+
+    unsigned index = sq_local_tail_ & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    ++sq_pending_;
+    return sqe;
+}
+
+int IoUringDispatcher::Enter(unsigned min_complete, unsigned flags) {
+    // publish new entries to the kernel
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    int r = sys_io_uring_enter(ring_fd_, sq_pending_, min_complete, flags);
+    if (r > 0) sq_pending_ -= std::min(sq_pending_, static_cast<unsigned>(r));
+    return r;
+}
+
+void IoUringDispatcher::ReapDeferred() {
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        deferred_cqes_.push_back(cqes_[head & *cq_mask_]);
+        ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringDispatcher::AddRead(int fd, const Callback& read_cb) {
+    CheckSize(fd);
+    Watch& w = watch_[fd];
+    w.read_cb.emplace_back(read_cb);
+    if (!w.poll_in) SubmitPoll(fd, /* write */ false);
+}
+
+void IoUringDispatcher::AddWrite(net::Connection& c, const Callback& write_cb) {
+    int fd = GetFd(c);
+    CheckSize(fd);
+    Watch& w = watch_[fd];
+    w.write_cb.emplace_back(write_cb);
+    if (!w.poll_out) SubmitPoll(fd, /* write */ true);
+}
+
+void IoUringDispatcher::Cancel(net::Connection& c) {
+    int fd = GetFd(c);
+    CheckSize(fd);
+    Watch& w = watch_[fd];
+
+    if (w.read_cb.size() == 0 && w.write_cb.size() == 0 &&
+        w.recv_queue.size() == 0 && w.send_queue.size() == 0)
+        LOG << "IoUringDispatcher::Cancel() fd=" << fd
+            << " called with no callbacks registered.";
+
+    // remove in-flight requests from the kernel.
+    auto cancel =
+        [this, fd](Kind kind, unsigned opcode) {
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = static_cast<uint8_t>(opcode);
+            sqe->fd = -1;
+            sqe->addr = MakeUserData(fd, kind);
+            sqe->user_data = kIgnore;
+        };
+
+    if (w.poll_in) cancel(kPollIn, IORING_OP_POLL_REMOVE);
+    if (w.poll_out) cancel(kPollOut, IORING_OP_POLL_REMOVE);
+
+    // in-flight transfers keep their memory until the kernel reports them.
+    if (w.recv_active) {
+        cancel(kRecv, IORING_OP_ASYNC_CANCEL);
+        zombies_.emplace_back(MakeUserData(fd, kRecv),
+                              std::move(w.recv_queue.front()));
+    }
+    if (w.send_active) {
+        cancel(kSend, IORING_OP_ASYNC_CANCEL);
+        zombies_.emplace_back(MakeUserData(fd, kSend),
+                              std::move(w.send_queue.front()));
+    }
+
+    for (Request& r : w.recv_queue) r.conn->rx_active_--;
+    for (Request& r : w.send_queue) r.conn->tx_active_--;
+    num_sends_ -= w.send_queue.size();
+
+    w.read_cb.clear();
+    w.write_cb.clear();
+    w.recv_queue.clear();
+    w.send_queue.clear();
+    w.poll_in = w.poll_out = false;
+    w.recv_active = w.send_active = false;
+    // completions of cancelled requests are now ignored.
+    w.generation++;
+}
+
+void IoUringDispatcher::SubmitPoll(int fd, bool write) {
+    struct io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = write ? POLLOUT : POLLIN;
+    sqe->user_data = MakeUserData(fd, write ? kPollOut : kPollIn);
+    (write ? watch_[fd].poll_out : watch_[fd].poll_in) = true;
+}
+
+void IoUringDispatcher::SubmitTransfer(int fd, bool write) {
+    Watch& w = watch_[fd];
+    Request& r = write ? w.send_queue.front() : w.recv_queue.front();
+
+    uint8_t* data = r.data() + r.pos;
+    size_t size = std::min<size_t>(r.size - r.pos, 1u << 30);
+
+    struct io_uring_sqe* sqe = GetSqe();
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->opcode = write ? IORING_OP_SEND : IORING_OP_RECV;
+    sqe->msg_flags = write ? MSG_NOSIGNAL : 0;
+
+    sqe->user_data = MakeUserData(fd, write ? kSend : kRecv);
+    (write ? w.send_active : w.recv_active) = true;
+}
+
+void IoUringDispatcher::QueueRequest(Request&& r) {
+    int fd = GetFd(*r.conn);
+    CheckSize(fd);
+    Watch& w = watch_[fd];
+
+    bool write = r.is_write();
+    if (write) {
+        r.conn->tx_active_++;
+        num_sends_++;
+        w.send_queue.emplace_back(std::move(r));
+        if (!w.send_active) SubmitTransfer(fd, write);
+    }
+    else {
+        r.conn->rx_active_++;
+        w.recv_queue.emplace_back(std::move(r));
+        if (!w.recv_active) SubmitTransfer(fd, write);
+    }
+}
+
+//! Run one iteration of dispatching io_uring completions.
+void IoUringDispatcher::DispatchOne(const std::chrono::milliseconds& timeout) {
+
+    // queue a timeout, which also completes with the next other completion.
+    timeout_ts_.tv_sec = timeout.count() / 1000;
+    timeout_ts_.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    struct io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&timeout_ts_);
+    sqe->len = 1;
+    sqe->off = 1;
+    sqe->user_data = kTimeout;
+
+    LOG << "Dispatch(): io_uring_enter() submitting " << sq_pending_;
+
+    // submit all queued requests and wait in one system call
+    int r = Enter(deferred_cqes_.empty() ? 1 : 0, IORING_ENTER_GETEVENTS);
+
+    if (r < 0) {
+        if (errno == EINTR) {
+            // if we caught a signal, this is intended to interrupt the wait.
+            LOG << "Dispatch(): io_uring_enter() was interrupted due to a signal.";
+        }
+        else if (errno != EBUSY && errno != EAGAIN) {
+            throw Exception("Dispatch::IoUring() failed!", errno);
+        }
+    }
+
+    // process completions moved aside while flushing.
+    if (!deferred_cqes_.empty()) {
+        std::vector<struct io_uring_cqe> deferred;
+        std::swap(deferred, deferred_cqes_);
+        for (const struct io_uring_cqe& cqe : deferred)
+            HandleCompletion(cqe);
+    }
+
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe cqe = cqes_[head & *cq_mask_];
+        // release the slot before running callbacks, which may submit more.
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        HandleCompletion(cqe);
+        head = *cq_head_;
+    }
+}
+
+void IoUringDispatcher::HandleCompletion(const struct io_uring_cqe& cqe) {
+    Kind kind = static_cast<Kind>(cqe.user_data & 0xF);
+    if (kind == kTimeout || kind == kIgnore) return;
+
+    int fd = static_cast<int>((cqe.user_data >> 4) & 0xFFFFFFFF);
+    assert(static_cast<size_t>(fd) < watch_.size());
+
+    if (cqe.user_data != MakeUserData(fd, kind)) {
+        // completion of a cancelled request: release its memory.
+        for (auto it = zombies_.begin(); it != zombies_.end(); ++it) {
+            if (it->first == cqe.user_data) {
+                zombies_.erase(it);
+                break;
+            }
+        }
+        return;
+    }
+
+    if (kind == kPollIn || kind == kPollOut)
+        HandlePoll(fd, kind == kPollOut);
+    else
+        HandleTransfer(fd, kind == kSend, cqe.res);
+}
+
+void IoUringDispatcher::HandlePoll(int fd, bool write) {
+    // watch_ is a deque, hence the reference remains valid even if callbacks
+    // add new file descriptors.
+    Watch& w = watch_[fd];
+    auto& queue = write ? w.write_cb : w.read_cb;
+    (write ? w.poll_out : w.poll_in) = false;
+
+    // run callbacks until one returns true (in which case it wants to be
+    // called again), or the list is empty.
+    while (queue.size() && queue.front()() == false) {
+        // the callback may have cancelled all callbacks on the fd.
+        if (queue.size()) queue.pop_front();
+    }
+
+    if (queue.size() && !(write ? w.poll_out : w.poll_in))
+        SubmitPoll(fd, write);
+}
+
+void IoUringDispatcher::HandleTransfer(int fd, bool write, int res) {
+    Watch& w = watch_[fd];
+    auto& queue = write ? w.send_queue : w.recv_queue;
+    (write ? w.send_active : w.recv_active) = false;
+
+    assert(queue.size());
+    Request& r = queue.front();
+
+    if (res == -EINTR || res == -EAGAIN) {
+        // these errors are acceptable: just redo the transfer.
+        return SubmitTransfer(fd, write);
+    }
+
+    if (res < 0 || (res == 0 && !write)) {
+        // these errors are end-of-file indications (both good and bad), which
+        // are delivered to the callback.
+        if (res != 0 && res != -EPIPE && res != -ECONNRESET) {
+            throw Exception(write ? "IoUringDispatcher() error in send"
+                            : "IoUringDispatcher() error in recv", -res);
+        }
+        LOG << "IoUringDispatcher() got end-of-file on fd " << fd;
+        // buffer reads deliver an invalid Buffer on end-of-file, as in
+        // net::Dispatcher, instead of the unfilled one.
+        if (r.type == Request::READ_BUFFER)
+            r.buffer = Buffer();
+        r.pos = r.size;
+    }
+    else {
+        r.pos += res;
+        (write ? r.conn->tx_bytes_ : r.conn->rx_bytes_) += res;
+
+        if (r.pos < r.size)
+            return SubmitTransfer(fd, write);
+    }
+
+    // complete request, and start the next one prior to running the callback.
+    Request done = std::move(r);
+    queue.pop_front();
+
+    if (queue.size())
+        SubmitTransfer(fd, write);
+
+    done.DoCallback();
+    (write ? done.conn->tx_active_ : done.conn->rx_active_)--;
+    if (write) num_sends_--;
+}
+
+void IoUringDispatcher::Drain() {
+    // cancelled transfers still in flight, plus the active ones cancelled now
+    size_t inflight = zombies_.size();
+
+    for (size_t fd = 0; fd < watch_.size(); ++fd) {
+        const Watch& w = watch_[fd];
+        for (Kind kind : { kRecv, kSend }) {
+            if (!(kind == kRecv ? w.recv_active : w.send_active)) continue;
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = MakeUserData(static_cast<int>(fd), kind);
+            sqe->user_data = kIgnore;
+            ++inflight;
+        }
+    }
+
+    // each transfer completes exactly once, either normally or cancelled.
+    auto count = [&inflight](const struct io_uring_cqe& cqe) {
+                     Kind kind = static_cast<Kind>(cqe.user_data & 0xF);
+                     if (kind == kRecv || kind == kSend) --inflight;
+                 };
+
+    // wait up to about one second, the completions are usually immediate.
+    for (size_t round = 0; round < 100; ++round) {
+        ReapDeferred();
+        for (const struct io_uring_cqe& cqe : deferred_cqes_) count(cqe);
+        deferred_cqes_.clear();
+        if (inflight == 0) return;
+
+        timeout_ts_.tv_sec = 0;
+        timeout_ts_.tv_nsec = 10 * 1000000;
+
+        struct io_uring_sqe* sqe = GetSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(&timeout_ts_);
+        sqe->len = 1;
+        sqe->off = 1;
+        sqe->user_data = kTimeout;
+
+        if (Enter(1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            throw Exception("IoUringDispatcher() io_uring_enter failed",
+                            errno);
+        }
+    }
+
+    LOG1 << "~IoUringDispatcher() " << inflight
+         << " transfers did not complete after cancellation.";
+}
+
+void IoUringDispatcher::Interrupt() {
+    // send one byte to wake up the io_uring_enter() handler.
+    ssize_t wb;
+    while ((wb = write(self_pipe_[1], this, 1)) == 0) {
+        LOG1 << "WakeUp: error sending to self-pipe: " << errno;
+    }
+    die_unless(wb == 1);
+}
+
+bool IoUringDispatcher::SelfPipeCallback() {
+    while (read(self_pipe_[0],
+                self_pipe_buffer_, sizeof(self_pipe_buffer_)) > 0) {
+        /* repeat, until empty pipe */
+    }
+    return true;
+}
+
+} // namespace tcp
+} // namespace net
+} // namespace thrill
+
+#endif // THRILL_HAVE_IO_URING
+
+/******************************************************************************/
@@ -0,0 +1,355 @@
+/*******************************************************************************
+ * thrill/net/tcp/io_uring_dispatcher.hpp
+ *
+ * Asynchronous callback and block transfer dispatcher using Linux io_uring
+ *
+ * Part of Project Thrill - http://project-thrill.org
+ *
+ *
+ * All rights reserved. Published under the BSD-2 license in the LICENSE file.
+ ******************************************************************************/
+
+#pragma once
+#ifndef THRILL_NET_TCP_IO_URING_DISPATCHER_HEADER
+#define THRILL_NET_TCP_IO_URING_DISPATCHER_HEADER
+
+#include <thrill/common/config.hpp>
+
+#if THRILL_HAVE_IO_URING
+
+#include <thrill/common/logger.hpp>
+#include <thrill/data/block.hpp>
+#include <thrill/data/byte_block.hpp>
+#include <thrill/mem/allocator.hpp>
+#include <thrill/net/buffer.hpp>
+#include <thrill/net/connection.hpp>
+#include <thrill/net/dispatcher.hpp>
+#include <thrill/net/exception.hpp>
+#include <thrill/net/tcp/connection.hpp>
+#include <tlx/die.hpp>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace thrill {
+namespace net {
+namespace tcp {
+
+//! \addtogroup net_tcp TCP Socket API
+//! \{
+
+/*!
+ * IoUringDispatcher implements net::Dispatcher using the Linux io_uring
+ * interface. Asynchronous reads and writes of Buffers and Blocks are not run
+ * via readiness callbacks and one recv()/send() syscall each, instead they are
+ * issued directly as IORING_OP_RECV and IORING_OP_SEND requests. All requests
+ * queued between two dispatches are submitted together with the wait for
+ * completions in a single io_uring_enter() call.
+ *
+ * Per connection and direction only one transfer is in flight, the following
+ * ones are queued, such that the byte stream order is kept.
+ *
+ * Generic AddRead() and AddWrite() readiness callbacks are implemented with
+ * one-shot IORING_OP_POLL_ADD requests, which are reissued while callbacks
+ * remain.
+ *
+ * Use IsSupported() to check whether the running kernel provides io_uring.
+ */
+class IoUringDispatcher final : public net::Dispatcher
+{
+    static constexpr bool debug = false;
+
+public:
+    //! type for file descriptor readiness callbacks
+    using Callback = AsyncCallback;
+
+    //! constructor, entries is the submission queue size.
+    explicit IoUringDispatcher(unsigned entries = 1024);
+
+    //! non-copyable: delete copy-constructor
+    IoUringDispatcher(const IoUringDispatcher&) = delete;
+    //! non-copyable: delete assignment operator
+    IoUringDispatcher& operator = (const IoUringDispatcher&) = delete;
+
+    ~IoUringDispatcher();
+
+    //! check whether the running kernel supports io_uring with all opcodes
+    //! needed by this dispatcher.
+    static bool IsSupported();
+
+    //! Register a buffered read callback.
+    void AddRead(int fd, const Callback& read_cb);
+
+    //! Register a buffered read callback.
+    void AddRead(net::Connection& c, const Callback& read_cb) final {
+        return AddRead(GetFd(c), read_cb);
+    }
+
+    //! Register a buffered write callback.
+    void AddWrite(net::Connection& c, const Callback& write_cb) final;
+
+    //! Cancel all callbacks on a given fd.
+    void Cancel(net::Connection& c) final;
+
+    //! \name Asynchronous Data Reader/Writer Requests
+    //! \{
+
+    void AsyncRead(net::Connection& c, uint32_t /* seq */, size_t size,
+                   const AsyncReadBufferCallback& done_cb) final {
+        assert(c.IsValid());
+
+        if (size == 0) {
+            if (done_cb) done_cb(c, Buffer());
+            return;
+        }
+
+        Request r(Request::READ_BUFFER, c, size);
+        r.buffer = Buffer(size);
+        r.read_buffer_cb = done_cb;
+        QueueRequest(std::move(r));
+    }
+
+    void AsyncRead(net::Connection& c, uint32_t /* seq */, size_t size,
+                   data::PinnedByteBlockPtr&& block,
+                   const AsyncReadByteBlockCallback& done_cb) final {
+        assert(c.IsValid());
+
+        if (block->size() == 0) {
+            if (done_cb) done_cb(c, std::move(block));
+            return;
+        }
+
+        Request r(Request::READ_BYTE_BLOCK, c, size);
+        r.byte_block = std::move(block);
+        r.read_byte_block_cb = done_cb;
+        QueueRequest(std::move(r));
+    }
+
+    void AsyncWrite(
+        net::Connection& c, uint32_t /* seq */, Buffer&& buffer,
+        const AsyncWriteCallback& done_cb = AsyncWriteCallback()) final {
+        assert(c.IsValid());
+
+        if (buffer.size() == 0) {
+            if (done_cb) done_cb(c);
+            return;
+        }
+
+        Request r(Request::WRITE_BUFFER, c, buffer.size());
+        r.buffer = std::move(buffer);
+        r.write_cb = done_cb;
+        QueueRequest(std::move(r));
+    }
+
+    void AsyncWrite(
+        net::Connection& c, uint32_t /* seq */, data::PinnedBlock&& block,
+        const AsyncWriteCallback& done_cb = AsyncWriteCallback()) final {
+        assert(c.IsValid());
+
+        if (block.size() == 0) {
+            if (done_cb) done_cb(c);
+            return;
+        }
+
+        Request r(Request::WRITE_BLOCK, c, block.size());
+        r.block = std::move(block);
+        r.write_cb = done_cb;
+        QueueRequest(std::move(r));
+    }
+
+    //! Check whether there are still AsyncWrite()s in the send queues.
+    bool HasAsyncWrites() const final { return num_sends_ != 0; }
+
+    //! \}
+
+    //! Submit queued requests and wait for and process completions.
+    void DispatchOne(const std::chrono::milliseconds& timeout) final;
+
+    //! Interrupt the current io_uring_enter() via self-pipe
+    void Interrupt() final;
+
+private:
+    //! \name Ring Buffer Mappings
+    //! \{
+
+    //! io_uring file descriptor
+    int ring_fd_ = -1;
+
+    //! mmap()ed submission and completion rings and the submission entries
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_map_size_ = 0, cq_map_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_map_size_ = 0;
+
+    //! pointers into the submission ring
+    unsigned* sq_head_, * sq_tail_, * sq_mask_, * sq_array_;
+    unsigned sq_entries_;
+
+    //! pointers into the completion ring
+    unsigned* cq_head_, * cq_tail_, * cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    //! local submission tail and number of entries not yet submitted
+    unsigned sq_local_tail_ = 0;
+    unsigned sq_pending_ = 0;
+
+    //! completions reaped while flushing a full submission queue, these are
+    //! processed in the next DispatchOne().
+    std::vector<struct io_uring_cqe> deferred_cqes_;
+
+    //! timeout of the current DispatchOne(), must live until submitted.
+    struct __kernel_timespec timeout_ts_;
+
+    //! \}
+
+    //! self-pipe to wake up io_uring_enter().
+    int self_pipe_[2];
+
+    //! buffer to receive one byte signals from self-pipe
+    char self_pipe_buffer_[32];
+
+    //! kinds of requests, stored in the low bits of the user_data field.
+    enum Kind : unsigned {
+        kPollIn = 1, kPollOut, kRecv, kSend, kTimeout, kIgnore
+    };
+
+    //! one queued Buffer or Block transfer, holds the memory and callback.
+    struct Request {
+        enum Type {
+            READ_BUFFER, READ_BYTE_BLOCK, WRITE_BUFFER, WRITE_BLOCK
+        };
+
+        Request(Type _type, net::Connection& _conn, size_t _size)
+            : type(_type), conn(&_conn), size(_size) { }
+
+        //! type of this request
+        Type                       type;
+        //! connection of this request
+        net::Connection            * conn;
+        //! total size to transfer
+        size_t                     size;
+        //! bytes already transferred
+        size_t                     pos = 0;
+
+        //! memory of the request, only one is used
+        Buffer                     buffer;
+        data::PinnedBlock          block;
+        data::PinnedByteBlockPtr   byte_block;
+
+        //! callback to run once complete, only one is used
+        AsyncWriteCallback         write_cb;
+        AsyncReadBufferCallback    read_buffer_cb;
+        AsyncReadByteBlockCallback read_byte_block_cb;
+
+        bool is_write() const {
+            return type == WRITE_BUFFER || type == WRITE_BLOCK;
+        }
+
+        //! begin of memory area to transfer
+        uint8_t * data() const;
+
+        //! deliver result to callback
+        void DoCallback();
+    };
+
+    //! callbacks and request queues per file descriptor
+    struct Watch {
+        //! generation counter, incremented by Cancel() to ignore stale
+        //! completions.
+        uint32_t generation = 0;
+        //! whether a poll request is in flight for reading or writing
+        bool     poll_in = false, poll_out = false;
+        //! whether the front recv or send request is in flight
+        bool     recv_active = false, send_active = false;
+        //! queue of readiness callbacks for fd.
+        std::deque<Callback, mem::GPoolAllocator<Callback> >
+                 read_cb, write_cb;
+        //! queue of transfers for fd.
+        std::deque<Request, mem::GPoolAllocator<Request> >
+                 recv_queue, send_queue;
+    };
+
+    //! handlers for all registered file descriptors, indexed by fd. A deque
+    //! never moves its items on growth, which Request cannot be copied for.
+    std::deque<Watch> watch_;
+
+    //! transfers cancelled while in flight, which must keep their memory
+    //! until the kernel reports completion. Keyed by user_data.
+    std::deque<std::pair<uint64_t, Request>,
+               mem::GPoolAllocator<std::pair<uint64_t, Request> > > zombies_;
+
+    //! number of write requests in all send queues
+    size_t num_sends_ = 0;
+
+    //! return fd of tcp connection
+    static int GetFd(net::Connection& c) {
+        assert(dynamic_cast<Connection*>(&c));
+        return static_cast<Connection&>(c).GetSocket().fd();
+    }
+
+    //! Grow table if needed
+    void CheckSize(int fd) {
+        assert(fd >= 0);
+        if (static_cast<size_t>(fd) >= watch_.size())
+            watch_.resize(fd + 1);
+    }
+
+    //! compose user_data of a request
+    uint64_t MakeUserData(int fd, Kind kind) const {
+        return (uint64_t(watch_[fd].generation) << 36)
+               | (uint64_t(static_cast<uint32_t>(fd)) << 4) | kind;
+    }
+
+    //! get a fresh submission queue entry, flushes the queue if full.
+    struct io_uring_sqe * GetSqe();
+
+    //! submit pending entries and optionally wait for one completion.
+    int Enter(unsigned min_complete, unsigned flags);
+
+    //! copy out all available completions into deferred_cqes_.
+    void ReapDeferred();
+
+    //! queue a one-shot poll request on fd
+    void SubmitPoll(int fd, bool write);
+
+    //! queue recv or send of the front request of fd
+    void SubmitTransfer(int fd, bool write);
+
+    //! enqueue a Buffer or Block transfer request
+    void QueueRequest(Request&& r);
+
+    //! process one completion
+    void HandleCompletion(const struct io_uring_cqe& cqe);
+
+    //! process a completed poll request
+    void HandlePoll(int fd, bool write);
+
+    //! process a completed recv or send request
+    void HandleTransfer(int fd, bool write, int res);
+
+    //! cancel all in-flight transfers and wait for their completions, after
+    //! which the kernel no longer accesses their memory.
+    void Drain();
+
+    //! Self-pipe callback
+    bool SelfPipeCallback();
+};
+
+//! \}
+
+} // namespace tcp
+} // namespace net
+} // namespace thrill
+
+#endif // THRILL_HAVE_IO_URING
+
+#endif // !THRILL_NET_TCP_IO_URING_DISPATCHER_HEADER
+
+/******************************************************************************/